@@ -0,0 +1,28 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * Boot Timing Implementation
+ */
+
+#include "boot_timing.h"
+#include "pico/time.h"
+
+static uint32_t marks[BOOT_MARK_COUNT];
+
+void boot_timing_mark(boot_mark_t mark) {
+    if (marks[mark] != 0) return;
+
+    // 0 means "not reached", so a mark at time 0 is moved to 1 us
+    uint32_t now_us = time_us_32();
+    marks[mark] = now_us ? now_us : 1;
+}
+
+uint32_t boot_timing_get(boot_mark_t mark) {
+    return marks[mark];
+}
+
+uint32_t boot_timing_ready_us(void) {
+    uint32_t ps2 = marks[BOOT_PS2_READY];
+    uint32_t usb = marks[BOOT_USB_MOUNTED];
+    if (ps2 == 0 || usb == 0) return 0;
+    return ps2 > usb ? ps2 : usb;
+}
@@ -0,0 +1,35 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * Boot Timing Header
+ *
+ * Records when each start-up milestone was first reached, in microseconds
+ * since the chip came out of reset (the timer starts then, so the boot ROM
+ * and runtime start-up are included). The keyboard's self-test and USB
+ * enumeration run side by side; the bridge is ready once both are done.
+ * Read with the console's stats command or the telemetry BOOT packet.
+ */
+
+#ifndef BOOT_TIMING_H_
+#define BOOT_TIMING_H_
+
+#include <stdint.h>
+
+typedef enum {
+    BOOT_MAIN = 0,              // main() entered
+    BOOT_USB_STARTED,           // USB stack initialized, host can enumerate
+    BOOT_PS2_READY,             // Keyboard self-test passed (or timed out)
+    BOOT_USB_MOUNTED,           // Host set the configuration
+    BOOT_FIRST_REPORT,          // First keyboard report handed to USB
+    BOOT_MARK_COUNT
+} boot_mark_t;
+
+// Record the current time for a milestone, unless it was already reached
+void boot_timing_mark(boot_mark_t mark);
+
+// Time a milestone was reached in us, or 0 if not yet
+uint32_t boot_timing_get(boot_mark_t mark);
+
+// Time both the keyboard and USB were ready in us, or 0 if not yet
+uint32_t boot_timing_ready_us(void);
+
+#endif /* BOOT_TIMING_H_ */
@@ -0,0 +1,57 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * Clock Governor Decisions
+ *
+ * Times are microseconds from a free-running 32-bit counter; only
+ * differences are used, and they stay far below the wrap-around since
+ * clock_gov_update() runs every main loop pass.
+ */
+
+#include "clock_gov.h"
+
+static clock_gov_state_t state = CLOCK_GOV_FULL;
+static uint32_t last_active_us = 0;
+static uint32_t wake_us = 0;
+static uint32_t slowdowns = 0;
+
+void clock_gov_init(uint32_t now_us) {
+    state = CLOCK_GOV_FULL;
+    last_active_us = now_us;
+    wake_us = 0;
+    slowdowns = 0;
+}
+
+clock_gov_action_t clock_gov_update(uint32_t now_us, bool active) {
+    switch (state) {
+        case CLOCK_GOV_FULL:
+            if (active) {
+                last_active_us = now_us;
+            } else if (now_us - last_active_us >= CLOCK_GOV_IDLE_MS * 1000u) {
+                state = CLOCK_GOV_LOW;
+                slowdowns++;
+                return CLOCK_GOV_SLOW_DOWN;
+            }
+            return CLOCK_GOV_NONE;
+
+        case CLOCK_GOV_LOW:
+            if (!active) return CLOCK_GOV_NONE;
+            state = CLOCK_GOV_WAKING;
+            wake_us = now_us;
+            return CLOCK_GOV_VOLTAGE_UP;
+
+        case CLOCK_GOV_WAKING:
+            if (now_us - wake_us < CLOCK_GOV_SETTLE_US) return CLOCK_GOV_NONE;
+            state = CLOCK_GOV_FULL;
+            last_active_us = now_us;
+            return CLOCK_GOV_SPEED_UP;
+    }
+    return CLOCK_GOV_NONE;
+}
+
+clock_gov_state_t clock_gov_state(void) {
+    return state;
+}
+
+uint32_t clock_gov_slowdowns(void) {
+    return slowdowns;
+}
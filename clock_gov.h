@@ -0,0 +1,85 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * Clock Governor Header
+ *
+ * Optional (CLOCK_GOV_ENABLE): after CLOCK_GOV_IDLE_MS without key
+ * activity the system clock is divided down and the core voltage lowered.
+ * On the first sign of activity (a PS/2 clock edge makes ps2_idle() false)
+ * the voltage is raised at once and the clock follows after
+ * CLOCK_GOV_SETTLE_US. The PS/2 sampling loop keeps running throughout,
+ * just with longer passes at the low clock, so the first frame is decoded
+ * while the clock comes back up.
+ *
+ * clock_gov.c only makes the decisions and has no hardware dependencies,
+ * so it runs on the host (tests/test_clock_gov.c, tools/clock_gov_sim.py).
+ * clock_gov_pico.c applies them.
+ */
+
+#ifndef CLOCK_GOV_H_
+#define CLOCK_GOV_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef CLOCK_GOV_ENABLE
+#define CLOCK_GOV_ENABLE        0
+#endif
+
+// Slow down after this long without activity (ms)
+#ifndef CLOCK_GOV_IDLE_MS
+#define CLOCK_GOV_IDLE_MS       10000
+#endif
+
+// Idle system clock = full clock / CLOCK_GOV_LOW_DIV (an integer, so the
+// PLL keeps running and the switch is immediate). Reduced if the result
+// would be below CLOCK_GOV_MIN_HZ.
+#ifndef CLOCK_GOV_LOW_DIV
+#define CLOCK_GOV_LOW_DIV       2
+#endif
+
+// Lowest idle system clock; the USB controller gets no slower clock than
+// its own 48 MHz
+#ifndef CLOCK_GOV_MIN_HZ
+#define CLOCK_GOV_MIN_HZ        48000000
+#endif
+
+// Core voltage while idle (a VREG_VOLTAGE_* value, see hardware/vreg.h)
+#ifndef CLOCK_GOV_LOW_VOLTAGE
+#define CLOCK_GOV_LOW_VOLTAGE   VREG_VOLTAGE_1_00
+#endif
+
+// Time for the regulator to reach the full voltage before the clock goes up
+#ifndef CLOCK_GOV_SETTLE_US
+#define CLOCK_GOV_SETTLE_US     1000
+#endif
+
+typedef enum {
+    CLOCK_GOV_FULL = 0,         // Full clock and voltage
+    CLOCK_GOV_LOW,              // Divided clock, low voltage
+    CLOCK_GOV_WAKING,           // Full voltage, clock still divided
+} clock_gov_state_t;
+
+typedef enum {
+    CLOCK_GOV_NONE = 0,
+    CLOCK_GOV_SLOW_DOWN,        // Divide the clock, then lower the voltage
+    CLOCK_GOV_VOLTAGE_UP,       // Raise the voltage
+    CLOCK_GOV_SPEED_UP,         // Restore the full clock
+} clock_gov_action_t;
+
+// Start at full speed
+void clock_gov_init(uint32_t now_us);
+
+// Decide, once per main loop pass, whether to change speed; active is true
+// while a PS/2 frame or key is in progress
+clock_gov_action_t clock_gov_update(uint32_t now_us, bool active);
+
+clock_gov_state_t clock_gov_state(void);
+
+// Number of slow-downs since boot
+uint32_t clock_gov_slowdowns(void);
+
+// Device side (clock_gov_pico.c): set up the clocks and apply decisions
+void clock_gov_start(void);
+void clock_gov_task(bool active);
+
+#endif /* CLOCK_GOV_H_ */
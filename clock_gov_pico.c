@@ -0,0 +1,68 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * Clock Governor - Clock and Regulator Control
+ *
+ * clk_sys stays on the system PLL and only its integer divider changes,
+ * so a switch takes effect at once and the PLL never relocks. Everything
+ * else timing-related is independent of clk_sys: the microsecond timer
+ * ticks from clk_ref, USB runs from the USB PLL, and clk_peri (UART) is
+ * moved to the USB PLL at start. The PS/2 decoder is polled and times
+ * nothing in CPU cycles, so no divider needs adjusting on a switch.
+ */
+
+#include "clock_gov.h"
+
+#if CLOCK_GOV_ENABLE
+
+#include "pico/stdlib.h"
+#include "hardware/clocks.h"
+#include "hardware/vreg.h"
+#include "hardware/uart.h"
+
+static uint32_t full_hz = 0;
+static uint32_t low_hz = 0;
+
+static void set_sys_hz(uint32_t hz) {
+    clock_configure(clk_sys, CLOCKS_CLK_SYS_CTRL_SRC_VALUE_CLKSRC_CLK_SYS_AUX,
+                    CLOCKS_CLK_SYS_CTRL_AUXSRC_VALUE_CLKSRC_PLL_SYS, full_hz, hz);
+}
+
+void clock_gov_start(void) {
+    full_hz = clock_get_hz(clk_sys);
+
+    uint32_t div = CLOCK_GOV_LOW_DIV;
+    while (div > 1 && full_hz / div < CLOCK_GOV_MIN_HZ) div--;
+    low_hz = full_hz / div;
+
+    // Keep the UART's clock (and baud rate) independent of clk_sys
+    clock_configure(clk_peri, 0, CLOCKS_CLK_PERI_CTRL_AUXSRC_VALUE_CLKSRC_PLL_USB,
+                    48 * MHZ, 48 * MHZ);
+#ifdef uart_default
+    uart_set_baudrate(uart_default, PICO_DEFAULT_UART_BAUD_RATE);
+#endif
+
+    clock_gov_init(time_us_32());
+}
+
+void clock_gov_task(bool active) {
+    switch (clock_gov_update(time_us_32(), active)) {
+        case CLOCK_GOV_SLOW_DOWN:
+            if (low_hz == full_hz) break;
+            set_sys_hz(low_hz);
+            vreg_set_voltage(CLOCK_GOV_LOW_VOLTAGE);
+            break;
+
+        case CLOCK_GOV_VOLTAGE_UP:
+            vreg_set_voltage(VREG_VOLTAGE_DEFAULT);
+            break;
+
+        case CLOCK_GOV_SPEED_UP:
+            set_sys_hz(full_hz);
+            break;
+
+        default:
+            break;
+    }
+}
+
+#endif /* CLOCK_GOV_ENABLE */
@@ -0,0 +1,236 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * Combo (Chord) Detection Implementation
+ */
+
+#include "combo.h"
+#include "hid_keycodes.h"
+#include <string.h>
+
+//--------------------------------------------------------------------+
+// Combo Definitions
+//--------------------------------------------------------------------+
+
+typedef struct {
+    uint8_t keys[COMBO_MAX_KEYS];   // 2 or more keys, unused entries 0
+    uint8_t output;                 // Keycode sent instead
+} combo_t;
+
+static const combo_t combos[] = {
+#if COMBO_EXAMPLE
+    { { HID_KEY_J, HID_KEY_K }, HID_KEY_ESCAPE },
+#endif
+#ifdef COMBO_DEFINITIONS
+#include COMBO_DEFINITIONS
+#endif
+    { { 0 }, 0 }  // Terminator (keeps the array non-empty)
+};
+
+#define COMBO_COUNT             (sizeof(combos) / sizeof(combos[0]) - 1)
+#define COMBO_WORDS             ((COMBO_COUNT + 31) / 32 + (COMBO_COUNT == 0))
+
+//--------------------------------------------------------------------+
+// Combo State
+//--------------------------------------------------------------------+
+
+static key_sink_t next_stage = NULL;
+static uint16_t term_ms = COMBO_TERM_MS;
+
+// Precomputed index: combos containing each key, combos of each size
+static uint32_t key_combos[256][COMBO_WORDS];
+static uint32_t size_combos[COMBO_MAX_KEYS + 1][COMBO_WORDS];
+static uint32_t combo_keys[256 / 32];  // Keys used by any combo
+
+static uint32_t key_down[256 / 32];    // Physical key state, filters typematic repeats
+static uint16_t fired_combo[256];      // Combo index + 1 a key's press was used for
+static uint32_t output_down[COMBO_WORDS];
+
+// Keys held back while a combo may still complete
+static uint32_t candidates[COMBO_WORDS];
+static uint8_t held_keys[COMBO_MAX_KEYS];
+static uint32_t held_times[COMBO_MAX_KEYS];
+static uint8_t held_count = 0;
+
+//--------------------------------------------------------------------+
+// Helper Functions
+//--------------------------------------------------------------------+
+
+static inline bool test_bit(const uint32_t* bits, unsigned n) {
+    return (bits[n >> 5] >> (n & 31)) & 1u;
+}
+
+static inline void set_bit(uint32_t* bits, unsigned n, bool value) {
+    if (value) {
+        bits[n >> 5] |= 1u << (n & 31);
+    } else {
+        bits[n >> 5] &= ~(1u << (n & 31));
+    }
+}
+
+// Lowest combo index set in both masks, or -1
+static int first_common(const uint32_t* a, const uint32_t* b) {
+    for (unsigned w = 0; w < COMBO_WORDS; w++) {
+        uint32_t both = a[w] & b[w];
+        if (both) return (int) (w * 32 + __builtin_ctz(both));
+    }
+    return -1;
+}
+
+// A combo of exactly the held keys, or -1
+static int complete_combo(void) {
+    return first_common(candidates, size_combos[held_count]);
+}
+
+// True if a candidate combo needs more keys than are held
+static bool larger_candidate(void) {
+    for (unsigned w = 0; w < COMBO_WORDS; w++) {
+        if (candidates[w] & ~size_combos[held_count][w]) return true;
+    }
+    return false;
+}
+
+static void fire(int index, uint32_t time_ms) {
+    for (uint8_t i = 0; i < held_count; i++) {
+        fired_combo[held_keys[i]] = (uint16_t) (index + 1);
+    }
+    held_count = 0;
+
+    set_bit(output_down, (unsigned) index, true);
+    next_stage(combos[index].output, true, time_ms);
+}
+
+// No more keys can join: send the completed combo, or the held keys as typed
+static void settle(uint32_t time_ms) {
+    int index = complete_combo();
+    if (index >= 0) {
+        fire(index, time_ms);
+        return;
+    }
+
+    for (uint8_t i = 0; i < held_count; i++) {
+        next_stage(held_keys[i], true, held_times[i]);
+    }
+    held_count = 0;
+}
+
+static void handle_press(uint8_t key, uint32_t time_ms) {
+    if (held_count != 0) {
+        uint32_t narrowed[COMBO_WORDS];
+        bool possible = false;
+        for (unsigned w = 0; w < COMBO_WORDS; w++) {
+            narrowed[w] = candidates[w] & key_combos[key][w];
+            possible |= narrowed[w] != 0;
+        }
+
+        if (!possible) {
+            // Key cannot extend any candidate - stop waiting and start over
+            settle(time_ms);
+        } else {
+            memcpy(candidates, narrowed, sizeof(candidates));
+            held_keys[held_count] = key;
+            held_times[held_count] = time_ms;
+            held_count++;
+
+            // Send right away unless a longer combo is still possible
+            if (complete_combo() >= 0 && !larger_candidate()) {
+                settle(time_ms);
+            }
+            return;
+        }
+    }
+
+    if (!test_bit(combo_keys, key)) {
+        next_stage(key, true, time_ms);
+        return;
+    }
+
+    memcpy(candidates, key_combos[key], sizeof(candidates));
+    held_keys[0] = key;
+    held_times[0] = time_ms;
+    held_count = 1;
+}
+
+static void handle_release(uint8_t key, uint32_t time_ms) {
+    for (uint8_t i = 0; i < held_count; i++) {
+        if (held_keys[i] == key) {
+            // A held key let go before the combo completed
+            settle(time_ms);
+            break;
+        }
+    }
+
+    uint16_t fired = fired_combo[key];
+    if (fired != 0) {
+        // The first released key of a combo releases its output
+        fired_combo[key] = 0;
+        if (test_bit(output_down, fired - 1u)) {
+            set_bit(output_down, fired - 1u, false);
+            next_stage(combos[fired - 1].output, false, time_ms);
+        }
+        return;
+    }
+
+    next_stage(key, false, time_ms);
+}
+
+//--------------------------------------------------------------------+
+// Public Interface
+//--------------------------------------------------------------------+
+
+void combo_init(key_sink_t sink) {
+    next_stage = sink;
+
+    memset(key_combos, 0, sizeof(key_combos));
+    memset(size_combos, 0, sizeof(size_combos));
+    memset(combo_keys, 0, sizeof(combo_keys));
+
+    for (unsigned c = 0; combos[c].keys[0] != 0; c++) {
+        unsigned size = 0;
+        for (unsigned i = 0; i < COMBO_MAX_KEYS && combos[c].keys[i] != 0; i++) {
+            set_bit(key_combos[combos[c].keys[i]], c, true);
+            set_bit(combo_keys, combos[c].keys[i], true);
+            size++;
+        }
+        set_bit(size_combos[size], c, true);
+    }
+
+    memset(key_down, 0, sizeof(key_down));
+    memset(fired_combo, 0, sizeof(fired_combo));
+    memset(output_down, 0, sizeof(output_down));
+    held_count = 0;
+}
+
+void combo_process(uint8_t key, bool pressed, uint32_t time_ms) {
+    // Drop typematic repeats and releases of keys that are not down
+    if (test_bit(key_down, key) == pressed) return;
+    set_bit(key_down, key, pressed);
+
+    // Window ran out before this event arrived
+    if (held_count != 0 && time_ms - held_times[0] >= term_ms) {
+        settle(held_times[0] + term_ms);
+    }
+
+    if (pressed) {
+        handle_press(key, time_ms);
+    } else {
+        handle_release(key, time_ms);
+    }
+}
+
+void combo_task(uint32_t now_ms) {
+    if (held_count != 0 && now_ms - held_times[0] >= term_ms) {
+        settle(held_times[0] + term_ms);
+    }
+}
+
+bool combo_pending(void) {
+    return held_count != 0;
+}
+
+void combo_set_term(uint16_t ms) {
+    term_ms = ms;
+}
+
+uint16_t combo_get_term(void) {
+    return term_ms;
+}
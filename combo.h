@@ -0,0 +1,59 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * Combo (Chord) Detection Header
+ *
+ * A combo is a set of keys pressed within COMBO_TERM_MS of each other that
+ * sends a different keycode, e.g. J+K -> Esc. Keys that belong to a combo
+ * are held back only while some combo can still complete; any other key
+ * passes straight through.
+ *
+ * Matching keeps a bitmask of candidate combos. Each press ANDs it with the
+ * precomputed mask of combos containing that key, so the cost per event
+ * grows with the number of mask words (combos / 32), not with the number
+ * of combos or their keys.
+ */
+
+#ifndef COMBO_H_
+#define COMBO_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "key_event.h"
+
+// Time window in which all keys of a combo must be pressed
+#ifndef COMBO_TERM_MS
+#define COMBO_TERM_MS           30
+#endif
+
+// Maximum number of keys in one combo
+#ifndef COMBO_MAX_KEYS
+#define COMBO_MAX_KEYS          4
+#endif
+
+// Build the example combo (J+K -> Esc)
+#ifndef COMBO_EXAMPLE
+#define COMBO_EXAMPLE           0
+#endif
+
+// Combos can also come from a file of combo table entries, e.g.
+// -DCOMBO_DEFINITIONS='"my_combos.h"' with lines like
+//   { { HID_KEY_J, HID_KEY_K }, HID_KEY_ESCAPE },
+
+// Initialize combo matching; key events are passed on to sink
+void combo_init(key_sink_t sink);
+
+// Feed a key event from the decoder
+void combo_process(uint8_t key, bool pressed, uint32_t time_ms);
+
+// Resolve held-back keys whose combo window has run out
+// Call regularly, e.g. from the PS/2 polling loop
+void combo_task(uint32_t now_ms);
+
+// True while keys are held back waiting for a combo to complete
+bool combo_pending(void);
+
+// Change the combo window (takes effect for the next decision)
+void combo_set_term(uint16_t ms);
+uint16_t combo_get_term(void);
+
+#endif /* COMBO_H_ */
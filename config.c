@@ -0,0 +1,360 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * Configuration Protocol Implementation
+ *
+ * Keymap writes are staged: a layer only changes when all of it has been
+ * received and committed, so a half-written layer is never active.
+ *
+ * Changed settings and layers are saved in the configuration store (see
+ * store.h). Values equal to the build's defaults are deleted from it, so
+ * a new firmware's defaults apply to them.
+ */
+
+#include "config.h"
+#include "keymap.h"
+#include "debounce.h"
+#include "taphold.h"
+#include "combo.h"
+#include "socd.h"
+#include "usb_descriptors.h"
+#include "usb_profile.h"
+#include "store.h"
+#include "keystats.h"
+#include <string.h>
+
+#define DATA_SIZE               (CONFIG_REPORT_SIZE - CONFIG_HEADER_SIZE)
+
+// Store keys: parameters use their CONFIG_PARAM_* number
+#define STORE_KEY_LAYER(layer)  (0x10 + (layer))
+#define STORE_KEY_KEYSTATS      0x30
+
+static uint8_t response[CONFIG_REPORT_SIZE];
+static uint8_t poll_interval_ms = HID_POLL_INTERVAL_MS;
+static bool reconnect_requested = false;
+static bool keymap_reset_pending = false;  // DEFAULTS waits for held keys
+
+// Keymap layer being written
+static uint8_t staged[CONFIG_LAYER_SIZE];
+static uint8_t staged_layer = 0xFF;
+static uint16_t staged_bytes = 0;
+
+static inline uint32_t get_u32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static inline void put_u32(uint8_t* p, uint32_t value) {
+    p[0] = (uint8_t) value;
+    p[1] = (uint8_t) (value >> 8);
+    p[2] = (uint8_t) (value >> 16);
+    p[3] = (uint8_t) (value >> 24);
+}
+
+//--------------------------------------------------------------------+
+// Parameters
+//--------------------------------------------------------------------+
+
+static bool get_param(uint8_t param, uint32_t* value) {
+    switch (param) {
+        case CONFIG_PARAM_POLL_INTERVAL: *value = poll_interval_ms; return true;
+        case CONFIG_PARAM_DEBOUNCE_MS:   *value = debounce_get_window(); return true;
+        case CONFIG_PARAM_TAPHOLD_TERM:  *value = taphold_get_term(); return true;
+        case CONFIG_PARAM_COMBO_TERM:    *value = combo_get_term(); return true;
+        case CONFIG_PARAM_SOCD_MODE:     *value = socd_get_mode(); return true;
+        case CONFIG_PARAM_USB_PROFILE:   *value = usb_profile_requested(); return true;
+        default: return false;
+    }
+}
+
+static uint32_t default_param(uint8_t param) {
+    switch (param) {
+        case CONFIG_PARAM_POLL_INTERVAL: return HID_POLL_INTERVAL_MS;
+        case CONFIG_PARAM_DEBOUNCE_MS:   return DEBOUNCE_MS;
+        case CONFIG_PARAM_TAPHOLD_TERM:  return TAPHOLD_TERM_MS;
+        case CONFIG_PARAM_COMBO_TERM:    return COMBO_TERM_MS;
+        case CONFIG_PARAM_SOCD_MODE:     return SOCD_MODE;
+        case CONFIG_PARAM_USB_PROFILE:   return USB_PROFILE_DEFAULT;
+        default: return 0;
+    }
+}
+
+static bool set_param(uint8_t param, uint32_t value) {
+    switch (param) {
+        case CONFIG_PARAM_POLL_INTERVAL:
+            if (value < 1 || value > 255) return false;
+            poll_interval_ms = (uint8_t) value;
+            return true;
+        case CONFIG_PARAM_DEBOUNCE_MS:
+            if (value > 255) return false;
+            debounce_set_window((uint8_t) value);
+            return true;
+        case CONFIG_PARAM_TAPHOLD_TERM:
+            if (value < 1 || value > 0xFFFF) return false;
+            taphold_set_term((uint16_t) value);
+            return true;
+        case CONFIG_PARAM_COMBO_TERM:
+            if (value < 1 || value > 0xFFFF) return false;
+            combo_set_term((uint16_t) value);
+            return true;
+        case CONFIG_PARAM_SOCD_MODE:
+            if (value > SOCD_MODE_FIRST_INPUT) return false;
+            socd_set_mode((uint8_t) value);
+            return true;
+        case CONFIG_PARAM_USB_PROFILE:
+            return value <= 0xFF && usb_profile_request((uint8_t) value);
+        default:
+            return false;
+    }
+}
+
+//--------------------------------------------------------------------+
+// Keymap Transfer
+//--------------------------------------------------------------------+
+
+static uint8_t keymap_read(const uint8_t* data, uint8_t* out) {
+    uint8_t layer = data[0];
+    uint16_t offset = (uint16_t) (data[1] | (data[2] << 8));
+    if (layer >= KEYMAP_NUM_LAYERS || offset >= CONFIG_LAYER_SIZE || (offset & 1)) {
+        return CONFIG_ERR_ARGUMENT;
+    }
+
+    uint8_t count = CONFIG_CHUNK_SIZE;
+    if (CONFIG_LAYER_SIZE - offset < count) count = (uint8_t) (CONFIG_LAYER_SIZE - offset);
+
+    memcpy(out, data, 3);
+    out[3] = count;
+    for (uint8_t i = 0; i < count; i += 2) {
+        uint16_t action = keymap_get(layer, (uint8_t) ((offset + i) / 2));
+        out[4 + i] = (uint8_t) action;
+        out[5 + i] = (uint8_t) (action >> 8);
+    }
+    return CONFIG_OK;
+}
+
+static uint8_t keymap_write(const uint8_t* data) {
+    uint8_t layer = data[0];
+    uint16_t offset = (uint16_t) (data[1] | (data[2] << 8));
+    uint8_t count = data[3];
+    if (layer >= KEYMAP_NUM_LAYERS || count > CONFIG_CHUNK_SIZE ||
+        offset + count > CONFIG_LAYER_SIZE) {
+        return CONFIG_ERR_ARGUMENT;
+    }
+
+    // Offset 0 starts a new layer
+    if (offset == 0) {
+        staged_layer = layer;
+        staged_bytes = 0;
+    }
+    if (layer != staged_layer || offset != staged_bytes) return CONFIG_ERR_SEQUENCE;
+
+    memcpy(&staged[offset], &data[4], count);
+    staged_bytes += count;
+    return CONFIG_OK;
+}
+
+static uint8_t keymap_commit(uint8_t layer) {
+    if (layer != staged_layer || staged_bytes != CONFIG_LAYER_SIZE) return CONFIG_ERR_SEQUENCE;
+    // Would be undone by the restore of a DEFAULTS request still waiting
+    if (keymap_reset_pending) return CONFIG_ERR_SEQUENCE;
+
+    for (int key = 0; key < 256; key++) {
+        keymap_set(layer, (uint8_t) key, (uint16_t) (staged[2 * key] | (staged[2 * key + 1] << 8)));
+    }
+    staged_layer = 0xFF;
+    staged_bytes = 0;
+    config_save_layer(layer);
+    return CONFIG_OK;
+}
+
+//--------------------------------------------------------------------+
+// Persistence
+//--------------------------------------------------------------------+
+
+// Current contents of a store key, NULL if it is at its default
+static const void* store_source(uint8_t key, uint16_t* len) {
+    static uint8_t value[4];
+    uint32_t v;
+
+    if (key == STORE_KEY_KEYSTATS) return keystats_record(len);
+
+    if (key >= STORE_KEY_LAYER(0) && key < STORE_KEY_LAYER(KEYMAP_NUM_LAYERS)) {
+        uint8_t layer = (uint8_t) (key - STORE_KEY_LAYER(0));
+        if (keymap_layer_is_default(layer)) return NULL;
+        *len = CONFIG_LAYER_SIZE;
+        return keymap_layer(layer);
+    }
+
+    if (!get_param(key, &v) || v == default_param(key)) return NULL;
+    put_u32(value, v);
+    *len = sizeof(value);
+    return value;
+}
+
+// Read saved layers in place from flash
+static void use_saved_layers(void) {
+    for (uint8_t layer = 0; layer < KEYMAP_NUM_LAYERS; layer++) {
+        uint16_t len;
+        const void* actions = store_get(STORE_KEY_LAYER(layer), &len);
+        if (actions && len == CONFIG_LAYER_SIZE) keymap_use_layer(layer, actions);
+    }
+}
+
+//--------------------------------------------------------------------+
+// Public Interface
+//--------------------------------------------------------------------+
+
+void config_init(void) {
+    memset(response, 0, sizeof(response));
+    poll_interval_ms = HID_POLL_INTERVAL_MS;
+    reconnect_requested = false;
+    keymap_reset_pending = false;
+    staged_layer = 0xFF;
+    staged_bytes = 0;
+}
+
+void config_request(const uint8_t* report, uint16_t len) {
+    uint8_t data[DATA_SIZE] = {0};
+    uint8_t* out = &response[CONFIG_HEADER_SIZE];
+    uint8_t status = CONFIG_OK;
+    uint32_t value;
+
+    memset(response, 0, sizeof(response));
+    response[0] = CONFIG_PROTOCOL_VERSION;
+    if (len < CONFIG_HEADER_SIZE) {
+        response[3] = CONFIG_ERR_ARGUMENT;
+        return;
+    }
+    response[1] = report[1];
+    response[2] = report[2];
+
+    if (report[0] != CONFIG_PROTOCOL_VERSION) {
+        response[3] = CONFIG_ERR_VERSION;
+        return;
+    }
+
+    // Missing data bytes read as zero
+    uint16_t data_len = report[3];
+    if (data_len > len - CONFIG_HEADER_SIZE) data_len = len - CONFIG_HEADER_SIZE;
+    if (data_len > DATA_SIZE) data_len = DATA_SIZE;
+    memcpy(data, &report[CONFIG_HEADER_SIZE], data_len);
+
+    switch (report[1]) {
+        case CONFIG_CMD_INFO:
+            out[0] = KEYMAP_NUM_LAYERS;
+            out[1] = CONFIG_CHUNK_SIZE;
+            out[2] = CONFIG_REPORT_SIZE;
+            break;
+
+        case CONFIG_CMD_GET_PARAM:
+            if (!get_param(data[0], &value)) {
+                status = CONFIG_ERR_ARGUMENT;
+                break;
+            }
+            out[0] = data[0];
+            put_u32(&out[1], value);
+            break;
+
+        case CONFIG_CMD_SET_PARAM:
+            if (!set_param(data[0], get_u32(&data[1])) || !get_param(data[0], &value)) {
+                status = CONFIG_ERR_ARGUMENT;
+                break;
+            }
+            config_save_param(data[0]);
+            out[0] = data[0];
+            put_u32(&out[1], value);
+            break;
+
+        case CONFIG_CMD_KEYMAP_READ:
+            status = keymap_read(data, out);
+            break;
+
+        case CONFIG_CMD_KEYMAP_WRITE:
+            status = keymap_write(data);
+            break;
+
+        case CONFIG_CMD_KEYMAP_COMMIT:
+            status = keymap_commit(data[0]);
+            break;
+
+        case CONFIG_CMD_DEFAULTS:
+            debounce_set_window(DEBOUNCE_MS);
+            taphold_set_term(TAPHOLD_TERM_MS);
+            combo_set_term(COMBO_TERM_MS);
+            socd_set_mode(SOCD_MODE);
+            poll_interval_ms = HID_POLL_INTERVAL_MS;
+            usb_profile_request(USB_PROFILE_DEFAULT);
+            staged_layer = 0xFF;
+            staged_bytes = 0;
+
+            // A held key would be released through the built-in keymap, not
+            // as what it was pressed as, and stay down: the keymap is
+            // restored once no key is held (at once if none is)
+            keymap_reset_pending = true;
+            config_task();
+            break;
+
+        case CONFIG_CMD_RECONNECT:
+            reconnect_requested = true;
+            break;
+
+        default:
+            status = CONFIG_ERR_COMMAND;
+            break;
+    }
+    response[3] = status;
+}
+
+uint16_t config_response(uint8_t* report) {
+    memcpy(report, response, CONFIG_REPORT_SIZE);
+    return CONFIG_REPORT_SIZE;
+}
+
+uint8_t config_poll_interval(void) {
+    return poll_interval_ms;
+}
+
+void config_task(void) {
+    if (!keymap_reset_pending || keymap_keys_down()) return;
+    keymap_reset_pending = false;
+    keymap_init();
+
+    // Defaults are not stored, this deletes every saved value
+    for (uint8_t key = 1; key < STORE_MAX_KEYS; key++) store_mark_dirty(key);
+}
+
+bool config_take_reconnect(void) {
+    bool requested = reconnect_requested;
+    reconnect_requested = false;
+    return requested;
+}
+
+void config_load(void) {
+    store_init(store_source);
+
+    for (uint8_t param = 1; param < STORE_KEY_LAYER(0); param++) {
+        uint16_t len;
+        const uint8_t* value = store_get(param, &len);
+        if (value && len == 4) set_param(param, get_u32(value));
+    }
+    use_saved_layers();
+
+    uint16_t len;
+    const void* counts = store_get(STORE_KEY_KEYSTATS, &len);
+    if (counts) keystats_restore(counts, len);
+}
+
+void config_save_param(uint8_t param) {
+    store_mark_dirty(param);
+}
+
+void config_save_layer(uint8_t layer) {
+    if (layer < KEYMAP_NUM_LAYERS) store_mark_dirty(STORE_KEY_LAYER(layer));
+}
+
+void config_save_keystats(void) {
+    store_mark_dirty(STORE_KEY_KEYSTATS);
+}
+
+void config_store_flushed(void) {
+    // Saved layers may have moved, edited ones now have a saved copy
+    use_saved_layers();
+}
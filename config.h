@@ -0,0 +1,98 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * Configuration Protocol Header
+ *
+ * Optional (CONFIG_ENABLE) protocol for changing the keymap and timing
+ * settings at runtime, carried in 64-byte feature reports on the keyboard
+ * interface so no extra driver is needed. The host sends a request with
+ * SET_REPORT(Feature) and reads the response with GET_REPORT(Feature).
+ * tools/config.py is the host CLI.
+ *
+ * The handler has no USB dependencies and can be built natively.
+ */
+
+#ifndef CONFIG_H_
+#define CONFIG_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef CONFIG_ENABLE
+#define CONFIG_ENABLE           0
+#endif
+
+// Bumped on incompatible changes; requests with another version fail
+#define CONFIG_PROTOCOL_VERSION 1
+
+#define CONFIG_REPORT_SIZE      64
+#define CONFIG_HEADER_SIZE      4
+
+// Keymap bytes per KEYMAP_READ / KEYMAP_WRITE chunk
+#define CONFIG_CHUNK_SIZE       48
+
+// A layer blob is 256 little-endian 16-bit actions (see keymap.h)
+#define CONFIG_LAYER_SIZE       (256 * 2)
+
+// Request:  [version, command, tag, data length] + data
+// Response: [version, command, tag, status] + data
+// The tag is echoed so the host can match a response to its request.
+#define CONFIG_CMD_INFO         0x01    // -> [layers, chunk size, report size]
+#define CONFIG_CMD_GET_PARAM    0x02    // [param] -> [param, value LE32]
+#define CONFIG_CMD_SET_PARAM    0x03    // [param, value LE32] -> [param, value LE32]
+#define CONFIG_CMD_KEYMAP_READ  0x04    // [layer, offset LE16] -> [layer, offset LE16, count, bytes]
+#define CONFIG_CMD_KEYMAP_WRITE 0x05    // [layer, offset LE16, count, bytes], in order from offset 0
+#define CONFIG_CMD_KEYMAP_COMMIT 0x06   // [layer]: the staged layer replaces the active one
+#define CONFIG_CMD_DEFAULTS     0x07    // Restore built-in settings and keymap
+#define CONFIG_CMD_RECONNECT    0x08    // Re-enumerate, e.g. to apply the poll interval
+
+#define CONFIG_OK               0
+#define CONFIG_ERR_VERSION      1
+#define CONFIG_ERR_COMMAND      2
+#define CONFIG_ERR_ARGUMENT     3
+#define CONFIG_ERR_SEQUENCE     4       // Chunk out of order, layer incomplete or
+                                        // DEFAULTS waiting for keys to be released
+
+#define CONFIG_PARAM_POLL_INTERVAL  0x01    // Keyboard bInterval ms (1-255), from the next enumeration
+#define CONFIG_PARAM_DEBOUNCE_MS    0x02    // Chatter window (0-255)
+#define CONFIG_PARAM_TAPHOLD_TERM   0x03    // Tap-hold term ms (1-65535)
+#define CONFIG_PARAM_COMBO_TERM     0x04    // Combo window ms (1-65535)
+#define CONFIG_PARAM_SOCD_MODE      0x05    // SOCD_MODE_* (0-3)
+#define CONFIG_PARAM_USB_PROFILE    0x06    // USB_PROFILE_* (0-2), from the next enumeration
+
+// Reset protocol state and the poll interval
+void config_init(void);
+
+// Handle a request report (SET_REPORT Feature)
+void config_request(const uint8_t* report, uint16_t len);
+
+// Fill the response to the last request (GET_REPORT Feature), returns its length
+uint16_t config_response(uint8_t* report);
+
+// Keyboard poll interval for the next enumeration
+uint8_t config_poll_interval(void);
+
+// Call every main loop pass: finishes a DEFAULTS request by restoring the
+// built-in keymap once no key is held
+void config_task(void);
+
+// True once after a RECONNECT request
+bool config_take_reconnect(void);
+
+// Apply the settings, layers and key statistics saved in flash (call at
+// boot, after the modules they belong to were initialized)
+void config_load(void);
+
+// Save a parameter's or layer's current value with the next store flush
+// (the configuration protocol does this itself; for other editors)
+void config_save_param(uint8_t param);
+void config_save_layer(uint8_t layer);
+
+// Save the key statistics (or their deletion, once cleared) with the next
+// store flush
+void config_save_keystats(void);
+
+// Call after a successful store_flush(): layers are read from their new
+// place in flash
+void config_store_flushed(void);
+
+#endif /* CONFIG_H_ */
@@ -0,0 +1,667 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * Debug Console Implementation
+ *
+ * Long outputs (help, stats, trace, binary replies) are jobs that emit one line or
+ * one chunk per console_task() call, and only when the CDC transmit buffer
+ * has room, so no call ever waits for the host.
+ */
+
+#include "console.h"
+#include <stdlib.h>
+#include <string.h>
+
+//--------------------------------------------------------------------+
+// Command Line Parsing
+//--------------------------------------------------------------------+
+
+int console_split(char* line, char* argv[], int max_args) {
+    int argc = 0;
+    char* p = line;
+
+    while (argc < max_args) {
+        while (*p == ' ' || *p == '\t') p++;
+        if (*p == '\0') break;
+
+        argv[argc++] = p;
+        while (*p != '\0' && *p != ' ' && *p != '\t') p++;
+        if (*p == '\0') break;
+        *p++ = '\0';
+    }
+    return argc;
+}
+
+bool console_parse_uint(const char* text, uint32_t* value) {
+    if (text == NULL) return false;
+
+    // Digits only, no sign or spaces; a leading 0 is decimal, not octal
+    unsigned base = 10;
+    if (text[0] == '0' && (text[1] == 'x' || text[1] == 'X')) {
+        base = 16;
+        text += 2;
+    }
+    if (*text == '\0') return false;
+
+    uint32_t v = 0;
+    for (; *text != '\0'; text++) {
+        unsigned digit;
+        if (*text >= '0' && *text <= '9') digit = (unsigned) (*text - '0');
+        else if (base == 16 && *text >= 'a' && *text <= 'f') digit = (unsigned) (*text - 'a' + 10);
+        else if (base == 16 && *text >= 'A' && *text <= 'F') digit = (unsigned) (*text - 'A' + 10);
+        else return false;
+
+        // Checked per digit: unsigned long is 32 bits on the RP2040
+        if (v > (UINT32_MAX - digit) / base) return false;
+        v = v * base + digit;
+    }
+    *value = v;
+    return true;
+}
+
+#if CONSOLE_ENABLE
+
+#include <stdarg.h>
+#include <stdio.h>
+#include "tusb.h"
+#include "pico/time.h"
+#include "ps2.h"
+#include "keymap.h"
+#include "socd.h"
+#include "debounce.h"
+#include "hid_idle.h"
+#include "telemetry.h"
+#include "usb_profile.h"
+#include "config.h"
+#include "keystats.h"
+#include "boot_timing.h"
+#include "clock_gov.h"
+#include "recovery.h"
+#include "sniffer.h"
+#include "hardware/clocks.h"
+
+#define BIN_HEADER_SIZE         4
+#define BIN_KEYMAP_SIZE         (256 * 2)
+#define BIN_CHUNK               64
+
+// Input bytes handled per call
+#define INPUT_PER_CALL          32
+
+// Benchmark length
+#define BENCH_MS                1000
+
+typedef enum {
+    JOB_NONE = 0,
+    JOB_HELP,
+    JOB_STATS,
+    JOB_TRACE,
+    JOB_KEYS,
+    JOB_BENCH,
+    JOB_BIN_KEYMAP,
+    JOB_BIN_TRACE,
+    JOB_SNIFF,
+} job_t;
+
+typedef struct {
+    const char* name;
+    const char* usage;
+    void (*run)(int argc, char* argv[]);
+} command_t;
+
+static bool binary_mode = false;
+
+// Text mode input
+static char line[CONSOLE_LINE_MAX];
+static uint8_t line_len = 0;
+
+// Binary mode input
+static uint8_t bin_header[BIN_HEADER_SIZE];
+static uint8_t bin_data[BIN_KEYMAP_SIZE];
+static uint16_t bin_received = 0;      // Header and data bytes of this frame
+static uint16_t bin_len = 0;
+
+// Output job in progress
+static job_t job = JOB_NONE;
+static uint16_t job_index = 0;
+static uint16_t job_total = 0;
+static uint8_t job_arg = 0;
+static uint32_t bench_start_us = 0;
+static uint32_t bench_last_us = 0;
+static uint32_t bench_passes = 0;
+static uint32_t bench_max_us = 0;
+#if SNIFFER_ENABLE
+static uint32_t sniff_us = 0;          // Capture start, then its length
+#endif
+
+//--------------------------------------------------------------------+
+// Output
+//--------------------------------------------------------------------+
+
+static bool line_fits(void) {
+    return tud_cdc_write_available() >= CONSOLE_LINE_MAX + 2;
+}
+
+// Write one line (truncated to CONSOLE_LINE_MAX)
+static void reply(const char* fmt, ...) {
+    char out[CONSOLE_LINE_MAX + 2];
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(out, CONSOLE_LINE_MAX, fmt, args);
+    va_end(args);
+
+    if (n < 0) return;
+    if (n >= CONSOLE_LINE_MAX) n = CONSOLE_LINE_MAX - 1;
+    out[n++] = '\r';
+    out[n++] = '\n';
+    tud_cdc_write(out, (uint32_t) n);
+    tud_cdc_write_flush();
+}
+
+static void prompt(void) {
+    tud_cdc_write_str("> ");
+    tud_cdc_write_flush();
+}
+
+static void bin_reply_header(uint8_t cmd, uint8_t status, uint16_t len) {
+    uint8_t header[BIN_HEADER_SIZE] = { cmd, status, (uint8_t) len, (uint8_t) (len >> 8) };
+    tud_cdc_write(header, sizeof(header));
+    tud_cdc_write_flush();
+}
+
+//--------------------------------------------------------------------+
+// Commands
+//--------------------------------------------------------------------+
+
+static void cmd_help(int argc, char* argv[]) {
+    (void) argc;
+    (void) argv;
+    job = JOB_HELP;
+    job_index = 0;
+}
+
+static void cmd_stats(int argc, char* argv[]) {
+    (void) argc;
+    (void) argv;
+    job = JOB_STATS;
+    job_index = 0;
+}
+
+// Line index of the stats output; false once there are no more
+static bool stats_line(uint16_t index) {
+    static const char* const kbd_states[] = { "powering up", "ok", "bat failed" };
+
+    switch (index) {
+        case 0:
+            reply("uptime %lu ms, layers 0x%02x, idle rate %u, clock %lu kHz",
+                  (unsigned long) to_ms_since_boot(get_absolute_time()), keymap_active_layers(),
+                  hid_idle_get_rate(), (unsigned long) (clock_get_hz(clk_sys) / 1000));
+            return true;
+        case 1:
+#if CLOCK_GOV_ENABLE
+            reply("socd %u, debounce %u ms, usb profile %u, %lu slow-downs",
+                  socd_get_mode(), debounce_get_window(), usb_profile_active(),
+                  (unsigned long) clock_gov_slowdowns());
+#else
+            reply("socd %u, debounce %u ms, usb profile %u",
+                  socd_get_mode(), debounce_get_window(), usb_profile_active());
+#endif
+            return true;
+        case 2:
+            reply("boot: main %lu us, usb %lu us, keyboard %lu us %s",
+                  (unsigned long) boot_timing_get(BOOT_MAIN),
+                  (unsigned long) boot_timing_get(BOOT_USB_STARTED),
+                  (unsigned long) boot_timing_get(BOOT_PS2_READY), kbd_states[ps2_kbd_state()]);
+            return true;
+        case 3:
+            reply("boot: mounted %lu us, ready %lu us, first report %lu us",
+                  (unsigned long) boot_timing_get(BOOT_USB_MOUNTED),
+                  (unsigned long) boot_timing_ready_us(),
+                  (unsigned long) boot_timing_get(BOOT_FIRST_REPORT));
+            return true;
+#if TELEMETRY_ENABLE
+        case 4:
+            reply("ps2 %lu bytes, %lu key events",
+                  (unsigned long) telemetry_counter(TM_PS2_BYTES),
+                  (unsigned long) telemetry_counter(TM_KEY_EVENTS));
+            return true;
+        case 5:
+            reply("reports %lu queued, %lu sent, %lu overruns",
+                  (unsigned long) telemetry_counter(TM_REPORTS_QUEUED),
+                  (unsigned long) telemetry_counter(TM_REPORTS_SENT),
+                  (unsigned long) telemetry_counter(TM_QUEUE_OVERRUNS));
+            return true;
+#endif
+        default:
+            return false;
+    }
+}
+
+static void cmd_trace(int argc, char* argv[]) {
+    (void) argc;
+    (void) argv;
+#if TELEMETRY_ENABLE
+    job = JOB_TRACE;
+    job_index = 0;
+    job_total = telemetry_trace_count();
+#else
+    reply("trace needs a TELEMETRY_ENABLE build");
+#endif
+}
+
+static void cmd_keys(int argc, char* argv[]) {
+#if KEYSTATS_ENABLE
+    if (argc > 1) {
+        if (strcmp(argv[1], "clear") != 0) {
+            reply("usage: keys [clear]");
+            return;
+        }
+        keystats_init();
+        config_save_keystats();
+    }
+    reply("%lu presses", (unsigned long) keystats_total());
+    job = JOB_KEYS;
+    job_index = 0;
+#else
+    (void) argc;
+    (void) argv;
+    reply("keys needs a KEYSTATS_ENABLE build");
+#endif
+}
+
+static void cmd_resets(int argc, char* argv[]) {
+    static const char* const causes[] = { "power-on", "watchdog", "reset" };
+    const recovery_record_t* last = recovery_last();
+    (void) argc;
+    (void) argv;
+
+    reply("last start: %s, %lu resets (%lu watchdog) since power-on",
+          causes[recovery_cause()], (unsigned long) recovery_rec->resets,
+          (unsigned long) recovery_rec->watchdog_resets);
+    if (recovery_cause() == RECOVERY_POWER_ON) return;
+
+    reply("previous run: %lu ms, stage %s, report %02x %02x %02x %02x %02x %02x %02x %02x",
+          (unsigned long) last->uptime_ms, recovery_stage_name(last->stage),
+          last->report[0], last->report[1], last->report[2], last->report[3],
+          last->report[4], last->report[5], last->report[6], last->report[7]);
+
+    char bytes[RECOVERY_PS2_BYTES * 3 + 1];
+    for (uint8_t i = 0; i < RECOVERY_PS2_BYTES; i++) {
+        snprintf(&bytes[3 * i], 4, " %02x", last->ps2_bytes[i]);
+    }
+    reply("last ps2 bytes:%s", bytes);
+}
+
+static void cmd_map(int argc, char* argv[]) {
+    uint32_t layer, key, action;
+    if (argc < 3 || !console_parse_uint(argv[1], &layer) || !console_parse_uint(argv[2], &key) ||
+        layer > 0xFF || key > 0xFF) {
+        reply("usage: map <layer> <key> [action]");
+        return;
+    }
+
+    if (argc > 3) {
+        if (!console_parse_uint(argv[3], &action) || action > 0xFFFF ||
+            !keymap_set((uint8_t) layer, (uint8_t) key, (uint16_t) action)) {
+            reply("bad layer or action");
+            return;
+        }
+        config_save_layer((uint8_t) layer);
+    }
+    reply("layer %lu key 0x%02lx: 0x%04x", (unsigned long) layer, (unsigned long) key,
+          keymap_get((uint8_t) layer, (uint8_t) key));
+}
+
+static void cmd_socd(int argc, char* argv[]) {
+    uint32_t mode;
+    if (argc > 1) {
+        if (!console_parse_uint(argv[1], &mode) || mode > SOCD_MODE_FIRST_INPUT) {
+            reply("usage: socd [0-3]");
+            return;
+        }
+        socd_set_mode((uint8_t) mode);
+        config_save_param(CONFIG_PARAM_SOCD_MODE);
+    }
+    reply("socd mode %u", socd_get_mode());
+}
+
+static void cmd_debounce(int argc, char* argv[]) {
+    uint32_t ms;
+    if (argc > 1) {
+        if (!console_parse_uint(argv[1], &ms) || ms > 255) {
+            reply("usage: debounce [0-255]");
+            return;
+        }
+        debounce_set_window((uint8_t) ms);
+        config_save_param(CONFIG_PARAM_DEBOUNCE_MS);
+    }
+    reply("debounce %u ms", debounce_get_window());
+}
+
+static void cmd_bench(int argc, char* argv[]) {
+    (void) argc;
+    (void) argv;
+    job = JOB_BENCH;
+    bench_start_us = time_us_32();
+    bench_last_us = bench_start_us;
+    bench_passes = 0;
+    bench_max_us = 0;
+#if PS2_TIMING_STATS
+    ps2_timing_stats_t stats;
+    ps2_take_timing_stats(&stats);
+#endif
+}
+
+static void cmd_sniff(int argc, char* argv[]) {
+    (void) argc;
+    (void) argv;
+#if SNIFFER_ENABLE
+    reply("sniff: %u-byte records follow, send any byte to stop", SNIFFER_RECORD_SIZE);
+    sniffer_start();
+    sniff_us = time_us_32();
+    job = JOB_SNIFF;
+    job_index = 0;
+#else
+    reply("sniff needs a SNIFFER_ENABLE build");
+#endif
+}
+
+static void cmd_binary(int argc, char* argv[]) {
+    (void) argc;
+    (void) argv;
+    reply("binary mode, frame 'x' to leave");
+    binary_mode = true;
+    bin_received = 0;
+}
+
+static const command_t commands[] = {
+    { "help",     "",                        cmd_help },
+    { "stats",    "",                        cmd_stats },
+    { "trace",    "",                        cmd_trace },
+    { "keys",     "[clear]",                 cmd_keys },
+    { "resets",   "",                        cmd_resets },
+    { "map",      "<layer> <key> [action]",  cmd_map },
+    { "socd",     "[mode]",                  cmd_socd },
+    { "debounce", "[ms]",                    cmd_debounce },
+    { "bench",    "",                        cmd_bench },
+    { "sniff",    "",                        cmd_sniff },
+    { "binary",   "",                        cmd_binary },
+};
+
+static const uint8_t command_count = sizeof(commands) / sizeof(commands[0]);
+
+static void execute(char* text) {
+    char* argv[CONSOLE_MAX_ARGS];
+    int argc = console_split(text, argv, CONSOLE_MAX_ARGS);
+    if (argc == 0) return;
+
+    for (uint8_t i = 0; i < command_count; i++) {
+        if (strcmp(argv[0], commands[i].name) == 0) {
+            commands[i].run(argc, argv);
+            return;
+        }
+    }
+    reply("unknown command '%s', try help", argv[0]);
+}
+
+//--------------------------------------------------------------------+
+// Jobs
+//--------------------------------------------------------------------+
+
+// Emit the next piece of the current job, returns true when it is done
+static bool run_job(void) {
+    switch (job) {
+        case JOB_HELP:
+            if (!line_fits()) return false;
+            reply("  %s %s", commands[job_index].name, commands[job_index].usage);
+            return ++job_index == command_count;
+
+        case JOB_STATS:
+            if (!line_fits()) return false;
+            return !stats_line(job_index++);
+
+#if TELEMETRY_ENABLE
+        case JOB_TRACE: {
+            if (job_index == job_total) return true;
+            if (!line_fits()) return false;
+            uint32_t entry = telemetry_trace_entry(job_index++);
+            reply("%5lu ms  event %lu  data 0x%02lx", (unsigned long) (entry & 0xFFFF),
+                  (unsigned long) ((entry >> 16) & 0xFF), (unsigned long) (entry >> 24));
+            return job_index == job_total;
+        }
+
+        case JOB_BIN_TRACE: {
+            // job_index counts bytes; entries are 4 bytes little-endian
+            if (tud_cdc_write_available() < BIN_CHUNK) return false;
+            uint8_t chunk[BIN_CHUNK];
+            uint16_t n = 0;
+            while (job_index < job_total && n < BIN_CHUNK) {
+                uint32_t entry = telemetry_trace_entry(job_index / 4);
+                chunk[n++] = (uint8_t) (entry >> (8 * (job_index % 4)));
+                job_index++;
+            }
+            tud_cdc_write(chunk, n);
+            tud_cdc_write_flush();
+            return job_index == job_total;
+        }
+#endif
+
+#if KEYSTATS_ENABLE
+        case JOB_KEYS:
+            // One line per key pressed at least once
+            while (job_index < KEYSTATS_KEYS && keystats_counts[job_index] == 0) job_index++;
+            if (job_index == KEYSTATS_KEYS) return true;
+            if (!line_fits()) return false;
+            reply("key 0x%02x: %lu", job_index, (unsigned long) keystats_counts[job_index]);
+            return ++job_index == KEYSTATS_KEYS;
+#endif
+
+        case JOB_BENCH: {
+            uint32_t now = time_us_32();
+            uint32_t gap = now - bench_last_us;
+            if (gap > bench_max_us) bench_max_us = gap;
+            bench_last_us = now;
+            bench_passes++;
+
+            if (now - bench_start_us < BENCH_MS * 1000 || !line_fits()) return false;
+            reply("idle passes %lu/s, longest gap %lu us",
+                  (unsigned long) bench_passes, (unsigned long) bench_max_us);
+#if PS2_TIMING_STATS
+            ps2_timing_stats_t stats;
+            ps2_take_timing_stats(&stats);
+            reply("ps2 %lu edges, longest edge-to-sample %lu us",
+                  (unsigned long) stats.edges, (unsigned long) stats.max_gap_us);
+#endif
+            return true;
+        }
+
+#if SNIFFER_ENABLE
+        case JOB_SNIFF: {
+            // job_index: 0 capturing, 1 draining after stop, 2-3 summary
+            if (job_index == 0 && tud_cdc_available()) {
+                tud_cdc_read_flush();
+                sniffer_stop();
+                sniff_us = time_us_32() - sniff_us;
+                job_index = 1;
+            }
+
+            if (job_index < 2) {
+                if (tud_cdc_write_available() < BIN_CHUNK) return false;
+                uint8_t chunk[BIN_CHUNK];
+                uint16_t n = sniffer_read_bytes(chunk, BIN_CHUNK);
+                if (n == 0 && job_index == 1) {
+                    // Nothing left: end marker, then text again
+                    sniffer_record_t end = { time_us_32(), 0, 0, SNIFFER_END };
+                    sniffer_encode(&end, chunk);
+                    n = SNIFFER_RECORD_SIZE;
+                    job_index = 2;
+                }
+                if (n) {
+                    tud_cdc_write(chunk, n);
+                    tud_cdc_write_flush();
+                }
+                return false;
+            }
+
+            if (!line_fits()) return false;
+            const sniffer_stats_t* stats = sniffer_stats();
+            if (job_index++ == 2) {
+                reply("sniff: %lu device, %lu host frames, %lu inhibits, %lu errors",
+                      (unsigned long) stats->device_frames, (unsigned long) stats->host_frames,
+                      (unsigned long) stats->inhibits, (unsigned long) stats->errors);
+                return false;
+            }
+            reply("sniff: %lu lost, high water %u/%u, %lu bytes in %lu ms",
+                  (unsigned long) stats->lost, stats->high_water, SNIFFER_RING_SIZE,
+                  (unsigned long) stats->bytes_streamed, (unsigned long) (sniff_us / 1000));
+            return true;
+        }
+#endif
+
+        case JOB_BIN_KEYMAP: {
+            if (tud_cdc_write_available() < BIN_CHUNK) return false;
+            uint8_t chunk[BIN_CHUNK];
+            uint16_t n = 0;
+            while (job_index < job_total && n < BIN_CHUNK) {
+                uint16_t action = keymap_get(job_arg, (uint8_t) (job_index / 2));
+                chunk[n++] = (uint8_t) (job_index % 2 ? action >> 8 : action);
+                job_index++;
+            }
+            tud_cdc_write(chunk, n);
+            tud_cdc_write_flush();
+            return job_index == job_total;
+        }
+
+        default:
+            return true;
+    }
+}
+
+//--------------------------------------------------------------------+
+// Binary Mode
+//--------------------------------------------------------------------+
+
+static void bin_execute(void) {
+    uint8_t cmd = bin_header[0];
+    uint8_t arg = bin_header[1];
+
+    switch (cmd) {
+        case CONSOLE_BIN_READ_KEYMAP:
+            if (arg >= KEYMAP_NUM_LAYERS) break;
+            bin_reply_header(cmd, CONSOLE_BIN_OK, BIN_KEYMAP_SIZE);
+            job = JOB_BIN_KEYMAP;
+            job_arg = arg;
+            job_index = 0;
+            job_total = BIN_KEYMAP_SIZE;
+            return;
+
+        case CONSOLE_BIN_WRITE_KEYMAP:
+            if (arg >= KEYMAP_NUM_LAYERS || bin_len != BIN_KEYMAP_SIZE) break;
+            for (int key = 0; key < 256; key++) {
+                keymap_set(arg, (uint8_t) key, (uint16_t) (bin_data[2 * key] | (bin_data[2 * key + 1] << 8)));
+            }
+            config_save_layer(arg);
+            bin_reply_header(cmd, CONSOLE_BIN_OK, 0);
+            return;
+
+#if TELEMETRY_ENABLE
+        case CONSOLE_BIN_READ_TRACE:
+            job = JOB_BIN_TRACE;
+            job_index = 0;
+            job_total = (uint16_t) (telemetry_trace_count() * 4);
+            bin_reply_header(cmd, CONSOLE_BIN_OK, job_total);
+            return;
+#endif
+
+        case CONSOLE_BIN_EXIT:
+            bin_reply_header(cmd, CONSOLE_BIN_OK, 0);
+            binary_mode = false;
+            line_len = 0;
+            return;
+
+        default:
+            break;
+    }
+    bin_reply_header(cmd, CONSOLE_BIN_ERROR, 0);
+}
+
+// Collect one frame byte; runs the frame when complete
+static void bin_input(uint8_t c) {
+    if (bin_received < BIN_HEADER_SIZE) {
+        bin_header[bin_received++] = c;
+        if (bin_received < BIN_HEADER_SIZE) return;
+        bin_len = (uint16_t) (bin_header[2] | (bin_header[3] << 8));
+    } else {
+        // Data beyond the buffer is dropped, the frame then fails
+        uint16_t offset = bin_received++ - BIN_HEADER_SIZE;
+        if (offset < sizeof(bin_data)) bin_data[offset] = c;
+    }
+
+    if (bin_received - BIN_HEADER_SIZE == bin_len) {
+        if (bin_len > sizeof(bin_data)) bin_len = 0xFFFF;
+        bin_received = 0;
+        bin_execute();
+    }
+}
+
+//--------------------------------------------------------------------+
+// Public Interface
+//--------------------------------------------------------------------+
+
+void console_init(void) {
+    binary_mode = false;
+    line_len = 0;
+    bin_received = 0;
+    job = JOB_NONE;
+}
+
+void console_task(void) {
+    if (!tud_cdc_connected()) {
+#if SNIFFER_ENABLE
+        // Nobody to stream to: back to decoding the keyboard
+        if (sniffer_active()) sniffer_stop();
+#endif
+        job = JOB_NONE;
+        return;
+    }
+
+    if (job != JOB_NONE) {
+        if (!run_job()) return;
+        job = JOB_NONE;
+        if (!binary_mode) prompt();
+        return;
+    }
+
+    // A command prints at most three lines at once
+    if (tud_cdc_write_available() < 3 * (CONSOLE_LINE_MAX + 2)) return;
+
+    for (int i = 0; i < INPUT_PER_CALL; i++) {
+        uint8_t c;
+        if (tud_cdc_read(&c, 1) != 1) return;
+
+        if (binary_mode) {
+            bin_input(c);
+            if (job != JOB_NONE || !binary_mode) return;
+            continue;
+        }
+
+        if (c == '\r' || c == '\n') {
+            if (line_len == 0) continue;
+            tud_cdc_write_str("\r\n");
+            line[line_len] = '\0';
+            line_len = 0;
+            execute(line);
+            if (job == JOB_NONE && !binary_mode) prompt();
+            return;
+        }
+
+        if ((c == '\b' || c == 0x7F) && line_len > 0) {
+            line_len--;
+            tud_cdc_write_str("\b \b");
+        } else if (c >= ' ' && c < 0x7F && line_len < CONSOLE_LINE_MAX - 1) {
+            line[line_len++] = (char) c;
+            tud_cdc_write_char((char) c);
+        }
+        tud_cdc_write_flush();
+    }
+}
+
+#endif /* CONSOLE_ENABLE */
@@ -0,0 +1,54 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * Debug Console Header
+ *
+ * Optional CDC-ACM serial console (CONSOLE_ENABLE) for live stats, trace
+ * dumps, keymap edits and a main loop benchmark. Type "help" for the
+ * commands. "binary" switches to framed binary transfers for bulk data.
+ *
+ * console_task() does a bounded amount of work per call (at most one
+ * command or one line of output) and must only be called in idle passes:
+ * between PS/2 frames with no keyboard report waiting.
+ */
+
+#ifndef CONSOLE_H_
+#define CONSOLE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef CONSOLE_ENABLE
+#define CONSOLE_ENABLE          0
+#endif
+
+// Longest command line and output line
+#define CONSOLE_LINE_MAX        80
+
+// Most words in a command line
+#define CONSOLE_MAX_ARGS        6
+
+// Binary mode frames, both directions: [cmd, arg/status, len (LE16)] + data
+// The reply repeats cmd, with status 0 on success
+#define CONSOLE_BIN_READ_KEYMAP  'r'    // arg = layer; reply: 256 x LE16 actions
+#define CONSOLE_BIN_WRITE_KEYMAP 'w'    // arg = layer; data: 256 x LE16 actions
+#define CONSOLE_BIN_READ_TRACE   't'    // reply: LE32 trace entries, oldest first
+#define CONSOLE_BIN_EXIT         'x'    // back to text mode
+
+#define CONSOLE_BIN_OK          0
+#define CONSOLE_BIN_ERROR       1
+
+// Reset console state
+void console_init(void);
+
+// Handle input and pending output; call only in idle passes
+void console_task(void);
+
+// Split a command line into words in place, returns the word count;
+// words past max_args are ignored
+int console_split(char* line, char* argv[], int max_args);
+
+// Parse a decimal or 0x-prefixed hex number, false if not a number or
+// above UINT32_MAX
+bool console_parse_uint(const char* text, uint32_t* value);
+
+#endif /* CONSOLE_H_ */
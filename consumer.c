@@ -0,0 +1,122 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * Consumer and System Control Implementation
+ */
+
+#include "consumer.h"
+#include "hid_keycodes.h"
+#include "usb_profile.h"
+
+#if (CONSUMER_QUEUE_DEPTH & (CONSUMER_QUEUE_DEPTH - 1)) != 0
+#error CONSUMER_QUEUE_DEPTH must be a power of two
+#endif
+
+// Consumer page usages (USB HID Usage Tables, section 15)
+#define CONSUMER_MUTE           0x00E2
+#define CONSUMER_VOLUME_UP      0x00E9
+#define CONSUMER_VOLUME_DOWN    0x00EA
+
+// System Control report values, in the order of the descriptor's usages
+#define SYSTEM_POWER_DOWN       1
+
+typedef struct {
+    uint8_t report_id;
+    uint16_t value;
+} consumer_report_t;
+
+static consumer_report_t queue[CONSUMER_QUEUE_DEPTH];
+static uint8_t queue_head = 0;   // Oldest entry
+static uint8_t queue_count = 0;
+
+// Usage currently reported for each report ID (one at a time, as on
+// media keyboards; releasing any other key leaves it alone)
+static uint16_t consumer_usage = 0;
+static uint8_t system_usage = 0;
+
+static void push(uint8_t report_id, uint16_t value) {
+    if (queue_count == CONSUMER_QUEUE_DEPTH) {
+        // Full - collapse into the newest entry
+        uint8_t last = (queue_head + queue_count - 1) & (CONSUMER_QUEUE_DEPTH - 1);
+        queue[last].report_id = report_id;
+        queue[last].value = value;
+        return;
+    }
+
+    uint8_t tail = (queue_head + queue_count) & (CONSUMER_QUEUE_DEPTH - 1);
+    queue[tail].report_id = report_id;
+    queue[tail].value = value;
+    queue_count++;
+}
+
+void consumer_init(void) {
+    queue_head = 0;
+    queue_count = 0;
+    consumer_usage = 0;
+    system_usage = 0;
+}
+
+bool consumer_process(uint8_t code, bool pressed) {
+    if (!(usb_profile_interfaces(usb_profile_active()) & USB_ITF_CONSUMER)) return false;
+
+    uint16_t usage;
+    switch (code) {
+        case HID_KEY_MUTE:        usage = CONSUMER_MUTE; break;
+        case HID_KEY_VOLUME_UP:   usage = CONSUMER_VOLUME_UP; break;
+        case HID_KEY_VOLUME_DOWN: usage = CONSUMER_VOLUME_DOWN; break;
+
+        case HID_KEY_POWER:
+            if (pressed) {
+                system_usage = SYSTEM_POWER_DOWN;
+            } else if (system_usage == SYSTEM_POWER_DOWN) {
+                system_usage = 0;
+            } else {
+                return true;
+            }
+            push(CONSUMER_REPORT_ID_SYSTEM, system_usage);
+            return true;
+
+        default:
+            return false;
+    }
+
+    if (pressed) {
+        consumer_usage = usage;
+    } else if (consumer_usage == usage) {
+        consumer_usage = 0;
+    } else {
+        return true;
+    }
+    push(CONSUMER_REPORT_ID_CONSUMER, consumer_usage);
+    return true;
+}
+
+uint16_t consumer_peek(uint8_t* report_id, uint8_t* data) {
+    if (queue_count == 0) return 0;
+
+    const consumer_report_t* entry = &queue[queue_head];
+    *report_id = entry->report_id;
+    data[0] = (uint8_t) entry->value;
+    if (entry->report_id == CONSUMER_REPORT_ID_SYSTEM) return 1;
+    data[1] = (uint8_t) (entry->value >> 8);
+    return 2;
+}
+
+void consumer_pop(void) {
+    if (queue_count == 0) return;
+    queue_head = (queue_head + 1) & (CONSUMER_QUEUE_DEPTH - 1);
+    queue_count--;
+}
+
+uint16_t consumer_current(uint8_t report_id, uint8_t* data) {
+    switch (report_id) {
+        case CONSUMER_REPORT_ID_CONSUMER:
+            data[0] = (uint8_t) consumer_usage;
+            data[1] = (uint8_t) (consumer_usage >> 8);
+            return 2;
+        case CONSUMER_REPORT_ID_SYSTEM:
+            data[0] = system_usage;
+            return 1;
+        default:
+            return 0;
+    }
+}
@@ -0,0 +1,45 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * Consumer and System Control Header
+ *
+ * In USB profiles with the consumer interface (see usb_profile.h), volume
+ * and power keys are sent as Consumer Control and System Control usages,
+ * which hosts act on, instead of the Keyboard page usages a boot keyboard
+ * is limited to. Every change is queued like keyboard reports, so a quick
+ * tap is never lost.
+ */
+
+#ifndef CONSUMER_H_
+#define CONSUMER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Report IDs on the consumer interface
+#define CONSUMER_REPORT_ID_CONSUMER 1   // 16-bit Consumer usage, 0 = none
+#define CONSUMER_REPORT_ID_SYSTEM   2   // 1 power down, 2 sleep, 3 wake up, 0 = none
+
+// Number of reports that can wait for the host (power of two)
+#ifndef CONSUMER_QUEUE_DEPTH
+#define CONSUMER_QUEUE_DEPTH    8
+#endif
+
+// Discard queued reports and release all keys
+void consumer_init(void);
+
+// Handle a resolved keycode; returns true if it was sent as a consumer or
+// system usage and must not go into the keyboard report
+bool consumer_process(uint8_t code, bool pressed);
+
+// Oldest queued report: sets its report ID and copies its data (up to 2
+// bytes), returns the data length or 0 if nothing is queued
+uint16_t consumer_peek(uint8_t* report_id, uint8_t* data);
+
+// Drop the oldest report (call after it was handed to the USB stack)
+void consumer_pop(void);
+
+// Current state for GET_REPORT, returns the data length or 0 for an
+// unknown report ID
+uint16_t consumer_current(uint8_t report_id, uint8_t* data);
+
+#endif /* CONSUMER_H_ */
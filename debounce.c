@@ -0,0 +1,117 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * Key Chatter Filter Implementation
+ */
+
+#include "debounce.h"
+#include <string.h>
+
+#if DEBOUNCE_MS > 255
+#error DEBOUNCE_MS must be 255 or less
+#endif
+
+static key_sink_t next_stage = NULL;
+static uint8_t window_ms = DEBOUNCE_MS;
+
+static uint16_t changed_ms[256];       // Low 16 bits of the last passed change
+static uint32_t physical[256 / 32];    // Latest state from the keyboard
+static uint32_t reported[256 / 32];    // State passed downstream
+static uint32_t settling[256 / 32];    // Keys inside their window
+static uint8_t settling_count = 0;
+
+static inline bool test_bit(const uint32_t* bits, uint8_t key) {
+    return (bits[key >> 5] >> (key & 31)) & 1u;
+}
+
+static inline void set_bit(uint32_t* bits, uint8_t key, bool value) {
+    if (value) {
+        bits[key >> 5] |= 1u << (key & 31);
+    } else {
+        bits[key >> 5] &= ~(1u << (key & 31));
+    }
+}
+
+static inline bool window_open(uint8_t key, uint32_t time_ms) {
+    return (uint16_t) ((uint16_t) time_ms - changed_ms[key]) < window_ms;
+}
+
+// Pass the key's physical state downstream and open its window
+static void pass(uint8_t key, uint32_t time_ms) {
+    bool pressed = test_bit(physical, key);
+
+    set_bit(reported, key, pressed);
+    changed_ms[key] = (uint16_t) time_ms;
+    if (!test_bit(settling, key)) {
+        set_bit(settling, key, true);
+        settling_count++;
+    }
+    next_stage(key, pressed, time_ms);
+}
+
+// Window ended: send the last state if it differs, otherwise stop watching
+static void settle(uint8_t key, uint32_t time_ms) {
+    if (test_bit(physical, key) != test_bit(reported, key)) {
+        pass(key, time_ms);
+        return;
+    }
+    set_bit(settling, key, false);
+    settling_count--;
+}
+
+//--------------------------------------------------------------------+
+// Public Interface
+//--------------------------------------------------------------------+
+
+void debounce_init(key_sink_t sink) {
+    next_stage = sink;
+
+    memset(changed_ms, 0, sizeof(changed_ms));
+    memset(physical, 0, sizeof(physical));
+    memset(reported, 0, sizeof(reported));
+    memset(settling, 0, sizeof(settling));
+    settling_count = 0;
+}
+
+void debounce_process(uint8_t key, bool pressed, uint32_t time_ms) {
+    if (window_ms == 0) {
+        next_stage(key, pressed, time_ms);
+        return;
+    }
+
+    set_bit(physical, key, pressed);
+
+    if (test_bit(settling, key)) {
+        // Chatter inside the window is only remembered
+        if (!window_open(key, time_ms)) settle(key, time_ms);
+        return;
+    }
+
+    if (pressed != test_bit(reported, key)) {
+        pass(key, time_ms);
+    }
+}
+
+void debounce_task(uint32_t now_ms) {
+    if (settling_count == 0) return;
+
+    for (unsigned word = 0; word < 256 / 32; word++) {
+        uint32_t bits = settling[word];
+        while (bits) {
+            uint8_t key = (uint8_t) (word * 32 + __builtin_ctz(bits));
+            bits &= bits - 1;
+            if (!window_open(key, now_ms)) settle(key, now_ms);
+        }
+    }
+}
+
+bool debounce_pending(void) {
+    return settling_count != 0;
+}
+
+void debounce_set_window(uint8_t ms) {
+    window_ms = ms;
+}
+
+uint8_t debounce_get_window(void) {
+    return window_ms;
+}
@@ -0,0 +1,49 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * Key Chatter Filter Header
+ *
+ * Worn keyboards can send make/break/make within a few milliseconds,
+ * which the host sees as a doubled letter. The filter passes a key's
+ * first change straight through, then ignores further changes of that key
+ * for DEBOUNCE_MS. When the window ends, the key's last state is sent if
+ * it differs from what the host has.
+ *
+ * Clean keys are never delayed; only a change that lands inside its own
+ * key's window (chatter, or a tap shorter than the window) waits for the
+ * window to end. A release that early cannot be told from chatter until
+ * then, so a tap of t ms shorter than the window is released DEBOUNCE_MS - t
+ * ms late; its press is never delayed.
+ *
+ * RAM: 256 x 16-bit timestamps + 3 x 32-byte key bitmaps = 608 bytes.
+ */
+
+#ifndef DEBOUNCE_H_
+#define DEBOUNCE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "key_event.h"
+
+// Chatter window in ms (0 disables the filter, max 255)
+#ifndef DEBOUNCE_MS
+#define DEBOUNCE_MS             0
+#endif
+
+// Initialize filter state; filtered events are passed to sink
+void debounce_init(key_sink_t sink);
+
+// Feed a key event from the decoder
+void debounce_process(uint8_t key, bool pressed, uint32_t time_ms);
+
+// Send the settled state of keys whose window has ended
+// Call regularly, e.g. from the PS/2 polling loop
+void debounce_task(uint32_t now_ms);
+
+// True while some key is inside its chatter window
+bool debounce_pending(void);
+
+// Change the chatter window (0 disables the filter)
+void debounce_set_window(uint8_t ms);
+uint8_t debounce_get_window(void);
+
+#endif /* DEBOUNCE_H_ */
@@ -0,0 +1,66 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * HID Idle Rate Implementation
+ *
+ * A single alarm runs while the idle rate is nonzero. Sending a report only
+ * records the time; when the alarm fires it either moves itself to the end
+ * of the new period or flags a resend, so reports never cancel the alarm.
+ */
+
+#include "hid_idle.h"
+#include "pico/time.h"
+
+static uint8_t idle_rate = 0;
+static uint32_t idle_period_us = 0;
+static alarm_id_t idle_alarm = 0;
+
+// Written by the main loop, read by the alarm callback
+static volatile uint32_t last_sent_us = 0;
+static volatile bool resend_due = false;
+
+static int64_t idle_alarm_cb(alarm_id_t id, void *user_data) {
+    (void) id;
+    (void) user_data;
+
+    uint32_t elapsed = time_us_32() - last_sent_us;
+    if (elapsed < idle_period_us) {
+        // A report went out since the alarm was set
+        return -(int64_t) (idle_period_us - elapsed);
+    }
+
+    resend_due = true;
+    last_sent_us = time_us_32();
+    return -(int64_t) idle_period_us;
+}
+
+void hid_idle_set_rate(uint8_t rate) {
+    if (idle_alarm > 0) {
+        cancel_alarm(idle_alarm);
+        idle_alarm = 0;
+    }
+
+    idle_rate = rate;
+    idle_period_us = (uint32_t) rate * HID_IDLE_UNIT_MS * 1000;
+    resend_due = false;
+    last_sent_us = time_us_32();
+
+    if (rate != 0) {
+        idle_alarm = add_alarm_in_us(idle_period_us, idle_alarm_cb, NULL, true);
+    }
+}
+
+uint8_t hid_idle_get_rate(void) {
+    return idle_rate;
+}
+
+void hid_idle_report_sent(void) {
+    last_sent_us = time_us_32();
+    // A repeat that fell due but has not gone out yet is superseded
+    resend_due = false;
+}
+
+bool hid_idle_resend_due(void) {
+    if (!resend_due) return false;
+    resend_due = false;
+    return true;
+}
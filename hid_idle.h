@@ -0,0 +1,32 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * HID Idle Rate Header
+ *
+ * Implements the SET_IDLE idle rate for the keyboard interface. With rate
+ * 0 (the default) reports are only sent on change. With a nonzero rate the
+ * last report is repeated whenever nothing was sent for that long. The
+ * repeat is timed by a hardware alarm; the main loop only checks a flag.
+ */
+
+#ifndef HID_IDLE_H_
+#define HID_IDLE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// SET_IDLE rates are in units of 4 ms
+#define HID_IDLE_UNIT_MS        4
+
+// Set the idle rate (0 = on change only); restarts the idle period
+void hid_idle_set_rate(uint8_t rate);
+
+// Current idle rate as reported by GET_IDLE
+uint8_t hid_idle_get_rate(void);
+
+// Restart the idle period (call after every keyboard report sent)
+void hid_idle_report_sent(void);
+
+// True once when the idle period expired without a report
+bool hid_idle_resend_due(void);
+
+#endif /* HID_IDLE_H_ */
@@ -0,0 +1,19 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * Key Event Pipeline
+ *
+ * Decoded key events pass through optional processing stages (tap-hold,
+ * ...) before reaching the layer keymap and the report state. Each stage
+ * forwards events to the next one through a key_sink_t.
+ */
+
+#ifndef KEY_EVENT_H_
+#define KEY_EVENT_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Receives a key event: keycode, press/release and the time it happened
+typedef void (*key_sink_t)(uint8_t key, bool pressed, uint32_t time_ms);
+
+#endif /* KEY_EVENT_H_ */
@@ -0,0 +1,244 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * Layer Keymap Implementation
+ *
+ * Layers are stored as flat 256-entry action tables indexed by keycode.
+ * A per-key bitmask records which layers define the key, so resolving a
+ * press is one AND with the active layer mask and one table lookup for
+ * the highest set bit - the cost does not depend on the number of layers.
+ */
+
+#include "keymap.h"
+#include "hid_keycodes.h"
+#include <string.h>
+
+#if KEYMAP_NUM_LAYERS < 1 || KEYMAP_NUM_LAYERS > 8
+#error KEYMAP_NUM_LAYERS must be between 1 and 8
+#endif
+
+#define LAYER_MASK_ALL          ((uint8_t) ((1u << KEYMAP_NUM_LAYERS) - 1))
+
+// Action type is the high byte of a keymap entry
+#define KM_TYPE(action)         ((action) & 0xFF00)
+#define KM_ARG(action)          ((uint8_t) ((action) & 0x00FF))
+
+//--------------------------------------------------------------------+
+// Layer Tables
+//--------------------------------------------------------------------+
+
+// Built-in keycode -> action for each layer (KM_TRNS = not defined on this layer)
+static const uint16_t default_layers[KEYMAP_NUM_LAYERS][256] = {
+    // Layer 0: base layer, undefined keys send their own keycode
+    [0] = {
+        KM_TRNS,
+#if KEYMAP_FN_LAYER
+        [HID_KEY_ALT_RIGHT] = KM_MO(1),  // Right Alt -> Fn
+#endif
+    },
+
+#if KEYMAP_FN_LAYER && KEYMAP_NUM_LAYERS > 1
+    // Layer 1: Fn layer
+    // The boot keyboard interface only carries the Keyboard usage page,
+    // so the media keys available here are mute and volume
+    [1] = {
+        [HID_KEY_DELETE]      = KM_KEY(HID_KEY_MUTE),
+        [HID_KEY_ARROW_UP]    = KM_KEY(HID_KEY_VOLUME_UP),
+        [HID_KEY_ARROW_DOWN]  = KM_KEY(HID_KEY_VOLUME_DOWN),
+        [HID_KEY_ARROW_LEFT]  = KM_KEY(HID_KEY_HOME),
+        [HID_KEY_ARROW_RIGHT] = KM_KEY(HID_KEY_END),
+    },
+#endif
+};
+
+//--------------------------------------------------------------------+
+// Layer State
+//--------------------------------------------------------------------+
+
+// Table each layer is read from: the built-in one, a saved layer read in
+// place from flash, or its RAM copy once it was edited
+static const uint16_t* keymap_layers[KEYMAP_NUM_LAYERS];
+
+// Edited layers
+static uint16_t edited_layers[KEYMAP_NUM_LAYERS][256];
+
+// Bit n set if layer n defines the key (bit 0 always set)
+static uint8_t key_layer_mask[256];
+
+// Highest set bit for every possible layer mask
+static uint8_t top_layer[1u << KEYMAP_NUM_LAYERS];
+
+// Layer each key was resolved on when it was pressed
+static uint8_t pressed_layer[256];
+
+// Keys currently down: a typematic repeat keeps the layer of its press
+static uint32_t key_down[256 / 32];
+
+static uint8_t momentary_layers = 0;   // Held MO/OSL keys
+static uint8_t toggled_layers = 0;     // Latched TG keys
+static uint8_t oneshot_layers = 0;     // OSL waiting for the next key
+
+static inline uint8_t active_layers(void) {
+    return (uint8_t) (1u | momentary_layers | toggled_layers | oneshot_layers);
+}
+
+static inline uint8_t layer_bit(uint8_t layer) {
+    return (uint8_t) ((1u << (layer & 7)) & LAYER_MASK_ALL);
+}
+
+static inline bool key_is_down(uint8_t key) {
+    return (key_down[key >> 5] >> (key & 31)) & 1u;
+}
+
+static inline void set_key_down(uint8_t key, bool down) {
+    if (down) {
+        key_down[key >> 5] |= 1u << (key & 31);
+    } else {
+        key_down[key >> 5] &= ~(1u << (key & 31));
+    }
+}
+
+// Keycode an action sends, 0 for layer keys
+static inline uint8_t action_code(uint16_t action, uint8_t key) {
+    switch (KM_TYPE(action)) {
+        case KM_TRNS:
+            return key;
+        case KM_MO(0):
+        case KM_TG(0):
+        case KM_OSL(0):
+            return 0;
+        default:
+            return KM_ARG(action);
+    }
+}
+
+//--------------------------------------------------------------------+
+// Public Interface
+//--------------------------------------------------------------------+
+
+static void update_layer_mask(uint8_t key) {
+    uint8_t mask = 1;
+    for (int layer = 1; layer < KEYMAP_NUM_LAYERS; layer++) {
+        if (keymap_layers[layer][key] != KM_TRNS) {
+            mask |= (uint8_t) (1u << layer);
+        }
+    }
+    key_layer_mask[key] = mask;
+}
+
+void keymap_init(void) {
+    for (int layer = 0; layer < KEYMAP_NUM_LAYERS; layer++) {
+        keymap_layers[layer] = default_layers[layer];
+    }
+    for (int key = 0; key < 256; key++) {
+        update_layer_mask((uint8_t) key);
+    }
+
+    top_layer[0] = 0;
+    for (unsigned mask = 1; mask < sizeof(top_layer); mask++) {
+        uint8_t layer = 0;
+        while (mask >> (layer + 1)) layer++;
+        top_layer[mask] = layer;
+    }
+
+    memset(pressed_layer, 0, sizeof(pressed_layer));
+    memset(key_down, 0, sizeof(key_down));
+    momentary_layers = 0;
+    toggled_layers = 0;
+    oneshot_layers = 0;
+}
+
+uint8_t keymap_press(uint8_t key) {
+    // A typematic repeat sends what the press sent and never toggles or
+    // arms a layer again
+    if (key_is_down(key)) {
+        return action_code(keymap_layers[pressed_layer[key]][key], key);
+    }
+    set_key_down(key, true);
+
+    uint8_t layer = top_layer[active_layers() & key_layer_mask[key]];
+    uint16_t action = keymap_layers[layer][key];
+    pressed_layer[key] = layer;
+
+    switch (KM_TYPE(action)) {
+        case KM_TRNS:
+            // Only reachable on layer 0
+            action = KM_KEY(key);
+            break;
+        case KM_MO(0):
+            momentary_layers |= layer_bit(KM_ARG(action));
+            return 0;
+        case KM_TG(0):
+            toggled_layers ^= layer_bit(KM_ARG(action));
+            return 0;
+        case KM_OSL(0):
+            momentary_layers |= layer_bit(KM_ARG(action));
+            oneshot_layers |= layer_bit(KM_ARG(action));
+            return 0;
+        default:
+            break;
+    }
+
+    // A regular key consumes any pending one-shot layer
+    oneshot_layers = 0;
+    return KM_ARG(action);
+}
+
+uint8_t keymap_release(uint8_t key) {
+    uint16_t action = keymap_layers[pressed_layer[key]][key];
+    set_key_down(key, false);
+
+    switch (KM_TYPE(action)) {
+        case KM_MO(0):
+        case KM_OSL(0):
+            // An OSL tapped on its own stays armed in oneshot_layers
+            momentary_layers &= (uint8_t) ~layer_bit(KM_ARG(action));
+            return 0;
+        default:
+            return action_code(action, key);
+    }
+}
+
+uint8_t keymap_active_layers(void) {
+    return active_layers();
+}
+
+bool keymap_keys_down(void) {
+    for (unsigned i = 0; i < sizeof(key_down) / sizeof(key_down[0]); i++) {
+        if (key_down[i]) return true;
+    }
+    return false;
+}
+
+uint16_t keymap_get(uint8_t layer, uint8_t key) {
+    return layer < KEYMAP_NUM_LAYERS ? keymap_layers[layer][key] : KM_TRNS;
+}
+
+bool keymap_set(uint8_t layer, uint8_t key, uint16_t action) {
+    if (layer >= KEYMAP_NUM_LAYERS) return false;
+
+    // Copy on first edit
+    if (keymap_layers[layer] != edited_layers[layer]) {
+        memcpy(edited_layers[layer], keymap_layers[layer], sizeof(edited_layers[layer]));
+        keymap_layers[layer] = edited_layers[layer];
+    }
+    edited_layers[layer][key] = action;
+    update_layer_mask(key);
+    return true;
+}
+
+const uint16_t* keymap_layer(uint8_t layer) {
+    return layer < KEYMAP_NUM_LAYERS ? keymap_layers[layer] : NULL;
+}
+
+bool keymap_layer_is_default(uint8_t layer) {
+    return layer < KEYMAP_NUM_LAYERS && keymap_layers[layer] == default_layers[layer];
+}
+
+bool keymap_use_layer(uint8_t layer, const uint16_t* actions) {
+    if (layer >= KEYMAP_NUM_LAYERS) return false;
+    keymap_layers[layer] = actions;
+    for (int key = 0; key < 256; key++) {
+        update_layer_mask((uint8_t) key);
+    }
+    return true;
+}
@@ -0,0 +1,69 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * Layer Keymap Header
+ *
+ * Keys are identified by the HID keycode the PS/2 translation tables give
+ * them (modifiers use their 0xE0-0xE7 usages).
+ * Each layer maps that code to an action; layer 0 is the base layer and
+ * is always active.
+ */
+
+#ifndef KEYMAP_H_
+#define KEYMAP_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Number of layers including the base layer (1-8, one bit per layer)
+#ifndef KEYMAP_NUM_LAYERS
+#define KEYMAP_NUM_LAYERS       4
+#endif
+
+// Build the example Fn layer: Right Alt becomes Fn and the navigation
+// cluster sends volume keys while it is held
+#ifndef KEYMAP_FN_LAYER
+#define KEYMAP_FN_LAYER         0
+#endif
+
+// Keymap actions: high byte is the action type, low byte its argument
+#define KM_TRNS                 0x0000                        // Use the next lower active layer
+#define KM_KEY(code)            ((uint16_t) (0x0100 | (code))) // Send a keycode
+#define KM_NO                   KM_KEY(0)                     // Do nothing
+#define KM_MO(layer)            ((uint16_t) (0x0200 | (layer))) // Layer active while held
+#define KM_TG(layer)            ((uint16_t) (0x0300 | (layer))) // Toggle layer on press
+#define KM_OSL(layer)           ((uint16_t) (0x0400 | (layer))) // Layer active for the next key
+
+// Initialize layer state and the per-key layer masks
+void keymap_init(void);
+
+// Resolve a key press through the active layers; a typematic repeat of a
+// held key resolves on the layer of its first press, without layer effects
+// Returns the keycode to press, or 0 if the key was a layer key
+uint8_t keymap_press(uint8_t key);
+
+// Resolve a key release against the layer the key was pressed on
+// Returns the keycode to release, or 0 if the key was a layer key
+uint8_t keymap_release(uint8_t key);
+
+// Bitmask of active layers (bit 0 is always set)
+uint8_t keymap_active_layers(void);
+
+// True while any key resolved by keymap_press is down, layer keys included
+bool keymap_keys_down(void);
+
+// Read or change a layer entry at runtime (keymap_init restores the
+// built-in keymap). A key held while its entry changes is released
+// through the new entry. keymap_set returns false for a bad layer.
+uint16_t keymap_get(uint8_t layer, uint8_t key);
+bool keymap_set(uint8_t layer, uint8_t key, uint16_t action);
+
+// The 256 actions of a layer as currently used, and whether that is still
+// the built-in table
+const uint16_t* keymap_layer(uint8_t layer);
+bool keymap_layer_is_default(uint8_t layer);
+
+// Read a layer from 256 actions in place (e.g. a layer saved in flash);
+// they must stay valid until the layer is replaced or edited
+bool keymap_use_layer(uint8_t layer, const uint16_t* actions);
+
+#endif /* KEYMAP_H_ */
@@ -0,0 +1,63 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * Key Usage Statistics Implementation
+ *
+ * The press path only increments a counter. The save policy sums the
+ * counters once per idle period, when the idle time has been reached.
+ */
+
+#include "keystats.h"
+
+#if KEYSTATS_ENABLE
+
+#include <stddef.h>
+#include <string.h>
+
+uint32_t keystats_counts[KEYSTATS_KEYS];
+
+static uint32_t saved_total = 0;       // Sum of the counters last saved
+static uint32_t busy_ms = 0;           // Last time USB was up or a key active
+static bool checked = false;           // This idle period was already checked
+
+void keystats_init(void) {
+    memset(keystats_counts, 0, sizeof(keystats_counts));
+    saved_total = 0;
+    checked = false;
+}
+
+void keystats_restore(const void* counts, uint16_t len) {
+    if (counts == NULL || len != sizeof(keystats_counts)) return;
+    memcpy(keystats_counts, counts, sizeof(keystats_counts));
+    saved_total = keystats_total();
+}
+
+const void* keystats_record(uint16_t* len) {
+    if (keystats_total() == 0) return NULL;
+    *len = sizeof(keystats_counts);
+    return keystats_counts;
+}
+
+uint32_t keystats_total(void) {
+    uint32_t total = 0;
+    for (unsigned key = 0; key < KEYSTATS_KEYS; key++) {
+        total += keystats_counts[key];
+    }
+    return total;
+}
+
+bool keystats_take_save(uint32_t now_ms, bool suspended, bool keys_active) {
+    if (keys_active || !suspended) {
+        busy_ms = now_ms;
+        checked = false;
+        return false;
+    }
+    if (checked || now_ms - busy_ms < KEYSTATS_IDLE_MS) return false;
+    checked = true;
+
+    uint32_t total = keystats_total();
+    if (total - saved_total < KEYSTATS_MIN_PRESSES) return false;
+    saved_total = total;
+    return true;
+}
+
+#endif /* KEYSTATS_ENABLE */
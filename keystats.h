@@ -0,0 +1,80 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * Key Usage Statistics Header
+ *
+ * Optional per-key press counters (KEYSTATS_ENABLE), indexed by the HID
+ * keycode of the physical key, before layers. Typematic repeats are not
+ * counted. Counting is one increment; the counters are kept in RAM and
+ * saved to the configuration store in one record, only while USB is
+ * suspended and the keyboard has been idle (see keystats_take_save()).
+ * Presses since the last save are lost at power-off.
+ *
+ * Read over the telemetry interface (TELEMETRY_PKT_KEYS) or with the
+ * console's keys command. RAM: 1 KB.
+ *
+ * With KEYSTATS_ENABLE 0 the hooks are empty inline functions.
+ */
+
+#ifndef KEYSTATS_H_
+#define KEYSTATS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifndef KEYSTATS_ENABLE
+#define KEYSTATS_ENABLE         0
+#endif
+
+// Save once USB has been suspended and no key active for this long (ms)...
+#ifndef KEYSTATS_IDLE_MS
+#define KEYSTATS_IDLE_MS        10000
+#endif
+
+// ...and at least this many presses were counted since the last save
+#ifndef KEYSTATS_MIN_PRESSES
+#define KEYSTATS_MIN_PRESSES    100
+#endif
+
+#define KEYSTATS_KEYS           256
+
+#if KEYSTATS_ENABLE
+
+extern uint32_t keystats_counts[KEYSTATS_KEYS];
+
+// Count a press (called once per press, after repeats are dropped)
+static inline void keystats_press(uint8_t key) {
+    keystats_counts[key]++;
+}
+
+// Clear the counters (and what was saved of them)
+void keystats_init(void);
+
+// Restore counters saved by an earlier run; ignored if len does not match
+void keystats_restore(const void* counts, uint16_t len);
+
+// Counters as a store record, NULL if all are zero
+const void* keystats_record(uint16_t* len);
+
+// Sum of all counters
+uint32_t keystats_total(void);
+
+// Call every main loop pass. Returns true, once, when the counters should
+// be saved: USB suspended and keys_active false for KEYSTATS_IDLE_MS, and
+// KEYSTATS_MIN_PRESSES new presses since the last save
+bool keystats_take_save(uint32_t now_ms, bool suspended, bool keys_active);
+
+#else
+
+static inline void keystats_press(uint8_t key) { (void) key; }
+static inline void keystats_init(void) {}
+static inline void keystats_restore(const void* counts, uint16_t len) { (void) counts; (void) len; }
+static inline const void* keystats_record(uint16_t* len) { (void) len; return NULL; }
+static inline bool keystats_take_save(uint32_t now_ms, bool suspended, bool keys_active) {
+    (void) now_ms; (void) suspended; (void) keys_active;
+    return false;
+}
+
+#endif
+
+#endif /* KEYSTATS_H_ */
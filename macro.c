@@ -0,0 +1,130 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * Keyboard Macro Implementation
+ */
+
+#include "macro.h"
+#include "ps2.h"
+#include "paste.h"
+#include "report_queue.h"
+#include "hid_keycodes.h"
+#include <string.h>
+
+//--------------------------------------------------------------------+
+// Macro Definitions
+//--------------------------------------------------------------------+
+
+typedef struct {
+    uint8_t modifiers;      // Modifier byte for this report
+    uint8_t key;            // Keycode for this report (0 = none)
+    uint16_t delay_ms;      // Wait after this report before the next
+} macro_step_t;
+
+typedef struct {
+    uint8_t key;                    // Keycode that starts the macro
+    const macro_step_t* steps;
+    uint8_t step_count;
+} macro_t;
+
+#if MACRO_EXAMPLE
+static const macro_step_t macro_ctrl_alt_del[] = {
+    { HID_MOD_LEFT_CTRL | HID_MOD_LEFT_ALT, 0,              0  },
+    { HID_MOD_LEFT_CTRL | HID_MOD_LEFT_ALT, HID_KEY_DELETE, 50 },
+    { 0,                                    0,              0  },
+};
+#endif
+
+static const macro_t macros[] = {
+#if MACRO_EXAMPLE
+    { HID_KEY_SCROLL_LOCK, macro_ctrl_alt_del, sizeof(macro_ctrl_alt_del) / sizeof(macro_ctrl_alt_del[0]) },
+#endif
+#ifdef MACRO_DEFINITIONS
+#include MACRO_DEFINITIONS
+#endif
+    { 0, NULL, 0 }  // Terminator (keeps the array non-empty)
+};
+
+//--------------------------------------------------------------------+
+// Playback State
+//--------------------------------------------------------------------+
+
+static uint8_t macro_index[256];       // Index + 1 into macros (0 = not bound)
+
+static const macro_t* playing = NULL;  // Macro being played, NULL if idle
+static uint8_t next_step = 0;
+static bool step_queued = false;       // Last step's report not yet handed to USB
+static bool step_waiting = false;      // Delay after the last step is running
+static uint32_t step_sent_ms = 0;
+
+//--------------------------------------------------------------------+
+// Public Interface
+//--------------------------------------------------------------------+
+
+void macro_init(void) {
+    memset(macro_index, 0, sizeof(macro_index));
+    for (uint8_t i = 0; macros[i].key != 0; i++) {
+        // A macro without steps is not bound; its key types as itself
+        if (macros[i].step_count != 0) macro_index[macros[i].key] = i + 1;
+    }
+
+    playing = NULL;
+    next_step = 0;
+    step_queued = false;
+    step_waiting = false;
+}
+
+bool macro_is_bound(uint8_t key) {
+    return macro_index[key] != 0;
+}
+
+void macro_start(uint8_t key) {
+    // Paste mode owns the injected keys until its text is typed
+    if (playing != NULL || macro_index[key] == 0 || paste_active()) return;
+
+    playing = &macros[macro_index[key] - 1];
+    next_step = 0;
+    step_queued = false;
+    step_waiting = false;
+}
+
+void macro_task(uint32_t now_ms) {
+    if (playing == NULL) return;
+
+    // A step's delay starts once its report has gone to the USB stack, so
+    // the host sees the step for the full delay
+    if (step_queued) {
+        if (report_queue_peek() != NULL) return;
+        step_queued = false;
+        step_sent_ms = now_ms;
+        step_waiting = true;
+    }
+
+    if (step_waiting) {
+        const macro_step_t* last = &playing->steps[next_step - 1];
+        if (now_ms - step_sent_ms < last->delay_ms) return;
+        step_waiting = false;
+    }
+
+    // Back-pressure: wait until earlier reports have been handed to USB
+    if (report_queue_peek() != NULL) return;
+
+    if (next_step == playing->step_count) {
+        // Done - make sure nothing stays pressed
+        const macro_step_t* last = &playing->steps[next_step - 1];
+        if (last->modifiers != 0 || last->key != 0) {
+            static const uint8_t no_keys[6] = {0};
+            ps2_set_injected(0, no_keys);
+        }
+        playing = NULL;
+        return;
+    }
+
+    const macro_step_t* step = &playing->steps[next_step++];
+    uint8_t keys[6] = { step->key };
+    ps2_set_injected(step->modifiers, keys);
+    step_queued = true;
+}
+
+bool macro_playing(void) {
+    return playing != NULL;
+}
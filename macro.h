@@ -0,0 +1,41 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * Keyboard Macro Header
+ *
+ * A macro is a list of reports (modifiers + one key) with a delay after
+ * each. Playback runs from macro_task() and hands one step at a time to
+ * the report queue once the previous report has gone to the USB stack, so
+ * with zero delays the macro plays at one report per HID polling interval.
+ */
+
+#ifndef MACRO_H_
+#define MACRO_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Build the example macro (Scroll Lock -> Ctrl+Alt+Delete)
+#ifndef MACRO_EXAMPLE
+#define MACRO_EXAMPLE           0
+#endif
+
+// Macros can also come from a file of macro table entries, e.g.
+// -DMACRO_DEFINITIONS='"my_macros.h"' (see macro_t in macro.c)
+
+// Initialize macro state
+void macro_init(void);
+
+// True if the keycode is bound to a macro
+bool macro_is_bound(uint8_t key);
+
+// Start the macro bound to key (ignored while another macro plays or
+// paste mode is typing)
+void macro_start(uint8_t key);
+
+// Advance playback; call from the main loop
+void macro_task(uint32_t now_ms);
+
+// True while a macro is playing
+bool macro_playing(void);
+
+#endif /* MACRO_H_ */
@@ -15,7 +15,26 @@
 #include "tusb.h"
 
 #include "usb_descriptors.h"
+#include "usb_profile.h"
 #include "ps2.h"
+#include "report_queue.h"
+#include "report_snapshot.h"
+#include "hid_idle.h"
+#include "macro.h"
+#include "consumer.h"
+#include "paste.h"
+#include "telemetry.h"
+#include "console.h"
+#include "config.h"
+#include "store.h"
+#include "keystats.h"
+#include "boot_timing.h"
+#include "clock_gov.h"
+#include "recovery.h"
+#include "profiler.h"
+#include "sniffer.h"
+#include "ps2_dev.h"
+#include "usb_host.h"
 
 //--------------------------------------------------------------------+
 // MACRO CONSTANT TYPEDEF PROTYPES
@@ -36,17 +55,86 @@ static uint32_t blink_interval_ms = BLINK_NOT_MOUNTED;
 
 void led_blinking_task(void);
 void hid_task(void);
+void consumer_hid_task(void);
+void paste_hid_task(void);
+void telemetry_hid_task(void);
+void usb_reconnect_task(void);
+void store_task(void);
+static bool keys_active(void);
+void timing_stats_task(void);
 
 /*------------- MAIN -------------*/
 int main(void)
 {
+  boot_timing_mark(BOOT_MAIN);
+
+#if USB_HOST_ENABLE
+  // PIO-USB's clock first: the UART board_init() sets up runs from it
+  usb_host_clock_init();
+#endif
   board_init();
+
+  // Keep the previous run's record and start the watchdog
+  bool const release_keys = recovery_start();
+
+#if CLOCK_GOV_ENABLE
+  clock_gov_start();
+#endif
   
   // Initialize PS/2 keyboard interface
   ps2_init();
 
+#if PS2_DEV_ENABLE
+  // Type everything to a PS/2 host too; it sees the self-test result
+  // PS2_DEV_BAT_MS from here
+  ps2_dev_init();
+#endif
+
+#if USB_HOST_ENABLE
+  // USB keyboards feed the same key pipeline; their host port runs on core 1
+  usb_host_start();
+#endif
+
+  // After a hang the host may still hold keys: release them first thing
+  // once it has enumerated the device again
+  if ( release_keys )
+  {
+    static uint8_t const released[REPORT_SIZE] = { 0 };
+    report_queue_push(released);
+  }
+
+#if PASTE_ENABLE
+  paste_init();
+#endif
+
+#if TELEMETRY_ENABLE
+  telemetry_init();
+  if ( recovery_cause() == RECOVERY_WATCHDOG ) telemetry_trace(TRACE_WATCHDOG_RESET, recovery_last()->stage);
+#endif
+
+#if PROFILER_ENABLE
+  // Sample from here on; read out through the telemetry interface
+  profiler_clear();
+  profiler_start();
+#endif
+
+#if CONSOLE_ENABLE
+  console_init();
+#endif
+
+#if CONFIG_ENABLE
+  config_init();
+#endif
+
+  // Apply settings saved in flash, including the USB profile
+  config_load();
+  usb_profile_apply();
+
   // init device stack on configured roothub port
+  // The keyboard's self-test is still running; ps2_task() picks up its
+  // result while the host enumerates, and reports queue until then
   tud_init(BOARD_TUD_RHPORT);
+  boot_timing_mark(BOOT_USB_STARTED);
 
   if (board_init_after_tusb) {
     board_init_after_tusb();
@@ -54,17 +142,107 @@ int main(void)
 
   while (1)
   {
+    // Each pass resets the watchdog; the stage marks record where a hang was
+    recovery_feed();
+    telemetry_loop();
+
+    recovery_stage(STAGE_USB);
     tud_task(); // tinyusb device task
+    recovery_stage(STAGE_LED);
     led_blinking_task();
     
-    // Poll PS/2 keyboard for incoming scancodes
-    ps2_task();
+    // Poll PS/2 keyboard for incoming scancodes, or only listen to the bus,
+    // and take the reports of USB keyboards
+    recovery_stage(STAGE_PS2);
+    if ( sniffer_active() ) sniffer_poll();
+    else ps2_task();
+    usb_host_task();
+
+    // Feed the next macro step once the report queue has drained
+    recovery_stage(STAGE_MACRO);
+    macro_task(board_millis());
+
+#if PASTE_ENABLE
+    // Type text received on the paste interface
+    recovery_stage(STAGE_PASTE);
+    paste_task();
+    paste_hid_task();
+#endif
     
-    // Send HID reports when needed
+    // Send HID reports when needed, and typematic repeats on the PS/2 output
+    recovery_stage(STAGE_HID);
     hid_task();
+    consumer_hid_task();
+    ps2_dev_task();
+
+#if TELEMETRY_ENABLE
+    // Stream diagnostics while no keyboard report is waiting
+    recovery_stage(STAGE_TELEMETRY);
+    telemetry_hid_task();
+#endif
+
+#if CONSOLE_ENABLE
+    // Console work only between PS/2 frames with no report waiting
+    recovery_stage(STAGE_CONSOLE);
+    bool const between_frames = sniffer_active() ? sniffer_idle() : ps2_idle();
+    if ( between_frames && !report_queue_peek() ) console_task();
+#endif
+
+    // Re-enumerate for a new USB profile or when the configuration tool asks
+    recovery_stage(STAGE_RECONNECT);
+    usb_reconnect_task();
+
+    // Save changed settings once the keyboard is idle; a DEFAULTS request
+    // restores the keymap first, once no key is held
+    recovery_stage(STAGE_STORE);
+    config_task();
+    store_task();
+
+#if CLOCK_GOV_ENABLE
+    // Lower the clock while idle, back up on the first PS/2 edge
+    recovery_stage(STAGE_CLOCK);
+    clock_gov_task(keys_active());
+#endif
+
+#if PS2_TIMING_STATS
+    timing_stats_task();
+#endif
   }
 }
 
+//--------------------------------------------------------------------+
+// PS/2 timing statistics
+//--------------------------------------------------------------------+
+
+#if PS2_TIMING_STATS
+// Print the edge-to-sample latency and byte handling time on the board UART
+// every 5 s. Compare a build with PS2_HOT_PATH_IN_RAM against one without
+// while typing.
+void timing_stats_task(void)
+{
+  const uint32_t interval_ms = 5000;
+  static uint32_t start_ms = 0;
+
+  if ( board_millis() - start_ms < interval_ms) return; // not enough time
+  start_ms += interval_ms;
+
+  ps2_timing_stats_t stats;
+  ps2_take_timing_stats(&stats);
+  if (stats.edges == 0) return;
+
+  printf("ps2: %lu edges, sample gap mean %lu us, max %lu us\r\n",
+         (unsigned long) stats.edges,
+         (unsigned long) (stats.total_gap_us / stats.edges),
+         (unsigned long) stats.max_gap_us);
+  if (stats.bytes == 0) return;
+
+  printf("ps2: %lu bytes, handling mean %lu us, max %lu us\r\n",
+         (unsigned long) stats.bytes,
+         (unsigned long) (stats.total_byte_us / stats.bytes),
+         (unsigned long) stats.max_byte_us);
+}
+#endif
+
 //--------------------------------------------------------------------+
 // Device callbacks
 //--------------------------------------------------------------------+
@@ -73,12 +251,16 @@ int main(void)
 void tud_mount_cb(void)
 {
   blink_interval_ms = BLINK_MOUNTED;
+  boot_timing_mark(BOOT_USB_MOUNTED);
+  hid_idle_set_rate(0); // idle rate is per configuration, host sets it again
+  telemetry_trace(TRACE_USB_MOUNT, 0);
 }
 
 // Invoked when device is unmounted
 void tud_umount_cb(void)
 {
   blink_interval_ms = BLINK_NOT_MOUNTED;
+  hid_idle_set_rate(0);
 }
 
 // Invoked when usb bus is suspended
@@ -88,40 +270,52 @@ void tud_suspend_cb(bool remote_wakeup_en)
 {
   (void) remote_wakeup_en;
   blink_interval_ms = BLINK_SUSPENDED;
+  telemetry_count(TM_USB_SUSPENDS);
+  telemetry_trace(TRACE_USB_SUSPEND, 0);
 }
 
 // Invoked when usb bus is resumed
 void tud_resume_cb(void)
 {
   blink_interval_ms = tud_mounted() ? BLINK_MOUNTED : BLINK_NOT_MOUNTED;
+  telemetry_trace(TRACE_USB_RESUME, 0);
 }
 
 //--------------------------------------------------------------------+
 // USB HID
 //--------------------------------------------------------------------+
 
-// Send keyboard HID report with current PS/2 state
+// Last keyboard report handed to the host, repeated by the idle rate
+static uint64_t last_report;
+
+// Send the oldest queued keyboard report
 static void send_hid_report(void)
 {
-  // skip if hid is not ready yet
+  // skip if hid is not ready yet, the report stays queued
   if ( !tud_hid_ready() ) return;
-  
+
+  uint8_t const* report = report_queue_peek();
+  if ( !report ) return;
+
   // Send keyboard report using Boot Keyboard format (no report ID)
-  // The tud_hid_keyboard_report function handles this correctly when
-  // the descriptor doesn't include a report ID
-  tud_hid_keyboard_report(0, ps2_get_modifiers(), (uint8_t*)ps2_get_keys());
+  // The report is already in the 8-byte boot layout
+  if ( tud_hid_report(0, report, REPORT_SIZE) )
+  {
+    memcpy(&last_report, report, REPORT_SIZE);
+    report_queue_pop();
+    recovery_report(report);
+    boot_timing_mark(BOOT_FIRST_REPORT);
+    hid_idle_report_sent();
+    telemetry_report_sent();
+    telemetry_trace(TRACE_REPORT_SENT, report[2] ? report[2] : report[0]);
+  }
 }
 
-// Send HID report periodically or when state changes
+// Send HID reports for queued keyboard state changes
+// A report is handed over as soon as the endpoint is free, so reports go
+// out at the HID polling interval (HID_POLL_INTERVAL_MS) set in the descriptor
 void hid_task(void)
 {
-  // Poll every 10ms to send reports
-  const uint32_t interval_ms = 10;
-  static uint32_t start_ms = 0;
-
-  if ( board_millis() - start_ms < interval_ms) return; // not enough time
-  start_ms += interval_ms;
-
   // If suspended, don't send reports
   if ( tud_suspended() )
   {
@@ -129,22 +323,174 @@ void hid_task(void)
     return;
   }
 
-  // Send report if state changed, or periodically for reliability
-  if (ps2_state_changed())
+  // Every state change is queued, so quick taps are not merged away
+  send_hid_report();
+
+  // With a nonzero idle rate, repeat the last report once nothing was sent
+  // for that long. If the endpoint is busy a report is already on its way.
+  if ( hid_idle_resend_due() && !report_queue_peek() && tud_hid_ready() )
+  {
+    if ( tud_hid_report(0, &last_report, REPORT_SIZE) )
+    {
+      hid_idle_report_sent();
+      telemetry_count(TM_REPORTS_REPEATED);
+    }
+  }
+}
+
+// Invoked when received SET_IDLE request. return false will stall the request
+// GET_IDLE is answered by the stack with the last accepted rate
+bool tud_hid_set_idle_cb(uint8_t instance, uint8_t idle_rate)
+{
+#if PASTE_ENABLE
+  // The paste status is event driven, only "on change" is supported
+  if (instance == HID_INSTANCE_PASTE) return idle_rate == 0;
+#endif
+#if TELEMETRY_ENABLE
+  if (instance == HID_INSTANCE_TELEMETRY) return idle_rate == 0;
+#endif
+  if (instance == HID_INSTANCE_CONSUMER) return idle_rate == 0;
+
+  hid_idle_set_rate(idle_rate);
+  return true;
+}
+
+// Send the oldest queued media key or power report; interfaces the USB
+// profile does not have are never ready
+void consumer_hid_task(void)
+{
+  uint8_t report_id;
+  uint8_t data[2];
+
+  if ( tud_suspended() || !tud_hid_n_ready(HID_INSTANCE_CONSUMER) ) return;
+
+  uint16_t len = consumer_peek(&report_id, data);
+  if ( len && tud_hid_n_report(HID_INSTANCE_CONSUMER, report_id, data, len) )
+  {
+    consumer_pop();
+  }
+}
+
+#if PASTE_ENABLE
+// Report FIFO space and typing state to the paste host tool whenever they
+// change; the tool only sends as much text as the FIFO has room for
+void paste_hid_task(void)
+{
+  static uint8_t last_status[5] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+  uint8_t report[PASTE_REPORT_SIZE];
+
+  if ( !tud_hid_n_ready(HID_INSTANCE_PASTE) ) return;
+
+  paste_status_report(report);
+  if ( memcmp(report, last_status, sizeof(last_status)) == 0 ) return;
+
+  if ( tud_hid_n_report(HID_INSTANCE_PASTE, 0, report, PASTE_REPORT_SIZE) )
+  {
+    memcpy(last_status, report, sizeof(last_status));
+  }
+}
+#endif
+
+#if TELEMETRY_ENABLE
+// Send the next telemetry packet. Keyboard reports go first: nothing is
+// sent while one is queued, and the telemetry endpoint is separate
+void telemetry_hid_task(void)
+{
+  uint8_t report[TELEMETRY_REPORT_SIZE];
+
+  if ( tud_suspended() || report_queue_peek() ) return;
+  if ( !tud_hid_n_ready(HID_INSTANCE_TELEMETRY) ) return;
+
+  uint16_t len = telemetry_next_packet(report);
+  if ( len ) tud_hid_n_report(HID_INSTANCE_TELEMETRY, 0, report, len);
+}
+#endif
+
+// Re-enumerate after a profile selection key or a RECONNECT request, so the
+// host picks up the new profile or poll interval. The disconnect waits a
+// little so the host can read the configuration response.
+void usb_reconnect_task(void)
+{
+  enum { IDLE, RESPONDING, DISCONNECTED };
+  static uint8_t state = IDLE;
+  static uint32_t start_ms = 0;
+
+  switch (state)
+  {
+    case IDLE:
+    {
+      bool const profile_changed = usb_profile_take_change();
+      bool const reconnect = config_take_reconnect();
+      if ( !profile_changed && !reconnect ) return;
+      start_ms = board_millis();
+      state = RESPONDING;
+      break;
+    }
+
+    case RESPONDING:
+      if ( board_millis() - start_ms < 50 ) return;
+      tud_disconnect();
+      usb_profile_apply();
+      start_ms = board_millis();
+      state = DISCONNECTED;
+      break;
+
+    default:
+      if ( board_millis() - start_ms < 100 ) return;
+      tud_connect();
+      state = IDLE;
+      break;
+  }
+}
+
+//--------------------------------------------------------------------+
+// Configuration store
+//--------------------------------------------------------------------+
+
+// A PS/2 frame is arriving, or keys are down, queued or being typed (on
+// USB or the PS/2 device output). The bus sniffer also counts: a flash
+// write would drive the clock line, and the idle clock would sample the
+// bus more slowly.
+static bool keys_active(void)
+{
+  return sniffer_active() || !ps2_idle() || ps2_keys_down() || report_queue_peek() != NULL ||
+         macro_playing() || paste_active() || ps2_dev_busy();
+}
+
+// Write changed settings to flash in one batch once no key was active for
+// a while. Key statistics are only saved while USB is suspended. Flash
+// erases stall the sampling loop, so the PS/2 clock is held low meanwhile
+// and the keyboard buffers any keys pressed. They also stop interrupts,
+// so the PS/2 device output finishes its byte first and waits.
+void store_task(void)
+{
+  uint32_t const now = board_millis();
+  bool const active = keys_active();
+  bool due = store_flush_due(now, active);
+
+  if ( keystats_take_save(now, tud_suspended(), active) )
   {
-    send_hid_report();
-    ps2_clear_changed();
+    config_save_keystats();
+    due = true;
   }
+  if ( !due ) return;
+
+  ps2_set_inhibit(true);
+  ps2_dev_hold(true);
+  bool const ok = store_flush();
+  ps2_dev_hold(false);
+  ps2_set_inhibit(false);
+
+  if ( ok ) config_store_flushed();
 }
 
 // Invoked when sent REPORT successfully to host
-// For a single keyboard device, we don't need to chain reports
+// Keyboard reports are chained from hid_task, nothing to do here
 void tud_hid_report_complete_cb(uint8_t instance, uint8_t const* report, uint16_t len)
 {
   (void) instance;
   (void) report;
   (void) len;
-  // Nothing to do - we only have one report type
 }
 
 // Invoked when received GET_REPORT control request
@@ -152,18 +498,43 @@ void tud_hid_report_complete_cb(uint8_t instance, uint8_t const* report, uint16_
 // Return zero will cause the stack to STALL request
 uint16_t tud_hid_get_report_cb(uint8_t instance, uint8_t report_id, hid_report_type_t report_type, uint8_t* buffer, uint16_t reqlen)
 {
+  if (instance == HID_INSTANCE_CONSUMER)
+  {
+    // Current media key or power state for the report ID
+    return (reqlen >= 2) ? consumer_current(report_id, buffer) : 0;
+  }
+
+#if PASTE_ENABLE
+  if (instance == HID_INSTANCE_PASTE)
+  {
+    return (reqlen >= PASTE_REPORT_SIZE) ? paste_status_report(buffer) : 0;
+  }
+#endif
+
+#if TELEMETRY_ENABLE
+  if (instance == HID_INSTANCE_TELEMETRY)
+  {
+    return (reqlen >= TELEMETRY_REPORT_SIZE) ? telemetry_counters_packet(buffer) : 0;
+  }
+#endif
   (void) instance;
-  (void) report_id;
   
+#if CONFIG_ENABLE
+  // Response to the last configuration request
+  if (report_type == HID_REPORT_TYPE_FEATURE)
+  {
+    return (reqlen >= CONFIG_REPORT_SIZE) ? config_response(buffer) : 0;
+  }
+#endif
+
   // For Boot Keyboard, return current keyboard state
+  // The snapshot is read as one consistent 8-byte report
   if (report_type == HID_REPORT_TYPE_INPUT)
   {
-    if (reqlen >= 8)
+    if (reqlen >= REPORT_SIZE)
     {
-      buffer[0] = ps2_get_modifiers();
-      buffer[1] = 0; // Reserved
-      memcpy(&buffer[2], ps2_get_keys(), 6);
-      return 8;
+      report_snapshot_read(buffer);
+      return REPORT_SIZE;
     }
   }
 
@@ -174,9 +545,49 @@ uint16_t tud_hid_get_report_cb(uint8_t instance, uint8_t report_id, hid_report_t
 // received data on OUT endpoint ( Report ID = 0, Type = 0 )
 void tud_hid_set_report_cb(uint8_t instance, uint8_t report_id, hid_report_type_t report_type, uint8_t const* buffer, uint16_t bufsize)
 {
-  (void) instance;
   (void) report_id;
 
+  // The consumer interface has no output reports
+  if (instance == HID_INSTANCE_CONSUMER) return;
+
+#if PASTE_ENABLE
+  if (instance == HID_INSTANCE_PASTE)
+  {
+    // Text chunk from the paste host tool
+    paste_receive(buffer, bufsize);
+    return;
+  }
+#endif
+
+#if TELEMETRY_ENABLE
+  if (instance == HID_INSTANCE_TELEMETRY)
+  {
+    uint8_t const command = bufsize ? buffer[0] : TELEMETRY_CMD_RESET;
+#if PROFILER_ENABLE
+    if ( command == TELEMETRY_CMD_PROFILER_START ) { profiler_start(); return; }
+    if ( command == TELEMETRY_CMD_PROFILER_STOP ) { profiler_stop(); return; }
+#endif
+    (void) command;
+
+    // Reset request from the telemetry host tool
+    telemetry_init();
+#if PROFILER_ENABLE
+    profiler_reset();
+#endif
+    return;
+  }
+#endif
+  (void) instance;
+
+#if CONFIG_ENABLE
+  if (report_type == HID_REPORT_TYPE_FEATURE)
+  {
+    // Request from the configuration tool, answered by the next GET_REPORT
+    config_request(buffer, bufsize);
+    return;
+  }
+#endif
+
   if (report_type == HID_REPORT_TYPE_OUTPUT)
   {
     // Set keyboard LED e.g Capslock, Numlock etc...
@@ -184,6 +595,7 @@ void tud_hid_set_report_cb(uint8_t instance, uint8_t report_id, hid_report_type_
     if ( bufsize < 1 ) return;
 
     uint8_t const kbd_leds = buffer[0];
+    usb_host_set_leds(kbd_leds);
 
     if (kbd_leds & KEYBOARD_LED_CAPSLOCK)
     {
@@ -0,0 +1,165 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * Paste Mode Implementation
+ */
+
+#include "paste.h"
+#include "ps2.h"
+#include "macro.h"
+#include "report_queue.h"
+#include "hid_keycodes.h"
+#include <string.h>
+
+#if (PASTE_FIFO_SIZE & (PASTE_FIFO_SIZE - 1)) != 0
+#error PASTE_FIFO_SIZE must be a power of two
+#endif
+
+#define SHIFT                   0x80    // Flag in ascii_to_hid: needs Left Shift
+
+//--------------------------------------------------------------------+
+// ASCII to HID Keycode (US layout)
+//--------------------------------------------------------------------+
+
+static const uint8_t ascii_to_hid[128] = {
+    ['\t'] = HID_KEY_TAB,
+    ['\n'] = HID_KEY_ENTER,
+    [' ']  = HID_KEY_SPACE,
+
+    ['a'] = HID_KEY_A, ['b'] = HID_KEY_B, ['c'] = HID_KEY_C, ['d'] = HID_KEY_D,
+    ['e'] = HID_KEY_E, ['f'] = HID_KEY_F, ['g'] = HID_KEY_G, ['h'] = HID_KEY_H,
+    ['i'] = HID_KEY_I, ['j'] = HID_KEY_J, ['k'] = HID_KEY_K, ['l'] = HID_KEY_L,
+    ['m'] = HID_KEY_M, ['n'] = HID_KEY_N, ['o'] = HID_KEY_O, ['p'] = HID_KEY_P,
+    ['q'] = HID_KEY_Q, ['r'] = HID_KEY_R, ['s'] = HID_KEY_S, ['t'] = HID_KEY_T,
+    ['u'] = HID_KEY_U, ['v'] = HID_KEY_V, ['w'] = HID_KEY_W, ['x'] = HID_KEY_X,
+    ['y'] = HID_KEY_Y, ['z'] = HID_KEY_Z,
+
+    ['A'] = SHIFT | HID_KEY_A, ['B'] = SHIFT | HID_KEY_B, ['C'] = SHIFT | HID_KEY_C,
+    ['D'] = SHIFT | HID_KEY_D, ['E'] = SHIFT | HID_KEY_E, ['F'] = SHIFT | HID_KEY_F,
+    ['G'] = SHIFT | HID_KEY_G, ['H'] = SHIFT | HID_KEY_H, ['I'] = SHIFT | HID_KEY_I,
+    ['J'] = SHIFT | HID_KEY_J, ['K'] = SHIFT | HID_KEY_K, ['L'] = SHIFT | HID_KEY_L,
+    ['M'] = SHIFT | HID_KEY_M, ['N'] = SHIFT | HID_KEY_N, ['O'] = SHIFT | HID_KEY_O,
+    ['P'] = SHIFT | HID_KEY_P, ['Q'] = SHIFT | HID_KEY_Q, ['R'] = SHIFT | HID_KEY_R,
+    ['S'] = SHIFT | HID_KEY_S, ['T'] = SHIFT | HID_KEY_T, ['U'] = SHIFT | HID_KEY_U,
+    ['V'] = SHIFT | HID_KEY_V, ['W'] = SHIFT | HID_KEY_W, ['X'] = SHIFT | HID_KEY_X,
+    ['Y'] = SHIFT | HID_KEY_Y, ['Z'] = SHIFT | HID_KEY_Z,
+
+    ['1'] = HID_KEY_1, ['2'] = HID_KEY_2, ['3'] = HID_KEY_3, ['4'] = HID_KEY_4,
+    ['5'] = HID_KEY_5, ['6'] = HID_KEY_6, ['7'] = HID_KEY_7, ['8'] = HID_KEY_8,
+    ['9'] = HID_KEY_9, ['0'] = HID_KEY_0,
+
+    ['!'] = SHIFT | HID_KEY_1, ['@'] = SHIFT | HID_KEY_2, ['#'] = SHIFT | HID_KEY_3,
+    ['$'] = SHIFT | HID_KEY_4, ['%'] = SHIFT | HID_KEY_5, ['^'] = SHIFT | HID_KEY_6,
+    ['&'] = SHIFT | HID_KEY_7, ['*'] = SHIFT | HID_KEY_8, ['('] = SHIFT | HID_KEY_9,
+    [')'] = SHIFT | HID_KEY_0,
+
+    ['-'] = HID_KEY_MINUS,          ['_'] = SHIFT | HID_KEY_MINUS,
+    ['='] = HID_KEY_EQUAL,          ['+'] = SHIFT | HID_KEY_EQUAL,
+    ['['] = HID_KEY_BRACKET_LEFT,   ['{'] = SHIFT | HID_KEY_BRACKET_LEFT,
+    [']'] = HID_KEY_BRACKET_RIGHT,  ['}'] = SHIFT | HID_KEY_BRACKET_RIGHT,
+    ['\\'] = HID_KEY_BACKSLASH,     ['|'] = SHIFT | HID_KEY_BACKSLASH,
+    [';'] = HID_KEY_SEMICOLON,      [':'] = SHIFT | HID_KEY_SEMICOLON,
+    ['\''] = HID_KEY_APOSTROPHE,    ['"'] = SHIFT | HID_KEY_APOSTROPHE,
+    ['`'] = HID_KEY_GRAVE,          ['~'] = SHIFT | HID_KEY_GRAVE,
+    [','] = HID_KEY_COMMA,          ['<'] = SHIFT | HID_KEY_COMMA,
+    ['.'] = HID_KEY_PERIOD,         ['>'] = SHIFT | HID_KEY_PERIOD,
+    ['/'] = HID_KEY_SLASH,          ['?'] = SHIFT | HID_KEY_SLASH,
+};
+
+//--------------------------------------------------------------------+
+// Paste State
+//--------------------------------------------------------------------+
+
+static uint8_t fifo[PASTE_FIFO_SIZE];
+static uint16_t fifo_head = 0;          // Next character to type
+static uint16_t fifo_count = 0;
+static uint16_t received = 0;           // Text bytes received, wraps
+
+static uint8_t last_key = 0;            // Key in the last report (0 = none)
+static uint8_t last_modifiers = 0;
+
+static inline void fifo_skip(void) {
+    fifo_head = (fifo_head + 1) & (PASTE_FIFO_SIZE - 1);
+    fifo_count--;
+}
+
+static void send(uint8_t modifiers, uint8_t key) {
+    uint8_t keys[6] = { key };
+    ps2_set_injected(modifiers, keys);
+    last_key = key;
+    last_modifiers = modifiers;
+}
+
+//--------------------------------------------------------------------+
+// Public Interface
+//--------------------------------------------------------------------+
+
+void paste_init(void) {
+    fifo_head = 0;
+    fifo_count = 0;
+    received = 0;
+    last_key = 0;
+    last_modifiers = 0;
+}
+
+void paste_receive(const uint8_t* report, uint16_t len) {
+    if (len < 1) return;
+
+    uint16_t count = report[0];
+    if (count > len - 1) count = len - 1;
+    received += count;
+
+    for (uint16_t i = 0; i < count && fifo_count < PASTE_FIFO_SIZE; i++) {
+        uint8_t c = report[1 + i];
+        // Carriage returns are dropped so CR LF types a single Enter
+        if (c == '\r' || c >= 128 || ascii_to_hid[c] == 0) continue;
+
+        fifo[(fifo_head + fifo_count) & (PASTE_FIFO_SIZE - 1)] = c;
+        fifo_count++;
+    }
+}
+
+uint16_t paste_free(void) {
+    return PASTE_FIFO_SIZE - fifo_count;
+}
+
+bool paste_active(void) {
+    return fifo_count != 0 || last_key != 0 || last_modifiers != 0;
+}
+
+void paste_task(void) {
+    if (!paste_active() || macro_playing()) return;
+
+    // Back-pressure: one report in flight at a time
+    if (report_queue_peek() != NULL) return;
+
+    if (fifo_count == 0) {
+        // Finished - release everything
+        send(0, 0);
+        return;
+    }
+
+    uint8_t code = ascii_to_hid[fifo[fifo_head]];
+    uint8_t key = code & ~SHIFT;
+    uint8_t modifiers = (code & SHIFT) ? HID_MOD_LEFT_SHIFT : 0;
+
+    if (key == last_key) {
+        // Same key twice: the host needs to see it released in between
+        send(last_modifiers, 0);
+        return;
+    }
+
+    fifo_skip();
+    send(modifiers, key);
+}
+
+uint16_t paste_status_report(uint8_t* report) {
+    uint16_t free_bytes = paste_free();
+
+    memset(report, 0, PASTE_REPORT_SIZE);
+    report[0] = paste_active() ? PASTE_STATUS_TYPING : 0;
+    report[1] = (uint8_t) (free_bytes & 0xFF);
+    report[2] = (uint8_t) (free_bytes >> 8);
+    report[3] = (uint8_t) (received & 0xFF);
+    report[4] = (uint8_t) (received >> 8);
+    return PASTE_REPORT_SIZE;
+}
@@ -0,0 +1,51 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * Paste Mode Header
+ *
+ * Text streamed from the host over the paste HID interface is typed on the
+ * boot keyboard interface using the fewest reports the host can decode:
+ * each report presses the next key (which implicitly releases the previous
+ * one) with the modifiers it needs, and an all-released report is only
+ * inserted when the same key is typed twice in a row.
+ */
+
+#ifndef PASTE_H_
+#define PASTE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Text waiting to be typed (power of two)
+#ifndef PASTE_FIFO_SIZE
+#define PASTE_FIFO_SIZE         1024
+#endif
+
+// Paste interface report size (both directions)
+#define PASTE_REPORT_SIZE       64
+
+// OUT report: [0] = text length (1-63), [1..] = ASCII text
+// IN report:  [0] = PASTE_STATUS_* flags, [1..2] = free FIFO bytes (LE),
+//             [3..4] = text bytes received so far, mod 65536 (LE)
+// The host may have (free - bytes sent but not yet counted) in flight
+#define PASTE_STATUS_TYPING     0x01
+
+// Initialize paste state
+void paste_init(void);
+
+// Queue an OUT report's text; characters beyond the free space are dropped
+void paste_receive(const uint8_t* report, uint16_t len);
+
+// Free space in the text FIFO (the host may send this many characters)
+uint16_t paste_free(void);
+
+// True while text is queued or being typed
+bool paste_active(void);
+
+// Type the next report once the report queue has drained
+// Call from the main loop
+void paste_task(void);
+
+// Fill an IN status report, returns its length
+uint16_t paste_status_report(uint8_t* report);
+
+#endif /* PASTE_H_ */
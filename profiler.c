@@ -0,0 +1,76 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * Sampling Profiler Histogram
+ *
+ * Slots are only written from the sampling interrupt. A slot's PC is set
+ * before its count, so a reader in the main loop never sees a count
+ * without its PC.
+ */
+
+#include "profiler.h"
+#include <string.h>
+
+#if (PROFILER_SLOTS & (PROFILER_SLOTS - 1)) != 0
+#error PROFILER_SLOTS must be a power of two
+#endif
+
+typedef struct {
+    uint32_t pc;                // 0 = empty
+    uint32_t count;
+} slot_t;
+
+static volatile slot_t slots[PROFILER_SLOTS];
+static volatile uint32_t samples = 0;
+static volatile uint32_t dropped = 0;
+
+// Fibonacci hash; PCs are at least 2-byte aligned
+static inline uint32_t slot_of(uint32_t pc) {
+    return ((pc >> 1) * 2654435761u) >> 16;
+}
+
+void profiler_clear(void) {
+    for (uint32_t i = 0; i < PROFILER_SLOTS; i++) {
+        slots[i].pc = 0;
+        slots[i].count = 0;
+    }
+    samples = 0;
+    dropped = 0;
+}
+
+void profiler_sample(uint32_t pc) {
+    samples++;
+    if (pc == 0) {
+        dropped++;
+        return;
+    }
+
+    uint32_t index = slot_of(pc);
+    for (uint32_t probe = 0; probe < PROFILER_PROBES; probe++) {
+        volatile slot_t* slot = &slots[(index + probe) & (PROFILER_SLOTS - 1)];
+        if (slot->pc == pc) {
+            slot->count++;
+            return;
+        }
+        if (slot->pc == 0) {
+            slot->pc = pc;
+            slot->count = 1;
+            return;
+        }
+    }
+    dropped++;
+}
+
+bool profiler_slot(uint16_t index, uint32_t* pc, uint32_t* count) {
+    if (index >= PROFILER_SLOTS) return false;
+    *pc = slots[index].pc;
+    *count = slots[index].count;
+    return *pc != 0 && *count != 0;
+}
+
+uint32_t profiler_samples(void) {
+    return samples;
+}
+
+uint32_t profiler_dropped(void) {
+    return dropped;
+}
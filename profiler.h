@@ -0,0 +1,61 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * Sampling Profiler Header
+ *
+ * Optional (PROFILER_ENABLE): a timer interrupt records the interrupted
+ * program counter every PROFILER_PERIOD_US (with a little jitter, so
+ * periodic work is not always hit at the same point). Samples are counted
+ * per PC in a fixed-size hash table; a PC that finds no free slot within
+ * PROFILER_PROBES is counted as dropped. The table is streamed over the
+ * telemetry interface (TELEMETRY_PKT_PROFILE) and tools/profiler.py
+ * resolves the PCs against the firmware's ELF file.
+ *
+ * profiler.c holds the table, without hardware dependencies;
+ * profiler_pico.c runs the sampling interrupt.
+ */
+
+#ifndef PROFILER_H_
+#define PROFILER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef PROFILER_ENABLE
+#define PROFILER_ENABLE         0
+#endif
+
+// Mean sampling interval
+#ifndef PROFILER_PERIOD_US
+#define PROFILER_PERIOD_US      1000
+#endif
+
+// Distinct PCs the table can hold (power of two), 8 bytes each
+#ifndef PROFILER_SLOTS
+#define PROFILER_SLOTS          1024
+#endif
+
+// Slots tried per sample before it is dropped
+#define PROFILER_PROBES         8
+
+// Empty the table and zero the totals (with sampling stopped, see
+// profiler_reset)
+void profiler_clear(void);
+
+// Count one sample (called from the sampling interrupt)
+void profiler_sample(uint32_t pc);
+
+// Read a slot: false if it is empty
+bool profiler_slot(uint16_t index, uint32_t* pc, uint32_t* count);
+
+// Samples taken and dropped since the last clear
+uint32_t profiler_samples(void);
+uint32_t profiler_dropped(void);
+
+// Device side (profiler_pico.c): start or stop the sampling interrupt,
+// and clear the table without losing a sample halfway
+void profiler_start(void);
+void profiler_stop(void);
+bool profiler_running(void);
+void profiler_reset(void);
+
+#endif /* PROFILER_H_ */
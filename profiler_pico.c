@@ -0,0 +1,105 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * Sampling Profiler - Timer Interrupt
+ *
+ * A hardware alarm of its own, at the highest interrupt priority so time
+ * spent in other interrupt handlers (the USB controller's) is sampled
+ * too. The timer counts microseconds from clk_ref, so the sampling rate
+ * does not change with the clock governor.
+ *
+ * On Arm the handler is entered straight from the vector table and takes
+ * the interrupted PC from the exception frame; on RISC-V the SDK's
+ * dispatcher calls it as a C function and the PC is in mepc.
+ */
+
+#include "profiler.h"
+
+#if PROFILER_ENABLE
+
+#include "pico/stdlib.h"
+#include "hardware/timer.h"
+#include "hardware/irq.h"
+
+static int alarm_num = -1;
+static bool running = false;
+static uint32_t lfsr = 0xACE1u;
+
+// Next interval: PROFILER_PERIOD_US on average, from half to one and a
+// half times it, so periodic main loop work is not always hit in phase
+static inline uint32_t __not_in_flash_func(next_delay)(void) {
+    lfsr = (lfsr >> 1) ^ (-(lfsr & 1u) & 0xB400u);
+    return PROFILER_PERIOD_US / 2 + lfsr % PROFILER_PERIOD_US;
+}
+
+static void __attribute__((used, noinline)) __not_in_flash_func(sample_pc)(uint32_t pc) {
+    timer_hw->intr = 1u << alarm_num;
+    timer_hw->alarm[alarm_num] = timer_hw->timerawl + next_delay();
+    profiler_sample(pc);
+}
+
+#if defined(__riscv)
+static void __not_in_flash_func(sample_irq)(void) {
+    uint32_t pc;
+    __asm volatile ("csrr %0, mepc" : "=r" (pc));
+    sample_pc(pc);
+}
+#else
+// The frame is on the process stack only if the interrupted code used it
+// (bit 2 of EXC_RETURN); the stacked PC is its seventh word
+static void __attribute__((naked)) __not_in_flash_func(sample_irq)(void) {
+    __asm volatile (
+        "movs r0, #4\n"
+        "mov  r1, lr\n"
+        "tst  r0, r1\n"
+        "beq  1f\n"
+        "mrs  r0, psp\n"
+        "b    2f\n"
+        "1:\n"
+        "mrs  r0, msp\n"
+        "2:\n"
+        "ldr  r0, [r0, #24]\n"
+        "ldr  r1, =sample_pc\n"
+        "bx   r1\n"
+        ".ltorg\n"
+    );
+}
+#endif
+
+void profiler_start(void) {
+    if (running) return;
+
+    if (alarm_num < 0) {
+        alarm_num = hardware_alarm_claim_unused(true);
+        uint irq = hardware_alarm_get_irq_num((uint) alarm_num);
+        irq_set_exclusive_handler(irq, sample_irq);
+        irq_set_priority(irq, PICO_HIGHEST_IRQ_PRIORITY);
+    }
+
+    hw_set_bits(&timer_hw->inte, 1u << alarm_num);
+    irq_set_enabled(hardware_alarm_get_irq_num((uint) alarm_num), true);
+    timer_hw->alarm[alarm_num] = timer_hw->timerawl + next_delay();
+    running = true;
+}
+
+void profiler_stop(void) {
+    if (!running) return;
+
+    irq_set_enabled(hardware_alarm_get_irq_num((uint) alarm_num), false);
+    hw_clear_bits(&timer_hw->inte, 1u << alarm_num);
+    timer_hw->armed = 1u << alarm_num;
+    timer_hw->intr = 1u << alarm_num;
+    running = false;
+}
+
+bool profiler_running(void) {
+    return running;
+}
+
+void profiler_reset(void) {
+    bool was_running = running;
+    profiler_stop();
+    profiler_clear();
+    if (was_running) profiler_start();
+}
+
+#endif /* PROFILER_ENABLE */
@@ -7,306 +7,86 @@
  */
 
 #include "ps2.h"
+#include "hid_keycodes.h"
+#include "ps2_tables.h"
+#include "keymap.h"
+#include "taphold.h"
+#include "combo.h"
+#include "debounce.h"
+#include "macro.h"
+#include "socd.h"
+#include "consumer.h"
+#include "keystats.h"
+#include "usb_profile.h"
+#include "report_queue.h"
+#include "report_snapshot.h"
+#include "ps2_dev.h"
+#include "telemetry.h"
+#include "boot_timing.h"
+#include "recovery.h"
 #include "pico/stdlib.h"
 #include "hardware/gpio.h"
 #include <string.h>
 
-//--------------------------------------------------------------------+
-// HID Keycode Definitions (from USB HID Usage Tables)
-//--------------------------------------------------------------------+
-
-// Letters A-Z (0x04 - 0x1D)
-#define HID_KEY_A               0x04
-#define HID_KEY_B               0x05
-#define HID_KEY_C               0x06
-#define HID_KEY_D               0x07
-#define HID_KEY_E               0x08
-#define HID_KEY_F               0x09
-#define HID_KEY_G               0x0A
-#define HID_KEY_H               0x0B
-#define HID_KEY_I               0x0C
-#define HID_KEY_J               0x0D
-#define HID_KEY_K               0x0E
-#define HID_KEY_L               0x0F
-#define HID_KEY_M               0x10
-#define HID_KEY_N               0x11
-#define HID_KEY_O               0x12
-#define HID_KEY_P               0x13
-#define HID_KEY_Q               0x14
-#define HID_KEY_R               0x15
-#define HID_KEY_S               0x16
-#define HID_KEY_T               0x17
-#define HID_KEY_U               0x18
-#define HID_KEY_V               0x19
-#define HID_KEY_W               0x1A
-#define HID_KEY_X               0x1B
-#define HID_KEY_Y               0x1C
-#define HID_KEY_Z               0x1D
-
-// Numbers 1-0 (0x1E - 0x27)
-#define HID_KEY_1               0x1E
-#define HID_KEY_2               0x1F
-#define HID_KEY_3               0x20
-#define HID_KEY_4               0x21
-#define HID_KEY_5               0x22
-#define HID_KEY_6               0x23
-#define HID_KEY_7               0x24
-#define HID_KEY_8               0x25
-#define HID_KEY_9               0x26
-#define HID_KEY_0               0x27
-
-// Special keys
-#define HID_KEY_ENTER           0x28
-#define HID_KEY_ESCAPE          0x29
-#define HID_KEY_BACKSPACE       0x2A
-#define HID_KEY_TAB             0x2B
-#define HID_KEY_SPACE           0x2C
-#define HID_KEY_MINUS           0x2D
-#define HID_KEY_EQUAL           0x2E
-#define HID_KEY_BRACKET_LEFT    0x2F
-#define HID_KEY_BRACKET_RIGHT   0x30
-#define HID_KEY_BACKSLASH       0x31
-#define HID_KEY_SEMICOLON       0x33
-#define HID_KEY_APOSTROPHE      0x34
-#define HID_KEY_GRAVE           0x35
-#define HID_KEY_COMMA           0x36
-#define HID_KEY_PERIOD          0x37
-#define HID_KEY_SLASH           0x38
-#define HID_KEY_CAPS_LOCK       0x39
-
-// Function keys F1-F12
-#define HID_KEY_F1              0x3A
-#define HID_KEY_F2              0x3B
-#define HID_KEY_F3              0x3C
-#define HID_KEY_F4              0x3D
-#define HID_KEY_F5              0x3E
-#define HID_KEY_F6              0x3F
-#define HID_KEY_F7              0x40
-#define HID_KEY_F8              0x41
-#define HID_KEY_F9              0x42
-#define HID_KEY_F10             0x43
-#define HID_KEY_F11             0x44
-#define HID_KEY_F12             0x45
-
-// Print Screen, Scroll Lock, Pause
-#define HID_KEY_PRINT_SCREEN    0x46
-#define HID_KEY_SCROLL_LOCK     0x47
-#define HID_KEY_PAUSE           0x48
-
-// Navigation cluster
-#define HID_KEY_INSERT          0x49
-#define HID_KEY_HOME            0x4A
-#define HID_KEY_PAGE_UP         0x4B
-#define HID_KEY_DELETE          0x4C
-#define HID_KEY_END             0x4D
-#define HID_KEY_PAGE_DOWN       0x4E
-#define HID_KEY_ARROW_RIGHT     0x4F
-#define HID_KEY_ARROW_LEFT      0x50
-#define HID_KEY_ARROW_DOWN      0x51
-#define HID_KEY_ARROW_UP        0x52
-
-// Numpad
-#define HID_KEY_NUM_LOCK        0x53
-#define HID_KEY_KEYPAD_DIVIDE   0x54
-#define HID_KEY_KEYPAD_MULTIPLY 0x55
-#define HID_KEY_KEYPAD_SUBTRACT 0x56
-#define HID_KEY_KEYPAD_ADD      0x57
-#define HID_KEY_KEYPAD_ENTER    0x58
-#define HID_KEY_KEYPAD_1        0x59
-#define HID_KEY_KEYPAD_2        0x5A
-#define HID_KEY_KEYPAD_3        0x5B
-#define HID_KEY_KEYPAD_4        0x5C
-#define HID_KEY_KEYPAD_5        0x5D
-#define HID_KEY_KEYPAD_6        0x5E
-#define HID_KEY_KEYPAD_7        0x5F
-#define HID_KEY_KEYPAD_8        0x60
-#define HID_KEY_KEYPAD_9        0x61
-#define HID_KEY_KEYPAD_0        0x62
-#define HID_KEY_KEYPAD_DECIMAL  0x63
-
-// Modifier key bits (for the modifier byte)
-#define HID_MOD_LEFT_CTRL       0x01
-#define HID_MOD_LEFT_SHIFT      0x02
-#define HID_MOD_LEFT_ALT        0x04
-#define HID_MOD_LEFT_GUI        0x08
-#define HID_MOD_RIGHT_CTRL      0x10
-#define HID_MOD_RIGHT_SHIFT     0x20
-#define HID_MOD_RIGHT_ALT       0x40
-#define HID_MOD_RIGHT_GUI       0x80
-
-// Application/Menu key
-#define HID_KEY_APPLICATION     0x65
+// The sampling loop, placed in SRAM with PS2_HOT_PATH_IN_RAM
+#if PS2_HOT_PATH_IN_RAM
+#define PS2_HOT_FUNC(func)  __not_in_flash_func(func)
+#else
+#define PS2_HOT_FUNC(func)  func
+#endif
 
 //--------------------------------------------------------------------+
-// PS/2 Scancode to HID Keycode Mapping Tables
+// Global Keyboard State
 //--------------------------------------------------------------------+
 
-// PS/2 Set 2 scancode -> HID Keycode (standard, non-extended keys)
-// Index is PS/2 scancode, value is HID keycode (0 = unmapped)
-static const uint8_t scancode_to_hid[256] = {
-    // 0x00-0x0F
-    [0x01] = HID_KEY_F9,
-    [0x03] = HID_KEY_F5,
-    [0x04] = HID_KEY_F3,
-    [0x05] = HID_KEY_F1,
-    [0x06] = HID_KEY_F2,
-    [0x07] = HID_KEY_F12,
-    [0x09] = HID_KEY_F10,
-    [0x0A] = HID_KEY_F8,
-    [0x0B] = HID_KEY_F6,
-    [0x0C] = HID_KEY_F4,
-    [0x0D] = HID_KEY_TAB,
-    [0x0E] = HID_KEY_GRAVE,
-    
-    // 0x10-0x1F
-    [0x11] = 0xFF,  // Left Alt (handled as modifier)
-    [0x12] = 0xFE,  // Left Shift (handled as modifier)
-    [0x14] = 0xFD,  // Left Ctrl (handled as modifier)
-    [0x15] = HID_KEY_Q,
-    [0x16] = HID_KEY_1,
-    [0x1A] = HID_KEY_Z,
-    [0x1B] = HID_KEY_S,
-    [0x1C] = HID_KEY_A,
-    [0x1D] = HID_KEY_W,
-    [0x1E] = HID_KEY_2,
-    
-    // 0x20-0x2F
-    [0x21] = HID_KEY_C,
-    [0x22] = HID_KEY_X,
-    [0x23] = HID_KEY_D,
-    [0x24] = HID_KEY_E,
-    [0x25] = HID_KEY_4,
-    [0x26] = HID_KEY_3,
-    [0x29] = HID_KEY_SPACE,
-    [0x2A] = HID_KEY_V,
-    [0x2B] = HID_KEY_F,
-    [0x2C] = HID_KEY_T,
-    [0x2D] = HID_KEY_R,
-    [0x2E] = HID_KEY_5,
-    
-    // 0x30-0x3F
-    [0x31] = HID_KEY_N,
-    [0x32] = HID_KEY_B,
-    [0x33] = HID_KEY_H,
-    [0x34] = HID_KEY_G,
-    [0x35] = HID_KEY_Y,
-    [0x36] = HID_KEY_6,
-    [0x3A] = HID_KEY_M,
-    [0x3B] = HID_KEY_J,
-    [0x3C] = HID_KEY_U,
-    [0x3D] = HID_KEY_7,
-    [0x3E] = HID_KEY_8,
-    
-    // 0x40-0x4F
-    [0x41] = HID_KEY_COMMA,
-    [0x42] = HID_KEY_K,
-    [0x43] = HID_KEY_I,
-    [0x44] = HID_KEY_O,
-    [0x45] = HID_KEY_0,
-    [0x46] = HID_KEY_9,
-    [0x49] = HID_KEY_PERIOD,
-    [0x4A] = HID_KEY_SLASH,
-    [0x4B] = HID_KEY_L,
-    [0x4C] = HID_KEY_SEMICOLON,
-    [0x4D] = HID_KEY_P,
-    [0x4E] = HID_KEY_MINUS,
-    
-    // 0x50-0x5F
-    [0x52] = HID_KEY_APOSTROPHE,
-    [0x54] = HID_KEY_BRACKET_LEFT,
-    [0x55] = HID_KEY_EQUAL,
-    [0x58] = 0xFC,  // Caps Lock (handled specially)
-    [0x59] = 0xFB,  // Right Shift (handled as modifier)
-    [0x5A] = HID_KEY_ENTER,
-    [0x5B] = HID_KEY_BRACKET_RIGHT,
-    [0x5D] = HID_KEY_BACKSLASH,
-    
-    // 0x60-0x6F
-    [0x66] = HID_KEY_BACKSPACE,
-    [0x69] = HID_KEY_KEYPAD_1,
-    [0x6B] = HID_KEY_KEYPAD_4,
-    [0x6C] = HID_KEY_KEYPAD_7,
-    
-    // 0x70-0x7F
-    [0x70] = HID_KEY_KEYPAD_0,
-    [0x71] = HID_KEY_KEYPAD_DECIMAL,
-    [0x72] = HID_KEY_KEYPAD_2,
-    [0x73] = HID_KEY_KEYPAD_5,
-    [0x74] = HID_KEY_KEYPAD_6,
-    [0x75] = HID_KEY_KEYPAD_8,
-    [0x76] = HID_KEY_ESCAPE,
-    [0x77] = HID_KEY_SCROLL_LOCK,
-    [0x78] = HID_KEY_F11,
-    [0x79] = HID_KEY_KEYPAD_ADD,
-    [0x7A] = HID_KEY_KEYPAD_3,
-    [0x7B] = HID_KEY_KEYPAD_SUBTRACT,
-    [0x7C] = HID_KEY_KEYPAD_MULTIPLY,
-    [0x7D] = HID_KEY_KEYPAD_9,
-    [0x7E] = HID_KEY_NUM_LOCK,
-    
-    // 0x80-0x8F
-    [0x83] = HID_KEY_F7,
-};
-
-// PS/2 Set 2 Extended scancodes (prefixed with 0xE0) -> HID Keycode
-static const uint8_t extended_scancode_to_hid[256] = {
-    [0x11] = 0xFA,  // Right Alt (handled as modifier)
-    [0x14] = 0xF9,  // Right Ctrl (handled as modifier)
-    [0x1F] = 0xF8,  // Left GUI (handled as modifier)
-    [0x27] = 0xF7,  // Right GUI (handled as modifier)
-    [0x2F] = HID_KEY_APPLICATION,  // Menu/Context key
-    
-    // Numpad extended
-    [0x4A] = HID_KEY_KEYPAD_DIVIDE,
-    [0x5A] = HID_KEY_KEYPAD_ENTER,
-    
-    // Navigation cluster
-    [0x69] = HID_KEY_END,
-    [0x6B] = HID_KEY_ARROW_LEFT,
-    [0x6C] = HID_KEY_HOME,
-    [0x70] = HID_KEY_INSERT,
-    [0x71] = HID_KEY_DELETE,
-    [0x72] = HID_KEY_ARROW_DOWN,
-    [0x74] = HID_KEY_ARROW_RIGHT,
-    [0x75] = HID_KEY_ARROW_UP,
-    [0x7A] = HID_KEY_PAGE_DOWN,
-    [0x7D] = HID_KEY_PAGE_UP,
-};
+// Boot report layout, 8-byte aligned so it can be compared as one word
+typedef union {
+    uint8_t bytes[REPORT_SIZE];        // Modifiers, reserved, 6 keycodes
+    uint64_t word;
+} boot_report_t;
 
-//--------------------------------------------------------------------+
-// Global Keyboard State
-//--------------------------------------------------------------------+
+// Current keyboard state, kept as a ready-to-send report and updated in
+// place by press_key() and release_key()
+static boot_report_t g_report;
+static uint8_t* const g_keys = &g_report.bytes[2];
 
-static uint8_t g_modifiers = 0;        // Current modifier key state
-static uint8_t g_keys[6] = {0};        // Up to 6 simultaneous key presses
-static bool g_state_changed = false;   // Flag to indicate state changed
+// Last report queued, to detect changes
+static uint64_t g_last_queued = 0;
+
+// Keys injected by macros, merged into every report
+static uint8_t g_injected_modifiers = 0;
+static uint8_t g_injected_keys[6] = {0};
+static bool g_injected_active = false;
 
 // PS/2 Frame decoding state
 static uint8_t frame_bit_index = 0;
 static uint8_t scancode_byte = 0;
 static bool break_pending = false;     // True after receiving 0xF0
 static bool extended_pending = false;  // True after receiving 0xE0
+static uint8_t pause_bytes = 0;        // Bytes left of the E1 Pause sequence
 static bool last_clk = true;           // Previous clock state
 
+// Keyboard start-up
+static ps2_kbd_state_t kbd_state = PS2_KBD_POWER_UP;
+static uint32_t init_ms = 0;
+
+#if PS2_TIMING_STATS
+static ps2_timing_stats_t timing;
+static uint32_t last_sample_us = 0;    // Time of the previous clock sample
+#endif
+
 //--------------------------------------------------------------------+
 // Helper Functions
 //--------------------------------------------------------------------+
 
 // Check if a keycode is a modifier and return its bit mask
 // Returns 0 if not a modifier
-static uint8_t get_modifier_mask(uint8_t hid_code) {
-    switch (hid_code) {
-        case 0xFF: return HID_MOD_LEFT_ALT;     // PS/2 0x11
-        case 0xFE: return HID_MOD_LEFT_SHIFT;   // PS/2 0x12
-        case 0xFD: return HID_MOD_LEFT_CTRL;    // PS/2 0x14
-        case 0xFC: return 0;                     // Caps Lock - not a modifier
-        case 0xFB: return HID_MOD_RIGHT_SHIFT;  // PS/2 0x59
-        case 0xFA: return HID_MOD_RIGHT_ALT;    // PS/2 E0 11
-        case 0xF9: return HID_MOD_RIGHT_CTRL;   // PS/2 E0 14
-        case 0xF8: return HID_MOD_LEFT_GUI;     // PS/2 E0 1F
-        case 0xF7: return HID_MOD_RIGHT_GUI;    // PS/2 E0 27
-        default:   return 0;
+static inline uint8_t get_modifier_mask(uint8_t hid_code) {
+    // HID modifier usages 0xE0-0xE7 map to modifier byte bits 0-7
+    if (hid_code >= HID_KEY_CONTROL_LEFT && hid_code <= HID_KEY_GUI_RIGHT) {
+        return (uint8_t) (1u << (hid_code - HID_KEY_CONTROL_LEFT));
     }
+    return 0;
 }
 
 // Press a key (add to the current state)
@@ -316,18 +96,10 @@ static void press_key(uint8_t hid_code) {
     // Check if it's a modifier key
     uint8_t mod_mask = get_modifier_mask(hid_code);
     if (mod_mask != 0) {
-        if (!(g_modifiers & mod_mask)) {
-            g_modifiers |= mod_mask;
-            g_state_changed = true;
-        }
+        g_report.bytes[0] |= mod_mask;
         return;
     }
     
-    // Handle Caps Lock specially (it's a toggle, but we just send press/release)
-    if (hid_code == 0xFC) {
-        hid_code = HID_KEY_CAPS_LOCK;
-    }
-    
     // Check if already pressed
     for (int i = 0; i < 6; i++) {
         if (g_keys[i] == hid_code) return; // Already pressed
@@ -337,7 +109,6 @@ static void press_key(uint8_t hid_code) {
     for (int i = 0; i < 6; i++) {
         if (g_keys[i] == 0) {
             g_keys[i] = hid_code;
-            g_state_changed = true;
             return;
         }
     }
@@ -351,36 +122,118 @@ static void release_key(uint8_t hid_code) {
     // Check if it's a modifier key
     uint8_t mod_mask = get_modifier_mask(hid_code);
     if (mod_mask != 0) {
-        if (g_modifiers & mod_mask) {
-            g_modifiers &= ~mod_mask;
-            g_state_changed = true;
-        }
+        g_report.bytes[0] &= ~mod_mask;
         return;
     }
     
-    // Handle Caps Lock specially
-    if (hid_code == 0xFC) {
-        hid_code = HID_KEY_CAPS_LOCK;
-    }
-    
     // Find and remove from keys array
     for (int i = 0; i < 6; i++) {
         if (g_keys[i] == hid_code) {
             g_keys[i] = 0;
-            g_state_changed = true;
             return;
         }
     }
 }
 
+// Queue a report if the state plus any injected keys differs from the
+// last one queued, and publish it for GET_REPORT (see report_snapshot.h)
+static void queue_report_if_changed(void) {
+    boot_report_t report = g_report;
+    
+    if (g_injected_active) {
+        report.bytes[0] |= g_injected_modifiers;
+        
+        // Injected keys take free slots not already used by the same key
+        for (int i = 0; i < 6; i++) {
+            uint8_t key = g_injected_keys[i];
+            if (key == 0 || memchr(&report.bytes[2], key, 6) != NULL) continue;
+            
+            uint8_t* slot = memchr(&report.bytes[2], 0, 6);
+            if (slot == NULL) break;
+            *slot = key;
+        }
+    }
+    
+    if (report.word == g_last_queued) return;
+    g_last_queued = report.word;
+    
+    report_snapshot_publish(report.bytes);
+    report_queue_push(report.bytes);
+    ps2_dev_send_report(report.bytes);
+    telemetry_count(TM_REPORTS_QUEUED);
+}
+
+// Update the keyboard state with a fully resolved key event
+static void update_key_state(uint8_t code, bool pressed, uint32_t time_ms) {
+    (void) time_ms;
+    
+    if (pressed) {
+        press_key(code);
+    } else {
+        release_key(code);
+    }
+}
+
+#if KEYSTATS_ENABLE
+// Keys down after the chatter filter, one bit per HID keycode
+static uint8_t counted_down[32];
+
+// Pipeline stage after the chatter filter: count each press once for the
+// key statistics, whatever later stages do with it. Typematic repeats
+// arrive as presses of a key that is already down and are not counted.
+static void count_key_event(uint8_t key, bool pressed, uint32_t time_ms) {
+    uint8_t bit = (uint8_t) (1u << (key & 7));
+    if (pressed) {
+        if (!(counted_down[key >> 3] & bit)) keystats_press(key);
+        counted_down[key >> 3] |= bit;
+    } else {
+        counted_down[key >> 3] &= (uint8_t) ~bit;
+    }
+    combo_process(key, pressed, time_ms);
+}
+#endif
+
+// Last pipeline stage: resolve layers and update the keyboard state
+static void apply_key_event(uint8_t key, bool pressed, uint32_t time_ms) {
+    // Resolve through the active keymap layers
+    uint8_t code = pressed ? keymap_press(key) : keymap_release(key);
+    if (code == 0) return;
+    
+    // Keys bound to a macro start playback instead of being pressed
+    if (macro_is_bound(code)) {
+        if (pressed) macro_start(code);
+        return;
+    }
+    
+    // Volume and power keys go to the consumer interface when it exists
+    if (consumer_process(code, pressed)) return;
+    
+    // Opposing direction keys may replace each other in the same report
+    socd_process(code, pressed, time_ms);
+    
+    queue_report_if_changed();
+}
+
+// Feed a decoded key into the key pipeline
+static void handle_key(uint8_t hid_code, bool pressed) {
+    uint32_t now_ms = to_ms_since_boot(get_absolute_time());
+    
+    // F1-F3 right after power-on pick the USB profile instead of being typed
+    if (usb_profile_key(hid_code, pressed, now_ms)) return;
+    
+    // Key pipeline: chatter filter -> key statistics -> combos -> tap-hold ->
+    // layers -> keyboard state
+    debounce_process(hid_code, pressed, now_ms);
+}
+
 // Handle a complete PS/2 scancode
 static void handle_scancode(uint8_t code, bool is_break, bool is_extended) {
     uint8_t hid_code;
     
     if (is_extended) {
-        hid_code = extended_scancode_to_hid[code];
+        hid_code = ps2_tables.extended[code];
     } else {
-        hid_code = scancode_to_hid[code];
+        hid_code = ps2_tables.normal[code];
     }
     
     if (hid_code == 0) {
@@ -388,10 +241,50 @@ static void handle_scancode(uint8_t code, bool is_break, bool is_extended) {
         return;
     }
     
-    if (is_break) {
-        release_key(hid_code);
+    handle_key(hid_code, !is_break);
+}
+
+// Leave the power-up state (once); a later BAT is a hot-plugged keyboard
+static void kbd_ready(ps2_kbd_state_t state) {
+    if (kbd_state == PS2_KBD_POWER_UP) boot_timing_mark(BOOT_PS2_READY);
+    kbd_state = state;
+}
+
+// Handle a complete byte from the keyboard: prefixes, self-test results
+// and scancodes
+static void handle_byte(uint8_t code) {
+    telemetry_count(TM_PS2_BYTES);
+    telemetry_trace(TRACE_PS2_BYTE, code);
+    recovery_ps2_byte(code);
+    
+    if (pause_bytes != 0) {
+        // Pause sends E1 14 77 E1 F0 14 F0 77 on press and nothing
+        // on release; the bytes inside must not reach the tables,
+        // where they would read as Ctrl and Num Lock
+        if (--pause_bytes == 0) {
+            handle_key(HID_KEY_PAUSE, true);
+            handle_key(HID_KEY_PAUSE, false);
+        }
+    } else if (code == PS2_BAT_PASSED || code == PS2_BAT_FAILED) {
+        // Self-test result; never part of a Set 2 scancode
+        telemetry_trace(TRACE_PS2_BAT, code);
+        kbd_ready(code == PS2_BAT_PASSED ? PS2_KBD_READY : PS2_KBD_BAT_FAILED);
+    } else if (code == 0xF0) {
+        // Break prefix
+        break_pending = true;
+    } else if (code == 0xE0) {
+        // Extended prefix
+        extended_pending = true;
+    } else if (code == 0xE1) {
+        // Pause: the rest of its fixed sequence follows
+        pause_bytes = 7;
     } else {
-        press_key(hid_code);
+        // Complete scancode received; a running keyboard is ready
+        if (kbd_state == PS2_KBD_POWER_UP) kbd_ready(PS2_KBD_READY);
+        telemetry_key_event();
+        handle_scancode(code, break_pending, extended_pending);
+        break_pending = false;
+        extended_pending = false;
     }
 }
 
@@ -415,21 +308,53 @@ void ps2_init(void) {
     scancode_byte = 0;
     break_pending = false;
     extended_pending = false;
+    pause_bytes = 0;
     last_clk = gpio_get(PS2_CLOCK_PIN);
+    kbd_state = PS2_KBD_POWER_UP;
+    init_ms = to_ms_since_boot(get_absolute_time());
+    
+    g_report.word = 0;
+    g_last_queued = 0;
+    g_injected_modifiers = 0;
+    memset(g_injected_keys, 0, sizeof(g_injected_keys));
+    g_injected_active = false;
     
-    g_modifiers = 0;
-    memset(g_keys, 0, sizeof(g_keys));
-    g_state_changed = false;
+    keymap_init();
+    macro_init();
+    consumer_init();
+    keystats_init();
+    socd_init(update_key_state);
+    taphold_init(apply_key_event);
+    combo_init(taphold_process);
+#if KEYSTATS_ENABLE
+    memset(counted_down, 0, sizeof(counted_down));
+    debounce_init(count_key_event);
+#else
+    debounce_init(combo_process);
+#endif
+    report_queue_init();
 }
 
-void ps2_task(void) {
+void PS2_HOT_FUNC(ps2_task)(void) {
     // Read current clock level
     bool clk = gpio_get(PS2_CLOCK_PIN);
     
+#if PS2_TIMING_STATS
+    uint32_t now_us = time_us_32();
+    uint32_t gap_us = now_us - last_sample_us;
+    last_sample_us = now_us;
+#endif
+    
     // Detect falling edge: previous high (true) -> current low (false)
     if (last_clk && !clk) {
         bool data_bit = gpio_get(PS2_DATA_PIN);
         
+#if PS2_TIMING_STATS
+        timing.edges++;
+        timing.total_gap_us += gap_us;
+        if (gap_us > timing.max_gap_us) timing.max_gap_us = gap_us;
+#endif
+        
         if (frame_bit_index == 0) {
             // Start bit (should be 0, ignore)
         } else if (frame_bit_index >= 1 && frame_bit_index <= 8) {
@@ -442,20 +367,29 @@ void ps2_task(void) {
             // Parity bit (ignored for now)
         } else if (frame_bit_index == 10) {
             // Stop bit - frame complete
-            uint8_t code = scancode_byte;
+#if PS2_HOT_PATH_IN_RAM
+            // Hold the clock low while the byte goes through the key
+            // pipeline, as a PC's keyboard controller does: that code runs
+            // from flash, and the keyboard waits instead of starting its
+            // next byte unseen. The stop bit was the 11th clock, so the
+            // byte counts as delivered.
+            gpio_put(PS2_CLOCK_PIN, 0);
+            gpio_set_dir(PS2_CLOCK_PIN, GPIO_OUT);
+#endif
             
-            if (code == 0xF0) {
-                // Break prefix
-                break_pending = true;
-            } else if (code == 0xE0) {
-                // Extended prefix
-                extended_pending = true;
-            } else {
-                // Complete scancode received
-                handle_scancode(code, break_pending, extended_pending);
-                break_pending = false;
-                extended_pending = false;
-            }
+            handle_byte(scancode_byte);
+            
+#if PS2_TIMING_STATS
+            uint32_t byte_us = time_us_32() - now_us;
+            timing.bytes++;
+            timing.total_byte_us += byte_us;
+            if (byte_us > timing.max_byte_us) timing.max_byte_us = byte_us;
+#endif
+#if PS2_HOT_PATH_IN_RAM
+            // The pull-up raises the line; last_clk stays low, so that rise
+            // is not taken for part of the next frame
+            gpio_set_dir(PS2_CLOCK_PIN, GPIO_IN);
+#endif
             
             // Reset for next frame
             frame_bit_index = 0;
@@ -466,23 +400,66 @@ void ps2_task(void) {
         }
         
         frame_bit_index++;
+    } else if (frame_bit_index == 0 &&
+               (debounce_pending() || combo_pending() || taphold_pending())) {
+        // Between frames - check for chatter, combo and dual-role timeouts
+        uint32_t now_ms = to_ms_since_boot(get_absolute_time());
+        debounce_task(now_ms);
+        combo_task(now_ms);
+        taphold_task(now_ms);
+    } else if (kbd_state == PS2_KBD_POWER_UP && frame_bit_index == 0 &&
+               to_ms_since_boot(get_absolute_time()) - init_ms >= PS2_BAT_TIMEOUT_MS) {
+        // No self-test result: the keyboard was powered before the bridge
+        kbd_ready(PS2_KBD_READY);
     }
     
     last_clk = clk;
 }
 
-uint8_t ps2_get_modifiers(void) {
-    return g_modifiers;
+ps2_kbd_state_t ps2_kbd_state(void) {
+    return kbd_state;
+}
+
+bool ps2_idle(void) {
+    return frame_bit_index == 0 && last_clk;
 }
 
-const uint8_t* ps2_get_keys(void) {
-    return g_keys;
+bool ps2_keys_down(void) {
+    return g_report.word != 0 || g_injected_active;
 }
 
-bool ps2_state_changed(void) {
-    return g_state_changed;
+void ps2_set_inhibit(bool inhibit) {
+    if (inhibit) {
+        // Holding the clock low for 100 us stops the keyboard, which aborts
+        // a byte in progress and sends it again later
+        gpio_put(PS2_CLOCK_PIN, 0);
+        gpio_set_dir(PS2_CLOCK_PIN, GPIO_OUT);
+        busy_wait_us(100);
+    } else {
+        gpio_set_dir(PS2_CLOCK_PIN, GPIO_IN);
+        busy_wait_us(10);   // Let the pull-up raise the line
+        
+        // Drop a partial frame; completed prefix bytes still apply
+        frame_bit_index = 0;
+        scancode_byte = 0;
+        last_clk = gpio_get(PS2_CLOCK_PIN);
+    }
+}
+
+void ps2_set_injected(uint8_t modifiers, const uint8_t keys[6]) {
+    static const uint8_t no_keys[6] = {0};
+    
+    g_injected_modifiers = modifiers;
+    memcpy(g_injected_keys, keys, sizeof(g_injected_keys));
+    g_injected_active = modifiers != 0 || memcmp(keys, no_keys, 6) != 0;
+    queue_report_if_changed();
 }
 
-void ps2_clear_changed(void) {
-    g_state_changed = false;
+void ps2_take_timing_stats(ps2_timing_stats_t* stats) {
+#if PS2_TIMING_STATS
+    *stats = timing;
+    memset(&timing, 0, sizeof(timing));
+#else
+    memset(stats, 0, sizeof(*stats));
+#endif
 }
@@ -9,26 +9,89 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 // PS/2 Pin Configuration (matching your Python code)
 // CLK on GP16 (brown wire), DATA on GP17 (white wire)
 #define PS2_CLOCK_PIN  16
 #define PS2_DATA_PIN   17
 
+// Run the sampling loop from SRAM so an XIP cache miss (e.g. after USB
+// activity) cannot delay sampling a clock edge, and hold the clock low
+// while each received byte goes through the key pipeline, which stays in
+// flash. Costs the code of ps2_task() in SRAM.
+#ifndef PS2_HOT_PATH_IN_RAM
+#define PS2_HOT_PATH_IN_RAM  0
+#endif
+
+// Measure how long a clock edge can wait before ps2_task() samples it, and
+// how long each byte takes to go through the key pipeline
+#ifndef PS2_TIMING_STATS
+#define PS2_TIMING_STATS     0
+#endif
+
+// The keyboard sends its self-test (BAT) result 300-750 ms after power-up.
+// Until then, or until PS2_BAT_TIMEOUT_MS without any byte (the keyboard
+// was already running, e.g. after a bridge reset), it is powering up. This
+// runs alongside USB enumeration; nothing waits for it.
+#ifndef PS2_BAT_TIMEOUT_MS
+#define PS2_BAT_TIMEOUT_MS   1000
+#endif
+
+#define PS2_BAT_PASSED       0xAA
+#define PS2_BAT_FAILED       0xFC
+
+typedef enum {
+    PS2_KBD_POWER_UP = 0,       // Waiting for the self-test result
+    PS2_KBD_READY,              // Self-test passed, timed out, or keys seen
+    PS2_KBD_BAT_FAILED,         // Keyboard reported a self-test failure
+} ps2_kbd_state_t;
+
+// Edge-to-sample timing: a falling edge happened at some point since the
+// previous clock sample, so the gap between samples bounds its latency
+typedef struct {
+    uint32_t edges;             // Falling edges sampled
+    uint32_t max_gap_us;        // Longest sample gap at an edge (worst case)
+    uint64_t total_gap_us;      // Sum of sample gaps at edges (for the mean)
+    uint32_t bytes;             // Bytes handled
+    uint32_t max_byte_us;       // Longest time from stop bit to byte handled
+    uint64_t total_byte_us;     // Sum of byte handling times (for the mean)
+} ps2_timing_stats_t;
+
 // Initialize PS/2 interface (GPIO pins with pull-ups)
 void ps2_init(void);
 
 // Poll PS/2 interface for incoming scancodes
 // Call this from the main loop
+// Each state change is queued as a full report (see report_queue.h) and
+// published as the current state (see report_snapshot.h)
 void ps2_task(void);
 
-// Get current keyboard state for USB HID report
-uint8_t ps2_get_modifiers(void);
-const uint8_t* ps2_get_keys(void);
+// Keyboard start-up state
+ps2_kbd_state_t ps2_kbd_state(void);
+
+// True between frames (clock high, no bits received); optional work in the
+// main loop should only run then
+bool ps2_idle(void);
+
+// True while any key or modifier is down, including keys injected by macros
+bool ps2_keys_down(void);
+
+// Hold the clock low so the keyboard buffers its output (host inhibit), or
+// release it. Used around flash writes, which stall the sampling loop.
+void ps2_set_inhibit(bool inhibit);
+
+// Set keys to send on top of the PS/2 keyboard state and queue a report
+// Used by macro playback; pass modifiers 0 and all-zero keys to clear
+void ps2_set_injected(uint8_t modifiers, const uint8_t keys[6]);
 
-// Check if keyboard state has changed since last report
-bool ps2_state_changed(void);
+// Copy and clear the edge-to-sample timing (PS2_TIMING_STATS builds)
+void ps2_take_timing_stats(ps2_timing_stats_t* stats);
 
-// Clear the state changed flag (call after sending HID report)
-void ps2_clear_changed(void);
+#ifdef __cplusplus
+}
+#endif
 
 #endif /* PS2_H_ */
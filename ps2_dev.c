@@ -0,0 +1,534 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * PS/2 Device Output
+ *
+ * ps2_dev_step() runs the wire protocol one clock phase per call, from an
+ * interrupt; ps2_dev_report() and ps2_dev_typematic() run in the main loop
+ * and only append whole scancode sequences to the queue, so the interrupt
+ * never sends half a sequence it could see being written. Everything the
+ * host asks for is answered from the interrupt side.
+ */
+
+#include "ps2_dev.h"
+#include "ps2_tables.h"
+#include "hid_keycodes.h"
+#include <string.h>
+
+#if (PS2_DEV_QUEUE_SIZE & (PS2_DEV_QUEUE_SIZE - 1)) != 0
+#error PS2_DEV_QUEUE_SIZE must be a power of two
+#endif
+
+#define QUARTER_US      (PS2_DEV_HALF_US / 2)
+
+// Typematic byte after a reset or defaults command: 500 ms, 10.9 per second
+#define TYPEMATIC_DEFAULT   0x2B
+
+typedef enum {
+    LINE_IDLE = 0,
+    LINE_SEND,                  // Device to host frame
+    LINE_RECEIVE,               // Host to device frame
+} line_state_t;
+
+typedef enum {
+    PHASE_DATA = 0,             // Check the clock, set the next bit
+    PHASE_CLOCK_LOW,
+    PHASE_CLOCK_HIGH,
+    PHASE_SAMPLE,               // Read the host's bit while the clock is high
+    PHASE_ACK_DATA,             // Pull data low for the acknowledge clock
+    PHASE_ACK_LOW,
+    PHASE_ACK_HIGH,
+    PHASE_ACK_END,
+} line_phase_t;
+
+// Wire state, interrupt side only
+static line_state_t line = LINE_IDLE;
+static line_phase_t phase = PHASE_DATA;
+static uint8_t bit = 0;
+static uint16_t frame = 0;              // Start, data, parity, stop (LSB first)
+static bool released_before = false;    // Clock was high at the previous idle step
+static uint32_t released_us = 0;
+static ps2_dev_lines_t drive = { true, true };
+static volatile bool hold = false;
+
+// Bytes to send. Replies (interrupt side) go before scancodes (main loop
+// side, read index owned by the interrupt).
+static uint8_t replies[8];
+static uint8_t reply_count = 0;
+static uint8_t queue[PS2_DEV_QUEUE_SIZE];
+static volatile uint32_t queue_written = 0;
+static volatile uint32_t queue_read = 0;
+static bool sending_reply = false;
+static uint8_t last_sent = 0xAA;
+static bool resend = false;
+
+// Host settings
+static volatile bool scanning = true;
+static volatile uint8_t typematic = TYPEMATIC_DEFAULT;
+static uint8_t leds = 0;
+static uint8_t argument_for = 0;        // Command whose argument comes next
+static bool bat_due = false;
+static uint32_t bat_us = 0;
+
+// Key model, main loop side
+static uint8_t last_report[8];
+static uint8_t repeat_key = 0;
+static uint32_t repeat_us = 0;
+
+static ps2_dev_stats_t stats;
+
+//--------------------------------------------------------------------+
+// Key Model
+//--------------------------------------------------------------------+
+
+static uint32_t typematic_delay_us(void) {
+    return (uint32_t) (((typematic >> 5) & 3u) + 1u) * 250000u;
+}
+
+// (8 + A) * 2^B * 4.17 ms: 30 down to 2 repeats per second
+static uint32_t typematic_period_us(void) {
+    return (8u + (typematic & 7u)) * (1u << ((typematic >> 3) & 3u)) * 4167u;
+}
+
+// Append a whole sequence or nothing
+static void queue_bytes(const uint8_t* bytes, uint8_t n) {
+    if (n == 0 || !scanning) return;
+    uint32_t written = queue_written;
+    if (PS2_DEV_QUEUE_SIZE - (written - queue_read) < n) {
+        stats.overruns++;
+        return;
+    }
+    for (uint8_t i = 0; i < n; i++) {
+        queue[(written + i) & (PS2_DEV_QUEUE_SIZE - 1)] = bytes[i];
+    }
+    queue_written = written + n;
+}
+
+static void type_key(uint8_t hid, bool make) {
+    uint8_t bytes[8];
+    uint8_t n = 0;
+
+    if (hid == HID_KEY_PAUSE) {
+        // Make only, with its own prefix; there is no break sequence
+        static const uint8_t pause[8] = { 0xE1, 0x14, 0x77, 0xE1, 0xF0, 0x14, 0xF0, 0x77 };
+        if (make) queue_bytes(pause, sizeof(pause));
+        return;
+    }
+
+    uint16_t code = ps2_set2_codes.make[hid];
+    if (code == 0) return;
+
+    // Print Screen comes with the fake shift keyboards send around it
+    if (hid == HID_KEY_PRINT_SCREEN && make) {
+        bytes[n++] = 0xE0;
+        bytes[n++] = 0x12;
+    }
+    if (code & 0x100) bytes[n++] = 0xE0;
+    if (!make) bytes[n++] = 0xF0;
+    bytes[n++] = (uint8_t) code;
+    if (hid == HID_KEY_PRINT_SCREEN && !make) {
+        bytes[n++] = 0xE0;
+        bytes[n++] = 0xF0;
+        bytes[n++] = 0x12;
+    }
+    queue_bytes(bytes, n);
+}
+
+static bool has_key(const uint8_t* report, uint8_t hid) {
+    return memchr(&report[2], hid, 6) != NULL;
+}
+
+void ps2_dev_report(const uint8_t report[8], uint32_t now_us) {
+    uint8_t released_mods = last_report[0] & (uint8_t) ~report[0];
+    uint8_t pressed_mods = report[0] & (uint8_t) ~last_report[0];
+
+    // Codes below A are "no event" and error rollover
+    for (int i = 2; i < 8; i++) {
+        uint8_t key = last_report[i];
+        if (key < HID_KEY_A || has_key(report, key)) continue;
+        type_key(key, false);
+        if (key == repeat_key) repeat_key = 0;
+    }
+    for (int i = 0; i < 8; i++) {
+        if (released_mods & (1u << i)) type_key((uint8_t) (HID_KEY_CONTROL_LEFT + i), false);
+    }
+    for (int i = 0; i < 8; i++) {
+        if (pressed_mods & (1u << i)) type_key((uint8_t) (HID_KEY_CONTROL_LEFT + i), true);
+    }
+    for (int i = 2; i < 8; i++) {
+        uint8_t key = report[i];
+        if (key < HID_KEY_A || has_key(last_report, key)) continue;
+        type_key(key, true);
+        if (key != HID_KEY_PAUSE) {
+            repeat_key = key;
+            repeat_us = now_us + typematic_delay_us();
+        }
+    }
+
+    memcpy(last_report, report, sizeof(last_report));
+}
+
+void ps2_dev_typematic(uint32_t now_us) {
+    if (repeat_key == 0 || (int32_t) (now_us - repeat_us) < 0) return;
+
+    // Repeats do not pile up behind a slow or inhibiting host
+    if (queue_written == queue_read) type_key(repeat_key, true);
+    repeat_us = now_us + typematic_period_us();
+}
+
+//--------------------------------------------------------------------+
+// Host Commands
+//--------------------------------------------------------------------+
+
+static void reply(uint8_t byte) {
+    if (reply_count < sizeof(replies)) replies[reply_count++] = byte;
+}
+
+// Scancodes waiting are dropped, as a keyboard clears its buffer
+static void clear_queue(void) {
+    queue_read = queue_written;
+    sending_reply = false;
+}
+
+static void set_defaults(void) {
+    typematic = TYPEMATIC_DEFAULT;
+    argument_for = 0;
+}
+
+static void handle_argument(uint8_t command, uint8_t value) {
+    reply(PS2_DEV_ACK);
+    switch (command) {
+        case PS2_CMD_SET_LEDS:
+            leds = value & 7u;
+            break;
+        case PS2_CMD_SCAN_SET:
+            // Only Set 2 is generated, whatever the host asks for
+            if (value == 0) reply(0x02);
+            break;
+        case PS2_CMD_TYPEMATIC:
+            typematic = value;
+            break;
+        default:
+            // Set 3 key type commands take key arguments until the next command
+            return;
+    }
+    argument_for = 0;
+}
+
+static void handle_command(uint8_t command, uint32_t now_us) {
+    argument_for = 0;
+    switch (command) {
+        case PS2_CMD_SET_LEDS:
+        case PS2_CMD_SCAN_SET:
+        case PS2_CMD_TYPEMATIC:
+            reply(PS2_DEV_ACK);
+            argument_for = command;
+            break;
+        case PS2_CMD_ECHO:
+            reply(PS2_DEV_ECHO);
+            break;
+        case PS2_CMD_READ_ID:
+            reply(PS2_DEV_ACK);
+            reply(0xAB);
+            reply(0x83);
+            break;
+        case PS2_CMD_ENABLE:
+            reply(PS2_DEV_ACK);
+            clear_queue();
+            scanning = true;
+            break;
+        case PS2_CMD_DISABLE:
+            reply(PS2_DEV_ACK);
+            clear_queue();
+            set_defaults();
+            scanning = false;
+            break;
+        case PS2_CMD_DEFAULTS:
+            reply(PS2_DEV_ACK);
+            clear_queue();
+            set_defaults();
+            break;
+        case PS2_CMD_RESEND:
+            stats.host_resends++;
+            resend = true;
+            break;
+        case PS2_CMD_RESET:
+            reply(PS2_DEV_ACK);
+            clear_queue();
+            set_defaults();
+            scanning = true;
+            leds = 0;
+            bat_due = true;
+            bat_us = now_us + PS2_DEV_BAT_MS * 1000u;
+            break;
+        default:
+            if (command >= 0xF7 && command <= 0xFD) {
+                // Set 3 key type commands: acknowledged, no effect in Set 2
+                reply(PS2_DEV_ACK);
+                if (command >= 0xFB) argument_for = command;
+            } else {
+                reply(PS2_DEV_RESEND);
+            }
+            break;
+    }
+}
+
+static void host_byte(uint16_t bits, uint32_t now_us) {
+    uint8_t value = (uint8_t) bits;
+    bool parity = (bits >> 8) & 1u;
+    bool stop = (bits >> 9) & 1u;
+
+    stats.bytes_received++;
+    for (int i = 0; i < 8; i++) parity ^= (value >> i) & 1u;
+    if (!parity || !stop) {
+        // Odd parity failed or no stop bit: ask for the byte again
+        stats.host_errors++;
+        reply(PS2_DEV_RESEND);
+        return;
+    }
+
+    if (argument_for != 0 && value < 0x80) {
+        handle_argument(argument_for, value);
+    } else {
+        handle_command(value, now_us);
+    }
+}
+
+//--------------------------------------------------------------------+
+// Line Protocol
+//--------------------------------------------------------------------+
+
+static uint16_t device_frame(uint8_t value) {
+    bool parity = true;
+    for (int i = 0; i < 8; i++) parity ^= (value >> i) & 1u;
+    // Start bit 0, data, odd parity, stop bit 1
+    return (uint16_t) ((uint16_t) value << 1 | (uint16_t) parity << 9 | 1u << 10);
+}
+
+// The byte to send next, if any; it leaves its queue once fully sent
+static bool next_byte(uint8_t* value) {
+    if (resend) {
+        *value = last_sent;
+        return true;
+    }
+    if (reply_count > 0) {
+        *value = replies[0];
+        sending_reply = true;
+        return true;
+    }
+    if (scanning && queue_read != queue_written) {
+        *value = queue[queue_read & (PS2_DEV_QUEUE_SIZE - 1)];
+        sending_reply = false;
+        return true;
+    }
+    return false;
+}
+
+static void byte_sent(void) {
+    if (resend) {
+        resend = false;
+    } else if (sending_reply) {
+        last_sent = replies[0];
+        memmove(&replies[0], &replies[1], --reply_count);
+        sending_reply = false;
+    } else if (queue_read != queue_written) {
+        last_sent = queue[queue_read & (PS2_DEV_QUEUE_SIZE - 1)];
+        queue_read++;
+    }
+    stats.bytes_sent++;
+}
+
+static void go_idle(bool clock_high, uint32_t now_us) {
+    line = LINE_IDLE;
+    drive.clock = true;
+    drive.data = true;
+    released_before = clock_high;
+    released_us = now_us;
+}
+
+static uint32_t step_idle(bool clock, bool data, uint32_t now_us) {
+    if (bat_due && (int32_t) (now_us - bat_us) >= 0) {
+        bat_due = false;
+        reply(PS2_DEV_BAT_PASSED);
+    }
+
+    if (!clock) {
+        // Host inhibit; wait for the clock to be released, closely only
+        // if there is something to send
+        released_before = false;
+        return ps2_dev_idle() ? PS2_DEV_POLL_US : PS2_DEV_IDLE_GAP_US;
+    }
+    if (hold) return PS2_DEV_POLL_US;
+
+    if (!data) {
+        // Request to send: clock the host's byte in
+        line = LINE_RECEIVE;
+        phase = PHASE_CLOCK_LOW;
+        bit = 0;
+        frame = 0;
+        return 0;
+    }
+
+    if (!released_before) {
+        released_before = true;
+        released_us = now_us;
+    }
+
+    uint8_t value;
+    if (!next_byte(&value)) {
+        if (bat_due) {
+            uint32_t wait = bat_us - now_us;
+            return wait < PS2_DEV_POLL_US ? wait : PS2_DEV_POLL_US;
+        }
+        return PS2_DEV_POLL_US;
+    }
+
+    uint32_t quiet_us = now_us - released_us;
+    if (quiet_us < PS2_DEV_IDLE_GAP_US) return PS2_DEV_IDLE_GAP_US - quiet_us;
+
+    line = LINE_SEND;
+    phase = PHASE_DATA;
+    bit = 0;
+    frame = device_frame(value);
+    return 0;
+}
+
+// Bit 0 start, 1-8 data, 9 parity, 10 stop; the host reads each bit on
+// the falling edge
+static uint32_t step_send(bool clock, uint32_t now_us) {
+    switch (phase) {
+        case PHASE_DATA:
+            if (bit > 0 && !clock) {
+                // Host inhibit before the eleventh clock: send it again later
+                stats.cancelled++;
+                go_idle(false, now_us);
+                return PS2_DEV_IDLE_GAP_US;
+            }
+            drive.data = (frame >> bit) & 1u;
+            phase = PHASE_CLOCK_LOW;
+            return QUARTER_US;
+
+        case PHASE_CLOCK_LOW:
+            drive.clock = false;
+            phase = PHASE_CLOCK_HIGH;
+            return PS2_DEV_HALF_US;
+
+        default:
+            drive.clock = true;
+            if (++bit == 11) {
+                byte_sent();
+                go_idle(true, now_us);
+                return PS2_DEV_IDLE_GAP_US;
+            }
+            phase = PHASE_DATA;
+            return QUARTER_US;
+    }
+}
+
+// Bits 0-7 data, 8 parity, 9 stop, read while the clock is high; then
+// data low for the eleventh clock acknowledges the byte
+static uint32_t step_receive(bool clock, bool data, uint32_t now_us) {
+    switch (phase) {
+        case PHASE_CLOCK_LOW:
+            drive.clock = false;
+            phase = PHASE_CLOCK_HIGH;
+            return PS2_DEV_HALF_US;
+
+        case PHASE_CLOCK_HIGH:
+            drive.clock = true;
+            phase = PHASE_SAMPLE;
+            return QUARTER_US;
+
+        case PHASE_SAMPLE:
+            if (!clock) {
+                // The host took the clock back: abandon the frame
+                go_idle(false, now_us);
+                return PS2_DEV_IDLE_GAP_US;
+            }
+            frame |= (uint16_t) data << bit;
+            phase = ++bit == 10 ? PHASE_ACK_DATA : PHASE_CLOCK_LOW;
+            return QUARTER_US;
+
+        case PHASE_ACK_DATA:
+            drive.data = false;
+            phase = PHASE_ACK_LOW;
+            return QUARTER_US;
+
+        case PHASE_ACK_LOW:
+            drive.clock = false;
+            phase = PHASE_ACK_HIGH;
+            return PS2_DEV_HALF_US;
+
+        case PHASE_ACK_HIGH:
+            drive.clock = true;
+            phase = PHASE_ACK_END;
+            return QUARTER_US;
+
+        default:
+            host_byte(frame, now_us);
+            go_idle(true, now_us);
+            return PS2_DEV_IDLE_GAP_US;
+    }
+}
+
+//--------------------------------------------------------------------+
+// Public Interface
+//--------------------------------------------------------------------+
+
+void ps2_dev_reset(uint32_t now_us) {
+    go_idle(false, now_us);
+    hold = false;
+    reply_count = 0;
+    queue_written = 0;
+    queue_read = 0;
+    sending_reply = false;
+    resend = false;
+    last_sent = PS2_DEV_BAT_PASSED;
+    scanning = true;
+    leds = 0;
+    set_defaults();
+    bat_due = true;
+    bat_us = now_us + PS2_DEV_BAT_MS * 1000u;
+    memset(last_report, 0, sizeof(last_report));
+    repeat_key = 0;
+    memset(&stats, 0, sizeof(stats));
+}
+
+uint32_t ps2_dev_step(bool clock, bool data, uint32_t now_us, ps2_dev_lines_t* lines) {
+    uint32_t delay;
+    do {
+        switch (line) {
+            case LINE_SEND:
+                delay = step_send(clock, now_us);
+                break;
+            case LINE_RECEIVE:
+                delay = step_receive(clock, data, now_us);
+                break;
+            default:
+                delay = step_idle(clock, data, now_us);
+                break;
+        }
+    } while (delay == 0);
+
+    *lines = drive;
+    return delay;
+}
+
+void ps2_dev_set_hold(bool value) {
+    hold = value;
+}
+
+bool ps2_dev_line_idle(void) {
+    return line == LINE_IDLE;
+}
+
+bool ps2_dev_idle(void) {
+    return line == LINE_IDLE && reply_count == 0 && !resend && queue_read == queue_written;
+}
+
+uint8_t ps2_dev_leds(void) {
+    return leds;
+}
+
+const ps2_dev_stats_t* ps2_dev_stats(void) {
+    return &stats;
+}
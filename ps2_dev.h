@@ -0,0 +1,152 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * PS/2 Device Output Header
+ *
+ * Optional output (PS2_DEV_ENABLE) that plays a PS/2 keyboard on a second
+ * pair of pins, for hosts without USB or as an inline PS/2-to-PS/2
+ * remapper: every report the key pipeline produces (layers, tap-hold,
+ * combos, macros) is also typed to the host as Set 2 make and break
+ * codes, alongside the USB output.
+ *
+ * The device generates the clock (12.5 kHz). It sends only while the
+ * host leaves the clock released; a host holding the clock low before the
+ * eleventh clock cancels the byte, which is sent again afterwards. A
+ * request to send (clock released with data low) is clocked in, checked,
+ * acknowledged and answered: reset, LEDs, scan code set, typematic rate
+ * and delay, read ID, echo, enable, disable, defaults and resend. Only
+ * Set 2 is generated; a request for another set is acknowledged and a
+ * query still answers 2. The last key pressed repeats at the host's
+ * typematic rate while held, as on a real keyboard.
+ *
+ * ps2_dev.c is the protocol and the key model without hardware
+ * dependencies, so it runs on the host (tools/ps2dev_sim.py);
+ * ps2_dev_pico.c drives the pins from a hardware alarm interrupt.
+ */
+
+#ifndef PS2_DEV_H_
+#define PS2_DEV_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef PS2_DEV_ENABLE
+#define PS2_DEV_ENABLE          0
+#endif
+
+// Output pins, open-drain (the host has the pull-ups)
+#ifndef PS2_DEV_CLOCK_PIN
+#define PS2_DEV_CLOCK_PIN       18
+#endif
+#ifndef PS2_DEV_DATA_PIN
+#define PS2_DEV_DATA_PIN        19
+#endif
+
+// Half a clock period; the standard allows 30-50 us
+#ifndef PS2_DEV_HALF_US
+#define PS2_DEV_HALF_US         40
+#endif
+
+// Clock released this long before the device may start a byte
+#define PS2_DEV_IDLE_GAP_US     50
+
+// Check for a request to send this often while there is nothing to send.
+// The host waits up to 15 ms for the device to start clocking.
+#ifndef PS2_DEV_POLL_US
+#define PS2_DEV_POLL_US         500
+#endif
+
+// Self-test (BAT) time after power-up and after a reset command
+#ifndef PS2_DEV_BAT_MS
+#define PS2_DEV_BAT_MS          300
+#endif
+
+// Scancode bytes waiting to be sent (power of two)
+#ifndef PS2_DEV_QUEUE_SIZE
+#define PS2_DEV_QUEUE_SIZE      128
+#endif
+
+// Device to host
+#define PS2_DEV_ACK             0xFA
+#define PS2_DEV_RESEND          0xFE
+#define PS2_DEV_BAT_PASSED      0xAA
+#define PS2_DEV_ECHO            0xEE
+#define PS2_DEV_OVERRUN         0x00
+
+// Host to device
+#define PS2_CMD_SET_LEDS        0xED
+#define PS2_CMD_ECHO            0xEE
+#define PS2_CMD_SCAN_SET        0xF0
+#define PS2_CMD_READ_ID         0xF2
+#define PS2_CMD_TYPEMATIC       0xF3
+#define PS2_CMD_ENABLE          0xF4
+#define PS2_CMD_DISABLE         0xF5
+#define PS2_CMD_DEFAULTS        0xF6
+#define PS2_CMD_RESEND          0xFE
+#define PS2_CMD_RESET           0xFF
+
+// Line levels: true = released (pulled up), false = driven low
+typedef struct {
+    bool clock;
+    bool data;
+} ps2_dev_lines_t;
+
+typedef struct {
+    uint32_t bytes_sent;
+    uint32_t bytes_received;    // Host commands and arguments
+    uint32_t cancelled;         // Bytes cut short by a host inhibit and sent again
+    uint32_t host_errors;       // Host bytes with a parity or stop bit error
+    uint32_t host_resends;      // Resend commands from the host
+    uint32_t overruns;          // Key events dropped on a full queue
+} ps2_dev_stats_t;
+
+// Power-on state: lines released, defaults, self-test result due after
+// PS2_DEV_BAT_MS
+void ps2_dev_reset(uint32_t now_us);
+
+// Type the difference between this boot report and the previous one: key
+// releases, modifier releases, modifier presses, then key presses
+void ps2_dev_report(const uint8_t report[8], uint32_t now_us);
+
+// Repeat the held key when its typematic time comes
+void ps2_dev_typematic(uint32_t now_us);
+
+// Advance the line state machine with the current line levels; sets the
+// levels to drive and returns the microseconds until the next call
+uint32_t ps2_dev_step(bool clock, bool data, uint32_t now_us, ps2_dev_lines_t* lines);
+
+// Finish the byte on the wire, then start no other until released
+void ps2_dev_set_hold(bool hold);
+
+// No frame on the wire
+bool ps2_dev_line_idle(void);
+
+// Nothing on the wire or waiting to be sent
+bool ps2_dev_idle(void);
+
+// Keyboard LEDs last set by the host (bit 0 Scroll, 1 Num, 2 Caps Lock)
+uint8_t ps2_dev_leds(void);
+
+const ps2_dev_stats_t* ps2_dev_stats(void);
+
+#if PS2_DEV_ENABLE
+
+// Device side (ps2_dev_pico.c): set up the pins and start the line
+// interrupt, pass each new report on, run typematic repeat from the main
+// loop, and stop sending around flash writes (interrupts are off then)
+void ps2_dev_init(void);
+void ps2_dev_send_report(const uint8_t report[8]);
+void ps2_dev_task(void);
+void ps2_dev_hold(bool hold);
+bool ps2_dev_busy(void);
+
+#else
+
+static inline void ps2_dev_init(void) {}
+static inline void ps2_dev_send_report(const uint8_t report[8]) { (void) report; }
+static inline void ps2_dev_task(void) {}
+static inline void ps2_dev_hold(bool hold) { (void) hold; }
+static inline bool ps2_dev_busy(void) { return false; }
+
+#endif
+
+#endif /* PS2_DEV_H_ */
@@ -0,0 +1,97 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * PS/2 Device Output - Line Interrupt
+ *
+ * The lines are open-drain: a pin drives low as an output (its output
+ * value stays 0) and is released by switching it back to an input. Each
+ * clock phase is one hardware alarm interrupt, at the highest priority so
+ * USB interrupts cannot stretch a clock pulse; the timer counts from
+ * clk_ref, so the bit rate does not change with the clock governor.
+ */
+
+#include "ps2_dev.h"
+
+#if PS2_DEV_ENABLE
+
+#include "pico/stdlib.h"
+#include "hardware/gpio.h"
+#include "hardware/timer.h"
+#include "hardware/irq.h"
+
+static int alarm_num = -1;
+
+static void __not_in_flash_func(line_irq)(void) {
+    timer_hw->intr = 1u << alarm_num;
+
+    uint32_t pins = gpio_get_all();
+    uint32_t now = timer_hw->timerawl;
+    ps2_dev_lines_t lines;
+    uint32_t delay = ps2_dev_step((pins >> PS2_DEV_CLOCK_PIN) & 1u, (pins >> PS2_DEV_DATA_PIN) & 1u,
+                                  now, &lines);
+
+    // Data first: it must be stable before the clock edge it belongs to
+    gpio_set_dir(PS2_DEV_DATA_PIN, !lines.data);
+    gpio_set_dir(PS2_DEV_CLOCK_PIN, !lines.clock);
+
+    timer_hw->alarm[alarm_num] = now + delay;
+}
+
+static void init_pin(uint pin) {
+    gpio_init(pin);
+    gpio_put(pin, false);
+    gpio_set_dir(pin, GPIO_IN);
+    gpio_pull_up(pin);
+}
+
+void ps2_dev_init(void) {
+    init_pin(PS2_DEV_CLOCK_PIN);
+    init_pin(PS2_DEV_DATA_PIN);
+    ps2_dev_reset(time_us_32());
+
+    alarm_num = hardware_alarm_claim_unused(true);
+    uint irq = hardware_alarm_get_irq_num((uint) alarm_num);
+    irq_set_exclusive_handler(irq, line_irq);
+    irq_set_priority(irq, PICO_HIGHEST_IRQ_PRIORITY);
+    hw_set_bits(&timer_hw->inte, 1u << alarm_num);
+    irq_set_enabled(irq, true);
+    timer_hw->alarm[alarm_num] = timer_hw->timerawl + PS2_DEV_POLL_US;
+}
+
+// Start on the first new scancode now instead of at the next idle poll
+// (later ones follow the byte before). With the interrupt masked it cannot
+// be in the middle of re-arming the alarm.
+static void kick(bool was_idle) {
+    if (!was_idle) return;
+    uint irq = hardware_alarm_get_irq_num((uint) alarm_num);
+    irq_set_enabled(irq, false);
+    if (ps2_dev_line_idle() && !ps2_dev_idle()) {
+        timer_hw->alarm[alarm_num] = timer_hw->timerawl + 2;
+    }
+    irq_set_enabled(irq, true);
+}
+
+void ps2_dev_send_report(const uint8_t report[8]) {
+    bool was_idle = ps2_dev_idle();
+    ps2_dev_report(report, time_us_32());
+    kick(was_idle);
+}
+
+void ps2_dev_task(void) {
+    bool was_idle = ps2_dev_idle();
+    ps2_dev_typematic(time_us_32());
+    kick(was_idle);
+}
+
+// A byte takes about a millisecond, so this waits at most that long
+void ps2_dev_hold(bool hold) {
+    ps2_dev_set_hold(hold);
+    while (hold && !ps2_dev_line_idle()) {
+        tight_loop_contents();
+    }
+}
+
+bool ps2_dev_busy(void) {
+    return !ps2_dev_idle();
+}
+
+#endif /* PS2_DEV_ENABLE */
@@ -0,0 +1,314 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * PS/2 Translation Tables
+ *
+ * Single declarative keymap: one line per physical key. The lookup tables
+ * used by the decoder are built from it by constexpr code and checked
+ * with static_assert, so a duplicate scancode, a key mapped twice, a gap
+ * in the supported key set or an out-of-range keycode fails the build.
+ * The result is a constant-initialised object with no runtime setup.
+ */
+
+#include "ps2_tables.h"
+#include "ps2.h"
+#include "hid_keycodes.h"
+#include <cstddef>
+
+namespace {
+
+//--------------------------------------------------------------------+
+// Declarative Keymap (PS/2 Set 2 -> HID)
+//--------------------------------------------------------------------+
+
+// Scancode with the 0xE0 extended prefix
+constexpr uint16_t E0(uint8_t code) { return (uint16_t) (0x100 | code); }
+
+struct KeyMapping {
+    uint16_t scancode;  // Set 2 make code, E0() for extended
+    uint8_t hid;        // HID keycode
+};
+
+constexpr KeyMapping keymap[] = {
+    // 0x00-0x0F
+    { 0x01,      HID_KEY_F9 },
+    { 0x03,      HID_KEY_F5 },
+    { 0x04,      HID_KEY_F3 },
+    { 0x05,      HID_KEY_F1 },
+    { 0x06,      HID_KEY_F2 },
+    { 0x07,      HID_KEY_F12 },
+    { 0x09,      HID_KEY_F10 },
+    { 0x0A,      HID_KEY_F8 },
+    { 0x0B,      HID_KEY_F6 },
+    { 0x0C,      HID_KEY_F4 },
+    { 0x0D,      HID_KEY_TAB },
+    { 0x0E,      HID_KEY_GRAVE },
+
+    // 0x10-0x1F
+    { 0x11,      HID_KEY_ALT_LEFT },
+    { 0x12,      HID_KEY_SHIFT_LEFT },
+    { 0x14,      HID_KEY_CONTROL_LEFT },
+    { 0x15,      HID_KEY_Q },
+    { 0x16,      HID_KEY_1 },
+    { 0x1A,      HID_KEY_Z },
+    { 0x1B,      HID_KEY_S },
+    { 0x1C,      HID_KEY_A },
+    { 0x1D,      HID_KEY_W },
+    { 0x1E,      HID_KEY_2 },
+
+    // 0x20-0x2F
+    { 0x21,      HID_KEY_C },
+    { 0x22,      HID_KEY_X },
+    { 0x23,      HID_KEY_D },
+    { 0x24,      HID_KEY_E },
+    { 0x25,      HID_KEY_4 },
+    { 0x26,      HID_KEY_3 },
+    { 0x29,      HID_KEY_SPACE },
+    { 0x2A,      HID_KEY_V },
+    { 0x2B,      HID_KEY_F },
+    { 0x2C,      HID_KEY_T },
+    { 0x2D,      HID_KEY_R },
+    { 0x2E,      HID_KEY_5 },
+
+    // 0x30-0x3F
+    { 0x31,      HID_KEY_N },
+    { 0x32,      HID_KEY_B },
+    { 0x33,      HID_KEY_H },
+    { 0x34,      HID_KEY_G },
+    { 0x35,      HID_KEY_Y },
+    { 0x36,      HID_KEY_6 },
+    { 0x3A,      HID_KEY_M },
+    { 0x3B,      HID_KEY_J },
+    { 0x3C,      HID_KEY_U },
+    { 0x3D,      HID_KEY_7 },
+    { 0x3E,      HID_KEY_8 },
+
+    // 0x40-0x4F
+    { 0x41,      HID_KEY_COMMA },
+    { 0x42,      HID_KEY_K },
+    { 0x43,      HID_KEY_I },
+    { 0x44,      HID_KEY_O },
+    { 0x45,      HID_KEY_0 },
+    { 0x46,      HID_KEY_9 },
+    { 0x49,      HID_KEY_PERIOD },
+    { 0x4A,      HID_KEY_SLASH },
+    { 0x4B,      HID_KEY_L },
+    { 0x4C,      HID_KEY_SEMICOLON },
+    { 0x4D,      HID_KEY_P },
+    { 0x4E,      HID_KEY_MINUS },
+
+    // 0x50-0x5F
+    { 0x52,      HID_KEY_APOSTROPHE },
+    { 0x54,      HID_KEY_BRACKET_LEFT },
+    { 0x55,      HID_KEY_EQUAL },
+    { 0x58,      HID_KEY_CAPS_LOCK },
+    { 0x59,      HID_KEY_SHIFT_RIGHT },
+    { 0x5A,      HID_KEY_ENTER },
+    { 0x5B,      HID_KEY_BRACKET_RIGHT },
+    { 0x5D,      HID_KEY_BACKSLASH },
+
+    // 0x60-0x6F
+    { 0x61,      HID_KEY_EUROPE_2 },
+    { 0x66,      HID_KEY_BACKSPACE },
+    { 0x69,      HID_KEY_KEYPAD_1 },
+    { 0x6B,      HID_KEY_KEYPAD_4 },
+    { 0x6C,      HID_KEY_KEYPAD_7 },
+
+    // 0x70-0x7F
+    { 0x70,      HID_KEY_KEYPAD_0 },
+    { 0x71,      HID_KEY_KEYPAD_DECIMAL },
+    { 0x72,      HID_KEY_KEYPAD_2 },
+    { 0x73,      HID_KEY_KEYPAD_5 },
+    { 0x74,      HID_KEY_KEYPAD_6 },
+    { 0x75,      HID_KEY_KEYPAD_8 },
+    { 0x76,      HID_KEY_ESCAPE },
+    { 0x77,      HID_KEY_NUM_LOCK },
+    { 0x78,      HID_KEY_F11 },
+    { 0x79,      HID_KEY_KEYPAD_ADD },
+    { 0x7A,      HID_KEY_KEYPAD_3 },
+    { 0x7B,      HID_KEY_KEYPAD_SUBTRACT },
+    { 0x7C,      HID_KEY_KEYPAD_MULTIPLY },
+    { 0x7D,      HID_KEY_KEYPAD_9 },
+    { 0x7E,      HID_KEY_SCROLL_LOCK },
+
+    // 0x80-0x8F
+    { 0x83,      HID_KEY_F7 },
+
+    // Extended (0xE0 prefix): right modifiers, GUI and menu keys
+    { E0(0x11),  HID_KEY_ALT_RIGHT },
+    { E0(0x14),  HID_KEY_CONTROL_RIGHT },
+    { E0(0x1F),  HID_KEY_GUI_LEFT },
+    { E0(0x27),  HID_KEY_GUI_RIGHT },
+    { E0(0x2F),  HID_KEY_APPLICATION },
+
+    // Numpad extended
+    { E0(0x4A),  HID_KEY_KEYPAD_DIVIDE },
+    { E0(0x5A),  HID_KEY_KEYPAD_ENTER },
+
+    // Navigation cluster
+    { E0(0x69),  HID_KEY_END },
+    { E0(0x6B),  HID_KEY_ARROW_LEFT },
+    { E0(0x6C),  HID_KEY_HOME },
+    { E0(0x70),  HID_KEY_INSERT },
+    { E0(0x71),  HID_KEY_DELETE },
+    { E0(0x72),  HID_KEY_ARROW_DOWN },
+    { E0(0x74),  HID_KEY_ARROW_RIGHT },
+    { E0(0x75),  HID_KEY_ARROW_UP },
+    { E0(0x7A),  HID_KEY_PAGE_DOWN },
+    { E0(0x7D),  HID_KEY_PAGE_UP },
+
+    // Print Screen (preceded by a fake E0 12, which stays unmapped)
+    { E0(0x7C),  HID_KEY_PRINT_SCREEN },
+
+    // Multimedia keyboards: volume and power (consumer/system usages in
+    // USB profiles that have them, see consumer.h)
+    { E0(0x23),  HID_KEY_MUTE },
+    { E0(0x32),  HID_KEY_VOLUME_UP },
+    { E0(0x21),  HID_KEY_VOLUME_DOWN },
+    { E0(0x37),  HID_KEY_POWER },
+};
+
+//--------------------------------------------------------------------+
+// Table Generation
+//--------------------------------------------------------------------+
+
+constexpr ps2_tables_t build_tables() {
+    ps2_tables_t tables{};
+    for (const KeyMapping& key : keymap) {
+        uint8_t* table = (key.scancode & 0x100) ? tables.extended : tables.normal;
+        table[key.scancode & 0xFF] = key.hid;
+    }
+    return tables;
+}
+
+// The same keymap read the other way, for the PS/2 device output
+constexpr ps2_set2_codes_t build_set2_codes() {
+    ps2_set2_codes_t codes{};
+    for (const KeyMapping& key : keymap) {
+        codes.make[key.hid] = key.scancode;
+    }
+    return codes;
+}
+
+//--------------------------------------------------------------------+
+// Static Validation
+//--------------------------------------------------------------------+
+
+constexpr std::size_t keymap_size = sizeof(keymap) / sizeof(keymap[0]);
+
+// No scancode is listed twice
+constexpr bool scancodes_unique() {
+    for (std::size_t i = 0; i < keymap_size; i++) {
+        for (std::size_t j = i + 1; j < keymap_size; j++) {
+            if (keymap[i].scancode == keymap[j].scancode) return false;
+        }
+    }
+    return true;
+}
+
+// No HID keycode comes from two keys (layers and tap-hold use the keycode
+// to identify the physical key)
+constexpr bool keycodes_unique() {
+    for (std::size_t i = 0; i < keymap_size; i++) {
+        for (std::size_t j = i + 1; j < keymap_size; j++) {
+            if (keymap[i].hid == keymap[j].hid) return false;
+        }
+    }
+    return true;
+}
+
+// Scancodes fit in one byte plus the extended flag
+constexpr bool scancodes_valid() {
+    for (const KeyMapping& key : keymap) {
+        if (key.scancode > 0x1FF || (key.scancode & 0xFF) == 0) return false;
+        // Prefix bytes can never be make codes
+        if ((key.scancode & 0xFF) == 0xE0 || (key.scancode & 0xFF) == 0xF0) return false;
+    }
+    return true;
+}
+
+// Keycodes are keyboard keys (0x04-0xA4) or modifiers (0xE0-0xE7); nothing
+// maps to 0, which the tables use for "unmapped"
+constexpr bool keycodes_valid() {
+    for (const KeyMapping& key : keymap) {
+        bool is_key = key.hid >= HID_KEY_A && key.hid <= 0xA4;
+        bool is_modifier = key.hid >= HID_KEY_CONTROL_LEFT && key.hid <= HID_KEY_GUI_RIGHT;
+        if (!is_key && !is_modifier) return false;
+    }
+    return true;
+}
+
+constexpr bool is_mapped(uint8_t hid) {
+    for (const KeyMapping& key : keymap) {
+        if (key.hid == hid) return true;
+    }
+    return false;
+}
+
+// Every key of a standard 104/105-key keyboard is present, except the
+// ones Set 2 cannot deliver as a single make code
+constexpr bool keyboard_covered() {
+    for (unsigned hid = HID_KEY_A; hid <= HID_KEY_APPLICATION; hid++) {
+        if (hid == HID_KEY_EUROPE_1) continue;  // Shares 0x5D with Backslash
+        if (hid == HID_KEY_PAUSE) continue;     // E1 sequence, decoded in ps2.c
+        if (!is_mapped((uint8_t) hid)) return false;
+    }
+    for (unsigned hid = HID_KEY_CONTROL_LEFT; hid <= HID_KEY_GUI_RIGHT; hid++) {
+        if (!is_mapped((uint8_t) hid)) return false;
+    }
+    return true;
+}
+
+static_assert(scancodes_unique(), "PS/2 scancode listed twice in keymap");
+static_assert(keycodes_unique(), "HID keycode produced by two keys in keymap");
+static_assert(scancodes_valid(), "Invalid PS/2 scancode in keymap");
+static_assert(keycodes_valid(), "Keymap entry outside the keyboard/modifier usage ranges");
+static_assert(keyboard_covered(), "Keymap is missing a standard keyboard key");
+
+// Spot checks against the Set 2 codes in the IBM technical reference, kept
+// apart from the keymap so a wrong keymap line cannot also change its check:
+// letters, the lock keys, keypad, the sections that share codes with E0
+constexpr KeyMapping reference[] = {
+    { 0x1C,      HID_KEY_A },
+    { 0x1A,      HID_KEY_Z },
+    { 0x45,      HID_KEY_0 },
+    { 0x76,      HID_KEY_ESCAPE },
+    { 0x5A,      HID_KEY_ENTER },
+    { 0x05,      HID_KEY_F1 },
+    { 0x07,      HID_KEY_F12 },
+    { 0x83,      HID_KEY_F7 },
+    { 0x58,      HID_KEY_CAPS_LOCK },
+    { 0x77,      HID_KEY_NUM_LOCK },
+    { 0x7E,      HID_KEY_SCROLL_LOCK },
+    { 0x14,      HID_KEY_CONTROL_LEFT },
+    { 0x12,      HID_KEY_SHIFT_LEFT },
+    { 0x70,      HID_KEY_KEYPAD_0 },
+    { 0x7C,      HID_KEY_KEYPAD_MULTIPLY },
+    { E0(0x14),  HID_KEY_CONTROL_RIGHT },
+    { E0(0x5A),  HID_KEY_KEYPAD_ENTER },
+    { E0(0x70),  HID_KEY_INSERT },
+    { E0(0x75),  HID_KEY_ARROW_UP },
+    { E0(0x7C),  HID_KEY_PRINT_SCREEN },
+};
+
+constexpr bool matches_reference() {
+    constexpr ps2_tables_t tables = build_tables();
+    for (const KeyMapping& key : reference) {
+        const uint8_t* table = (key.scancode & 0x100) ? tables.extended : tables.normal;
+        if (table[key.scancode & 0xFF] != key.hid) return false;
+    }
+    return true;
+}
+
+static_assert(matches_reference(), "Keymap disagrees with a known Set 2 scancode");
+
+} // namespace
+
+//--------------------------------------------------------------------+
+// Generated Tables
+//--------------------------------------------------------------------+
+
+// Read while the PS/2 clock is held after a byte (see ps2.c), so flash is fine
+extern "C" constexpr ps2_tables_t ps2_tables = build_tables();
+
+// Only read by the device output's main loop side, so it stays in flash
+extern "C" constexpr ps2_set2_codes_t ps2_set2_codes = build_set2_codes();
@@ -0,0 +1,40 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * PS/2 Translation Tables Header
+ *
+ * The tables are generated at compile time from the declarative keymap in
+ * ps2_tables.cpp and live in flash as plain arrays: Set 2 to HID for the
+ * decoder, and HID to Set 2 for the PS/2 device output.
+ */
+
+#ifndef PS2_TABLES_H_
+#define PS2_TABLES_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Index is the PS/2 Set 2 scancode, value is the HID keycode (0 = unmapped)
+typedef struct {
+    uint8_t normal[256];    // Plain scancodes
+    uint8_t extended[256];  // Scancodes after an 0xE0 prefix
+} ps2_tables_t;
+
+extern const ps2_tables_t ps2_tables;
+
+// Index is the HID keycode, value is the Set 2 make code with 0x100 set for
+// an 0xE0 prefix (0 = no single make code, e.g. Pause). Keycodes are unique
+// in the keymap, so this is the exact inverse of ps2_tables.
+typedef struct {
+    uint16_t make[256];
+} ps2_set2_codes_t;
+
+extern const ps2_set2_codes_t ps2_set2_codes;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PS2_TABLES_H_ */
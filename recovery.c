@@ -0,0 +1,78 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * Watchdog Recovery Implementation
+ *
+ * RAM holds random data after power-on, so the record only counts as
+ * valid with both magic words intact. The hooks write the record without
+ * a checksum so they stay a single store each.
+ */
+
+#include "recovery.h"
+#include <string.h>
+
+#define RECOVERY_MAGIC          0x52435659u     // "RCVY"
+
+static const char* const stage_names[STAGE_COUNT] = {
+    "start-up", "usb", "led", "ps2", "macro", "paste", "hid", "telemetry",
+    "console", "reconnect", "store", "clock",
+};
+
+// Placeholder until recovery_boot() runs, so the hooks always have a target
+static recovery_record_t unused_record;
+recovery_record_t* recovery_rec = &unused_record;
+
+static recovery_cause_t cause = RECOVERY_POWER_ON;
+static recovery_record_t last;
+
+bool recovery_boot(recovery_record_t* record, bool watchdog_timeout) {
+    bool valid = record->magic == RECOVERY_MAGIC && record->magic_check == ~RECOVERY_MAGIC;
+
+    memset(&last, 0, sizeof(last));
+    if (!valid) {
+        cause = RECOVERY_POWER_ON;
+        memset(record, 0, sizeof(*record));
+        record->magic = RECOVERY_MAGIC;
+        record->magic_check = ~RECOVERY_MAGIC;
+    } else {
+        cause = watchdog_timeout ? RECOVERY_WATCHDOG : RECOVERY_RESET;
+        last = *record;
+        if (last.stage >= STAGE_COUNT) last.stage = STAGE_NONE;
+
+        // Oldest PS/2 byte first
+        for (uint8_t i = 0; i < RECOVERY_PS2_BYTES; i++) {
+            last.ps2_bytes[i] = record->ps2_bytes[(record->ps2_next + i) & (RECOVERY_PS2_BYTES - 1)];
+        }
+        last.ps2_next = 0;
+
+        record->resets++;
+        if (cause == RECOVERY_WATCHDOG) record->watchdog_resets++;
+    }
+
+    record->uptime_ms = 0;
+    record->stage = STAGE_NONE;
+    record->ps2_next = 0;
+    memset(record->report, 0, sizeof(record->report));
+    memset(record->ps2_bytes, 0, sizeof(record->ps2_bytes));
+    recovery_rec = record;
+
+    // After a hang the host may still hold the keys from the last report
+    static const uint8_t released[8] = {0};
+    return watchdog_timeout ||
+           (cause == RECOVERY_RESET && memcmp(last.report, released, sizeof(released)) != 0);
+}
+
+recovery_cause_t recovery_cause(void) {
+    return cause;
+}
+
+const recovery_record_t* recovery_last(void) {
+    return &last;
+}
+
+const char* recovery_stage_name(uint8_t stage) {
+    return stage < STAGE_COUNT ? stage_names[stage] : "?";
+}
+
+void recovery_report(const uint8_t report[8]) {
+    memcpy(recovery_rec->report, report, sizeof(recovery_rec->report));
+}
@@ -0,0 +1,107 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * Watchdog Recovery Header
+ *
+ * The hardware watchdog (WATCHDOG_ENABLE) resets the chip if a main loop
+ * pass takes longer than WATCHDOG_TIMEOUT_MS. A record in RAM that is not
+ * cleared at start-up survives that reset. It holds the main loop stage
+ * that was running, the last keyboard report sent and the last PS/2 bytes
+ * received. After a reset the previous record is kept for diagnostics
+ * (console "resets" command), and a watchdog reset queues an all-keys-
+ * released report, so the host does not keep the keys that were down
+ * when the firmware hung.
+ *
+ * recovery.c holds the logic, without hardware dependencies;
+ * recovery_pico.c places the record and drives the watchdog.
+ */
+
+#ifndef RECOVERY_H_
+#define RECOVERY_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef WATCHDOG_ENABLE
+#define WATCHDOG_ENABLE         1
+#endif
+
+// Longest main loop pass before a reset (flash erases feed the watchdog
+// between sectors)
+#ifndef WATCHDOG_TIMEOUT_MS
+#define WATCHDOG_TIMEOUT_MS     1000
+#endif
+
+#define RECOVERY_PS2_BYTES      16      // Power of two
+
+typedef enum {
+    RECOVERY_POWER_ON = 0,      // No valid record: power was off
+    RECOVERY_WATCHDOG,          // The watchdog timed out
+    RECOVERY_RESET,             // Any other reset (RUN pin, debugger, reboot)
+} recovery_cause_t;
+
+// Main loop stages, in loop order
+typedef enum {
+    STAGE_NONE = 0,             // Start-up, before the main loop
+    STAGE_USB,
+    STAGE_LED,
+    STAGE_PS2,
+    STAGE_MACRO,
+    STAGE_PASTE,
+    STAGE_HID,
+    STAGE_TELEMETRY,
+    STAGE_CONSOLE,
+    STAGE_RECONNECT,
+    STAGE_STORE,
+    STAGE_CLOCK,
+    STAGE_COUNT
+} recovery_stage_t;
+
+typedef struct {
+    uint32_t magic;             // RECOVERY_MAGIC once initialized
+    uint32_t magic_check;       // ~magic
+    uint32_t resets;            // Resets since power-on
+    uint32_t watchdog_resets;   // Of which watchdog timeouts
+    uint32_t uptime_ms;         // At the last watchdog feed
+    uint8_t stage;              // Main loop stage running
+    uint8_t ps2_next;           // Next ps2_bytes entry to write
+    uint8_t report[8];          // Last keyboard report sent
+    uint8_t ps2_bytes[RECOVERY_PS2_BYTES];
+} recovery_record_t;
+
+// Record being written (set by recovery_boot())
+extern recovery_record_t* recovery_rec;
+
+// Validate the record after a reset of the given kind, keep a copy of it
+// as the previous run's, and start a new one. Returns true if the host
+// should get an all-keys-released report.
+bool recovery_boot(recovery_record_t* record, bool watchdog_timeout);
+
+// Why the chip was reset, and the record of the run before (valid unless
+// the cause is RECOVERY_POWER_ON); ps2_bytes are oldest first
+recovery_cause_t recovery_cause(void);
+const recovery_record_t* recovery_last(void);
+
+// Name of a stage for diagnostics
+const char* recovery_stage_name(uint8_t stage);
+
+// Recording hooks
+static inline void recovery_stage(recovery_stage_t stage) {
+    recovery_rec->stage = (uint8_t) stage;
+}
+
+static inline void recovery_ps2_byte(uint8_t byte) {
+    recovery_rec->ps2_bytes[recovery_rec->ps2_next++ & (RECOVERY_PS2_BYTES - 1)] = byte;
+}
+
+static inline void recovery_alive(uint32_t uptime_ms) {
+    recovery_rec->uptime_ms = uptime_ms;
+}
+
+void recovery_report(const uint8_t report[8]);
+
+// Device side (recovery_pico.c): check the reset reason, start the
+// watchdog, and feed it once per main loop pass
+bool recovery_start(void);
+void recovery_feed(void);
+
+#endif /* RECOVERY_H_ */
@@ -0,0 +1,31 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * Watchdog Recovery - Watchdog and Preserved RAM
+ *
+ * The record is placed in .uninitialized_data, which the runtime does not
+ * clear, so it survives any reset that keeps the chip powered.
+ */
+
+#include "recovery.h"
+#include "pico/stdlib.h"
+#include "hardware/watchdog.h"
+
+static recovery_record_t __uninitialized_ram(record);
+
+bool recovery_start(void) {
+    // True only for a timeout of a watchdog started with watchdog_enable()
+    bool release = recovery_boot(&record, watchdog_enable_caused_reboot());
+
+#if WATCHDOG_ENABLE
+    // Paused while a debugger halts the cores
+    watchdog_enable(WATCHDOG_TIMEOUT_MS, true);
+#endif
+    return release;
+}
+
+void recovery_feed(void) {
+#if WATCHDOG_ENABLE
+    watchdog_update();
+#endif
+    recovery_alive(to_ms_since_boot(get_absolute_time()));
+}
@@ -0,0 +1,50 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * Keyboard Report Queue Implementation
+ */
+
+#include "report_queue.h"
+#include "telemetry.h"
+#include <string.h>
+
+#if REPORT_SIZE != 8
+#error Queue entries are one 64-bit word
+#endif
+
+#if (REPORT_QUEUE_DEPTH & (REPORT_QUEUE_DEPTH - 1)) != 0
+#error REPORT_QUEUE_DEPTH must be a power of two
+#endif
+
+// One 64-bit word per report keeps every entry aligned for the USB stack
+static uint64_t queue[REPORT_QUEUE_DEPTH];
+static uint8_t queue_head = 0;   // Oldest entry
+static uint8_t queue_count = 0;
+
+void report_queue_init(void) {
+    queue_head = 0;
+    queue_count = 0;
+}
+
+void report_queue_push(const uint8_t report[REPORT_SIZE]) {
+    if (queue_count == REPORT_QUEUE_DEPTH) {
+        // Full - collapse into the newest entry
+        uint8_t last = (queue_head + queue_count - 1) & (REPORT_QUEUE_DEPTH - 1);
+        memcpy(&queue[last], report, REPORT_SIZE);
+        telemetry_count(TM_QUEUE_OVERRUNS);
+        return;
+    }
+
+    uint8_t tail = (queue_head + queue_count) & (REPORT_QUEUE_DEPTH - 1);
+    memcpy(&queue[tail], report, REPORT_SIZE);
+    queue_count++;
+}
+
+const uint8_t* report_queue_peek(void) {
+    return queue_count ? (const uint8_t*) &queue[queue_head] : NULL;
+}
+
+void report_queue_pop(void) {
+    if (queue_count == 0) return;
+    queue_head = (queue_head + 1) & (REPORT_QUEUE_DEPTH - 1);
+    queue_count--;
+}
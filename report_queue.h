@@ -0,0 +1,37 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * Keyboard Report Queue Header
+ *
+ * Every keyboard state change is queued as a complete 8-byte boot report
+ * so that short press/release pairs are never merged away before the
+ * host polls the endpoint.
+ */
+
+#ifndef REPORT_QUEUE_H_
+#define REPORT_QUEUE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Boot keyboard report size: modifiers, reserved, 6 keycodes
+#define REPORT_SIZE             8
+
+// Number of reports that can wait for the host (power of two)
+#ifndef REPORT_QUEUE_DEPTH
+#define REPORT_QUEUE_DEPTH      16
+#endif
+
+// Discard all queued reports
+void report_queue_init(void);
+
+// Queue a report; when full the newest entry is replaced so the host
+// still ends up with the latest state
+void report_queue_push(const uint8_t report[REPORT_SIZE]);
+
+// Oldest queued report, or NULL if the queue is empty
+const uint8_t* report_queue_peek(void);
+
+// Drop the oldest report (call after it was handed to the USB stack)
+void report_queue_pop(void);
+
+#endif /* REPORT_QUEUE_H_ */
@@ -0,0 +1,62 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * Keyboard Report Snapshot Implementation
+ *
+ * Latched sequence counter: the report is kept twice and the writer
+ * updates one copy at a time, bumping the counter before each. The low
+ * bit of the counter tells readers which copy is not being written. A
+ * reader retries only if the counter moved while it was copying, which
+ * cannot happen when the reader has interrupted the writer.
+ *
+ * The copies are stored as 32-bit atomics so the racing accesses are well
+ * defined; relaxed 32-bit loads and stores are plain LDR/STR on Cortex-M.
+ */
+
+#include "report_snapshot.h"
+#include <stdatomic.h>
+#include <string.h>
+
+#define REPORT_WORDS            (REPORT_SIZE / 4)
+
+static atomic_uint snapshot_seq;
+static atomic_uint snapshot[2][REPORT_WORDS];
+
+static void store_copy(int index, const uint32_t words[REPORT_WORDS]) {
+    for (int i = 0; i < REPORT_WORDS; i++) {
+        atomic_store_explicit(&snapshot[index][i], words[i], memory_order_relaxed);
+    }
+}
+
+void report_snapshot_publish(const uint8_t report[REPORT_SIZE]) {
+    uint32_t words[REPORT_WORDS];
+    memcpy(words, report, REPORT_SIZE);
+
+    // Only this function writes the counter, so no read-modify-write needed
+    unsigned seq = atomic_load_explicit(&snapshot_seq, memory_order_relaxed);
+
+    // Odd: readers use copy 1 while copy 0 is updated
+    atomic_store_explicit(&snapshot_seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    store_copy(0, words);
+
+    // Even: readers use copy 0 while copy 1 is updated
+    atomic_store_explicit(&snapshot_seq, seq + 2, memory_order_release);
+    atomic_thread_fence(memory_order_release);
+    store_copy(1, words);
+}
+
+void report_snapshot_read(uint8_t report[REPORT_SIZE]) {
+    uint32_t words[REPORT_WORDS];
+    unsigned seq;
+
+    do {
+        seq = atomic_load_explicit(&snapshot_seq, memory_order_acquire);
+        int index = seq & 1;
+        for (int i = 0; i < REPORT_WORDS; i++) {
+            words[i] = atomic_load_explicit(&snapshot[index][i], memory_order_relaxed);
+        }
+        atomic_thread_fence(memory_order_acquire);
+    } while (atomic_load_explicit(&snapshot_seq, memory_order_relaxed) != seq);
+
+    memcpy(report, words, REPORT_SIZE);
+}
@@ -0,0 +1,25 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * Keyboard Report Snapshot Header
+ *
+ * Holds the latest complete 8-byte boot report so that any context (USB
+ * control requests, an interrupt handler, the other core) can read it
+ * without locks and without ever seeing half of an update.
+ *
+ * There must be a single writer. The writer never waits, and a reader
+ * that interrupts the writer never waits either.
+ */
+
+#ifndef REPORT_SNAPSHOT_H_
+#define REPORT_SNAPSHOT_H_
+
+#include <stdint.h>
+#include "report_queue.h"
+
+// Publish a new report (single writer only)
+void report_snapshot_publish(const uint8_t report[REPORT_SIZE]);
+
+// Copy the latest published report (all zero before the first publish)
+void report_snapshot_read(uint8_t report[REPORT_SIZE]);
+
+#endif /* REPORT_SNAPSHOT_H_ */
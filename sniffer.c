@@ -0,0 +1,247 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * PS/2 Bus Sniffer Decoder
+ *
+ * Edges are timed by the sample that first sees them, so timestamps are
+ * as precise as the sampling loop is fast. Timeouts are checked on every
+ * sample without an edge.
+ */
+
+#include "sniffer.h"
+#include <string.h>
+
+#if (SNIFFER_RING_SIZE & (SNIFFER_RING_SIZE - 1)) != 0
+#error SNIFFER_RING_SIZE must be a power of two
+#endif
+
+typedef enum {
+    BUS_IDLE = 0,               // Both lines released
+    BUS_DEVICE,                 // Device-to-host frame
+    BUS_INHIBIT,                // Host holds the clock low
+    BUS_HOST,                   // Host-to-device frame after a request to send
+} bus_state_t;
+
+static bus_state_t state = BUS_IDLE;
+static bool started = false;            // Line levels known
+static bool last_clk = true;
+static bool last_data = true;
+static uint32_t edge_us = 0;            // Last clock edge
+static uint32_t start_us = 0;           // Start of the frame or inhibit
+static uint8_t bit = 0;                 // Next bit of the frame
+static uint8_t value = 0;               // Data bits so far (LSB first)
+static uint8_t flags = 0;
+static bool parity = false;             // Odd number of ones so far
+
+static sniffer_record_t ring[SNIFFER_RING_SIZE];
+static uint32_t ring_written = 0;
+static uint32_t ring_read = 0;
+static sniffer_stats_t stats;
+
+static void push(uint32_t time_us, uint32_t end_us, uint8_t data, uint8_t record_flags) {
+    if (record_flags & SNIFFER_INHIBIT) {
+        stats.inhibits++;
+    } else if (record_flags & SNIFFER_HOST) {
+        stats.host_frames++;
+    } else {
+        stats.device_frames++;
+    }
+    if (record_flags & (SNIFFER_PARITY_ERROR | SNIFFER_FRAMING_ERROR | SNIFFER_NO_ACK | SNIFFER_ABORTED)) {
+        stats.errors++;
+    }
+
+    uint32_t waiting = ring_written - ring_read;
+    if (waiting == SNIFFER_RING_SIZE) {
+        stats.lost++;
+        return;
+    }
+    if (waiting + 1 > stats.high_water) stats.high_water = (uint16_t) (waiting + 1);
+
+    uint32_t length = end_us - time_us;
+    sniffer_record_t* record = &ring[ring_written++ & (SNIFFER_RING_SIZE - 1)];
+    record->time_us = time_us;
+    record->length_us = (uint16_t) (length > 0xFFFF ? 0xFFFF : length);
+    record->data = data;
+    record->flags = record_flags;
+}
+
+static void begin_frame(bus_state_t frame) {
+    state = frame;
+    bit = 0;
+    value = 0;
+    parity = false;
+    flags = frame == BUS_HOST ? SNIFFER_HOST : 0;
+}
+
+// Data, parity (for odd parity over data and parity bit) and stop bits
+// shared by both directions: bit 0-7 data, 8 parity, 9 stop
+static void frame_bit(bool data) {
+    if (bit < 8) {
+        value = (uint8_t) (value | (data ? 1u << bit : 0u));
+        parity ^= data;
+    } else if (bit == 8) {
+        parity ^= data;
+        if (!parity) flags |= SNIFFER_PARITY_ERROR;
+    } else if (bit == 9) {
+        if (!data) flags |= SNIFFER_FRAMING_ERROR;
+    }
+    bit++;
+}
+
+static void end_frame(uint32_t end_us) {
+    push(start_us, end_us, value, flags);
+    state = BUS_IDLE;
+}
+
+static void falling_edge(bool data, uint32_t now_us) {
+    switch (state) {
+        case BUS_IDLE:
+            // Data low: the device's start bit. Data high: the host takes
+            // the clock (inhibit, maybe followed by a request to send)
+            start_us = now_us;
+            if (data) {
+                state = BUS_INHIBIT;
+            } else {
+                begin_frame(BUS_DEVICE);
+            }
+            break;
+
+        case BUS_DEVICE:
+            // Device frames: start bit already seen, then bits on falling edges
+            frame_bit(data);
+            if (bit == 10) end_frame(now_us);
+            break;
+
+        case BUS_HOST:
+            // Eleventh clock: the device pulls data low to acknowledge
+            if (bit == 10 && data) flags |= SNIFFER_NO_ACK;
+            break;
+
+        default:
+            break;
+    }
+}
+
+static void rising_edge(bool data, uint32_t now_us) {
+    switch (state) {
+        case BUS_INHIBIT:
+            if (!data) {
+                // Request to send; start_us stays at the inhibit
+                begin_frame(BUS_HOST);
+            } else {
+                push(start_us, now_us, 0, SNIFFER_INHIBIT);
+                state = BUS_IDLE;
+            }
+            break;
+
+        case BUS_HOST:
+            // Host frames: bits are read on rising edges, then the ack clock
+            if (bit < 10) {
+                frame_bit(data);
+            } else {
+                end_frame(now_us);
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+// Called on samples without a clock edge
+static void check_timeouts(bool clk, uint32_t now_us) {
+    uint32_t quiet_us = now_us - edge_us;
+
+    if (state == BUS_DEVICE && !clk && quiet_us >= SNIFFER_INHIBIT_US) {
+        // The host holds the clock: the device aborts its byte (and sends
+        // it again later). A lone falling edge was the inhibit itself.
+        if (bit > 0) push(start_us, edge_us, value, flags | SNIFFER_ABORTED);
+        start_us = edge_us;
+        state = BUS_INHIBIT;
+    } else if ((state == BUS_DEVICE || state == BUS_HOST) && quiet_us >= SNIFFER_FRAME_TIMEOUT_US) {
+        // A host frame that got its stop bit but no ack clock is complete
+        if (state == BUS_HOST && bit == 10) {
+            flags |= SNIFFER_NO_ACK;
+        } else {
+            flags |= SNIFFER_ABORTED;
+        }
+        end_frame(edge_us);
+        if (!clk) {
+            start_us = edge_us;
+            state = BUS_INHIBIT;
+        }
+    }
+}
+
+//--------------------------------------------------------------------+
+// Public Interface
+//--------------------------------------------------------------------+
+
+void sniffer_reset(void) {
+    state = BUS_IDLE;
+    started = false;
+    ring_written = 0;
+    ring_read = 0;
+    memset(&stats, 0, sizeof(stats));
+}
+
+void sniffer_sample(bool clk, bool data, uint32_t now_us) {
+    if (!started) {
+        // Wait for a released bus so the first frame is seen whole
+        if (!clk || !data) return;
+        started = true;
+        last_clk = true;
+        edge_us = now_us;
+        return;
+    }
+
+    last_data = data;
+    if (clk == last_clk) {
+        check_timeouts(clk, now_us);
+        return;
+    }
+
+    last_clk = clk;
+    edge_us = now_us;
+    if (clk) {
+        rising_edge(data, now_us);
+    } else {
+        falling_edge(data, now_us);
+    }
+}
+
+bool sniffer_idle(void) {
+    // An inhibit only turns into a frame after data goes low
+    return state == BUS_IDLE || (state == BUS_INHIBIT && last_data);
+}
+
+bool sniffer_read(sniffer_record_t* record) {
+    if (ring_read == ring_written) return false;
+    *record = ring[ring_read++ & (SNIFFER_RING_SIZE - 1)];
+    return true;
+}
+
+void sniffer_encode(const sniffer_record_t* record, uint8_t* out) {
+    out[0] = (uint8_t) record->time_us;
+    out[1] = (uint8_t) (record->time_us >> 8);
+    out[2] = (uint8_t) (record->time_us >> 16);
+    out[3] = (uint8_t) (record->time_us >> 24);
+    out[4] = (uint8_t) record->length_us;
+    out[5] = (uint8_t) (record->length_us >> 8);
+    out[6] = record->data;
+    out[7] = record->flags;
+}
+
+uint16_t sniffer_read_bytes(uint8_t* out, uint16_t max) {
+    uint16_t n = 0;
+    sniffer_record_t record;
+    while (max - n >= SNIFFER_RECORD_SIZE && sniffer_read(&record)) {
+        sniffer_encode(&record, &out[n]);
+        n += SNIFFER_RECORD_SIZE;
+    }
+    stats.bytes_streamed += n;
+    return n;
+}
+
+const sniffer_stats_t* sniffer_stats(void) {
+    return &stats;
+}
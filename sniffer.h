@@ -0,0 +1,109 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * PS/2 Bus Sniffer Header
+ *
+ * Optional listen-only mode (SNIFFER_ENABLE, needs CONSOLE_ENABLE) for
+ * diagnosing other PS/2 hosts and keyboards: with the bridge's CLK and
+ * DATA wired in parallel to their cable, the console's "sniff" command
+ * stops the keyboard decoder and streams every frame on the wire, in both
+ * directions, as binary records (tools/sniff.py). The bridge never drives
+ * the lines while sniffing; saving settings waits until it stops.
+ *
+ * Device-to-host frames are read on falling clock edges. A host-to-device
+ * frame starts with the host holding the clock low (inhibit) and pulling
+ * data low (request to send); its bits are read on rising edges and the
+ * device acknowledges by pulling data low on the eleventh clock. A host
+ * inhibit without a request to send is recorded as an event of its own.
+ *
+ * sniffer.c decodes line samples and queues records, without hardware
+ * dependencies, so it runs on the host (tests/test_sniffer.c and
+ * tools/sniff.py --simulate); sniffer_pico.c samples the pins.
+ */
+
+#ifndef SNIFFER_H_
+#define SNIFFER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef SNIFFER_ENABLE
+#define SNIFFER_ENABLE          0
+#endif
+
+// Records waiting to be streamed (power of two), 8 bytes each
+#ifndef SNIFFER_RING_SIZE
+#define SNIFFER_RING_SIZE       512
+#endif
+
+// Clock held low longer than this is the host inhibiting, not a bit
+#define SNIFFER_INHIBIT_US      100
+
+// No clock edge for this long ends a frame in progress
+#define SNIFFER_FRAME_TIMEOUT_US 2000
+
+// Record flags
+#define SNIFFER_HOST            0x01    // Host to device
+#define SNIFFER_PARITY_ERROR    0x02
+#define SNIFFER_FRAMING_ERROR   0x04    // Bad start or stop bit
+#define SNIFFER_NO_ACK          0x08    // Host frame not acknowledged
+#define SNIFFER_ABORTED         0x10    // Cut short; data holds the bits so far
+#define SNIFFER_INHIBIT         0x20    // Host held the clock low, no frame
+#define SNIFFER_END             0xFF    // Last record of a capture
+
+// Wire format, little-endian: u32 time_us, u16 length_us, u8 data, u8 flags
+#define SNIFFER_RECORD_SIZE     8
+
+typedef struct {
+    uint32_t time_us;           // First edge (host frames: clock pulled low)
+    uint16_t length_us;         // First to last edge, 0xFFFF if longer
+    uint8_t data;
+    uint8_t flags;
+} sniffer_record_t;
+
+typedef struct {
+    uint32_t device_frames;
+    uint32_t host_frames;
+    uint32_t inhibits;
+    uint32_t errors;            // Records with an error or abort flag
+    uint32_t lost;              // Records dropped because the ring was full
+    uint32_t bytes_streamed;    // Record bytes taken by sniffer_read_bytes()
+    uint16_t high_water;        // Most records waiting at once
+} sniffer_stats_t;
+
+// Clear the decoder, the ring and the statistics
+void sniffer_reset(void);
+
+// Feed one sample of both lines (true = high); call as often as possible
+void sniffer_sample(bool clk, bool data, uint32_t now_us);
+
+// True between frames, when other work cannot delay a bit
+bool sniffer_idle(void);
+
+// Take the oldest record, false if none is waiting
+bool sniffer_read(sniffer_record_t* record);
+
+// Take as many whole records as fit in max bytes, in wire format
+uint16_t sniffer_read_bytes(uint8_t* out, uint16_t max);
+
+// Wire format of a record
+void sniffer_encode(const sniffer_record_t* record, uint8_t* out);
+
+const sniffer_stats_t* sniffer_stats(void);
+
+#if SNIFFER_ENABLE
+
+// Device side (sniffer_pico.c): enter or leave listen-only mode, and
+// sample the pins (instead of ps2_task()) while in it
+void sniffer_start(void);
+void sniffer_stop(void);
+bool sniffer_active(void);
+void sniffer_poll(void);
+
+#else
+
+static inline bool sniffer_active(void) { return false; }
+static inline void sniffer_poll(void) {}
+
+#endif
+
+#endif /* SNIFFER_H_ */
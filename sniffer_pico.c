@@ -0,0 +1,46 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * PS/2 Bus Sniffer - Pin Sampling
+ *
+ * Both lines are read in one GPIO access, so a data change can never be
+ * mistaken for one on the other side of a clock edge. The pins stay
+ * inputs throughout; their pull-ups only add to the bus's own.
+ */
+
+#include "sniffer.h"
+
+#if SNIFFER_ENABLE
+
+#include "console.h"
+#include "ps2.h"
+#include "pico/stdlib.h"
+#include "hardware/gpio.h"
+
+#if !CONSOLE_ENABLE
+#error SNIFFER_ENABLE streams over the debug console and needs CONSOLE_ENABLE
+#endif
+
+static bool active = false;
+
+void sniffer_start(void) {
+    sniffer_reset();
+    active = true;
+}
+
+void sniffer_stop(void) {
+    active = false;
+
+    // Resynchronise the keyboard decoder with the bus
+    ps2_set_inhibit(false);
+}
+
+bool sniffer_active(void) {
+    return active;
+}
+
+void sniffer_poll(void) {
+    uint32_t pins = gpio_get_all();
+    sniffer_sample((pins >> PS2_CLOCK_PIN) & 1u, (pins >> PS2_DATA_PIN) & 1u, time_us_32());
+}
+
+#endif /* SNIFFER_ENABLE */
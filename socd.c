@@ -0,0 +1,111 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * SOCD (Simultaneous Opposing Cardinal Directions) Implementation
+ */
+
+#include "socd.h"
+#include "hid_keycodes.h"
+#include <string.h>
+
+//--------------------------------------------------------------------+
+// Opposing Key Pairs
+//--------------------------------------------------------------------+
+
+static const uint8_t socd_pairs[][2] = {
+    { HID_KEY_A,          HID_KEY_D           },
+    { HID_KEY_W,          HID_KEY_S           },
+    { HID_KEY_ARROW_LEFT, HID_KEY_ARROW_RIGHT },
+    { HID_KEY_ARROW_UP,   HID_KEY_ARROW_DOWN  },
+};
+
+//--------------------------------------------------------------------+
+// SOCD State
+//--------------------------------------------------------------------+
+
+static key_sink_t next_stage = NULL;
+static uint8_t mode = SOCD_MODE;
+
+static uint8_t partner[256];           // Opposing key (0 = not in a pair)
+static uint32_t held[256 / 32];        // Keys physically held
+static uint32_t sent[256 / 32];        // Keys currently sent to the host
+
+static inline bool test_bit(const uint32_t* bits, uint8_t key) {
+    return (bits[key >> 5] >> (key & 31)) & 1u;
+}
+
+static inline void set_bit(uint32_t* bits, uint8_t key, bool value) {
+    if (value) {
+        bits[key >> 5] |= 1u << (key & 31);
+    } else {
+        bits[key >> 5] &= ~(1u << (key & 31));
+    }
+}
+
+static void send(uint8_t key, bool pressed, uint32_t time_ms) {
+    set_bit(sent, key, pressed);
+    next_stage(key, pressed, time_ms);
+}
+
+//--------------------------------------------------------------------+
+// Public Interface
+//--------------------------------------------------------------------+
+
+void socd_init(key_sink_t sink) {
+    next_stage = sink;
+
+    memset(partner, 0, sizeof(partner));
+    for (unsigned i = 0; i < sizeof(socd_pairs) / sizeof(socd_pairs[0]); i++) {
+        partner[socd_pairs[i][0]] = socd_pairs[i][1];
+        partner[socd_pairs[i][1]] = socd_pairs[i][0];
+    }
+
+    memset(held, 0, sizeof(held));
+    memset(sent, 0, sizeof(sent));
+}
+
+void socd_process(uint8_t key, bool pressed, uint32_t time_ms) {
+    uint8_t other = partner[key];
+    if (other == 0) {
+        next_stage(key, pressed, time_ms);
+        return;
+    }
+
+    // Pair keys are tracked in every mode, so a mode change while they are
+    // held still releases what was sent
+    set_bit(held, key, pressed);
+
+    if (!pressed) {
+        if (test_bit(sent, key)) send(key, false, time_ms);
+
+        // The opposing key comes back if it is still held
+        if (test_bit(held, other) && !test_bit(sent, other)) send(other, true, time_ms);
+        return;
+    }
+
+    if (mode == SOCD_MODE_OFF || !test_bit(held, other)) {
+        send(key, true, time_ms);
+        return;
+    }
+
+    switch (mode) {
+        case SOCD_MODE_LAST_INPUT:
+            if (test_bit(sent, other)) send(other, false, time_ms);
+            send(key, true, time_ms);
+            break;
+        case SOCD_MODE_NEUTRAL:
+            if (test_bit(sent, other)) send(other, false, time_ms);
+            break;
+        case SOCD_MODE_FIRST_INPUT:
+        default:
+            // Opposing key keeps priority; this one is sent once it lets go
+            break;
+    }
+}
+
+void socd_set_mode(uint8_t new_mode) {
+    mode = new_mode;
+}
+
+uint8_t socd_get_mode(void) {
+    return mode;
+}
@@ -0,0 +1,39 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * SOCD (Simultaneous Opposing Cardinal Directions) Header
+ *
+ * Resolves opposing key pairs (A/D, W/S, Left/Right, Up/Down) held at the
+ * same time. Runs on resolved keycodes right before the keyboard state is
+ * updated; each event costs one partner lookup, and the resolved change is
+ * part of the same report as the key that caused it.
+ */
+
+#ifndef SOCD_H_
+#define SOCD_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "key_event.h"
+
+// Resolution modes
+#define SOCD_MODE_OFF           0   // Send both keys as pressed
+#define SOCD_MODE_LAST_INPUT    1   // Newest key wins, older one returns on release
+#define SOCD_MODE_NEUTRAL       2   // Both held -> neither is sent
+#define SOCD_MODE_FIRST_INPUT   3   // Key held first wins until it is released
+
+// Mode at startup
+#ifndef SOCD_MODE
+#define SOCD_MODE               SOCD_MODE_OFF
+#endif
+
+// Initialize pair state; resolved events are passed to sink
+void socd_init(key_sink_t sink);
+
+// Feed a resolved key event
+void socd_process(uint8_t key, bool pressed, uint32_t time_ms);
+
+// Change the resolution mode (takes effect for the next event)
+void socd_set_mode(uint8_t mode);
+uint8_t socd_get_mode(void);
+
+#endif /* SOCD_H_ */
@@ -0,0 +1,299 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * Configuration Store Implementation
+ *
+ * Block:  [magic, sequence, header CRC, committed] + records
+ * Record: [key, ~key, length LE16, CRC LE32] + data, padded to 4 bytes
+ *
+ * A record's data is programmed before its header, so a record exists only
+ * once its header is complete and the CRC over header and data matches.
+ * "committed" is programmed last when a block is filled from the previous
+ * one; any cleared bit counts, since programming only starts after the
+ * copy has finished.
+ */
+
+#include "store.h"
+#include "store_flash.h"
+#include <string.h>
+
+#if STORE_BLOCK_SIZE % STORE_FLASH_SECTOR_SIZE != 0
+#error STORE_BLOCK_SIZE must be a multiple of the flash sector size
+#endif
+
+#if STORE_BLOCKS < 2
+#error The store needs at least two blocks
+#endif
+
+#define BLOCK_MAGIC             0x53474643u     // "CFGS"
+#define BLOCK_HEADER_SIZE       16
+#define RECORD_HEADER_SIZE      8
+#define NO_BLOCK                0xFF
+
+#define RECORD_SIZE(len)        (RECORD_HEADER_SIZE + (((uint32_t) (len) + 3) & ~3u))
+
+static store_source_t store_source = NULL;
+
+static uint8_t current = NO_BLOCK;      // Block records are appended to
+static uint32_t current_seq = 0;
+static uint32_t write_pos = 0;          // Offset of the next record in the block
+
+// Offset of each key's latest record in the current block (0 = none)
+static uint16_t record_index[STORE_MAX_KEYS];
+
+static uint64_t dirty = 0;              // One bit per key
+static bool dirty_changed = false;
+static uint32_t last_change_ms = 0;
+static uint32_t last_active_ms = 0;
+
+//--------------------------------------------------------------------+
+// Helpers
+//--------------------------------------------------------------------+
+
+// CRC-32 (IEEE 802.3), four bits at a time
+static uint32_t crc32_update(uint32_t crc, const uint8_t* data, uint32_t len) {
+    static const uint32_t table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+    };
+    for (uint32_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        crc = (crc >> 4) ^ table[crc & 0x0F];
+        crc = (crc >> 4) ^ table[crc & 0x0F];
+    }
+    return crc;
+}
+
+static uint32_t record_crc(const uint8_t* header, const uint8_t* data, uint16_t len) {
+    uint32_t crc = crc32_update(0xFFFFFFFFu, header, 4);
+    return ~crc32_update(crc, data, len);
+}
+
+static inline uint32_t get_u32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static inline void put_u32(uint8_t* p, uint32_t value) {
+    p[0] = (uint8_t) value;
+    p[1] = (uint8_t) (value >> 8);
+    p[2] = (uint8_t) (value >> 16);
+    p[3] = (uint8_t) (value >> 24);
+}
+
+static inline const uint8_t* block_ptr(uint8_t block) {
+    return store_flash_base() + (uint32_t) block * STORE_BLOCK_SIZE;
+}
+
+static bool is_erased(const uint8_t* p, uint32_t len) {
+    for (uint32_t i = 0; i < len; i++) {
+        if (p[i] != 0xFF) return false;
+    }
+    return true;
+}
+
+// Program and read back
+static bool program(uint32_t offset, const void* data, uint32_t len) {
+    return store_flash_program(offset, data, len) &&
+           memcmp(store_flash_base() + offset, data, len) == 0;
+}
+
+//--------------------------------------------------------------------+
+// Blocks and Records
+//--------------------------------------------------------------------+
+
+// Sequence number of a committed block, or 0
+static uint32_t block_seq(uint8_t block) {
+    const uint8_t* p = block_ptr(block);
+    if (get_u32(p) != BLOCK_MAGIC) return 0;
+    if (get_u32(p + 8) != ~crc32_update(0xFFFFFFFFu, p, 8)) return 0;
+    if (get_u32(p + 12) == 0xFFFFFFFFu) return 0;
+    return get_u32(p + 4);
+}
+
+// Index the records of the current block and find the end of the log. A
+// bad record or programmed bytes past the end mean an interrupted write;
+// the block is then treated as full so the next flush moves on.
+static void scan_block(void) {
+    const uint8_t* base = block_ptr(current);
+    uint32_t pos = BLOCK_HEADER_SIZE;
+
+    memset(record_index, 0, sizeof(record_index));
+    while (pos + RECORD_HEADER_SIZE <= STORE_BLOCK_SIZE) {
+        const uint8_t* header = base + pos;
+        if (is_erased(header, RECORD_HEADER_SIZE)) break;
+
+        uint8_t key = header[0];
+        uint16_t len = (uint16_t) (header[2] | (header[3] << 8));
+        if (key == 0 || key >= STORE_MAX_KEYS || (uint8_t) (header[0] ^ header[1]) != 0xFF ||
+            RECORD_SIZE(len) > STORE_BLOCK_SIZE - pos ||
+            get_u32(header + 4) != record_crc(header, header + RECORD_HEADER_SIZE, len)) {
+            write_pos = STORE_BLOCK_SIZE;
+            return;
+        }
+        record_index[key] = (uint16_t) pos;
+        pos += RECORD_SIZE(len);
+    }
+
+    write_pos = is_erased(base + pos, STORE_BLOCK_SIZE - pos) ? pos : STORE_BLOCK_SIZE;
+}
+
+// Append a record to a block at *pos; len 0 deletes the key
+static bool append(uint8_t block, uint32_t* pos, uint8_t key, const void* data, uint16_t len) {
+    if (RECORD_SIZE(len) > STORE_BLOCK_SIZE - *pos) return false;
+
+    uint8_t header[RECORD_HEADER_SIZE];
+    header[0] = key;
+    header[1] = (uint8_t) ~key;
+    header[2] = (uint8_t) len;
+    header[3] = (uint8_t) (len >> 8);
+    put_u32(&header[4], record_crc(header, data, len));
+
+    uint32_t offset = (uint32_t) block * STORE_BLOCK_SIZE + *pos;
+    if (len && !program(offset + RECORD_HEADER_SIZE, data, len)) return false;
+    if (!program(offset, header, RECORD_HEADER_SIZE)) return false;
+
+    *pos += RECORD_SIZE(len);
+    return true;
+}
+
+// What a flush writes for a dirty key: its current contents, or a deletion
+// (len 0) if it has a record; false if there is nothing to write
+static bool dirty_record(uint8_t key, const void** data, uint16_t* len) {
+    *len = 0;
+    *data = store_source ? store_source(key, len) : NULL;
+    if (*data && *len) return true;
+
+    uint16_t old_len;
+    *data = NULL;
+    *len = 0;
+    return store_get(key, &old_len) != NULL;
+}
+
+// Data a new block gets for a key: its current contents if dirty, else
+// its record
+static const void* live_data(uint8_t key, uint16_t* len) {
+    if (dirty & (1ull << key)) {
+        const void* data;
+        return dirty_record(key, &data, len) ? data : NULL;
+    }
+    return store_get(key, len);
+}
+
+// Copy the live value of every key into the next block and make it current
+static bool move_to_next_block(void) {
+    uint8_t next = (current == NO_BLOCK) ? 0 : (uint8_t) ((current + 1) % STORE_BLOCKS);
+    uint32_t base = (uint32_t) next * STORE_BLOCK_SIZE;
+    uint16_t next_index[STORE_MAX_KEYS] = {0};
+    uint32_t pos = BLOCK_HEADER_SIZE;
+
+    if (!store_flash_erase(base, STORE_BLOCK_SIZE)) return false;
+
+    uint8_t header[12];
+    put_u32(&header[0], BLOCK_MAGIC);
+    put_u32(&header[4], current_seq + 1);
+    put_u32(&header[8], ~crc32_update(0xFFFFFFFFu, header, 8));
+    if (!program(base, header, sizeof(header))) return false;
+
+    for (uint8_t key = 1; key < STORE_MAX_KEYS; key++) {
+        uint16_t len;
+        const void* data = live_data(key, &len);
+        if (!data) continue;
+
+        next_index[key] = (uint16_t) pos;
+        if (!append(next, &pos, key, data, len)) return false;
+    }
+
+    static const uint8_t committed[4] = {0};
+    if (!program(base + 12, committed, sizeof(committed))) return false;
+
+    current = next;
+    current_seq++;
+    write_pos = pos;
+    memcpy(record_index, next_index, sizeof(record_index));
+    return true;
+}
+
+//--------------------------------------------------------------------+
+// Public Interface
+//--------------------------------------------------------------------+
+
+void store_init(store_source_t source) {
+    store_source = source;
+    current = NO_BLOCK;
+    current_seq = 0;
+    write_pos = 0;
+    memset(record_index, 0, sizeof(record_index));
+    dirty = 0;
+    dirty_changed = false;
+    last_change_ms = 0;
+    last_active_ms = 0;
+
+    for (uint8_t block = 0; block < STORE_BLOCKS; block++) {
+        uint32_t seq = block_seq(block);
+        if (seq > current_seq) {
+            current = block;
+            current_seq = seq;
+        }
+    }
+    if (current != NO_BLOCK) scan_block();
+}
+
+const void* store_get(uint8_t key, uint16_t* len) {
+    if (key == 0 || key >= STORE_MAX_KEYS || current == NO_BLOCK || !record_index[key]) return NULL;
+
+    const uint8_t* header = block_ptr(current) + record_index[key];
+    *len = (uint16_t) (header[2] | (header[3] << 8));
+    return *len ? header + RECORD_HEADER_SIZE : NULL;
+}
+
+void store_mark_dirty(uint8_t key) {
+    if (key == 0 || key >= STORE_MAX_KEYS) return;
+    dirty |= 1ull << key;
+    dirty_changed = true;
+}
+
+bool store_flush_due(uint32_t now_ms, bool keys_active) {
+    if (keys_active) last_active_ms = now_ms;
+    if (dirty_changed) {
+        dirty_changed = false;
+        last_change_ms = now_ms;
+    }
+    return dirty != 0 &&
+           now_ms - last_change_ms >= STORE_FLUSH_DELAY_MS &&
+           now_ms - last_active_ms >= STORE_IDLE_MS;
+}
+
+bool store_flush(void) {
+    const void* data;
+    uint16_t len;
+
+    if (!dirty) return true;
+
+    // Size of the batch
+    uint32_t need = 0;
+    for (uint8_t key = 1; key < STORE_MAX_KEYS; key++) {
+        if ((dirty & (1ull << key)) && dirty_record(key, &data, &len)) need += RECORD_SIZE(len);
+    }
+
+    // Append to the current block if the batch fits, else start the next one
+    bool ok = false;
+    if (current != NO_BLOCK && need <= STORE_BLOCK_SIZE - write_pos) {
+        ok = true;
+        for (uint8_t key = 1; key < STORE_MAX_KEYS && ok; key++) {
+            if (!(dirty & (1ull << key)) || !dirty_record(key, &data, &len)) continue;
+
+            uint32_t pos = write_pos;
+            ok = append(current, &pos, key, data, len);
+            if (ok) {
+                record_index[key] = (uint16_t) write_pos;
+                write_pos = pos;
+            }
+        }
+
+        // A failed write leaves the rest of the block unusable
+        if (!ok) write_pos = STORE_BLOCK_SIZE;
+    }
+    if (!ok) ok = move_to_next_block();
+
+    dirty = 0;
+    return ok;
+}
@@ -0,0 +1,70 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * Configuration Store Header
+ *
+ * Log-structured key/value store in the last flash sectors, for settings
+ * that must survive power loss. Each record carries a CRC. A value is read
+ * in place through XIP, nothing is copied at boot. Changed values are only
+ * marked dirty; the store fetches their current contents from a source
+ * callback and writes them in one batch once the keyboard has been idle
+ * for a while (see store_flush_due()).
+ *
+ * Records are appended to the current block. When it is full, the latest
+ * record of every key is copied into the next block of a ring, which is
+ * then committed and becomes current, so erases rotate over all blocks.
+ * A torn write at power loss leaves a record with a bad CRC, which is
+ * skipped along with the rest of its block; an interrupted block copy is
+ * never committed and the previous block stays current.
+ */
+
+#ifndef STORE_H_
+#define STORE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Ring of blocks at the end of flash (block size a multiple of 4 KB)
+#ifndef STORE_BLOCK_SIZE
+#define STORE_BLOCK_SIZE        8192
+#endif
+#ifndef STORE_BLOCKS
+#define STORE_BLOCKS            4
+#endif
+#define STORE_SIZE              (STORE_BLOCK_SIZE * STORE_BLOCKS)
+
+// Keys are 1 to STORE_MAX_KEYS - 1
+#define STORE_MAX_KEYS          64
+
+// A batch is written this long after the last change...
+#ifndef STORE_FLUSH_DELAY_MS
+#define STORE_FLUSH_DELAY_MS    1000
+#endif
+
+// ...and only once no key was active for this long
+#ifndef STORE_IDLE_MS
+#define STORE_IDLE_MS           2000
+#endif
+
+// Current contents of a key to write: returns the data and sets len, or
+// returns NULL to delete the key
+typedef const void* (*store_source_t)(uint8_t key, uint16_t* len);
+
+// Find the current block and index its records
+void store_init(store_source_t source);
+
+// Latest value of a key, read in place (valid until the next flush), or
+// NULL if it was never written or deleted
+const void* store_get(uint8_t key, uint16_t* len);
+
+// Write the key's current contents with the next batch
+void store_mark_dirty(uint8_t key);
+
+// True when a batch is waiting, the last change was STORE_FLUSH_DELAY_MS
+// ago and keys_active has been false for STORE_IDLE_MS. Call every pass.
+bool store_flush_due(uint32_t now_ms, bool keys_active);
+
+// Write all dirty keys now; false if the flash failed or the values no
+// longer fit in a block (they are dropped either way)
+bool store_flush(void);
+
+#endif /* STORE_H_ */
@@ -0,0 +1,40 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * Configuration Store Flash Interface
+ *
+ * The region of flash the configuration store (see store.h) lives in.
+ * store_flash_pico.c drives the on-board flash; store_flash_ram.c emulates
+ * it in RAM for host builds, with power-fail injection.
+ *
+ * Flash semantics: erase sets every byte of a sector to 0xFF, and
+ * programming can only clear bits, at any offset and length.
+ */
+
+#ifndef STORE_FLASH_H_
+#define STORE_FLASH_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Erase unit
+#define STORE_FLASH_SECTOR_SIZE 4096
+
+// Memory-mapped view of the region (XIP on the device); reads go straight
+// through this pointer
+const uint8_t* store_flash_base(void);
+
+// Erase whole sectors; offset and len are multiples of the sector size
+bool store_flash_erase(uint32_t offset, uint32_t len);
+
+// Program len bytes at offset (relative to the region); data may point
+// into the region itself
+bool store_flash_program(uint32_t offset, const void* data, uint32_t len);
+
+// store_flash_ram.c only: erase the whole region, and simulate a power failure
+// after the given number of erased or programmed bytes (-1 = never). The
+// failing operation stops part way and every later one fails until the
+// next store_flash_ram_fail_after() call.
+void store_flash_ram_reset(void);
+void store_flash_ram_fail_after(int32_t bytes);
+
+#endif /* STORE_FLASH_H_ */
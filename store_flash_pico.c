@@ -0,0 +1,91 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * Configuration Store Flash Interface - On-board Flash
+ *
+ * The store occupies the last STORE_SIZE bytes of flash. XIP is off while
+ * the flash is erased or programmed, so interrupts are disabled (and core 1
+ * parked, if it runs) and data is staged one 256-byte page at a time in
+ * RAM (it may come from flash).
+ * Bytes of a page outside the data are programmed as 0xFF, which leaves
+ * them unchanged.
+ */
+
+#include "store_flash.h"
+#include "store.h"
+#include "pico/stdlib.h"
+#include "hardware/flash.h"
+#include "hardware/sync.h"
+#include "hardware/watchdog.h"
+#include "usb_host.h"
+#include <string.h>
+
+#if USB_HOST_ENABLE
+#include "pico/multicore.h"
+#endif
+
+#define STORE_FLASH_OFFSET      (PICO_FLASH_SIZE_BYTES - STORE_SIZE)
+
+#if STORE_FLASH_SECTOR_SIZE != FLASH_SECTOR_SIZE
+#error STORE_FLASH_SECTOR_SIZE does not match the flash
+#endif
+
+// Core 1 (the USB keyboard host) runs from flash too: park it first
+static uint32_t flash_begin(void) {
+#if USB_HOST_ENABLE
+    multicore_lockout_start_blocking();
+#endif
+    return save_and_disable_interrupts();
+}
+
+static void flash_end(uint32_t irq) {
+    restore_interrupts(irq);
+#if USB_HOST_ENABLE
+    multicore_lockout_end_blocking();
+#endif
+}
+
+const uint8_t* store_flash_base(void) {
+    return (const uint8_t*) (XIP_BASE + STORE_FLASH_OFFSET);
+}
+
+bool store_flash_erase(uint32_t offset, uint32_t len) {
+    if (offset % FLASH_SECTOR_SIZE || len % FLASH_SECTOR_SIZE || offset + len > STORE_SIZE) {
+        return false;
+    }
+
+    // One sector at a time, so interrupts are only held off for one erase;
+    // a sector erase can take up to 400 ms, so feed the watchdog each time
+    for (uint32_t done = 0; done < len; done += FLASH_SECTOR_SIZE) {
+        watchdog_update();
+        uint32_t irq = flash_begin();
+        flash_range_erase(STORE_FLASH_OFFSET + offset + done, FLASH_SECTOR_SIZE);
+        flash_end(irq);
+    }
+    return true;
+}
+
+bool store_flash_program(uint32_t offset, const void* data, uint32_t len) {
+    static uint8_t page[FLASH_PAGE_SIZE];
+    const uint8_t* src = data;
+
+    if (offset + len > STORE_SIZE) return false;
+
+    while (len) {
+        uint32_t page_offset = offset & ~(uint32_t) (FLASH_PAGE_SIZE - 1);
+        uint32_t start = offset - page_offset;
+        uint32_t count = FLASH_PAGE_SIZE - start;
+        if (count > len) count = len;
+
+        memset(page, 0xFF, sizeof(page));
+        memcpy(&page[start], src, count);
+
+        uint32_t irq = flash_begin();
+        flash_range_program(STORE_FLASH_OFFSET + page_offset, page, FLASH_PAGE_SIZE);
+        flash_end(irq);
+
+        offset += count;
+        src += count;
+        len -= count;
+    }
+    return true;
+}
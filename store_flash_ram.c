@@ -0,0 +1,66 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * Configuration Store Flash Interface - RAM Emulation
+ *
+ * Host builds use this instead of store_flash_pico.c. It follows the flash
+ * rules (erase to 0xFF, programming only clears bits) so the store behaves
+ * as on the device, and can cut an operation short to simulate power loss.
+ */
+
+#include "store_flash.h"
+#include "store.h"
+#include <string.h>
+
+static uint8_t region[STORE_SIZE];
+static bool region_ready = false;
+
+// Bytes left before the simulated power failure, -1 = never
+static int32_t budget = -1;
+
+// Consume budget for len bytes; returns how many may still be touched
+static uint32_t take_budget(uint32_t len) {
+    if (budget < 0) return len;
+    uint32_t allowed = ((uint32_t) budget < len) ? (uint32_t) budget : len;
+    budget -= (int32_t) allowed;
+    return allowed;
+}
+
+const uint8_t* store_flash_base(void) {
+    if (!region_ready) store_flash_ram_reset();
+    return region;
+}
+
+bool store_flash_erase(uint32_t offset, uint32_t len) {
+    if (!region_ready) store_flash_ram_reset();
+    if (offset % STORE_FLASH_SECTOR_SIZE || len % STORE_FLASH_SECTOR_SIZE ||
+        offset + len > STORE_SIZE) {
+        return false;
+    }
+
+    uint32_t done = take_budget(len);
+    memset(&region[offset], 0xFF, done);
+    return done == len;
+}
+
+bool store_flash_program(uint32_t offset, const void* data, uint32_t len) {
+    if (!region_ready) store_flash_ram_reset();
+    if (offset + len > STORE_SIZE) return false;
+
+    // Data may alias the region; bytes are read before they are programmed
+    const uint8_t* src = data;
+    uint32_t done = take_budget(len);
+    for (uint32_t i = 0; i < done; i++) {
+        region[offset + i] &= src[i];
+    }
+    return done == len;
+}
+
+void store_flash_ram_reset(void) {
+    memset(region, 0xFF, sizeof(region));
+    region_ready = true;
+    budget = -1;
+}
+
+void store_flash_ram_fail_after(int32_t bytes) {
+    budget = bytes;
+}
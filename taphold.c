@@ -0,0 +1,207 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * Tap-Hold (Dual-Role Key) Implementation
+ */
+
+#include "taphold.h"
+#include "hid_keycodes.h"
+#include <string.h>
+
+//--------------------------------------------------------------------+
+// Dual-Role Key Definitions
+//--------------------------------------------------------------------+
+
+typedef struct {
+    uint8_t key;    // Keycode from the translation tables
+    uint8_t tap;    // Keycode sent when tapped
+    uint8_t hold;   // Keycode sent when held
+} dual_role_key_t;
+
+static const dual_role_key_t dual_role_keys[] = {
+#if TAPHOLD_EXAMPLE_KEYS
+    { HID_KEY_SPACE,  HID_KEY_SPACE,  HID_KEY_SHIFT_LEFT },  // Space / Left Shift
+    { HID_KEY_ESCAPE, HID_KEY_ESCAPE, HID_KEY_CONTROL_LEFT },  // Esc / Left Ctrl
+#endif
+    { 0, 0, 0 }  // Terminator (keeps the array non-empty)
+};
+
+//--------------------------------------------------------------------+
+// Tap-Hold State
+//--------------------------------------------------------------------+
+
+typedef struct {
+    uint8_t key;
+    bool pressed;
+    uint32_t time_ms;
+} buffered_event_t;
+
+static key_sink_t next_stage = NULL;
+static uint16_t term_ms = TAPHOLD_TERM_MS;
+
+static uint8_t dual_role_index[256];   // Index + 1 into dual_role_keys (0 = normal key)
+static uint8_t decided_as[256];        // Keycode a decided dual-role key is sending
+static uint32_t key_down[256 / 32];    // Physical key state, filters typematic repeats
+
+static bool pending = false;           // A dual-role key is undecided
+static uint8_t pending_key = 0;
+static uint32_t pending_since = 0;
+
+// Events waiting behind the pending key, oldest first
+static buffered_event_t buffer[TAPHOLD_BUFFER_SIZE];
+static uint8_t buffer_count = 0;
+
+//--------------------------------------------------------------------+
+// Helper Functions
+//--------------------------------------------------------------------+
+
+static inline bool is_down(uint8_t key) {
+    return (key_down[key >> 5] >> (key & 31)) & 1u;
+}
+
+static inline void set_down(uint8_t key, bool down) {
+    if (down) {
+        key_down[key >> 5] |= 1u << (key & 31);
+    } else {
+        key_down[key >> 5] &= ~(1u << (key & 31));
+    }
+}
+
+// Forward an event once no decision is pending
+static void forward_event(const buffered_event_t* ev) {
+    if (ev->pressed) {
+        uint8_t index = dual_role_index[ev->key];
+        if (index != 0) {
+            pending = true;
+            pending_key = ev->key;
+            pending_since = ev->time_ms;
+            return;
+        }
+        next_stage(ev->key, true, ev->time_ms);
+    } else {
+        uint8_t sent = decided_as[ev->key];
+        if (sent != 0) {
+            decided_as[ev->key] = 0;
+            next_stage(sent, false, ev->time_ms);
+        } else {
+            next_stage(ev->key, false, ev->time_ms);
+        }
+    }
+}
+
+// Settle the pending key and press its chosen keycode
+static void decide(bool hold, uint32_t time_ms) {
+    const dual_role_key_t* dual_role = &dual_role_keys[dual_role_index[pending_key] - 1];
+    uint8_t code = hold ? dual_role->hold : dual_role->tap;
+
+    pending = false;
+    decided_as[pending_key] = code;
+    next_stage(code, true, time_ms);
+}
+
+// Decide what the buffered events allow and forward everything that
+// is no longer held back
+static void run(uint32_t now_ms) {
+    uint8_t head = 0;
+
+    while (head < buffer_count || pending) {
+        if (!pending) {
+            forward_event(&buffer[head++]);
+            continue;
+        }
+
+        // Scan events after the pending press for the first decision
+        bool decided = false;
+        for (uint8_t i = head; i < buffer_count; i++) {
+            const buffered_event_t* ev = &buffer[i];
+
+            if (ev->time_ms - pending_since >= term_ms) {
+                // Hold time ran out before this event arrived
+                decide(true, pending_since + term_ms);
+                decided = true;
+                break;
+            }
+            if (ev->pressed) continue;
+
+            if (ev->key == pending_key) {
+                decide(false, ev->time_ms);
+                decided = true;
+                break;
+            }
+#if TAPHOLD_PERMISSIVE_HOLD
+            // Another key tapped entirely inside the pending key
+            for (uint8_t j = head; j < i; j++) {
+                if (buffer[j].pressed && buffer[j].key == ev->key) {
+                    decide(true, ev->time_ms);
+                    decided = true;
+                    break;
+                }
+            }
+            if (decided) break;
+#endif
+        }
+
+        if (!decided) {
+            if (now_ms - pending_since < term_ms) break;
+            decide(true, pending_since + term_ms);
+        }
+    }
+
+    // Keep what is still waiting at the front of the buffer
+    buffer_count -= head;
+    memmove(buffer, &buffer[head], buffer_count * sizeof(buffer[0]));
+}
+
+//--------------------------------------------------------------------+
+// Public Interface
+//--------------------------------------------------------------------+
+
+void taphold_init(key_sink_t sink) {
+    next_stage = sink;
+
+    memset(dual_role_index, 0, sizeof(dual_role_index));
+    for (uint8_t i = 0; dual_role_keys[i].key != 0; i++) {
+        dual_role_index[dual_role_keys[i].key] = i + 1;
+    }
+
+    memset(decided_as, 0, sizeof(decided_as));
+    memset(key_down, 0, sizeof(key_down));
+    pending = false;
+    buffer_count = 0;
+}
+
+void taphold_process(uint8_t key, bool pressed, uint32_t time_ms) {
+    // Drop typematic repeats and releases of keys that are not down
+    if (is_down(key) == pressed) return;
+    set_down(key, pressed);
+
+    if (buffer_count == TAPHOLD_BUFFER_SIZE) {
+        // Out of buffer space - settle as hold to make room
+        decide(true, time_ms);
+        run(time_ms);
+    }
+
+    buffer[buffer_count].key = key;
+    buffer[buffer_count].pressed = pressed;
+    buffer[buffer_count].time_ms = time_ms;
+    buffer_count++;
+
+    run(time_ms);
+}
+
+void taphold_task(uint32_t now_ms) {
+    if (pending) {
+        run(now_ms);
+    }
+}
+
+bool taphold_pending(void) {
+    return pending;
+}
+
+void taphold_set_term(uint16_t ms) {
+    term_ms = ms;
+}
+
+uint16_t taphold_get_term(void) {
+    return term_ms;
+}
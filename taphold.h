@@ -0,0 +1,60 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * Tap-Hold (Dual-Role Key) Header
+ *
+ * A dual-role key sends its tap keycode when tapped and its hold keycode
+ * (usually a modifier) when held. While the decision is open, later key
+ * events are buffered and replayed in order once it is made.
+ *
+ * A pending key is decided as soon as one of these rules applies:
+ * - it is released: tap
+ * - it has been held for TAPHOLD_TERM_MS: hold
+ * - permissive hold: another key is pressed and released while it is
+ *   held: hold
+ */
+
+#ifndef TAPHOLD_H_
+#define TAPHOLD_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "key_event.h"
+
+// Hold time after which a dual-role key becomes its hold keycode
+#ifndef TAPHOLD_TERM_MS
+#define TAPHOLD_TERM_MS         200
+#endif
+
+// Decide hold when another key is tapped inside a dual-role key
+#ifndef TAPHOLD_PERMISSIVE_HOLD
+#define TAPHOLD_PERMISSIVE_HOLD 1
+#endif
+
+// Key events that can wait behind an undecided key
+#ifndef TAPHOLD_BUFFER_SIZE
+#define TAPHOLD_BUFFER_SIZE     16
+#endif
+
+// Build the example dual-role keys (Space/Left Shift, Esc/Left Ctrl)
+#ifndef TAPHOLD_EXAMPLE_KEYS
+#define TAPHOLD_EXAMPLE_KEYS    0
+#endif
+
+// Initialize tap-hold state; decided events are passed to sink
+void taphold_init(key_sink_t sink);
+
+// Feed a key event from the decoder
+void taphold_process(uint8_t key, bool pressed, uint32_t time_ms);
+
+// Decide a pending key whose hold time has run out
+// Call regularly, e.g. from the PS/2 polling loop
+void taphold_task(uint32_t now_ms);
+
+// True while a dual-role key is undecided and events are being held back
+bool taphold_pending(void);
+
+// Change the hold time (takes effect for the next decision)
+void taphold_set_term(uint16_t ms);
+uint16_t taphold_get_term(void);
+
+#endif /* TAPHOLD_H_ */
@@ -0,0 +1,279 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * Telemetry Implementation
+ *
+ * All hooks run in the main loop context. Counters and histograms are
+ * cumulative since boot (or the last reset from the host), so a lost
+ * packet only delays an update.
+ */
+
+#include "telemetry.h"
+#include "keystats.h"
+#include "boot_timing.h"
+#include "profiler.h"
+
+#if TELEMETRY_ENABLE
+
+#include "pico/time.h"
+#include <string.h>
+
+#if (TELEMETRY_TRACE_SIZE & (TELEMETRY_TRACE_SIZE - 1)) != 0
+#error TELEMETRY_TRACE_SIZE must be a power of two
+#endif
+
+#define HEADER_SIZE             4
+#define TRACE_PER_PACKET        ((TELEMETRY_REPORT_SIZE - HEADER_SIZE) / 4)
+#define KEYS_PER_PACKET         ((TELEMETRY_REPORT_SIZE - HEADER_SIZE) / 4)
+#define PROFILE_PER_PACKET      ((TELEMETRY_REPORT_SIZE - HEADER_SIZE - 8) / 8)
+
+// Packets still to send for the current interval
+#define DUE_COUNTERS            0x01
+#define DUE_LOOP_HIST           0x02
+#define DUE_LATENCY             0x04
+#define DUE_KEYS                0x08
+#define DUE_BOOT                0x10
+#define DUE_PROFILE             0x20
+
+#define DUE_ALL                 (DUE_COUNTERS | DUE_LOOP_HIST | DUE_LATENCY | DUE_BOOT | \
+                                 (KEYSTATS_ENABLE ? DUE_KEYS : 0) | \
+                                 (PROFILER_ENABLE ? DUE_PROFILE : 0))
+
+static uint32_t counters[TM_COUNTER_COUNT];
+static uint32_t loop_hist[TELEMETRY_HIST_BUCKETS];
+static uint32_t latency_hist[TELEMETRY_HIST_BUCKETS];
+
+// Trace ring: time_ms (16 bits) | event << 16 | data << 24
+// Sent entries stay readable until overwritten (see telemetry_trace_entry)
+static uint32_t trace[TELEMETRY_TRACE_SIZE];
+static uint32_t trace_written = 0;     // Entries ever written
+static uint32_t trace_sent = 0;        // Entries ever sent or dropped
+
+static uint32_t last_loop_us = 0;
+static uint32_t event_us = 0;          // First key event not yet reported
+static bool event_pending = false;
+
+static uint8_t sequence = 0;
+static uint8_t due = 0;
+static uint32_t interval_start_ms = 0;
+
+#if KEYSTATS_ENABLE
+static uint16_t keys_next = 0;          // First keycode of the next KEYS packet
+#endif
+
+#if PROFILER_ENABLE
+static uint16_t profile_next = 0;       // First slot of the next PROFILE packet
+#endif
+
+static inline uint32_t now_ms(void) {
+    return to_ms_since_boot(get_absolute_time());
+}
+
+static void histogram_add(uint32_t* hist, uint32_t us) {
+    // Bucket = bit length of the value
+    unsigned bucket = us ? 32 - (unsigned) __builtin_clz(us) : 0;
+    if (bucket >= TELEMETRY_HIST_BUCKETS) bucket = TELEMETRY_HIST_BUCKETS - 1;
+    hist[bucket]++;
+}
+
+static void put_u32(uint8_t* dst, uint32_t value) {
+    dst[0] = (uint8_t) value;
+    dst[1] = (uint8_t) (value >> 8);
+    dst[2] = (uint8_t) (value >> 16);
+    dst[3] = (uint8_t) (value >> 24);
+}
+
+static uint16_t packet(uint8_t* report, uint8_t type, uint8_t count,
+                       const uint32_t* values, uint8_t value_count) {
+    memset(report, 0, TELEMETRY_REPORT_SIZE);
+    report[0] = type;
+    report[1] = sequence++;
+    report[2] = count;
+    for (uint8_t i = 0; i < value_count; i++) {
+        put_u32(&report[HEADER_SIZE + 4 * i], values[i]);
+    }
+    return TELEMETRY_REPORT_SIZE;
+}
+
+//--------------------------------------------------------------------+
+// Recording
+//--------------------------------------------------------------------+
+
+void telemetry_init(void) {
+    memset(counters, 0, sizeof(counters));
+    memset(loop_hist, 0, sizeof(loop_hist));
+    memset(latency_hist, 0, sizeof(latency_hist));
+    trace_written = 0;
+    trace_sent = 0;
+    event_pending = false;
+    last_loop_us = time_us_32();
+    interval_start_ms = now_ms();
+    due = DUE_ALL;
+}
+
+void telemetry_count(telemetry_counter_t counter) {
+    counters[counter]++;
+}
+
+void telemetry_trace(telemetry_trace_t event, uint8_t data) {
+    if (trace_written - trace_sent == TELEMETRY_TRACE_SIZE) {
+        // Full - drop the oldest unsent entry
+        trace_sent++;
+        counters[TM_TRACE_DROPPED]++;
+    }
+
+    trace[trace_written & (TELEMETRY_TRACE_SIZE - 1)] =
+        (now_ms() & 0xFFFF) | ((uint32_t) event << 16) | ((uint32_t) data << 24);
+    trace_written++;
+}
+
+void telemetry_loop(void) {
+    uint32_t now_us = time_us_32();
+    histogram_add(loop_hist, now_us - last_loop_us);
+    last_loop_us = now_us;
+}
+
+void telemetry_key_event(void) {
+    counters[TM_KEY_EVENTS]++;
+    if (!event_pending) {
+        event_us = time_us_32();
+        event_pending = true;
+    }
+}
+
+void telemetry_report_sent(void) {
+    counters[TM_REPORTS_SENT]++;
+    if (event_pending) {
+        histogram_add(latency_hist, time_us_32() - event_us);
+        event_pending = false;
+    }
+}
+
+//--------------------------------------------------------------------+
+// Packets
+//--------------------------------------------------------------------+
+
+#if KEYSTATS_ENABLE
+// Next range of key counters with a press in it, one range per interval;
+// 0 if no key was pressed
+static uint16_t keys_packet(uint8_t* report) {
+    for (uint16_t tried = 0; tried < KEYSTATS_KEYS; tried += KEYS_PER_PACKET) {
+        uint16_t first = keys_next;
+        uint8_t n = (uint8_t) (KEYSTATS_KEYS - first < KEYS_PER_PACKET ?
+                               KEYSTATS_KEYS - first : KEYS_PER_PACKET);
+        keys_next = (first + n) % KEYSTATS_KEYS;
+
+        for (uint8_t i = 0; i < n; i++) {
+            if (keystats_counts[first + i]) {
+                packet(report, TELEMETRY_PKT_KEYS, n, &keystats_counts[first], n);
+                report[3] = (uint8_t) first;
+                return TELEMETRY_REPORT_SIZE;
+            }
+        }
+    }
+    return 0;
+}
+#endif
+
+#if PROFILER_ENABLE
+// Next PROFILE_PER_PACKET used slots of the profiler's table. A pass ends
+// with [3] = 1 (possibly with no entries); as counts only grow, the host
+// then has the whole histogram.
+static uint16_t profile_packet(uint8_t* report) {
+    uint32_t values[2 + 2 * PROFILE_PER_PACKET];
+    uint8_t n = 0;
+    while (profile_next < PROFILER_SLOTS && n < PROFILE_PER_PACKET) {
+        if (profiler_slot(profile_next++, &values[2 + 2 * n], &values[3 + 2 * n])) n++;
+    }
+    values[0] = profiler_samples();
+    values[1] = profiler_dropped();
+
+    packet(report, TELEMETRY_PKT_PROFILE, n, values, (uint8_t) (2 + 2 * n));
+    if (profile_next == PROFILER_SLOTS) {
+        profile_next = 0;
+        due &= (uint8_t) ~DUE_PROFILE;
+        report[3] = 1;
+    }
+    return TELEMETRY_REPORT_SIZE;
+}
+#endif
+
+uint16_t telemetry_counters_packet(uint8_t* report) {
+    uint32_t values[1 + TM_COUNTER_COUNT];
+    values[0] = now_ms();
+    memcpy(&values[1], counters, sizeof(counters));
+    return packet(report, TELEMETRY_PKT_COUNTERS, TM_COUNTER_COUNT,
+                  values, 1 + TM_COUNTER_COUNT);
+}
+
+uint16_t telemetry_next_packet(uint8_t* report) {
+    if (due == 0 && now_ms() - interval_start_ms >= TELEMETRY_INTERVAL_MS) {
+        interval_start_ms = now_ms();
+        due = DUE_ALL;
+    }
+
+    if (due & DUE_COUNTERS) {
+        due &= (uint8_t) ~DUE_COUNTERS;
+        return telemetry_counters_packet(report);
+    }
+    if (due & DUE_LOOP_HIST) {
+        due &= (uint8_t) ~DUE_LOOP_HIST;
+        return packet(report, TELEMETRY_PKT_LOOP_HIST, TELEMETRY_HIST_BUCKETS,
+                      loop_hist, TELEMETRY_HIST_BUCKETS);
+    }
+    if (due & DUE_LATENCY) {
+        due &= (uint8_t) ~DUE_LATENCY;
+        return packet(report, TELEMETRY_PKT_LATENCY, TELEMETRY_HIST_BUCKETS,
+                      latency_hist, TELEMETRY_HIST_BUCKETS);
+    }
+
+    if (due & DUE_BOOT) {
+        due &= (uint8_t) ~DUE_BOOT;
+        uint32_t values[BOOT_MARK_COUNT];
+        for (uint8_t mark = 0; mark < BOOT_MARK_COUNT; mark++) {
+            values[mark] = boot_timing_get((boot_mark_t) mark);
+        }
+        return packet(report, TELEMETRY_PKT_BOOT, BOOT_MARK_COUNT, values, BOOT_MARK_COUNT);
+    }
+
+#if KEYSTATS_ENABLE
+    if (due & DUE_KEYS) {
+        due &= (uint8_t) ~DUE_KEYS;
+        uint16_t length = keys_packet(report);
+        if (length) return length;
+    }
+#endif
+
+    if (trace_sent != trace_written) {
+        uint32_t chunk[TRACE_PER_PACKET];
+        uint8_t n = 0;
+        while (trace_sent != trace_written && n < TRACE_PER_PACKET) {
+            chunk[n++] = trace[trace_sent++ & (TELEMETRY_TRACE_SIZE - 1)];
+        }
+        return packet(report, TELEMETRY_PKT_TRACE, n, chunk, n);
+    }
+
+#if PROFILER_ENABLE
+    // Last: a pass over a full table takes many packets
+    if (due & DUE_PROFILE) return profile_packet(report);
+#endif
+    return 0;
+}
+
+//--------------------------------------------------------------------+
+// Local readers (debug console)
+//--------------------------------------------------------------------+
+
+uint32_t telemetry_counter(telemetry_counter_t counter) {
+    return counters[counter];
+}
+
+uint16_t telemetry_trace_count(void) {
+    return trace_written < TELEMETRY_TRACE_SIZE ? (uint16_t) trace_written : TELEMETRY_TRACE_SIZE;
+}
+
+uint32_t telemetry_trace_entry(uint16_t index) {
+    uint32_t first = trace_written - telemetry_trace_count();
+    return trace[(first + index) & (TELEMETRY_TRACE_SIZE - 1)];
+}
+
+#endif /* TELEMETRY_ENABLE */
@@ -0,0 +1,116 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * Telemetry Header
+ *
+ * Field diagnostics streamed over an optional vendor-defined HID interface
+ * (TELEMETRY_ENABLE), readable without a driver by tools/telemetry.py.
+ * Each IN report is one packet: event counters, main loop time and key
+ * latency histograms, a chunk of the event trace, in KEYSTATS_ENABLE
+ * builds a range of per-key press counters, or in PROFILER_ENABLE builds
+ * a run of the profiler's PC histogram. Packets are only sent while no
+ * keyboard report is waiting.
+ *
+ * With TELEMETRY_ENABLE 0 the recording hooks are empty inline functions.
+ */
+
+#ifndef TELEMETRY_H_
+#define TELEMETRY_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef TELEMETRY_ENABLE
+#define TELEMETRY_ENABLE        0
+#endif
+
+// Telemetry interface report size (IN packets)
+#define TELEMETRY_REPORT_SIZE   64
+
+// Counters and histograms are sent this often (ms)
+#ifndef TELEMETRY_INTERVAL_MS
+#define TELEMETRY_INTERVAL_MS   250
+#endif
+
+// Trace entries kept until sent (power of two)
+#ifndef TELEMETRY_TRACE_SIZE
+#define TELEMETRY_TRACE_SIZE    128
+#endif
+
+// Packet: [0] = type, [1] = sequence number, [2] = item count, [3] = 0
+// (first keycode for TELEMETRY_PKT_KEYS, 1 on the last packet of a pass
+// over the table for TELEMETRY_PKT_PROFILE), then little-endian payload.
+// Histogram bucket n counts values v with 2^(n-1) <= v < 2^n
+// microseconds (bucket 0: v = 0, last: everything above).
+#define TELEMETRY_PKT_COUNTERS  0x01    // u32 uptime_ms, then u32 per counter
+#define TELEMETRY_PKT_LOOP_HIST 0x02    // u32 per bucket: main loop pass time
+#define TELEMETRY_PKT_LATENCY   0x03    // u32 per bucket: scancode to report sent
+#define TELEMETRY_PKT_TRACE     0x04    // {u16 time_ms, u8 event, u8 data} per entry
+#define TELEMETRY_PKT_KEYS      0x05    // u32 presses per keycode, from [3] on
+#define TELEMETRY_PKT_BOOT      0x06    // u32 us per boot_mark_t (0 = not reached)
+#define TELEMETRY_PKT_PROFILE   0x07    // u32 samples, u32 dropped, {u32 pc, u32 count} per entry
+
+// OUT report (one byte): anything other than the profiler commands
+// resets the statistics
+#define TELEMETRY_CMD_RESET             0x01
+#define TELEMETRY_CMD_PROFILER_START    0x02
+#define TELEMETRY_CMD_PROFILER_STOP     0x03
+
+#define TELEMETRY_HIST_BUCKETS  15
+
+typedef enum {
+    TM_PS2_BYTES = 0,           // PS/2 frames received
+    TM_KEY_EVENTS,              // Make and break codes
+    TM_REPORTS_QUEUED,          // Keyboard reports queued
+    TM_REPORTS_SENT,            // Keyboard reports handed to the USB stack
+    TM_REPORTS_REPEATED,        // Idle rate repeats
+    TM_QUEUE_OVERRUNS,          // Reports merged because the queue was full
+    TM_USB_SUSPENDS,            // Bus suspends
+    TM_TRACE_DROPPED,           // Trace entries overwritten before being sent
+    TM_COUNTER_COUNT
+} telemetry_counter_t;
+
+typedef enum {
+    TRACE_PS2_BYTE = 1,         // data = byte received
+    TRACE_REPORT_SENT,          // data = first keycode (or modifiers)
+    TRACE_USB_MOUNT,
+    TRACE_USB_SUSPEND,
+    TRACE_USB_RESUME,
+    TRACE_PS2_BAT,              // data = self-test result (0xAA passed, 0xFC failed)
+    TRACE_WATCHDOG_RESET,       // At boot, data = main loop stage that hung
+} telemetry_trace_t;
+
+#if TELEMETRY_ENABLE
+
+// Clear counters, histograms and the trace
+void telemetry_init(void);
+
+// Recording hooks
+void telemetry_count(telemetry_counter_t counter);
+void telemetry_trace(telemetry_trace_t event, uint8_t data);
+void telemetry_loop(void);              // Once per main loop pass
+void telemetry_key_event(void);         // Scancode completed
+void telemetry_report_sent(void);       // Keyboard report handed to USB
+
+// Fill the next IN packet, returns its length or 0 if nothing is due
+uint16_t telemetry_next_packet(uint8_t* report);
+
+// Fill a counters packet (for GET_REPORT), returns its length
+uint16_t telemetry_counters_packet(uint8_t* report);
+
+// Read without consuming: a counter, the number of trace entries kept,
+// and entry index (0 = oldest) as time_ms | event << 16 | data << 24
+uint32_t telemetry_counter(telemetry_counter_t counter);
+uint16_t telemetry_trace_count(void);
+uint32_t telemetry_trace_entry(uint16_t index);
+
+#else
+
+static inline void telemetry_count(telemetry_counter_t counter) { (void) counter; }
+static inline void telemetry_trace(telemetry_trace_t event, uint8_t data) { (void) event; (void) data; }
+static inline void telemetry_loop(void) {}
+static inline void telemetry_key_event(void) {}
+static inline void telemetry_report_sent(void) {}
+
+#endif
+
+#endif /* TELEMETRY_H_ */
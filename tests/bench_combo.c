@@ -0,0 +1,81 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * Combo Matching Benchmark
+ *
+ * Built once per combo count with COMBO_DEFINITIONS naming a generated
+ * table of two-key combos over the letter, digit and symbol keys (see
+ * CMakeLists.txt). Random overlapping typing over the same keys is fed
+ * through combo_process() and the time per event is printed, so the cost
+ * can be compared across combo counts. Host timings only show the trend;
+ * the RP2040 is much slower in absolute terms.
+ */
+
+#include "test.h"
+#include "combo.h"
+#include <stdlib.h>
+#include <time.h>
+
+#ifndef BENCH_COMBOS
+#define BENCH_COMBOS            0
+#endif
+
+static uint32_t presses_out, releases_out;
+
+static void sink(uint8_t key, bool pressed, uint32_t time_ms) {
+    (void) key;
+    (void) time_ms;
+    if (pressed) presses_out++;
+    else releases_out++;
+}
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main(void) {
+    enum { EVENTS = 1 << 20, KEYS = 96 };
+    static uint8_t keys[EVENTS];
+    static bool pressed[EVENTS];
+    static uint32_t times[EVENTS];
+    bool down[KEYS] = { false };
+
+    // Up to two keys down at once, 5-40 ms apart
+    srand(1);
+    uint32_t t = 0;
+    int held = 0;
+    for (int i = 0; i < EVENTS; i++) {
+        int k = rand() % KEYS;
+        if (held >= 2 && !down[k]) {
+            while (!down[k]) k = (k + 1) % KEYS;
+        }
+        down[k] = !down[k];
+        held += down[k] ? 1 : -1;
+        t += 5 + rand() % 36;
+        keys[i] = (uint8_t) (4 + k);
+        pressed[i] = down[k];
+        times[i] = t;
+    }
+
+    combo_init(sink);
+    double start = now_ns();
+    for (int i = 0; i < EVENTS; i++) {
+        combo_process(keys[i], pressed[i], times[i]);
+        combo_task(times[i]);
+    }
+    double elapsed = now_ns() - start;
+
+    // Once every key is up, each press out has been matched by a release
+    for (int k = 0; k < KEYS; k++) {
+        if (down[k]) combo_process((uint8_t) (4 + k), false, t);
+    }
+    combo_task(t + COMBO_TERM_MS);
+
+    printf("  %4d combos: %6.1f ns per event (%u presses, %u releases out)\n",
+           BENCH_COMBOS, elapsed / EVENTS, presses_out, releases_out);
+    CHECK(!combo_pending());
+    CHECK(presses_out > 0);
+    CHECK_EQ(presses_out, releases_out);
+    return test_summary();
+}
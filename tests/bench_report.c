@@ -0,0 +1,166 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * Report Building Benchmark
+ *
+ * Times the work from a resolved key event to a report in the queue: four
+ * keys pressed and released through update_key_state() and
+ * queue_report_if_changed() in ps2.c (included here for its static
+ * functions), then the queue pop that follows the USB hand-over. The same
+ * events also go through a copy of the earlier byte-array version for
+ * comparison. Host cycle counts only show the difference between the two;
+ * Cortex-M0+ numbers need a board.
+ */
+
+#include "../ps2.c"
+#include "test.h"
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_UNIT              "cycles"
+static inline uint64_t bench_now(void) { return __rdtsc(); }
+#else
+#define BENCH_UNIT              "ns"
+static inline uint64_t bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+}
+#endif
+
+//--------------------------------------------------------------------+
+// Earlier Version: byte arrays, a changed flag, report built per queue
+//--------------------------------------------------------------------+
+
+static uint8_t old_modifiers;
+static uint8_t old_keys[6];
+static bool old_changed;
+static uint8_t old_queue[REPORT_QUEUE_DEPTH][REPORT_SIZE];
+static uint8_t old_head, old_count;
+
+static void old_press(uint8_t code) {
+    uint8_t mask = get_modifier_mask(code);
+    if (mask != 0) {
+        if (!(old_modifiers & mask)) {
+            old_modifiers |= mask;
+            old_changed = true;
+        }
+        return;
+    }
+    for (int i = 0; i < 6; i++) {
+        if (old_keys[i] == code) return;
+    }
+    for (int i = 0; i < 6; i++) {
+        if (old_keys[i] == 0) {
+            old_keys[i] = code;
+            old_changed = true;
+            return;
+        }
+    }
+}
+
+static void old_release(uint8_t code) {
+    uint8_t mask = get_modifier_mask(code);
+    if (mask != 0) {
+        if (old_modifiers & mask) {
+            old_modifiers &= (uint8_t) ~mask;
+            old_changed = true;
+        }
+        return;
+    }
+    for (int i = 0; i < 6; i++) {
+        if (old_keys[i] == code) {
+            old_keys[i] = 0;
+            old_changed = true;
+            return;
+        }
+    }
+}
+
+static void old_queue_report_if_changed(void) {
+    if (!old_changed) return;
+    uint8_t report[REPORT_SIZE];
+    report[0] = old_modifiers | g_injected_modifiers;
+    report[1] = 0;
+    memcpy(&report[2], old_keys, sizeof(old_keys));
+    for (int i = 0; i < 6; i++) {
+        uint8_t key = g_injected_keys[i];
+        if (key == 0 || memchr(&report[2], key, 6) != NULL) continue;
+        uint8_t* slot = memchr(&report[2], 0, 6);
+        if (slot == NULL) break;
+        *slot = key;
+    }
+    report_snapshot_publish(report);
+    if (old_count < REPORT_QUEUE_DEPTH) {
+        memcpy(old_queue[(old_head + old_count) & (REPORT_QUEUE_DEPTH - 1)], report, REPORT_SIZE);
+        old_count++;
+    }
+    old_changed = false;
+}
+
+static void old_pop(void) {
+    old_head = (old_head + 1) & (REPORT_QUEUE_DEPTH - 1);
+    old_count--;
+}
+
+//--------------------------------------------------------------------+
+// Benchmark
+//--------------------------------------------------------------------+
+
+static const uint8_t keys[4] = { HID_KEY_SHIFT_LEFT, HID_KEY_A, HID_KEY_S, HID_KEY_D };
+
+enum { ROUNDS = 1000000, REPORTS = ROUNDS * 8 };
+
+static double bench_current(void) {
+    uint64_t start = bench_now();
+    for (int r = 0; r < ROUNDS; r++) {
+        for (int i = 0; i < 8; i++) {
+            update_key_state(keys[i & 3], i < 4, 0);
+            queue_report_if_changed();
+            report_queue_pop();
+        }
+    }
+    return (double) (bench_now() - start) / REPORTS;
+}
+
+static double bench_old(void) {
+    uint64_t start = bench_now();
+    for (int r = 0; r < ROUNDS; r++) {
+        for (int i = 0; i < 8; i++) {
+            if (i < 4) old_press(keys[i & 3]);
+            else old_release(keys[i & 3]);
+            old_queue_report_if_changed();
+            old_pop();
+        }
+    }
+    return (double) (bench_now() - start) / REPORTS;
+}
+
+int main(void) {
+    mock_time_reset(10 * 1000 * 1000);
+    ps2_init();
+
+    // Both versions build the same reports
+    int same = 0;
+    for (int i = 0; i < 8; i++) {
+        update_key_state(keys[i & 3], i < 4, 0);
+        queue_report_if_changed();
+        if (i < 4) old_press(keys[i & 3]);
+        else old_release(keys[i & 3]);
+        old_queue_report_if_changed();
+        const uint8_t* report = report_queue_peek();
+        same += report != NULL && memcmp(report, old_queue[old_head], REPORT_SIZE) == 0;
+        report_queue_pop();
+        old_pop();
+    }
+    CHECK_EQ(same, 8);
+
+    double current = 1e30, old = 1e30;
+    for (int run = 0; run < 5; run++) {
+        double c = bench_current(), o = bench_old();
+        if (c < current) current = c;
+        if (o < old) old = o;
+    }
+    printf("  per report: %.1f %s now, %.1f %s with the earlier byte arrays (best of 5)\n",
+           current, BENCH_UNIT, old, BENCH_UNIT);
+    return test_summary();
+}
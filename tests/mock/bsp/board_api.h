@@ -0,0 +1,15 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * Board API Stand-in for Host Tests
+ */
+
+#ifndef MOCK_BOARD_API_H_
+#define MOCK_BOARD_API_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Serial number string in UTF-16, returns its length in characters
+size_t board_usb_get_serial(uint16_t desc_str[], size_t max_chars);
+
+#endif /* MOCK_BOARD_API_H_ */
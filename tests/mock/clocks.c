@@ -0,0 +1,53 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * Clocks and Regulator Stand-in for Host Tests
+ */
+
+#include "hardware/clocks.h"
+#include "hardware/vreg.h"
+#include "pico/time.h"
+#include <string.h>
+
+uint32_t mock_clock_hz[CLK_COUNT];
+uint32_t mock_voltage;
+mock_clocks_entry_t mock_clocks_log[MOCK_CLOCKS_LOG_SIZE];
+int mock_clocks_log_count;
+
+static void log_event(mock_clocks_event_t event, uint32_t target, uint32_t value) {
+    if (mock_clocks_log_count < MOCK_CLOCKS_LOG_SIZE) {
+        mock_clocks_entry_t* e = &mock_clocks_log[mock_clocks_log_count++];
+        e->event = event;
+        e->target = target;
+        e->value = value;
+        e->time_us = time_us_32();
+    }
+}
+
+void mock_clocks_reset(uint32_t sys_hz) {
+    memset(mock_clock_hz, 0, sizeof(mock_clock_hz));
+    mock_clock_hz[clk_ref] = 12 * MHZ;
+    mock_clock_hz[clk_sys] = sys_hz;
+    mock_clock_hz[clk_peri] = sys_hz;
+    mock_clock_hz[clk_usb] = 48 * MHZ;
+    mock_voltage = VREG_VOLTAGE_DEFAULT;
+    mock_clocks_log_count = 0;
+}
+
+bool clock_configure(enum clock_index clk_index, uint32_t src, uint32_t auxsrc,
+                     uint32_t src_freq, uint32_t freq) {
+    (void) src;
+    (void) auxsrc;
+    if (freq > src_freq) return false;
+    mock_clock_hz[clk_index] = freq;
+    log_event(MOCK_SET_CLOCK, clk_index, freq);
+    return true;
+}
+
+uint32_t clock_get_hz(enum clock_index clk_index) {
+    return mock_clock_hz[clk_index];
+}
+
+void vreg_set_voltage(enum vreg_voltage voltage) {
+    mock_voltage = voltage;
+    log_event(MOCK_SET_VOLTAGE, 0, voltage);
+}
@@ -0,0 +1,11 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * GPIO Stand-in for Host Tests
+ */
+
+#include "hardware/gpio.h"
+
+bool mock_gpio_line[MOCK_GPIO_PINS];
+bool mock_gpio_out[MOCK_GPIO_PINS];
+bool mock_gpio_dir[MOCK_GPIO_PINS];
+uint32_t mock_gpio_held_low[MOCK_GPIO_PINS];
@@ -0,0 +1,54 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * Clocks and Regulator Stand-in for Host Tests
+ *
+ * clock_configure() and vreg_set_voltage() (hardware/vreg.h) only record
+ * the setting in one log, in call order, so a test can check the order
+ * in which clock and voltage change.
+ */
+
+#ifndef MOCK_HARDWARE_CLOCKS_H_
+#define MOCK_HARDWARE_CLOCKS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define MHZ                     1000000u
+#define MOCK_CLOCKS_LOG_SIZE    64
+
+enum clock_index {
+    clk_gpout0 = 0, clk_gpout1, clk_gpout2, clk_gpout3,
+    clk_ref, clk_sys, clk_peri, clk_usb, clk_adc, clk_rtc,
+    CLK_COUNT
+};
+
+#define CLOCKS_CLK_SYS_CTRL_SRC_VALUE_CLKSRC_CLK_SYS_AUX    1
+#define CLOCKS_CLK_SYS_CTRL_AUXSRC_VALUE_CLKSRC_PLL_SYS     0
+#define CLOCKS_CLK_PERI_CTRL_AUXSRC_VALUE_CLKSRC_PLL_USB    2
+
+typedef enum {
+    MOCK_SET_CLOCK = 0,         // clock_configure(): clock, frequency
+    MOCK_SET_VOLTAGE,           // vreg_set_voltage(): voltage
+} mock_clocks_event_t;
+
+typedef struct {
+    mock_clocks_event_t event;
+    uint32_t target;            // Clock index, 0 for the regulator
+    uint32_t value;             // Hz or VREG_VOLTAGE_* value
+    uint32_t time_us;
+} mock_clocks_entry_t;
+
+extern uint32_t mock_clock_hz[CLK_COUNT];
+extern uint32_t mock_voltage;
+extern mock_clocks_entry_t mock_clocks_log[MOCK_CLOCKS_LOG_SIZE];
+extern int mock_clocks_log_count;
+
+// Clocks as the SDK leaves them at sys_hz, default voltage, empty log
+void mock_clocks_reset(uint32_t sys_hz);
+
+// Pico SDK API
+bool clock_configure(enum clock_index clk_index, uint32_t src, uint32_t auxsrc,
+                     uint32_t src_freq, uint32_t freq);
+uint32_t clock_get_hz(enum clock_index clk_index);
+
+#endif /* MOCK_HARDWARE_CLOCKS_H_ */
@@ -0,0 +1,48 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * GPIO Stand-in for Host Tests
+ *
+ * Open-drain lines with pull-ups, as the PS/2 bus is wired: a pin reads
+ * low if the test drives it low (mock_gpio_line) or the firmware does
+ * (output set to 0).
+ */
+
+#ifndef MOCK_HARDWARE_GPIO_H_
+#define MOCK_HARDWARE_GPIO_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define GPIO_IN                 false
+#define GPIO_OUT                true
+#define MOCK_GPIO_PINS          30
+
+extern bool mock_gpio_line[MOCK_GPIO_PINS];     // Level driven by the other side
+extern bool mock_gpio_out[MOCK_GPIO_PINS];      // Firmware output level
+extern bool mock_gpio_dir[MOCK_GPIO_PINS];      // Firmware direction
+extern uint32_t mock_gpio_held_low[MOCK_GPIO_PINS];  // Times the firmware pulled low
+
+static inline void gpio_init(unsigned pin) {
+    mock_gpio_dir[pin] = GPIO_IN;
+    mock_gpio_out[pin] = false;
+    mock_gpio_line[pin] = true;
+}
+
+static inline void gpio_pull_up(unsigned pin) {
+    (void) pin;
+}
+
+static inline void gpio_set_dir(unsigned pin, bool out) {
+    if (out && !mock_gpio_dir[pin] && !mock_gpio_out[pin]) mock_gpio_held_low[pin]++;
+    mock_gpio_dir[pin] = out;
+}
+
+static inline void gpio_put(unsigned pin, bool value) {
+    mock_gpio_out[pin] = value;
+}
+
+static inline bool gpio_get(unsigned pin) {
+    return mock_gpio_line[pin] && !(mock_gpio_dir[pin] == GPIO_OUT && !mock_gpio_out[pin]);
+}
+
+#endif /* MOCK_HARDWARE_GPIO_H_ */
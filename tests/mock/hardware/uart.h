@@ -0,0 +1,9 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * UART Stand-in for Host Tests (no default UART)
+ */
+
+#ifndef MOCK_HARDWARE_UART_H_
+#define MOCK_HARDWARE_UART_H_
+
+#endif /* MOCK_HARDWARE_UART_H_ */
@@ -0,0 +1,21 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * Voltage Regulator Stand-in for Host Tests (logged with the clocks)
+ */
+
+#ifndef MOCK_HARDWARE_VREG_H_
+#define MOCK_HARDWARE_VREG_H_
+
+#include "hardware/clocks.h"
+
+enum vreg_voltage {
+    VREG_VOLTAGE_0_95 = 0b01110,
+    VREG_VOLTAGE_1_00 = 0b01111,
+    VREG_VOLTAGE_1_05 = 0b10000,
+    VREG_VOLTAGE_1_10 = 0b10001,
+    VREG_VOLTAGE_DEFAULT = VREG_VOLTAGE_1_10,
+};
+
+void vreg_set_voltage(enum vreg_voltage voltage);
+
+#endif /* MOCK_HARDWARE_VREG_H_ */
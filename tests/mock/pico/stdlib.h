@@ -0,0 +1,18 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * Pico SDK stdlib Stand-in for Host Tests
+ */
+
+#ifndef MOCK_PICO_STDLIB_H_
+#define MOCK_PICO_STDLIB_H_
+
+#include "pico/time.h"
+
+#define __not_in_flash_func(func)   func
+#define __not_in_flash(group)
+
+static inline void busy_wait_us(uint64_t us) {
+    mock_time_advance_us(us);
+}
+
+#endif /* MOCK_PICO_STDLIB_H_ */
@@ -0,0 +1,49 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * Pico SDK Time Stand-in for Host Tests
+ *
+ * A simulated microsecond clock that only moves when the test advances it.
+ * Alarms fire in time order as the clock passes them, and are rescheduled
+ * from their callback's return value as the SDK does.
+ */
+
+#ifndef MOCK_PICO_TIME_H_
+#define MOCK_PICO_TIME_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef uint64_t absolute_time_t;
+typedef int32_t alarm_id_t;
+typedef int64_t (*alarm_callback_t)(alarm_id_t id, void* user_data);
+
+extern uint64_t mock_time_us;
+
+// Move the clock forward by us, firing alarms that fall due on the way
+void mock_time_advance_us(uint64_t us);
+
+// Forget all alarms and restart the clock at start_us
+void mock_time_reset(uint64_t start_us);
+
+// Pico SDK API
+static inline absolute_time_t get_absolute_time(void) {
+    return mock_time_us;
+}
+
+static inline uint32_t to_ms_since_boot(absolute_time_t t) {
+    return (uint32_t) (t / 1000);
+}
+
+static inline uint32_t time_us_32(void) {
+    return (uint32_t) mock_time_us;
+}
+
+static inline uint64_t time_us_64(void) {
+    return mock_time_us;
+}
+
+alarm_id_t add_alarm_in_us(uint64_t us, alarm_callback_t callback, void* user_data, bool fire_if_past);
+bool cancel_alarm(alarm_id_t id);
+
+#endif /* MOCK_PICO_TIME_H_ */
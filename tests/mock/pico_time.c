@@ -0,0 +1,80 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * Pico SDK Time Stand-in for Host Tests
+ */
+
+#include "pico/time.h"
+#include <string.h>
+
+#define MAX_ALARMS              8
+
+typedef struct {
+    alarm_id_t id;              // 0 = free
+    uint64_t target_us;
+    alarm_callback_t callback;
+    void* user_data;
+} mock_alarm_t;
+
+uint64_t mock_time_us = 0;
+
+static mock_alarm_t alarms[MAX_ALARMS];
+static alarm_id_t next_id = 1;
+
+void mock_time_reset(uint64_t start_us) {
+    memset(alarms, 0, sizeof(alarms));
+    mock_time_us = start_us;
+}
+
+alarm_id_t add_alarm_in_us(uint64_t us, alarm_callback_t callback, void* user_data, bool fire_if_past) {
+    (void) fire_if_past;
+    for (int i = 0; i < MAX_ALARMS; i++) {
+        if (alarms[i].id == 0) {
+            alarms[i] = (mock_alarm_t) { next_id++, mock_time_us + us, callback, user_data };
+            return alarms[i].id;
+        }
+    }
+    return -1;
+}
+
+bool cancel_alarm(alarm_id_t id) {
+    for (int i = 0; i < MAX_ALARMS; i++) {
+        if (alarms[i].id == id && id != 0) {
+            alarms[i].id = 0;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Earliest alarm due at or before limit_us, or NULL
+static mock_alarm_t* next_due(uint64_t limit_us) {
+    mock_alarm_t* next = NULL;
+    for (int i = 0; i < MAX_ALARMS; i++) {
+        if (alarms[i].id != 0 && alarms[i].target_us <= limit_us &&
+            (next == NULL || alarms[i].target_us < next->target_us)) {
+            next = &alarms[i];
+        }
+    }
+    return next;
+}
+
+void mock_time_advance_us(uint64_t us) {
+    uint64_t end_us = mock_time_us + us;
+    mock_alarm_t* alarm;
+
+    while ((alarm = next_due(end_us)) != NULL) {
+        mock_time_us = alarm->target_us;
+        int64_t ret = alarm->callback(alarm->id, alarm->user_data);
+
+        // < 0: again that long after this firing's target time
+        // > 0: again that long from now; 0: done
+        if (ret < 0) {
+            alarm->target_us += (uint64_t) -ret;
+        } else if (ret > 0) {
+            alarm->target_us = mock_time_us + (uint64_t) ret;
+        } else {
+            alarm->id = 0;
+        }
+    }
+    mock_time_us = end_us;
+}
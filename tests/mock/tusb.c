@@ -0,0 +1,56 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * TinyUSB Stand-in for Host Tests
+ */
+
+#include "tusb.h"
+#include <string.h>
+
+uint32_t mock_now_ms = 0;
+bool mock_usb_mounted = true;
+mock_report_t mock_usb_log[MOCK_USB_LOG_SIZE];
+int mock_usb_log_count = 0;
+
+static mock_report_t in_flight[MOCK_USB_INSTANCES];
+static bool busy[MOCK_USB_INSTANCES];
+
+void mock_usb_reset(void) {
+    memset(busy, 0, sizeof(busy));
+    mock_usb_log_count = 0;
+    mock_usb_mounted = true;
+}
+
+bool mock_usb_poll(uint8_t instance) {
+    if (!busy[instance]) return false;
+    busy[instance] = false;
+
+    in_flight[instance].time_ms = mock_now_ms;
+    if (mock_usb_log_count < MOCK_USB_LOG_SIZE) {
+        mock_usb_log[mock_usb_log_count++] = in_flight[instance];
+    }
+    return true;
+}
+
+bool tud_mounted(void) {
+    return mock_usb_mounted;
+}
+
+bool tud_suspended(void) {
+    return false;
+}
+
+bool tud_hid_n_ready(uint8_t instance) {
+    return mock_usb_mounted && instance < MOCK_USB_INSTANCES && !busy[instance];
+}
+
+bool tud_hid_n_report(uint8_t instance, uint8_t report_id, void const* report, uint16_t len) {
+    if (!tud_hid_n_ready(instance) || len > sizeof(in_flight[0].data)) return false;
+
+    mock_report_t* r = &in_flight[instance];
+    r->instance = instance;
+    r->report_id = report_id;
+    r->len = len;
+    memcpy(r->data, report, len);
+    busy[instance] = true;
+    return true;
+}
@@ -0,0 +1,62 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * TinyUSB Stand-in for Host Tests
+ *
+ * Just the HID device calls the firmware makes, and the descriptor macros
+ * (tusb_descriptors.h). An interface's IN endpoint takes one report and
+ * stays busy until the test polls it as the host would (mock_usb_poll),
+ * which logs the report with the mock clock.
+ */
+
+#ifndef MOCK_TUSB_H_
+#define MOCK_TUSB_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// The firmware's own configuration, as the real tusb.h includes it
+#define OPT_MCU_NONE            0
+#define OPT_OS_NONE             1
+#define OPT_MODE_DEFAULT_SPEED  0
+#define CFG_TUSB_MCU            OPT_MCU_NONE
+#include "tusb_config.h"
+#include "tusb_descriptors.h"
+
+#define MOCK_USB_INSTANCES      4
+#define MOCK_USB_LOG_SIZE       1024
+
+typedef struct {
+    uint8_t instance;
+    uint8_t report_id;
+    uint16_t len;
+    uint32_t time_ms;           // mock_now_ms when the host read it
+    uint8_t data[64];
+} mock_report_t;
+
+extern uint32_t mock_now_ms;
+extern bool mock_usb_mounted;
+extern mock_report_t mock_usb_log[MOCK_USB_LOG_SIZE];
+extern int mock_usb_log_count;
+
+// Empty the endpoints and the log, mounted
+void mock_usb_reset(void);
+
+// The host reads the instance's endpoint: a waiting report is logged and
+// the endpoint is free again. Returns true if there was a report.
+bool mock_usb_poll(uint8_t instance);
+
+// TinyUSB device API
+bool tud_mounted(void);
+bool tud_suspended(void);
+bool tud_hid_n_ready(uint8_t instance);
+bool tud_hid_n_report(uint8_t instance, uint8_t report_id, void const* report, uint16_t len);
+
+static inline bool tud_hid_ready(void) {
+    return tud_hid_n_ready(0);
+}
+
+static inline bool tud_hid_report(uint8_t report_id, void const* report, uint16_t len) {
+    return tud_hid_n_report(0, report_id, report, len);
+}
+
+#endif /* MOCK_TUSB_H_ */
@@ -0,0 +1,284 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * TinyUSB Descriptor Stand-in for Host Tests
+ *
+ * The descriptor types, constants and builder macros usb_descriptors.c
+ * uses, laid out byte for byte as TinyUSB's (tusb_types.h, usbd.h,
+ * class/hid/hid.h and hid_device.h). Included by the stand-in tusb.h.
+ */
+
+#ifndef MOCK_TUSB_DESCRIPTORS_H_
+#define MOCK_TUSB_DESCRIPTORS_H_
+
+#include <stdint.h>
+
+#define TU_ARRAY_SIZE(a)                (sizeof(a) / sizeof(a[0]))
+#define TU_BIT(n)                       (1UL << (n))
+#define TU_VERIFY_STATIC                _Static_assert
+#define TU_U16_LOW(u16)                 ((uint8_t) ((u16) & 0x00ff))
+#define TU_U16_HIGH(u16)                ((uint8_t) (((u16) >> 8) & 0x00ff))
+#define U16_TO_U8S_LE(u16)              TU_U16_LOW(u16), TU_U16_HIGH(u16)
+
+#define TUD_OPT_HIGH_SPEED              0
+
+//--------------------------------------------------------------------+
+// Standard descriptors
+//--------------------------------------------------------------------+
+
+enum {
+    TUSB_DESC_DEVICE = 0x01,
+    TUSB_DESC_CONFIGURATION = 0x02,
+    TUSB_DESC_STRING = 0x03,
+    TUSB_DESC_INTERFACE = 0x04,
+    TUSB_DESC_ENDPOINT = 0x05,
+    TUSB_DESC_DEVICE_QUALIFIER = 0x06,
+    TUSB_DESC_OTHER_SPEED_CONFIG = 0x07,
+    TUSB_DESC_INTERFACE_ASSOCIATION = 0x0B,
+    TUSB_DESC_CS_INTERFACE = 0x24,
+};
+
+enum {
+    TUSB_XFER_CONTROL = 0,
+    TUSB_XFER_ISOCHRONOUS,
+    TUSB_XFER_BULK,
+    TUSB_XFER_INTERRUPT,
+};
+
+enum {
+    TUSB_CLASS_CDC = 2,
+    TUSB_CLASS_HID = 3,
+    TUSB_CLASS_CDC_DATA = 10,
+    TUSB_CLASS_MISC = 0xEF,
+};
+
+enum {
+    MISC_SUBCLASS_COMMON = 2,
+    MISC_PROTOCOL_IAD = 1,
+};
+
+#define TUSB_DESC_CONFIG_ATT_REMOTE_WAKEUP  TU_BIT(5)
+
+typedef struct __attribute__((packed)) {
+    uint8_t bLength;
+    uint8_t bDescriptorType;
+    uint16_t bcdUSB;
+    uint8_t bDeviceClass;
+    uint8_t bDeviceSubClass;
+    uint8_t bDeviceProtocol;
+    uint8_t bMaxPacketSize0;
+    uint16_t idVendor;
+    uint16_t idProduct;
+    uint16_t bcdDevice;
+    uint8_t iManufacturer;
+    uint8_t iProduct;
+    uint8_t iSerialNumber;
+    uint8_t bNumConfigurations;
+} tusb_desc_device_t;
+
+#define TUD_CONFIG_DESC_LEN             (9)
+
+#define TUD_CONFIG_DESCRIPTOR(config_num, _itfcount, _stridx, _total_len, _attribute, _power_ma) \
+    9, TUSB_DESC_CONFIGURATION, U16_TO_U8S_LE(_total_len), _itfcount, config_num, _stridx, \
+    TU_BIT(7) | _attribute, (_power_ma) / 2
+
+//--------------------------------------------------------------------+
+// HID
+//--------------------------------------------------------------------+
+
+enum {
+    HID_SUBCLASS_NONE = 0,
+    HID_SUBCLASS_BOOT = 1,
+};
+
+enum {
+    HID_ITF_PROTOCOL_NONE = 0,
+    HID_ITF_PROTOCOL_KEYBOARD = 1,
+    HID_ITF_PROTOCOL_MOUSE = 2,
+};
+
+enum {
+    HID_DESC_TYPE_HID = 0x21,
+    HID_DESC_TYPE_REPORT = 0x22,
+};
+
+typedef enum {
+    HID_REPORT_TYPE_INVALID = 0,
+    HID_REPORT_TYPE_INPUT,
+    HID_REPORT_TYPE_OUTPUT,
+    HID_REPORT_TYPE_FEATURE,
+} hid_report_type_t;
+
+#define TUD_HID_DESC_LEN                (9 + 9 + 7)
+
+#define TUD_HID_DESCRIPTOR(_itfnum, _stridx, _boot_protocol, _report_desc_len, _epin, _epsize, _ep_interval) \
+    9, TUSB_DESC_INTERFACE, _itfnum, 0, 1, TUSB_CLASS_HID, \
+    (uint8_t) ((_boot_protocol) ? (uint8_t) HID_SUBCLASS_BOOT : 0), _boot_protocol, _stridx, \
+    9, HID_DESC_TYPE_HID, U16_TO_U8S_LE(0x0111), 0, 1, HID_DESC_TYPE_REPORT, U16_TO_U8S_LE(_report_desc_len), \
+    7, TUSB_DESC_ENDPOINT, _epin, TUSB_XFER_INTERRUPT, U16_TO_U8S_LE(_epsize), _ep_interval
+
+#define TUD_HID_INOUT_DESC_LEN          (9 + 9 + 7 + 7)
+
+#define TUD_HID_INOUT_DESCRIPTOR(_itfnum, _stridx, _boot_protocol, _report_desc_len, _epout, _epin, _epsize, _ep_interval) \
+    9, TUSB_DESC_INTERFACE, _itfnum, 0, 2, TUSB_CLASS_HID, \
+    (uint8_t) ((_boot_protocol) ? (uint8_t) HID_SUBCLASS_BOOT : 0), _boot_protocol, _stridx, \
+    9, HID_DESC_TYPE_HID, U16_TO_U8S_LE(0x0111), 0, 1, HID_DESC_TYPE_REPORT, U16_TO_U8S_LE(_report_desc_len), \
+    7, TUSB_DESC_ENDPOINT, _epout, TUSB_XFER_INTERRUPT, U16_TO_U8S_LE(_epsize), _ep_interval, \
+    7, TUSB_DESC_ENDPOINT, _epin, TUSB_XFER_INTERRUPT, U16_TO_U8S_LE(_epsize), _ep_interval
+
+// Report descriptor short items: prefix (tag, type, size code), then data
+#define HID_REPORT_DATA_0(data)
+#define HID_REPORT_DATA_1(data)         , (data)
+#define HID_REPORT_DATA_2(data)         , U16_TO_U8S_LE(data)
+#define HID_REPORT_ITEM(data, tag, type, size) \
+    (((tag) << 4) | ((type) << 2) | (size)) HID_REPORT_DATA_##size(data)
+
+#define RI_TYPE_MAIN                    0
+#define RI_TYPE_GLOBAL                  1
+#define RI_TYPE_LOCAL                   2
+
+#define HID_DATA                        (0 << 0)
+#define HID_CONSTANT                    (1 << 0)
+#define HID_ARRAY                       (0 << 1)
+#define HID_VARIABLE                    (1 << 1)
+#define HID_ABSOLUTE                    (0 << 2)
+
+#define HID_INPUT(x)                    HID_REPORT_ITEM(x, 8, RI_TYPE_MAIN, 1)
+#define HID_OUTPUT(x)                   HID_REPORT_ITEM(x, 9, RI_TYPE_MAIN, 1)
+#define HID_COLLECTION(x)               HID_REPORT_ITEM(x, 10, RI_TYPE_MAIN, 1)
+#define HID_FEATURE(x)                  HID_REPORT_ITEM(x, 11, RI_TYPE_MAIN, 1)
+#define HID_COLLECTION_END              HID_REPORT_ITEM(x, 12, RI_TYPE_MAIN, 0)
+
+#define HID_USAGE_PAGE(x)               HID_REPORT_ITEM(x, 0, RI_TYPE_GLOBAL, 1)
+#define HID_USAGE_PAGE_N(x, n)          HID_REPORT_ITEM(x, 0, RI_TYPE_GLOBAL, n)
+#define HID_LOGICAL_MIN(x)              HID_REPORT_ITEM(x, 1, RI_TYPE_GLOBAL, 1)
+#define HID_LOGICAL_MAX(x)              HID_REPORT_ITEM(x, 2, RI_TYPE_GLOBAL, 1)
+#define HID_LOGICAL_MAX_N(x, n)         HID_REPORT_ITEM(x, 2, RI_TYPE_GLOBAL, n)
+#define HID_REPORT_SIZE(x)              HID_REPORT_ITEM(x, 7, RI_TYPE_GLOBAL, 1)
+#define HID_REPORT_ID(x)                HID_REPORT_ITEM(x, 8, RI_TYPE_GLOBAL, 1),
+#define HID_REPORT_COUNT(x)             HID_REPORT_ITEM(x, 9, RI_TYPE_GLOBAL, 1)
+
+#define HID_USAGE(x)                    HID_REPORT_ITEM(x, 0, RI_TYPE_LOCAL, 1)
+#define HID_USAGE_MIN(x)                HID_REPORT_ITEM(x, 1, RI_TYPE_LOCAL, 1)
+#define HID_USAGE_MAX(x)                HID_REPORT_ITEM(x, 2, RI_TYPE_LOCAL, 1)
+#define HID_USAGE_MAX_N(x, n)           HID_REPORT_ITEM(x, 2, RI_TYPE_LOCAL, n)
+
+#define HID_COLLECTION_APPLICATION      1
+
+#define HID_USAGE_PAGE_DESKTOP          0x01
+#define HID_USAGE_PAGE_KEYBOARD         0x07
+#define HID_USAGE_PAGE_LED              0x08
+#define HID_USAGE_PAGE_CONSUMER         0x0C
+#define HID_USAGE_PAGE_VENDOR           0xFF00
+
+#define HID_USAGE_DESKTOP_KEYBOARD      0x06
+#define HID_USAGE_DESKTOP_SYSTEM_CONTROL    0x80
+#define HID_USAGE_DESKTOP_SYSTEM_POWER_DOWN 0x81
+#define HID_USAGE_DESKTOP_SYSTEM_SLEEP      0x82
+#define HID_USAGE_DESKTOP_SYSTEM_WAKE_UP    0x83
+#define HID_USAGE_CONSUMER_CONTROL      0x01
+
+#define TUD_HID_REPORT_DESC_KEYBOARD(...) \
+    HID_USAGE_PAGE ( HID_USAGE_PAGE_DESKTOP ), \
+    HID_USAGE ( HID_USAGE_DESKTOP_KEYBOARD ), \
+    HID_COLLECTION ( HID_COLLECTION_APPLICATION ), \
+        __VA_ARGS__ \
+        HID_USAGE_PAGE ( HID_USAGE_PAGE_KEYBOARD ), \
+        HID_USAGE_MIN ( 224 ), \
+        HID_USAGE_MAX ( 231 ), \
+        HID_LOGICAL_MIN ( 0 ), \
+        HID_LOGICAL_MAX ( 1 ), \
+        HID_REPORT_COUNT ( 8 ), \
+        HID_REPORT_SIZE ( 1 ), \
+        HID_INPUT ( HID_DATA | HID_VARIABLE | HID_ABSOLUTE ), \
+        HID_REPORT_COUNT ( 1 ), \
+        HID_REPORT_SIZE ( 8 ), \
+        HID_INPUT ( HID_CONSTANT ), \
+        HID_USAGE_PAGE ( HID_USAGE_PAGE_LED ), \
+        HID_USAGE_MIN ( 1 ), \
+        HID_USAGE_MAX ( 5 ), \
+        HID_REPORT_COUNT ( 5 ), \
+        HID_REPORT_SIZE ( 1 ), \
+        HID_OUTPUT ( HID_DATA | HID_VARIABLE | HID_ABSOLUTE ), \
+        HID_REPORT_COUNT ( 1 ), \
+        HID_REPORT_SIZE ( 3 ), \
+        HID_OUTPUT ( HID_CONSTANT ), \
+        HID_USAGE_PAGE ( HID_USAGE_PAGE_KEYBOARD ), \
+        HID_USAGE_MIN ( 0 ), \
+        HID_USAGE_MAX_N ( 255, 2 ), \
+        HID_LOGICAL_MIN ( 0 ), \
+        HID_LOGICAL_MAX_N ( 255, 2 ), \
+        HID_REPORT_COUNT ( 6 ), \
+        HID_REPORT_SIZE ( 8 ), \
+        HID_INPUT ( HID_DATA | HID_ARRAY | HID_ABSOLUTE ), \
+    HID_COLLECTION_END
+
+#define TUD_HID_REPORT_DESC_CONSUMER(...) \
+    HID_USAGE_PAGE ( HID_USAGE_PAGE_CONSUMER ), \
+    HID_USAGE ( HID_USAGE_CONSUMER_CONTROL ), \
+    HID_COLLECTION ( HID_COLLECTION_APPLICATION ), \
+        __VA_ARGS__ \
+        HID_LOGICAL_MIN ( 0x00 ), \
+        HID_LOGICAL_MAX_N ( 0x03FF, 2 ), \
+        HID_USAGE_MIN ( 0x00 ), \
+        HID_USAGE_MAX_N ( 0x03FF, 2 ), \
+        HID_REPORT_COUNT ( 1 ), \
+        HID_REPORT_SIZE ( 16 ), \
+        HID_INPUT ( HID_DATA | HID_ARRAY | HID_ABSOLUTE ), \
+    HID_COLLECTION_END
+
+#define TUD_HID_REPORT_DESC_SYSTEM_CONTROL(...) \
+    HID_USAGE_PAGE ( HID_USAGE_PAGE_DESKTOP ), \
+    HID_USAGE ( HID_USAGE_DESKTOP_SYSTEM_CONTROL ), \
+    HID_COLLECTION ( HID_COLLECTION_APPLICATION ), \
+        __VA_ARGS__ \
+        HID_LOGICAL_MIN ( 1 ), \
+        HID_LOGICAL_MAX ( 3 ), \
+        HID_REPORT_COUNT ( 1 ), \
+        HID_REPORT_SIZE ( 2 ), \
+        HID_USAGE ( HID_USAGE_DESKTOP_SYSTEM_POWER_DOWN ), \
+        HID_USAGE ( HID_USAGE_DESKTOP_SYSTEM_SLEEP ), \
+        HID_USAGE ( HID_USAGE_DESKTOP_SYSTEM_WAKE_UP ), \
+        HID_INPUT ( HID_DATA | HID_ARRAY | HID_ABSOLUTE ), \
+        HID_REPORT_COUNT ( 1 ), \
+        HID_REPORT_SIZE ( 6 ), \
+        HID_INPUT ( HID_CONSTANT ), \
+    HID_COLLECTION_END
+
+#define TUD_HID_REPORT_DESC_GENERIC_INOUT(report_size, ...) \
+    HID_USAGE_PAGE_N ( HID_USAGE_PAGE_VENDOR, 2 ), \
+    HID_USAGE ( 0x01 ), \
+    HID_COLLECTION ( HID_COLLECTION_APPLICATION ), \
+        __VA_ARGS__ \
+        HID_USAGE ( 0x02 ), \
+        HID_LOGICAL_MIN ( 0x00 ), \
+        HID_LOGICAL_MAX_N ( 0xff, 2 ), \
+        HID_REPORT_SIZE ( 8 ), \
+        HID_REPORT_COUNT ( report_size ), \
+        HID_INPUT ( HID_DATA | HID_VARIABLE | HID_ABSOLUTE ), \
+        HID_USAGE ( 0x03 ), \
+        HID_LOGICAL_MIN ( 0x00 ), \
+        HID_LOGICAL_MAX_N ( 0xff, 2 ), \
+        HID_REPORT_SIZE ( 8 ), \
+        HID_REPORT_COUNT ( report_size ), \
+        HID_OUTPUT ( HID_DATA | HID_VARIABLE | HID_ABSOLUTE ), \
+    HID_COLLECTION_END
+
+//--------------------------------------------------------------------+
+// CDC
+//--------------------------------------------------------------------+
+
+#define TUD_CDC_DESC_LEN                (8 + 9 + 5 + 5 + 4 + 5 + 7 + 9 + 7 + 7)
+
+#define TUD_CDC_DESCRIPTOR(_itfnum, _stridx, _ep_notif, _ep_notif_size, _epout, _epin, _epsize) \
+    8, TUSB_DESC_INTERFACE_ASSOCIATION, _itfnum, 2, TUSB_CLASS_CDC, 2, 0, 0, \
+    9, TUSB_DESC_INTERFACE, _itfnum, 0, 1, TUSB_CLASS_CDC, 2, 0, _stridx, \
+    5, TUSB_DESC_CS_INTERFACE, 0x00, U16_TO_U8S_LE(0x0120), \
+    5, TUSB_DESC_CS_INTERFACE, 0x01, 0, (uint8_t) ((_itfnum) + 1), \
+    4, TUSB_DESC_CS_INTERFACE, 0x02, 6, \
+    5, TUSB_DESC_CS_INTERFACE, 0x06, _itfnum, (uint8_t) ((_itfnum) + 1), \
+    7, TUSB_DESC_ENDPOINT, _ep_notif, TUSB_XFER_INTERRUPT, U16_TO_U8S_LE(_ep_notif_size), 16, \
+    9, TUSB_DESC_INTERFACE, (uint8_t) ((_itfnum) + 1), 0, 2, TUSB_CLASS_CDC_DATA, 0, 0, 0, \
+    7, TUSB_DESC_ENDPOINT, _epout, TUSB_XFER_BULK, U16_TO_U8S_LE(_epsize), 0, \
+    7, TUSB_DESC_ENDPOINT, _epin, TUSB_XFER_BULK, U16_TO_U8S_LE(_epsize), 0
+
+#endif /* MOCK_TUSB_DESCRIPTORS_H_ */
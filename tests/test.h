@@ -0,0 +1,49 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * Host Test Helpers
+ *
+ * Each test is a small program linking the hardware-independent modules
+ * it covers. CHECK() records a failure and carries on, so one run lists
+ * every broken expectation; the exit status is non-zero if any failed.
+ */
+
+#ifndef TEST_H_
+#define TEST_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+static int test_checks = 0;
+static int test_failures = 0;
+
+#define CHECK(cond) do { \
+        test_checks++; \
+        if (!(cond)) { \
+            test_failures++; \
+            printf("  FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+        } \
+    } while (0)
+
+#define CHECK_EQ(actual, expected) do { \
+        long long a_ = (long long) (actual), e_ = (long long) (expected); \
+        test_checks++; \
+        if (a_ != e_) { \
+            test_failures++; \
+            printf("  FAIL %s:%d: %s is %lld, expected %lld\n", __FILE__, __LINE__, #actual, a_, e_); \
+        } \
+    } while (0)
+
+// Run one test function and name it in the output
+#define RUN(test) do { \
+        int failures_ = test_failures; \
+        test(); \
+        printf("%s %s\n", test_failures == failures_ ? "ok  " : "FAIL", #test); \
+    } while (0)
+
+static inline int test_summary(void) {
+    printf("%d checks, %d failed\n", test_checks, test_failures);
+    return test_failures ? 1 : 0;
+}
+
+#endif /* TEST_H_ */
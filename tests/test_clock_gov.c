@@ -0,0 +1,196 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * Clock Governor Tests
+ *
+ * The decisions in clock_gov.c on a simulated microsecond clock, and
+ * clock_gov_pico.c applying them to the clocks and regulator stand-in.
+ * The system clock must never run above the idle clock while the core
+ * voltage is low: it goes down before the voltage does, and comes back
+ * up only CLOCK_GOV_SETTLE_US after the voltage.
+ */
+
+#include "test.h"
+#include "pico/time.h"
+#include "hardware/clocks.h"
+#include "hardware/vreg.h"
+#include "clock_gov.h"
+
+#define LOOP_US                 100
+
+static uint32_t full_hz;
+static uint32_t low_hz;
+static bool overclocked;        // clk_sys above the idle clock at low voltage
+
+// Boot with the system clock at sys_hz and start the governor
+static void start(uint32_t sys_hz) {
+    mock_time_reset(5 * 1000 * 1000);
+    mock_clocks_reset(sys_hz);
+    clock_gov_start();
+    full_hz = sys_hz;
+    low_hz = sys_hz / CLOCK_GOV_LOW_DIV;
+    overclocked = false;
+    mock_clocks_log_count = 0;
+}
+
+// Main loop passes for us, with the keyboard active or not
+static void run(uint32_t us, bool active) {
+    for (uint32_t t = 0; t < us; t += LOOP_US) {
+        mock_time_advance_us(LOOP_US);
+        clock_gov_task(active);
+        if (mock_voltage != VREG_VOLTAGE_DEFAULT && mock_clock_hz[clk_sys] > low_hz) overclocked = true;
+    }
+}
+
+static bool logged(int i, mock_clocks_event_t event, uint32_t value) {
+    return i < mock_clocks_log_count && mock_clocks_log[i].event == event &&
+           mock_clocks_log[i].value == value &&
+           (event == MOCK_SET_VOLTAGE || mock_clocks_log[i].target == clk_sys);
+}
+
+//--------------------------------------------------------------------+
+// Decisions
+//--------------------------------------------------------------------+
+
+// Slows down after CLOCK_GOV_IDLE_MS without activity, not before
+static void test_idle_threshold(void) {
+    const uint32_t idle_us = CLOCK_GOV_IDLE_MS * 1000u;
+    clock_gov_init(1000);
+    CHECK_EQ(clock_gov_update(1000 + idle_us - 1, false), CLOCK_GOV_NONE);
+    CHECK_EQ(clock_gov_state(), CLOCK_GOV_FULL);
+    CHECK_EQ(clock_gov_update(1000 + idle_us, false), CLOCK_GOV_SLOW_DOWN);
+    CHECK_EQ(clock_gov_state(), CLOCK_GOV_LOW);
+    CHECK_EQ(clock_gov_slowdowns(), 1);
+    CHECK_EQ(clock_gov_update(1000 + 2 * idle_us, false), CLOCK_GOV_NONE);
+
+    // Activity restarts the idle time
+    clock_gov_init(0);
+    CHECK_EQ(clock_gov_update(idle_us - 10, true), CLOCK_GOV_NONE);
+    CHECK_EQ(clock_gov_update(idle_us, false), CLOCK_GOV_NONE);
+    CHECK_EQ(clock_gov_update(2 * idle_us - 11, false), CLOCK_GOV_NONE);
+    CHECK_EQ(clock_gov_update(2 * idle_us - 10, false), CLOCK_GOV_SLOW_DOWN);
+}
+
+// Voltage first, then the clock once the regulator has settled, whether
+// or not the keyboard is still active
+static void test_wake_up(void) {
+    const uint32_t idle_us = CLOCK_GOV_IDLE_MS * 1000u;
+    clock_gov_init(0);
+    CHECK_EQ(clock_gov_update(idle_us, false), CLOCK_GOV_SLOW_DOWN);
+
+    uint32_t wake = idle_us + 12345;
+    CHECK_EQ(clock_gov_update(wake, true), CLOCK_GOV_VOLTAGE_UP);
+    CHECK_EQ(clock_gov_state(), CLOCK_GOV_WAKING);
+    CHECK_EQ(clock_gov_update(wake + CLOCK_GOV_SETTLE_US - 1, false), CLOCK_GOV_NONE);
+    CHECK_EQ(clock_gov_update(wake + CLOCK_GOV_SETTLE_US, false), CLOCK_GOV_SPEED_UP);
+    CHECK_EQ(clock_gov_state(), CLOCK_GOV_FULL);
+
+    // The idle time counts from the speed-up
+    uint32_t full = wake + CLOCK_GOV_SETTLE_US;
+    CHECK_EQ(clock_gov_update(full + idle_us - 1, false), CLOCK_GOV_NONE);
+    CHECK_EQ(clock_gov_update(full + idle_us, false), CLOCK_GOV_SLOW_DOWN);
+    CHECK_EQ(clock_gov_slowdowns(), 2);
+}
+
+// Only differences of the 32-bit microsecond counter are used
+static void test_timer_wrap(void) {
+    const uint32_t idle_us = CLOCK_GOV_IDLE_MS * 1000u;
+    uint32_t start = 0xFFFFFFFFu - idle_us / 2;
+    clock_gov_init(start);
+    CHECK_EQ(clock_gov_update(start + idle_us - 1, false), CLOCK_GOV_NONE);
+    CHECK_EQ(clock_gov_update(start + idle_us, false), CLOCK_GOV_SLOW_DOWN);
+
+    uint32_t wake = 0xFFFFFFFFu - CLOCK_GOV_SETTLE_US / 2;
+    CHECK_EQ(clock_gov_update(wake, true), CLOCK_GOV_VOLTAGE_UP);
+    CHECK_EQ(clock_gov_update(wake + CLOCK_GOV_SETTLE_US - 1, true), CLOCK_GOV_NONE);
+    CHECK_EQ(clock_gov_update(wake + CLOCK_GOV_SETTLE_US, true), CLOCK_GOV_SPEED_UP);
+}
+
+//--------------------------------------------------------------------+
+// Clocks and Regulator
+//--------------------------------------------------------------------+
+
+// The UART clock leaves clk_sys at start, so its baud rate survives
+static void test_start(void) {
+    mock_time_reset(0);
+    mock_clocks_reset(120 * MHZ);
+    clock_gov_start();
+    CHECK_EQ(mock_clock_hz[clk_peri], 48 * MHZ);
+    CHECK_EQ(mock_clock_hz[clk_sys], 120 * MHZ);
+    CHECK_EQ(mock_voltage, VREG_VOLTAGE_DEFAULT);
+    CHECK_EQ(clock_gov_state(), CLOCK_GOV_FULL);
+}
+
+// A full idle and wake cycle: divider before voltage going down, voltage
+// before divider coming back
+static void test_switch_order(void) {
+    start(120 * MHZ);
+    run(CLOCK_GOV_IDLE_MS * 1000u - LOOP_US, false);
+    CHECK_EQ(mock_clocks_log_count, 0);
+    run(LOOP_US, false);
+    CHECK_EQ(mock_clocks_log_count, 2);
+    CHECK(logged(0, MOCK_SET_CLOCK, low_hz));
+    CHECK(logged(1, MOCK_SET_VOLTAGE, CLOCK_GOV_LOW_VOLTAGE));
+    CHECK_EQ(clock_gov_slowdowns(), 1);
+
+    // Stays low however long the keyboard is idle
+    run(60 * 1000 * 1000, false);
+    CHECK_EQ(mock_clocks_log_count, 2);
+
+    // A key: voltage up now, full clock after the settle time
+    run(LOOP_US, true);
+    CHECK_EQ(mock_clocks_log_count, 3);
+    CHECK(logged(2, MOCK_SET_VOLTAGE, VREG_VOLTAGE_DEFAULT));
+    CHECK_EQ(mock_clock_hz[clk_sys], low_hz);
+    run(CLOCK_GOV_SETTLE_US, true);
+    CHECK_EQ(mock_clocks_log_count, 4);
+    CHECK(logged(3, MOCK_SET_CLOCK, full_hz));
+    CHECK(mock_clocks_log[3].time_us - mock_clocks_log[2].time_us >= CLOCK_GOV_SETTLE_US);
+    CHECK(!overclocked);
+
+    // And down again after the next idle period
+    run(CLOCK_GOV_IDLE_MS * 1000u + LOOP_US, false);
+    CHECK_EQ(mock_clocks_log_count, 6);
+    CHECK(logged(4, MOCK_SET_CLOCK, low_hz));
+    CHECK(logged(5, MOCK_SET_VOLTAGE, CLOCK_GOV_LOW_VOLTAGE));
+    CHECK_EQ(clock_gov_slowdowns(), 2);
+}
+
+// A short key burst between idle periods never leaves the clock high at
+// the low voltage
+static void test_bursts(void) {
+    start(120 * MHZ);
+    for (int i = 0; i < 20; i++) {
+        run(CLOCK_GOV_IDLE_MS * 1000u + 7 * LOOP_US, false);
+        run(LOOP_US * (1 + i % 3), true);
+        run(3 * LOOP_US, false);
+    }
+    CHECK(!overclocked);
+    CHECK_EQ(clock_gov_slowdowns(), 20);
+}
+
+// The idle clock is never below CLOCK_GOV_MIN_HZ: the divider is reduced,
+// and with no divider left the governor changes nothing
+static void test_minimum_clock(void) {
+    start(72 * MHZ);
+    run(CLOCK_GOV_IDLE_MS * 1000u + LOOP_US, false);
+    CHECK_EQ(clock_gov_state(), CLOCK_GOV_LOW);
+    CHECK_EQ(mock_clocks_log_count, 0);
+    CHECK_EQ(mock_clock_hz[clk_sys], 72 * MHZ);
+    CHECK_EQ(mock_voltage, VREG_VOLTAGE_DEFAULT);
+
+    start(200 * MHZ);
+    run(CLOCK_GOV_IDLE_MS * 1000u + LOOP_US, false);
+    CHECK(logged(0, MOCK_SET_CLOCK, 100 * MHZ));
+    CHECK(mock_clock_hz[clk_sys] >= CLOCK_GOV_MIN_HZ);
+}
+
+int main(void) {
+    RUN(test_idle_threshold);
+    RUN(test_wake_up);
+    RUN(test_timer_wrap);
+    RUN(test_start);
+    RUN(test_switch_order);
+    RUN(test_bursts);
+    RUN(test_minimum_clock);
+    return test_summary();
+}
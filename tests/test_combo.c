@@ -0,0 +1,146 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * Combo Tests
+ *
+ * Built with COMBO_EXAMPLE=1 (J+K -> Esc) and the default 30 ms window.
+ */
+
+#include "test.h"
+#include "combo.h"
+#include "hid_keycodes.h"
+
+typedef struct {
+    uint8_t key;
+    bool pressed;
+    uint32_t time_ms;
+} out_event_t;
+
+static out_event_t out[64];
+static int out_count;
+
+static void sink(uint8_t key, bool pressed, uint32_t time_ms) {
+    if (out_count < (int) (sizeof(out) / sizeof(out[0]))) {
+        out[out_count++] = (out_event_t) { key, pressed, time_ms };
+    }
+}
+
+static void reset(void) {
+    combo_init(sink);
+    combo_set_term(COMBO_TERM_MS);
+    out_count = 0;
+}
+
+static bool out_is(int i, uint8_t key, bool pressed) {
+    return i < out_count && out[i].key == key && out[i].pressed == pressed;
+}
+
+static void test_combo_fires(void) {
+    reset();
+    combo_process(HID_KEY_J, true, 1000);
+    CHECK(combo_pending());
+    CHECK_EQ(out_count, 0);
+    combo_process(HID_KEY_K, true, 1010);
+    CHECK(!combo_pending());
+    CHECK_EQ(out_count, 1);
+    CHECK(out_is(0, HID_KEY_ESCAPE, true) && out[0].time_ms == 1010);
+
+    // The first key released releases the output; the second is swallowed
+    combo_process(HID_KEY_K, false, 1100);
+    CHECK(out_is(1, HID_KEY_ESCAPE, false));
+    combo_process(HID_KEY_J, false, 1120);
+    CHECK_EQ(out_count, 2);
+}
+
+static void test_either_order(void) {
+    reset();
+    combo_process(HID_KEY_K, true, 1000);
+    combo_process(HID_KEY_J, true, 1020);
+    CHECK(out_is(0, HID_KEY_ESCAPE, true));
+    combo_process(HID_KEY_J, false, 1050);
+    combo_process(HID_KEY_K, false, 1060);
+    CHECK_EQ(out_count, 2);
+    CHECK(out_is(1, HID_KEY_ESCAPE, false));
+}
+
+static void test_lone_key_tapped(void) {
+    reset();
+    combo_process(HID_KEY_J, true, 1000);
+    combo_process(HID_KEY_J, false, 1015);
+    CHECK_EQ(out_count, 2);
+    CHECK(out_is(0, HID_KEY_J, true) && out[0].time_ms == 1000);
+    CHECK(out_is(1, HID_KEY_J, false));
+}
+
+static void test_window_runs_out(void) {
+    reset();
+    combo_process(HID_KEY_J, true, 1000);
+    combo_task(1029);
+    CHECK(combo_pending());
+    combo_task(1030);
+    CHECK(!combo_pending());
+    CHECK(out_is(0, HID_KEY_J, true) && out[0].time_ms == 1000);
+
+    // Too late to form the combo
+    combo_process(HID_KEY_K, true, 1040);
+    CHECK(combo_pending());
+    combo_process(HID_KEY_K, false, 1060);
+    combo_process(HID_KEY_J, false, 1070);
+    CHECK_EQ(out_count, 4);
+    CHECK(out_is(1, HID_KEY_K, true) && out_is(2, HID_KEY_K, false) && out_is(3, HID_KEY_J, false));
+}
+
+// A window that ran out before the next event is settled at its end
+static void test_late_event_settles_first(void) {
+    reset();
+    combo_process(HID_KEY_J, true, 1000);
+    combo_process(HID_KEY_K, true, 1100);
+    CHECK(out_is(0, HID_KEY_J, true));
+    CHECK(combo_pending());
+}
+
+// A key in no combo ends the wait at once and is never held back itself
+static void test_other_key_ends_wait(void) {
+    reset();
+    combo_process(HID_KEY_A, true, 1000);
+    CHECK(out_is(0, HID_KEY_A, true));
+    combo_process(HID_KEY_J, true, 1005);
+    combo_process(HID_KEY_L, true, 1010);
+    CHECK(!combo_pending());
+    CHECK_EQ(out_count, 3);
+    CHECK(out_is(1, HID_KEY_J, true) && out[1].time_ms == 1005);
+    CHECK(out_is(2, HID_KEY_L, true));
+    combo_process(HID_KEY_A, false, 1020);
+    CHECK(out_is(3, HID_KEY_A, false));
+}
+
+static void test_repeats_dropped(void) {
+    reset();
+    combo_process(HID_KEY_J, true, 1000);
+    combo_process(HID_KEY_K, true, 1010);
+    combo_process(HID_KEY_K, true, 1500);
+    combo_process(HID_KEY_J, true, 1530);
+    CHECK_EQ(out_count, 1);
+    combo_process(HID_KEY_A, false, 1540);
+    CHECK_EQ(out_count, 1);
+}
+
+static void test_term_setting(void) {
+    reset();
+    combo_set_term(80);
+    CHECK_EQ(combo_get_term(), 80);
+    combo_process(HID_KEY_J, true, 1000);
+    combo_process(HID_KEY_K, true, 1070);
+    CHECK(out_is(0, HID_KEY_ESCAPE, true));
+}
+
+int main(void) {
+    RUN(test_combo_fires);
+    RUN(test_either_order);
+    RUN(test_lone_key_tapped);
+    RUN(test_window_runs_out);
+    RUN(test_late_event_settles_first);
+    RUN(test_other_key_ends_wait);
+    RUN(test_repeats_dropped);
+    RUN(test_term_setting);
+    return test_summary();
+}
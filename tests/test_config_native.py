@@ -0,0 +1,191 @@
+#!/usr/bin/env python3
+"""
+PS/2 to USB HID Keyboard Bridge - configuration protocol round trips
+
+Runs tools/config.py's Config class against the firmware's protocol
+handler built as a host library (the --native transport), with the store
+on its RAM flash stand-in:
+
+  test_config_native.py LIB
+
+tests/CMakeLists.txt builds the library and runs this under ctest.
+"""
+
+import ctypes
+import os
+import struct
+import sys
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'tools'))
+import config as cfg  # noqa: E402
+
+HID_KEY_A = 0x04
+HID_KEY_B = 0x05
+HID_KEY_CAPS_LOCK = 0x39
+HID_KEY_CONTROL_LEFT = 0xE0
+HID_KEY_F12 = 0x45
+
+
+def km_key(code):
+    return 0x0100 | code
+
+
+def km_mo(layer):
+    return 0x0200 | layer
+
+
+failures = 0
+
+
+def check(cond, what):
+    global failures
+    if not cond:
+        failures += 1
+        print(f"  FAIL: {what}")
+
+
+def expect_error(fn, message, what):
+    try:
+        fn()
+    except cfg.ConfigError as e:
+        check(str(e) == message, f"{what}: got '{e}', expected '{message}'")
+    else:
+        check(False, f"{what}: no error")
+
+
+def entry(blob, key):
+    return struct.unpack_from('<H', blob, 2 * key)[0]
+
+
+def with_entry(blob, key, action):
+    blob = bytearray(blob)
+    struct.pack_into('<H', blob, 2 * key, action)
+    return bytes(blob)
+
+
+def test_info(config):
+    info = config.info()
+    check(info['layers'] == 4 and info['report_size'] == cfg.REPORT_SIZE, f"info {info}")
+    check(0 < info['chunk_size'] <= cfg.REPORT_SIZE - cfg.HEADER_SIZE - 4 and info['chunk_size'] % 2 == 0,
+          f"chunk size {info['chunk_size']}")
+
+
+def test_params(config):
+    values = {'poll-interval': 4, 'debounce': 7, 'taphold-term': 180,
+              'combo-term': 40, 'socd': 2, 'usb-profile': 1}
+    for name, value in values.items():
+        check(config.set(cfg.PARAMS[name], value) == value, f"set {name}")
+        check(config.get(cfg.PARAMS[name]) == value, f"get {name}")
+
+    bad = {'poll-interval': 0, 'debounce': 256, 'taphold-term': 0x10000,
+           'combo-term': 0, 'socd': 4, 'usb-profile': 3}
+    for name, value in bad.items():
+        expect_error(lambda: config.set(cfg.PARAMS[name], value), 'bad argument', f"set {name} {value}")
+        check(config.get(cfg.PARAMS[name]) == values[name], f"{name} kept after a bad value")
+    expect_error(lambda: config.get(0x7F), 'bad argument', "unknown parameter")
+
+
+def test_keymap(config):
+    for layer in range(4):
+        check(len(config.read_layer(layer)) == cfg.LAYER_SIZE, f"layer {layer} size")
+    expect_error(lambda: config.read_layer(4), 'bad argument', "layer 4")
+
+    layer1 = with_entry(config.read_layer(1), HID_KEY_A, km_key(HID_KEY_B))
+    layer1 = with_entry(layer1, 0xFF, 0x01FF)
+    config.write_layer(1, layer1)
+    check(config.read_layer(1) == layer1, "layer 1 read back as written")
+
+    # A layer is only replaced once complete
+    chunk = config.info()['chunk_size']
+    config.request(cfg.CMD_KEYMAP_WRITE, struct.pack('<BHB', 2, 0, chunk) + b'\x01' * chunk)
+    expect_error(lambda: config.request(cfg.CMD_KEYMAP_COMMIT, bytes([2])), 'out of sequence',
+                 "commit of a partial layer")
+    check(entry(config.read_layer(2), 0) == 0, "partial layer not applied")
+
+    # Version mismatch
+    response = config.transport.transfer(bytes([cfg.PROTOCOL_VERSION + 1, cfg.CMD_INFO, 0, 0])
+                                         .ljust(cfg.REPORT_SIZE, b'\x00'))
+    check(response[3] == 1, "version mismatch status")
+
+
+# Settings survive a store flush and a reload, as after a power cycle
+def test_saved(config, lib):
+    config.set(cfg.PARAMS['debounce'], 9)
+    check(lib.store_flush(), "store flush")
+    lib.config_store_flushed()
+    lib.debounce_set_window(0)
+    lib.config_load()
+    check(config.get(cfg.PARAMS['debounce']) == 9, "debounce reloaded from the store")
+    check(entry(config.read_layer(1), HID_KEY_A) == km_key(HID_KEY_B), "layer 1 reloaded from the store")
+
+
+def test_defaults(config, lib):
+    config.request(cfg.CMD_DEFAULTS)
+    check(config.get(cfg.PARAMS['debounce']) == 0, "debounce back to default")
+    check(config.get(cfg.PARAMS['usb-profile']) == 0, "usb-profile back to default")
+    check(entry(config.read_layer(1), HID_KEY_A) == 0, "layer 1 back to default")
+    check(lib.store_flush(), "store flush")
+    lib.config_store_flushed()
+    lib.config_load()
+    check(entry(config.read_layer(1), HID_KEY_A) == 0, "saved layer deleted")
+
+
+# Keys held across DEFAULTS are released as what they were pressed as
+def test_defaults_with_keys_held(config, lib):
+    config.write_layer(0, with_entry(with_entry(config.read_layer(0), HID_KEY_CAPS_LOCK,
+                                                km_key(HID_KEY_CONTROL_LEFT)),
+                                     HID_KEY_F12, km_mo(1)))
+    config.write_layer(1, with_entry(config.read_layer(1), HID_KEY_A, km_key(HID_KEY_B)))
+
+    check(lib.keymap_press(HID_KEY_CAPS_LOCK) == HID_KEY_CONTROL_LEFT, "Caps Lock pressed as Ctrl")
+    check(lib.keymap_press(HID_KEY_F12) == 0, "F12 pressed as MO(1)")
+    check(lib.keymap_press(HID_KEY_A) == HID_KEY_B, "A pressed as B on layer 1")
+
+    config.request(cfg.CMD_DEFAULTS)
+    lib.config_task()
+    check(entry(config.read_layer(0), HID_KEY_CAPS_LOCK) == km_key(HID_KEY_CONTROL_LEFT),
+          "keymap kept while keys are held")
+    blob = with_entry(config.read_layer(2), HID_KEY_A, km_key(HID_KEY_B))
+    expect_error(lambda: config.write_layer(2, blob), 'out of sequence', "commit while the restore waits")
+
+    check(lib.keymap_release(HID_KEY_A) == HID_KEY_B, "A released as B")
+    check(lib.keymap_release(HID_KEY_F12) == 0, "F12 released as a layer key")
+    lib.config_task()
+    check(entry(config.read_layer(0), HID_KEY_CAPS_LOCK) != 0, "restore waits for the last key")
+    check(lib.keymap_release(HID_KEY_CAPS_LOCK) == HID_KEY_CONTROL_LEFT, "Caps Lock released as Ctrl")
+    lib.config_task()
+    check(entry(config.read_layer(0), HID_KEY_CAPS_LOCK) == 0, "keymap restored once all keys are up")
+    check(lib.keymap_active_layers() == 1, "no layer left active")
+    check(lib.keymap_press(HID_KEY_CAPS_LOCK) == HID_KEY_CAPS_LOCK, "Caps Lock is itself again")
+    lib.keymap_release(HID_KEY_CAPS_LOCK)
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit(__doc__.strip())
+    transport = cfg.NativeTransport(sys.argv[1])
+    lib = transport.lib
+    lib.keymap_press.restype = ctypes.c_uint8
+    lib.keymap_release.restype = ctypes.c_uint8
+    lib.keymap_active_layers.restype = ctypes.c_uint8
+    lib.store_flush.restype = ctypes.c_bool
+    config = cfg.Config(transport)
+
+    tests = [
+        ('test_info', lambda: test_info(config)),
+        ('test_params', lambda: test_params(config)),
+        ('test_keymap', lambda: test_keymap(config)),
+        ('test_saved', lambda: test_saved(config, lib)),
+        ('test_defaults', lambda: test_defaults(config, lib)),
+        ('test_defaults_with_keys_held', lambda: test_defaults_with_keys_held(config, lib)),
+    ]
+    for name, test in tests:
+        before = failures
+        test()
+        print(f"{'ok  ' if failures == before else 'FAIL'} {name}")
+    print(f"{failures} failed")
+    return 1 if failures else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,88 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * Debug Console Parsing Tests
+ *
+ * The command line helpers build without CONSOLE_ENABLE, so they are
+ * tested here without the CDC interface.
+ */
+
+#include "test.h"
+#include "console.h"
+#include <string.h>
+
+static void test_split(void) {
+    char line[CONSOLE_LINE_MAX];
+    char* argv[CONSOLE_MAX_ARGS];
+
+    strcpy(line, "key 0 0x39 0x0105");
+    CHECK_EQ(console_split(line, argv, CONSOLE_MAX_ARGS), 4);
+    CHECK(strcmp(argv[0], "key") == 0);
+    CHECK(strcmp(argv[1], "0") == 0);
+    CHECK(strcmp(argv[2], "0x39") == 0);
+    CHECK(strcmp(argv[3], "0x0105") == 0);
+
+    // Runs of spaces and tabs, leading and trailing
+    strcpy(line, " \t stats  \t reset \t");
+    CHECK_EQ(console_split(line, argv, CONSOLE_MAX_ARGS), 2);
+    CHECK(strcmp(argv[0], "stats") == 0);
+    CHECK(strcmp(argv[1], "reset") == 0);
+
+    strcpy(line, "");
+    CHECK_EQ(console_split(line, argv, CONSOLE_MAX_ARGS), 0);
+    strcpy(line, "  \t ");
+    CHECK_EQ(console_split(line, argv, CONSOLE_MAX_ARGS), 0);
+}
+
+// Words past the limit are ignored, the last one kept is terminated
+static void test_split_limit(void) {
+    char line[CONSOLE_LINE_MAX];
+    char* argv[CONSOLE_MAX_ARGS + 1];
+
+    strcpy(line, "a b c d e f g h");
+    argv[CONSOLE_MAX_ARGS] = NULL;
+    CHECK_EQ(console_split(line, argv, CONSOLE_MAX_ARGS), CONSOLE_MAX_ARGS);
+    CHECK(strcmp(argv[CONSOLE_MAX_ARGS - 1], "f") == 0);
+    CHECK(argv[CONSOLE_MAX_ARGS] == NULL);
+
+    strcpy(line, "one two");
+    CHECK_EQ(console_split(line, argv, 1), 1);
+    CHECK(strcmp(argv[0], "one") == 0);
+}
+
+static void test_parse_uint(void) {
+    uint32_t v = 0;
+    CHECK(console_parse_uint("0", &v) && v == 0);
+    CHECK(console_parse_uint("42", &v) && v == 42);
+    CHECK(console_parse_uint("0x1F", &v) && v == 0x1F);
+    CHECK(console_parse_uint("0XaB", &v) && v == 0xAB);
+    CHECK(console_parse_uint("4294967295", &v) && v == UINT32_MAX);
+    CHECK(console_parse_uint("0xFFFFFFFF", &v) && v == UINT32_MAX);
+    CHECK(console_parse_uint("0x00000000000001", &v) && v == 1);
+
+    // A leading zero is not octal
+    CHECK(console_parse_uint("010", &v) && v == 10);
+    CHECK(console_parse_uint("09", &v) && v == 9);
+}
+
+static void test_parse_uint_rejects(void) {
+    static const char* const bad[] = {
+        "", "-1", "+1", " 1", "1 ", "1a", "0x", "0xG", "abc", "1.5",
+        "4294967296", "0x100000000", "99999999999999999999",
+    };
+    for (unsigned i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+        uint32_t v = 1234;
+        bool ok = console_parse_uint(bad[i], &v);
+        CHECK(!ok);
+        CHECK_EQ(v, 1234);
+        if (ok) printf("  accepted \"%s\"\n", bad[i]);
+    }
+    CHECK(!console_parse_uint(NULL, &(uint32_t) { 0 }));
+}
+
+int main(void) {
+    RUN(test_split);
+    RUN(test_split_limit);
+    RUN(test_parse_uint);
+    RUN(test_parse_uint_rejects);
+    return test_summary();
+}
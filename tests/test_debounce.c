@@ -0,0 +1,214 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * Chatter Filter Tests
+ *
+ * Built with DEBOUNCE_MS=10. Events are fed on a simulated millisecond
+ * clock with debounce_task() called every tick, as the PS/2 polling loop
+ * does; each event passed on records the clock.
+ */
+
+#include "test.h"
+#include "debounce.h"
+#include "hid_keycodes.h"
+#include <stdlib.h>
+
+typedef struct {
+    uint8_t key;
+    bool pressed;
+    uint32_t at_ms;
+} out_event_t;
+
+static out_event_t out[8192];
+static int out_count;
+static uint32_t now_ms;
+
+static void sink(uint8_t key, bool pressed, uint32_t time_ms) {
+    (void) time_ms;
+    if (out_count < (int) (sizeof(out) / sizeof(out[0]))) {
+        out[out_count++] = (out_event_t) { key, pressed, now_ms };
+    }
+}
+
+static void reset(uint32_t start_ms) {
+    debounce_init(sink);
+    debounce_set_window(DEBOUNCE_MS);
+    out_count = 0;
+    now_ms = start_ms;
+}
+
+static void advance(uint32_t t) {
+    while (now_ms < t) {
+        now_ms++;
+        debounce_task(now_ms);
+    }
+}
+
+static void event(uint32_t t, uint8_t key, bool pressed) {
+    advance(t);
+    debounce_process(key, pressed, now_ms);
+}
+
+static bool out_is(int i, uint8_t key, bool pressed, uint32_t at_ms) {
+    return i < out_count && out[i].key == key && out[i].pressed == pressed && out[i].at_ms == at_ms;
+}
+
+// Presses and releases further apart than the window are not delayed
+static void test_clean_keys_not_delayed(void) {
+    reset(1000);
+    event(1000, HID_KEY_A, true);
+    event(1060, HID_KEY_A, false);
+    event(1065, HID_KEY_B, true);
+    event(1070, HID_KEY_C, true);
+    event(1100, HID_KEY_B, false);
+    event(1110, HID_KEY_C, false);
+    CHECK_EQ(out_count, 6);
+    CHECK(out_is(0, HID_KEY_A, true, 1000));
+    CHECK(out_is(1, HID_KEY_A, false, 1060));
+    CHECK(out_is(2, HID_KEY_B, true, 1065));
+    CHECK(out_is(3, HID_KEY_C, true, 1070));
+    CHECK(out_is(4, HID_KEY_B, false, 1100));
+    CHECK(out_is(5, HID_KEY_C, false, 1110));
+    advance(1200);
+    CHECK(!debounce_pending());
+}
+
+// make/break/make inside the window is one press
+static void test_press_chatter(void) {
+    reset(1000);
+    event(1000, HID_KEY_A, true);
+    event(1002, HID_KEY_A, false);
+    event(1004, HID_KEY_A, true);
+    advance(1050);
+    CHECK_EQ(out_count, 1);
+    CHECK(out_is(0, HID_KEY_A, true, 1000));
+    event(1080, HID_KEY_A, false);
+    CHECK(out_is(1, HID_KEY_A, false, 1080));
+}
+
+// break/make/break inside the window is one release
+static void test_release_chatter(void) {
+    reset(1000);
+    event(1000, HID_KEY_A, true);
+    event(1080, HID_KEY_A, false);
+    event(1081, HID_KEY_A, true);
+    event(1083, HID_KEY_A, false);
+    advance(1150);
+    CHECK_EQ(out_count, 2);
+    CHECK(out_is(1, HID_KEY_A, false, 1080));
+}
+
+// A tap shorter than the window cannot be told from chatter until the
+// window ends, so its release waits until then; the press is not delayed
+static void test_short_tap_release_at_window_end(void) {
+    reset(1000);
+    event(1000, HID_KEY_A, true);
+    event(1006, HID_KEY_A, false);
+    CHECK_EQ(out_count, 1);
+    advance(1009);
+    CHECK_EQ(out_count, 1);
+    advance(1010);
+    CHECK(out_is(1, HID_KEY_A, false, 1000 + DEBOUNCE_MS));
+    printf("  6 ms tap: press sent at once, release %u ms late\n", out[1].at_ms - 1006);
+}
+
+// Chatter that ends in the other state is sent once, at the window end
+static void test_chatter_settles_to_last_state(void) {
+    reset(1000);
+    event(1000, HID_KEY_A, true);
+    event(1003, HID_KEY_A, false);
+    event(1004, HID_KEY_A, true);
+    event(1007, HID_KEY_A, false);
+    advance(1030);
+    CHECK_EQ(out_count, 2);
+    CHECK(out_is(1, HID_KEY_A, false, 1010));
+}
+
+// Keys have separate windows
+static void test_keys_independent(void) {
+    reset(1000);
+    event(1000, HID_KEY_A, true);
+    event(1001, HID_KEY_B, true);
+    event(1002, HID_KEY_A, false);
+    event(1003, HID_KEY_B, false);
+    CHECK_EQ(out_count, 2);
+    advance(1020);
+    CHECK_EQ(out_count, 4);
+    CHECK(out_is(2, HID_KEY_A, false, 1010));
+    CHECK(out_is(3, HID_KEY_B, false, 1011));
+}
+
+static void test_disabled(void) {
+    reset(1000);
+    debounce_set_window(0);
+    CHECK_EQ(debounce_get_window(), 0);
+    event(1000, HID_KEY_A, true);
+    event(1001, HID_KEY_A, false);
+    event(1002, HID_KEY_A, true);
+    CHECK_EQ(out_count, 3);
+    CHECK(!debounce_pending());
+}
+
+// Windows use 16-bit timestamps; a window across the wrap still ends on time
+static void test_timestamp_wrap(void) {
+    reset(0x1FFF8);
+    event(0x1FFFA, HID_KEY_A, true);
+    event(0x1FFFC, HID_KEY_A, false);
+    advance(0x20010);
+    CHECK_EQ(out_count, 2);
+    CHECK(out_is(1, HID_KEY_A, false, 0x1FFFA + DEBOUNCE_MS));
+}
+
+// Random taps with chatter bursts at some of their edges: every tap comes
+// out as exactly one press and one release, each at its first physical edge
+static void test_random_chatter(void) {
+    enum { TAPS = 1000 };
+    static uint32_t edge_ms[2 * TAPS];
+    static uint8_t edge_key[2 * TAPS];
+    int edges = 0, bursts = 0, bad = 0;
+
+    reset(1000);
+    srand(1);
+    for (int i = 0; i < TAPS; i++) {
+        uint8_t key = (uint8_t) (HID_KEY_A + rand() % 8);
+        uint32_t t = now_ms + 30 + rand() % 40;
+        uint32_t hold = 20 + rand() % 120;
+
+        for (int edge = 0; edge < 2; edge++) {
+            bool pressed = edge == 0;
+            event(edge == 0 ? t : t + hold, key, pressed);
+            edge_ms[edges] = now_ms;
+            edge_key[edges++] = key;
+
+            // 1-3 bounces, one every millisecond
+            if (rand() % 3 == 0) {
+                bursts++;
+                for (int b = 1 + rand() % 3; b > 0; b--) {
+                    event(now_ms + 1, key, !pressed);
+                    event(now_ms + 1, key, pressed);
+                }
+            }
+        }
+    }
+    advance(now_ms + 100);
+
+    CHECK_EQ(out_count, edges);
+    for (int j = 0; j < out_count && j < edges; j++) {
+        if (!out_is(j, edge_key[j], j % 2 == 0, edge_ms[j])) bad++;
+    }
+    CHECK_EQ(bad, 0);
+    CHECK(!debounce_pending());
+    printf("  %d taps, %d chatter bursts: %d events out, none delayed\n", TAPS, bursts, out_count);
+}
+
+int main(void) {
+    RUN(test_clean_keys_not_delayed);
+    RUN(test_press_chatter);
+    RUN(test_release_chatter);
+    RUN(test_short_tap_release_at_window_end);
+    RUN(test_chatter_settles_to_last_state);
+    RUN(test_keys_independent);
+    RUN(test_disabled);
+    RUN(test_timestamp_wrap);
+    RUN(test_random_chatter);
+    return test_summary();
+}
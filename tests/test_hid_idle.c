@@ -0,0 +1,167 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * HID Idle Rate Tests
+ *
+ * The idle alarm runs on the simulated clock of the pico/time.h stand-in.
+ * The loop below sends reports the way hid_task() in main.c does, passing
+ * every LOOP_US, so the times at which reports go out can be checked
+ * against the idle period.
+ */
+
+#include "test.h"
+#include "pico/time.h"
+#include "hid_idle.h"
+#include <stdlib.h>
+
+#define LOOP_US                 100
+
+static uint64_t sent_us[4096];
+static bool sent_resend[4096];
+static int sent_count;
+
+static void reset(void) {
+    mock_time_reset(1000000);
+    hid_idle_set_rate(0);
+    sent_count = 0;
+}
+
+static void send(bool resend) {
+    if (sent_count < (int) (sizeof(sent_us) / sizeof(sent_us[0]))) {
+        sent_us[sent_count] = mock_time_us;
+        sent_resend[sent_count++] = resend;
+    }
+    hid_idle_report_sent();
+}
+
+// Run the main loop for us; a key report goes out at each time in keys_us
+static void run(uint64_t us, const uint64_t* keys_us, int key_count) {
+    uint64_t end = mock_time_us + us;
+    int next_key = 0;
+    while (mock_time_us < end) {
+        mock_time_advance_us(LOOP_US);
+        if (next_key < key_count && keys_us[next_key] <= mock_time_us) {
+            next_key++;
+            send(false);
+        } else if (hid_idle_resend_due()) {
+            send(true);
+        }
+    }
+}
+
+static void test_rate_zero_never_repeats(void) {
+    reset();
+    CHECK_EQ(hid_idle_get_rate(), 0);
+    run(5000000, NULL, 0);
+    CHECK_EQ(sent_count, 0);
+}
+
+// Rate 25 = 100 ms: the last report is repeated every 100 ms
+static void test_repeats_at_rate(void) {
+    reset();
+    hid_idle_set_rate(25);
+    CHECK_EQ(hid_idle_get_rate(), 25);
+    run(1000000 + LOOP_US, NULL, 0);
+    CHECK_EQ(sent_count, 10);
+    for (int i = 0; i < sent_count; i++) {
+        CHECK(sent_resend[i]);
+        CHECK_EQ(sent_us[i], 1000000 + (uint64_t) (i + 1) * 100000);
+    }
+}
+
+// A report restarts the period: the next repeat is a full period later
+static void test_report_restarts_period(void) {
+    uint64_t keys[] = { 1050000 };
+
+    reset();
+    hid_idle_set_rate(25);
+    run(300000, keys, 1);
+    CHECK_EQ(sent_count, 3);
+    CHECK(!sent_resend[0] && sent_us[0] == 1050000);
+    CHECK(sent_resend[1] && sent_us[1] == 1150000);
+    CHECK(sent_resend[2] && sent_us[2] == 1250000);
+}
+
+// Changing the rate restarts the period; rate 0 stops the repeats
+static void test_rate_change(void) {
+    reset();
+    hid_idle_set_rate(25);
+    run(50000, NULL, 0);
+    hid_idle_set_rate(50);
+    run(250000, NULL, 0);
+    CHECK_EQ(sent_count, 1);
+    CHECK_EQ(sent_us[0], 1050000 + 200000);
+    hid_idle_set_rate(0);
+    run(1000000, NULL, 0);
+    CHECK_EQ(sent_count, 1);
+}
+
+// A repeat that fell due while the main loop was busy is sent once
+static void test_resend_flag_is_one_shot(void) {
+    reset();
+    hid_idle_set_rate(1);
+    mock_time_advance_us(20000);
+    CHECK(hid_idle_resend_due());
+    CHECK(!hid_idle_resend_due());
+}
+
+// A key report sent while a repeat is due replaces the repeat
+static void test_report_supersedes_due_repeat(void) {
+    reset();
+    hid_idle_set_rate(25);
+    mock_time_advance_us(100000);
+    send(false);
+    CHECK(!hid_idle_resend_due());
+    run(99000, NULL, 0);
+    CHECK_EQ(sent_count, 1);
+    run(2000, NULL, 0);
+    CHECK_EQ(sent_count, 2);
+    CHECK(sent_resend[1] && sent_us[1] == 1200000);
+}
+
+// Random key reports at many rates: there is never a gap longer than the
+// period, and no repeat comes sooner than a period after the last report
+static void test_random_traffic(void) {
+    static uint64_t keys[2000];
+    int bad_gap = 0, early = 0;
+    uint64_t worst_late = 0;
+
+    srand(1);
+    for (int round = 0; round < 20; round++) {
+        reset();
+        uint8_t rate = (uint8_t) (1 + rand() % 100);
+        uint64_t period = (uint64_t) rate * HID_IDLE_UNIT_MS * 1000;
+        hid_idle_set_rate(rate);
+
+        uint64_t t = mock_time_us;
+        int count = 0;
+        while (count < 100) {
+            t += (uint64_t) (rand() % (int) (2 * period));
+            keys[count++] = t;
+        }
+        run(t - mock_time_us + period, keys, count);
+
+        uint64_t prev = 1000000;
+        for (int i = 0; i < sent_count; i++) {
+            uint64_t gap = sent_us[i] - prev;
+            if (gap > period + LOOP_US) bad_gap++;
+            if (sent_resend[i] && gap < period) early++;
+            if (gap > period && gap - period > worst_late) worst_late = gap - period;
+            prev = sent_us[i];
+        }
+    }
+    CHECK_EQ(bad_gap, 0);
+    CHECK_EQ(early, 0);
+    printf("  20 rates x 100 key reports: longest gap is the period + %llu us\n",
+           (unsigned long long) worst_late);
+}
+
+int main(void) {
+    RUN(test_rate_zero_never_repeats);
+    RUN(test_repeats_at_rate);
+    RUN(test_report_restarts_period);
+    RUN(test_rate_change);
+    RUN(test_resend_flag_is_one_shot);
+    RUN(test_report_supersedes_due_repeat);
+    RUN(test_random_traffic);
+    return test_summary();
+}
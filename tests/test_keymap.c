@@ -0,0 +1,150 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * Layer Keymap Tests
+ *
+ * Built with KEYMAP_FN_LAYER=1: Right Alt is MO(1), and layer 1 turns
+ * Delete and the arrows into media and navigation keys.
+ */
+
+#include "test.h"
+#include "keymap.h"
+#include "hid_keycodes.h"
+
+#define KEY_FN          HID_KEY_ALT_RIGHT
+#define KEY_TOGGLE      HID_KEY_F10
+#define KEY_ONESHOT     HID_KEY_F11
+
+static void test_base_layer(void) {
+    keymap_init();
+    CHECK_EQ(keymap_active_layers(), 0x01);
+    CHECK_EQ(keymap_press(HID_KEY_A), HID_KEY_A);
+    CHECK_EQ(keymap_release(HID_KEY_A), HID_KEY_A);
+    CHECK_EQ(keymap_press(HID_KEY_DELETE), HID_KEY_DELETE);
+    CHECK_EQ(keymap_release(HID_KEY_DELETE), HID_KEY_DELETE);
+    CHECK(keymap_layer_is_default(0) && keymap_layer_is_default(1));
+}
+
+static void test_momentary(void) {
+    keymap_init();
+    CHECK_EQ(keymap_press(KEY_FN), 0);
+    CHECK_EQ(keymap_active_layers(), 0x03);
+    CHECK_EQ(keymap_press(HID_KEY_DELETE), HID_KEY_MUTE);
+    CHECK_EQ(keymap_release(HID_KEY_DELETE), HID_KEY_MUTE);
+    // Not on layer 1: falls through to the base layer
+    CHECK_EQ(keymap_press(HID_KEY_A), HID_KEY_A);
+    CHECK_EQ(keymap_release(HID_KEY_A), HID_KEY_A);
+    CHECK_EQ(keymap_release(KEY_FN), 0);
+    CHECK_EQ(keymap_active_layers(), 0x01);
+}
+
+// A key is released as what it was pressed as, whatever the layers do meanwhile
+static void test_release_after_layer_change(void) {
+    keymap_init();
+    keymap_press(KEY_FN);
+    CHECK_EQ(keymap_press(HID_KEY_ARROW_UP), HID_KEY_VOLUME_UP);
+    keymap_release(KEY_FN);
+    CHECK_EQ(keymap_release(HID_KEY_ARROW_UP), HID_KEY_VOLUME_UP);
+
+    CHECK_EQ(keymap_press(HID_KEY_ARROW_UP), HID_KEY_ARROW_UP);
+    keymap_press(KEY_FN);
+    CHECK_EQ(keymap_release(HID_KEY_ARROW_UP), HID_KEY_ARROW_UP);
+    keymap_release(KEY_FN);
+}
+
+// Typematic repeats resolve like the first press and have no layer effects
+static void test_repeats(void) {
+    keymap_init();
+    CHECK(keymap_set(0, KEY_TOGGLE, KM_TG(2)));
+    CHECK(keymap_set(2, HID_KEY_A, KM_KEY(HID_KEY_B)));
+
+    CHECK_EQ(keymap_press(KEY_TOGGLE), 0);
+    CHECK_EQ(keymap_active_layers(), 0x05);
+    for (int i = 0; i < 5; i++) CHECK_EQ(keymap_press(KEY_TOGGLE), 0);
+    CHECK_EQ(keymap_active_layers(), 0x05);
+    CHECK_EQ(keymap_release(KEY_TOGGLE), 0);
+    CHECK_EQ(keymap_active_layers(), 0x05);
+
+    // Held across a layer change: repeats keep the original layer
+    CHECK_EQ(keymap_press(HID_KEY_ARROW_UP), HID_KEY_ARROW_UP);
+    keymap_press(KEY_FN);
+    CHECK_EQ(keymap_press(HID_KEY_ARROW_UP), HID_KEY_ARROW_UP);
+    keymap_release(KEY_FN);
+    CHECK_EQ(keymap_release(HID_KEY_ARROW_UP), HID_KEY_ARROW_UP);
+
+    // Repeats of a held Fn leave the layer on; one release clears it
+    keymap_press(KEY_FN);
+    keymap_press(KEY_FN);
+    CHECK_EQ(keymap_active_layers(), 0x07);
+    keymap_release(KEY_FN);
+    CHECK_EQ(keymap_active_layers(), 0x05);
+
+    CHECK_EQ(keymap_press(HID_KEY_A), HID_KEY_B);
+    CHECK_EQ(keymap_release(HID_KEY_A), HID_KEY_B);
+    keymap_press(KEY_TOGGLE);
+    keymap_release(KEY_TOGGLE);
+    CHECK_EQ(keymap_active_layers(), 0x01);
+    CHECK_EQ(keymap_press(HID_KEY_A), HID_KEY_A);
+    keymap_release(HID_KEY_A);
+}
+
+static void test_oneshot(void) {
+    keymap_init();
+    keymap_set(0, KEY_ONESHOT, KM_OSL(1));
+
+    // Tapped: layer 1 for the next key only
+    CHECK_EQ(keymap_press(KEY_ONESHOT), 0);
+    CHECK_EQ(keymap_release(KEY_ONESHOT), 0);
+    CHECK_EQ(keymap_active_layers(), 0x03);
+    CHECK_EQ(keymap_press(HID_KEY_DELETE), HID_KEY_MUTE);
+    CHECK_EQ(keymap_active_layers(), 0x01);
+    CHECK_EQ(keymap_release(HID_KEY_DELETE), HID_KEY_MUTE);
+    CHECK_EQ(keymap_press(HID_KEY_DELETE), HID_KEY_DELETE);
+    keymap_release(HID_KEY_DELETE);
+
+    // Held: momentary for every key until released
+    keymap_press(KEY_ONESHOT);
+    CHECK_EQ(keymap_press(HID_KEY_ARROW_LEFT), HID_KEY_HOME);
+    keymap_release(HID_KEY_ARROW_LEFT);
+    CHECK_EQ(keymap_press(HID_KEY_ARROW_RIGHT), HID_KEY_END);
+    keymap_release(HID_KEY_ARROW_RIGHT);
+    keymap_release(KEY_ONESHOT);
+    CHECK_EQ(keymap_active_layers(), 0x01);
+}
+
+static void test_edit_and_restore(void) {
+    keymap_init();
+    CHECK(!keymap_set(KEYMAP_NUM_LAYERS, HID_KEY_A, KM_NO));
+    CHECK(keymap_set(0, HID_KEY_CAPS_LOCK, KM_KEY(HID_KEY_CONTROL_LEFT)));
+    CHECK(!keymap_layer_is_default(0));
+    CHECK_EQ(keymap_get(0, HID_KEY_CAPS_LOCK), KM_KEY(HID_KEY_CONTROL_LEFT));
+    CHECK_EQ(keymap_press(HID_KEY_CAPS_LOCK), HID_KEY_CONTROL_LEFT);
+
+    // Held while its entry changes: released through the new entry
+    keymap_set(0, HID_KEY_CAPS_LOCK, KM_KEY(HID_KEY_ESCAPE));
+    CHECK_EQ(keymap_release(HID_KEY_CAPS_LOCK), HID_KEY_ESCAPE);
+
+    // A layer read in place, e.g. from flash
+    static uint16_t saved[256];
+    saved[HID_KEY_B] = KM_KEY(HID_KEY_C);
+    CHECK(keymap_use_layer(3, saved));
+    keymap_set(0, HID_KEY_F12, KM_MO(3));
+    keymap_press(HID_KEY_F12);
+    CHECK_EQ(keymap_press(HID_KEY_B), HID_KEY_C);
+    keymap_release(HID_KEY_B);
+    keymap_release(HID_KEY_F12);
+
+    keymap_init();
+    CHECK(keymap_layer_is_default(0) && keymap_layer_is_default(3));
+    CHECK_EQ(keymap_press(HID_KEY_CAPS_LOCK), HID_KEY_CAPS_LOCK);
+    keymap_release(HID_KEY_CAPS_LOCK);
+}
+
+int main(void) {
+    RUN(test_base_layer);
+    RUN(test_momentary);
+    RUN(test_release_after_layer_change);
+    RUN(test_repeats);
+    RUN(test_oneshot);
+    RUN(test_edit_and_restore);
+    return test_summary();
+}
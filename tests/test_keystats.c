@@ -0,0 +1,205 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * Key Statistics Tests
+ *
+ * The save policy of keystats_take_save() called as main.c does every
+ * pass, and the counters saved through the store on its RAM flash
+ * emulation and restored after a power cycle, as config.c does.
+ */
+
+#include "test.h"
+#include "keystats.h"
+#include "store.h"
+#include "store_flash.h"
+#include <string.h>
+
+#define STORE_KEY_KEYSTATS      1
+#define LOOP_MS                 1
+
+static uint32_t now_ms;
+
+static const void* source(uint8_t key, uint16_t* len) {
+    return key == STORE_KEY_KEYSTATS ? keystats_record(len) : NULL;
+}
+
+//--------------------------------------------------------------------+
+// Helpers
+//--------------------------------------------------------------------+
+
+// Counters cleared, and a pass with USB up so the idle period starts now
+static void reset(void) {
+    now_ms = 100000;
+    keystats_init();
+    keystats_take_save(now_ms, false, false);
+}
+
+static void press(uint8_t key, uint32_t times) {
+    for (uint32_t i = 0; i < times; i++) keystats_press(key);
+}
+
+// Run the main loop for ms; returns how many passes asked for a save
+static int run(uint32_t ms, bool suspended, bool keys_active) {
+    int saves = 0;
+    for (uint32_t end = now_ms + ms; now_ms != end; ) {
+        now_ms += LOOP_MS;
+        saves += keystats_take_save(now_ms, suspended, keys_active);
+    }
+    return saves;
+}
+
+//--------------------------------------------------------------------+
+// Tests
+//--------------------------------------------------------------------+
+
+static void test_counting(void) {
+    reset();
+    uint16_t len = 0;
+    CHECK(keystats_record(&len) == NULL);
+    CHECK_EQ(keystats_total(), 0);
+
+    press(0x04, 3);
+    press(0xE0, 1);
+    CHECK_EQ(keystats_counts[0x04], 3);
+    CHECK_EQ(keystats_counts[0xE0], 1);
+    CHECK_EQ(keystats_total(), 4);
+    CHECK(keystats_record(&len) == keystats_counts);
+    CHECK_EQ(len, sizeof(keystats_counts));
+
+    keystats_init();
+    CHECK_EQ(keystats_total(), 0);
+    CHECK(keystats_record(&len) == NULL);
+}
+
+// Nothing is saved while USB is up or a key is active, however long
+static void test_needs_suspend_and_idle(void) {
+    reset();
+    press(0x04, KEYSTATS_MIN_PRESSES);
+    CHECK_EQ(run(3 * KEYSTATS_IDLE_MS, false, false), 0);
+    CHECK_EQ(run(3 * KEYSTATS_IDLE_MS, true, true), 0);
+
+    // Suspended and idle: saved once the idle time is reached
+    CHECK_EQ(run(KEYSTATS_IDLE_MS - LOOP_MS, true, false), 0);
+    CHECK_EQ(run(LOOP_MS, true, false), 1);
+}
+
+// A key or a resume during the idle time starts it again
+static void test_idle_restarts(void) {
+    reset();
+    press(0x04, KEYSTATS_MIN_PRESSES);
+    CHECK_EQ(run(KEYSTATS_IDLE_MS - LOOP_MS, true, false), 0);
+    CHECK_EQ(run(LOOP_MS, true, true), 0);
+    CHECK_EQ(run(KEYSTATS_IDLE_MS - LOOP_MS, true, false), 0);
+    CHECK_EQ(run(LOOP_MS, false, false), 0);
+    CHECK_EQ(run(KEYSTATS_IDLE_MS - LOOP_MS, true, false), 0);
+    CHECK_EQ(run(LOOP_MS, true, false), 1);
+}
+
+// Fewer than KEYSTATS_MIN_PRESSES new presses are not worth a flash write
+static void test_min_presses(void) {
+    reset();
+    press(0x04, KEYSTATS_MIN_PRESSES - 1);
+    CHECK_EQ(run(2 * KEYSTATS_IDLE_MS, true, false), 0);
+
+    // Counted in the next idle period once enough presses came in
+    press(0x05, 1);
+    CHECK_EQ(run(2 * KEYSTATS_IDLE_MS, true, false), 0);
+    run(LOOP_MS, false, false);
+    CHECK_EQ(run(2 * KEYSTATS_IDLE_MS, true, false), 1);
+
+    // The presses already saved do not count again
+    press(0x05, KEYSTATS_MIN_PRESSES - 1);
+    run(LOOP_MS, true, true);
+    CHECK_EQ(run(2 * KEYSTATS_IDLE_MS, true, false), 0);
+    press(0x05, 1);
+    run(LOOP_MS, true, true);
+    CHECK_EQ(run(2 * KEYSTATS_IDLE_MS, true, false), 1);
+}
+
+// At most one save per idle period, however long it lasts
+static void test_once_per_idle_period(void) {
+    reset();
+    press(0x04, 10 * KEYSTATS_MIN_PRESSES);
+    CHECK_EQ(run(10 * KEYSTATS_IDLE_MS, true, false), 1);
+    press(0x04, 10 * KEYSTATS_MIN_PRESSES);
+    CHECK_EQ(run(10 * KEYSTATS_IDLE_MS, true, false), 0);
+    run(LOOP_MS, false, false);
+    CHECK_EQ(run(10 * KEYSTATS_IDLE_MS, true, false), 1);
+}
+
+// The idle time is measured across the millisecond counter wrapping
+static void test_clock_wrap(void) {
+    reset();
+    now_ms = 0xFFFFFFFFu - KEYSTATS_IDLE_MS / 2;
+    keystats_take_save(now_ms, false, false);
+    press(0x04, KEYSTATS_MIN_PRESSES);
+    CHECK_EQ(run(KEYSTATS_IDLE_MS - LOOP_MS, true, false), 0);
+    CHECK_EQ(run(LOOP_MS, true, false), 1);
+}
+
+// Restored counters count as saved; a record of the wrong size is ignored
+static void test_restore(void) {
+    static uint32_t saved[KEYSTATS_KEYS];
+    reset();
+    memset(saved, 0, sizeof(saved));
+    saved[0x04] = 500;
+    saved[0x2C] = 1000;
+
+    keystats_restore(saved, sizeof(saved) - 4);
+    CHECK_EQ(keystats_total(), 0);
+    keystats_restore(NULL, sizeof(saved));
+    CHECK_EQ(keystats_total(), 0);
+
+    keystats_restore(saved, sizeof(saved));
+    CHECK_EQ(keystats_counts[0x04], 500);
+    CHECK_EQ(keystats_total(), 1500);
+    CHECK_EQ(run(2 * KEYSTATS_IDLE_MS, true, false), 0);
+
+    press(0x04, KEYSTATS_MIN_PRESSES);
+    run(LOOP_MS, false, false);
+    CHECK_EQ(run(2 * KEYSTATS_IDLE_MS, true, false), 1);
+}
+
+// Saved through the store and restored after a power cycle
+static void test_saved_in_store(void) {
+    reset();
+    store_flash_ram_reset();
+    store_init(source);
+
+    press(0x04, 150);
+    press(0x1D, 7);
+    CHECK_EQ(run(KEYSTATS_IDLE_MS, true, false), 1);
+    store_mark_dirty(STORE_KEY_KEYSTATS);
+    CHECK(store_flush());
+
+    // Presses after the save are lost at power-off
+    press(0x04, 5);
+
+    keystats_init();
+    store_init(source);
+    uint16_t len = 0;
+    const void* counts = store_get(STORE_KEY_KEYSTATS, &len);
+    CHECK(counts != NULL);
+    keystats_restore(counts, len);
+    CHECK_EQ(keystats_counts[0x04], 150);
+    CHECK_EQ(keystats_counts[0x1D], 7);
+    CHECK_EQ(keystats_total(), 157);
+
+    // Cleared counters delete the record
+    keystats_init();
+    store_mark_dirty(STORE_KEY_KEYSTATS);
+    CHECK(store_flush());
+    store_init(source);
+    CHECK(store_get(STORE_KEY_KEYSTATS, &len) == NULL);
+}
+
+int main(void) {
+    RUN(test_counting);
+    RUN(test_needs_suspend_and_idle);
+    RUN(test_idle_restarts);
+    RUN(test_min_presses);
+    RUN(test_once_per_idle_period);
+    RUN(test_clock_wrap);
+    RUN(test_restore);
+    RUN(test_saved_in_store);
+    return test_summary();
+}
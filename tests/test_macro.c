@@ -0,0 +1,181 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * Macro Playback Tests
+ *
+ * Built with MACRO_EXAMPLE=1 (Scroll Lock -> Ctrl+Alt+Delete) and the
+ * entries in test_macros.h: F1 has no steps, F2 types "hi". Playback runs
+ * through the report queue and a TinyUSB stand-in whose endpoint the host
+ * polls every HID_POLL_INTERVAL_MS, as main.c sends reports, so both the
+ * reports the host sees and when it sees them are checked.
+ */
+
+#include "test.h"
+#include "tusb.h"
+#include "usb_descriptors.h"
+#include "macro.h"
+#include "paste.h"
+#include "ps2.h"
+#include "report_queue.h"
+#include "hid_keycodes.h"
+#include <string.h>
+
+//--------------------------------------------------------------------+
+// Stand-ins for ps2.c and main.c
+//--------------------------------------------------------------------+
+
+static uint8_t last_queued[REPORT_SIZE];
+
+// The keyboard itself is idle: reports carry only the injected keys
+void ps2_set_injected(uint8_t modifiers, const uint8_t keys[6]) {
+    uint8_t report[REPORT_SIZE] = { modifiers, 0 };
+    memcpy(&report[2], keys, 6);
+    if (memcmp(report, last_queued, REPORT_SIZE) == 0) return;
+    memcpy(last_queued, report, REPORT_SIZE);
+    report_queue_push(report);
+}
+
+// As send_keyboard_report() in main.c
+static void send_keyboard_report(void) {
+    if (!tud_hid_ready()) return;
+    const uint8_t* report = report_queue_peek();
+    if (report && tud_hid_report(0, report, REPORT_SIZE)) report_queue_pop();
+}
+
+static void reset(void) {
+    memset(last_queued, 0, sizeof(last_queued));
+    report_queue_init();
+    macro_init();
+    paste_init();
+    mock_usb_reset();
+    mock_now_ms = 1000;
+}
+
+// Run the main loop every millisecond up to t; the host polls on the interval
+static void run_until(uint32_t t) {
+    while (mock_now_ms < t) {
+        mock_now_ms++;
+        macro_task(mock_now_ms);
+        paste_task();
+        send_keyboard_report();
+        if (mock_now_ms % HID_POLL_INTERVAL_MS == 0) mock_usb_poll(0);
+    }
+}
+
+static bool sent_is(int i, uint8_t modifiers, uint8_t key) {
+    return i < mock_usb_log_count && mock_usb_log[i].len == REPORT_SIZE &&
+           mock_usb_log[i].data[0] == modifiers && mock_usb_log[i].data[2] == key &&
+           mock_usb_log[i].data[3] == 0;
+}
+
+//--------------------------------------------------------------------+
+// Tests
+//--------------------------------------------------------------------+
+
+static void test_example_macro(void) {
+    reset();
+    CHECK(macro_is_bound(HID_KEY_SCROLL_LOCK));
+    CHECK(!macro_is_bound(HID_KEY_A));
+
+    macro_start(HID_KEY_SCROLL_LOCK);
+    CHECK(macro_playing());
+    run_until(1200);
+    CHECK(!macro_playing());
+
+    uint8_t ctrl_alt = HID_MOD_LEFT_CTRL | HID_MOD_LEFT_ALT;
+    CHECK_EQ(mock_usb_log_count, 3);
+    CHECK(sent_is(0, ctrl_alt, 0));
+    CHECK(sent_is(1, ctrl_alt, HID_KEY_DELETE));
+    CHECK(sent_is(2, 0, 0));
+
+    // One report per polling interval; Delete is held for its 50 ms delay
+    CHECK_EQ(mock_usb_log[0].time_ms, 1010);
+    CHECK_EQ(mock_usb_log[1].time_ms, 1020);
+    uint32_t held = mock_usb_log[2].time_ms - mock_usb_log[1].time_ms;
+    CHECK(held >= 50 && held < 50 + HID_POLL_INTERVAL_MS);
+    printf("  Ctrl+Alt+Delete: reports at +%u, +%u, +%u ms\n",
+           mock_usb_log[0].time_ms - 1000, mock_usb_log[1].time_ms - 1000,
+           mock_usb_log[2].time_ms - 1000);
+}
+
+// Zero-delay steps go out back to back, one per polling interval, in order
+static void test_zero_delay_steps(void) {
+    reset();
+    macro_start(HID_KEY_F2);
+    run_until(1100);
+    CHECK_EQ(mock_usb_log_count, 3);
+    CHECK(sent_is(0, 0, HID_KEY_H));
+    CHECK(sent_is(1, 0, HID_KEY_I));
+    CHECK(sent_is(2, 0, 0));
+    for (int i = 1; i < mock_usb_log_count; i++) {
+        CHECK_EQ(mock_usb_log[i].time_ms - mock_usb_log[i - 1].time_ms, HID_POLL_INTERVAL_MS);
+    }
+}
+
+// A macro without steps is not bound, so its key is typed normally
+static void test_empty_macro_not_bound(void) {
+    reset();
+    CHECK(!macro_is_bound(HID_KEY_F1));
+    macro_start(HID_KEY_F1);
+    CHECK(!macro_playing());
+    macro_task(1001);
+    CHECK_EQ(report_queue_peek() == NULL, 1);
+}
+
+static void test_one_macro_at_a_time(void) {
+    reset();
+    macro_start(HID_KEY_F2);
+    macro_start(HID_KEY_SCROLL_LOCK);
+    run_until(1200);
+    CHECK_EQ(mock_usb_log_count, 3);
+    CHECK(sent_is(0, 0, HID_KEY_H));
+}
+
+// Macros and paste mode never interleave their keys
+static void test_paste_excludes_macros(void) {
+    static const uint8_t text[] = { 2, 'a', 'b' };
+
+    reset();
+    paste_receive(text, sizeof(text));
+    CHECK(paste_active());
+    macro_start(HID_KEY_F2);
+    CHECK(!macro_playing());
+    run_until(1200);
+    CHECK(!paste_active());
+    CHECK_EQ(mock_usb_log_count, 3);
+    CHECK(sent_is(0, 0, HID_KEY_A) && sent_is(1, 0, HID_KEY_B) && sent_is(2, 0, 0));
+
+    // Text arriving during a macro waits until the macro has finished
+    reset();
+    macro_start(HID_KEY_F2);
+    run_until(1005);
+    paste_receive(text, sizeof(text));
+    run_until(1200);
+    CHECK_EQ(mock_usb_log_count, 6);
+    CHECK(sent_is(0, 0, HID_KEY_H) && sent_is(1, 0, HID_KEY_I) && sent_is(2, 0, 0));
+    CHECK(sent_is(3, 0, HID_KEY_A) && sent_is(4, 0, HID_KEY_B) && sent_is(5, 0, 0));
+}
+
+// Nothing is queued while the endpoint is busy, so playback waits for the
+// host rather than overrunning the report queue
+static void test_waits_for_host(void) {
+    reset();
+    mock_usb_mounted = false;
+    macro_start(HID_KEY_F2);
+    run_until(1500);
+    CHECK(macro_playing());
+    CHECK_EQ(mock_usb_log_count, 0);
+    mock_usb_mounted = true;
+    run_until(1600);
+    CHECK(!macro_playing());
+    CHECK_EQ(mock_usb_log_count, 3);
+}
+
+int main(void) {
+    RUN(test_example_macro);
+    RUN(test_zero_delay_steps);
+    RUN(test_empty_macro_not_bound);
+    RUN(test_one_macro_at_a_time);
+    RUN(test_paste_excludes_macros);
+    RUN(test_waits_for_host);
+    return test_summary();
+}
@@ -0,0 +1,7 @@
+// Macro table entries for test_macro.c (MACRO_DEFINITIONS)
+{ HID_KEY_F1, NULL, 0 },
+{ HID_KEY_F2, (const macro_step_t[]) {
+    { 0, HID_KEY_H, 0 },
+    { 0, HID_KEY_I, 0 },
+    { 0, 0,         0 },
+  }, 3 },
@@ -0,0 +1,261 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * Paste Mode Tests
+ *
+ * Text goes in through paste_receive() within the free space the firmware
+ * reports, as tools/paste.py sends it, and is typed by paste_task() through
+ * the report queue and the TinyUSB stand-in. The host polls the keyboard
+ * endpoint once per bInterval, so the typing rate measured here is the
+ * one the host would see.
+ *
+ *   test_paste                 run the tests
+ *   test_paste FILE            chars/s for FILE at each bInterval
+ */
+
+#include "test.h"
+#include "tusb.h"
+#include "usb_descriptors.h"
+#include "macro.h"
+#include "paste.h"
+#include "ps2.h"
+#include "report_queue.h"
+#include "hid_keycodes.h"
+#include <stdlib.h>
+#include <string.h>
+
+//--------------------------------------------------------------------+
+// Stand-ins for ps2.c and main.c
+//--------------------------------------------------------------------+
+
+static uint8_t last_queued[REPORT_SIZE];
+
+// The keyboard itself is idle: reports carry only the injected keys
+void ps2_set_injected(uint8_t modifiers, const uint8_t keys[6]) {
+    uint8_t report[REPORT_SIZE] = { modifiers, 0 };
+    memcpy(&report[2], keys, 6);
+    if (memcmp(report, last_queued, REPORT_SIZE) == 0) return;
+    memcpy(last_queued, report, REPORT_SIZE);
+    report_queue_push(report);
+}
+
+// As send_keyboard_report() in main.c
+static void send_keyboard_report(void) {
+    if (!tud_hid_ready()) return;
+    const uint8_t* report = report_queue_peek();
+    if (report && tud_hid_report(0, report, REPORT_SIZE)) report_queue_pop();
+}
+
+//--------------------------------------------------------------------+
+// Harness
+//--------------------------------------------------------------------+
+
+typedef struct {
+    uint32_t reports;           // Reports the host read
+    uint32_t first_ms;          // When it read the first and the last
+    uint32_t last_ms;
+} typed_t;
+
+static void reset(void) {
+    memset(last_queued, 0, sizeof(last_queued));
+    report_queue_init();
+    macro_init();
+    paste_init();
+    mock_usb_reset();
+    mock_now_ms = 1000;
+}
+
+// Send text as the tool does and run the main loop every millisecond
+// until it is typed; the host polls every interval_ms
+static typed_t type_text(const char* text, size_t len, uint32_t interval_ms) {
+    typed_t typed = {0};
+    size_t sent = 0;
+    uint32_t limit = mock_now_ms + 1000 + (uint32_t) len * 4 * interval_ms;
+
+    while ((sent < len || paste_active() || report_queue_peek() || !tud_hid_ready()) &&
+           mock_now_ms < limit) {
+        while (sent < len && paste_free() > 0) {
+            uint8_t report[PASTE_REPORT_SIZE] = {0};
+            size_t chunk = len - sent;
+            if (chunk > PASTE_REPORT_SIZE - 1) chunk = PASTE_REPORT_SIZE - 1;
+            if (chunk > paste_free()) chunk = paste_free();
+            report[0] = (uint8_t) chunk;
+            memcpy(&report[1], &text[sent], chunk);
+            paste_receive(report, sizeof(report));
+            sent += chunk;
+        }
+
+        mock_now_ms++;
+        paste_task();
+        send_keyboard_report();
+        if (mock_now_ms % interval_ms == 0 && mock_usb_poll(0)) {
+            if (typed.reports++ == 0) typed.first_ms = mock_now_ms;
+            typed.last_ms = mock_now_ms;
+        }
+    }
+    return typed;
+}
+
+static typed_t type_string(const char* text) {
+    reset();
+    return type_text(text, strlen(text), HID_POLL_INTERVAL_MS);
+}
+
+static bool sent_is(int i, uint8_t modifiers, uint8_t key) {
+    static const uint8_t no_keys[5] = {0};
+    return i < mock_usb_log_count && mock_usb_log[i].len == REPORT_SIZE &&
+           mock_usb_log[i].data[0] == modifiers && mock_usb_log[i].data[2] == key &&
+           memcmp(&mock_usb_log[i].data[3], no_keys, sizeof(no_keys)) == 0;
+}
+
+//--------------------------------------------------------------------+
+// Tests
+//--------------------------------------------------------------------+
+
+// One report per character and a final release
+static void test_one_report_per_key(void) {
+    typed_t typed = type_string("abc");
+    CHECK_EQ(typed.reports, 4);
+    CHECK(sent_is(0, 0, HID_KEY_A));
+    CHECK(sent_is(1, 0, HID_KEY_B));
+    CHECK(sent_is(2, 0, HID_KEY_C));
+    CHECK(sent_is(3, 0, 0));
+    CHECK(!paste_active());
+}
+
+// A key typed twice in a row is released in between
+static void test_repeated_key(void) {
+    typed_t typed = type_string("hello");
+    CHECK_EQ(typed.reports, 7);
+    CHECK(sent_is(2, 0, HID_KEY_L));
+    CHECK(sent_is(3, 0, 0));
+    CHECK(sent_is(4, 0, HID_KEY_L));
+    CHECK(sent_is(5, 0, HID_KEY_O));
+
+    // Three in a row: a release before each repeat
+    typed = type_string("aaa");
+    CHECK_EQ(typed.reports, 6);
+
+    // The release keeps Shift down between two shifted repeats
+    typed = type_string("LL");
+    CHECK_EQ(typed.reports, 4);
+    CHECK(sent_is(0, HID_MOD_LEFT_SHIFT, HID_KEY_L));
+    CHECK(sent_is(1, HID_MOD_LEFT_SHIFT, 0));
+    CHECK(sent_is(2, HID_MOD_LEFT_SHIFT, HID_KEY_L));
+    CHECK(sent_is(3, 0, 0));
+}
+
+// Shift changes with the next key in the same report; only the same key
+// with a different shift state needs a release
+static void test_shift_changes(void) {
+    typed_t typed = type_string("aBc!1");
+    CHECK_EQ(typed.reports, 7);
+    CHECK(sent_is(0, 0, HID_KEY_A));
+    CHECK(sent_is(1, HID_MOD_LEFT_SHIFT, HID_KEY_B));
+    CHECK(sent_is(2, 0, HID_KEY_C));
+    CHECK(sent_is(3, HID_MOD_LEFT_SHIFT, HID_KEY_1));
+    CHECK(sent_is(4, HID_MOD_LEFT_SHIFT, 0));
+    CHECK(sent_is(5, 0, HID_KEY_1));
+    CHECK(sent_is(6, 0, 0));
+
+    typed = type_string("A!B");
+    CHECK_EQ(typed.reports, 4);
+    CHECK(sent_is(1, HID_MOD_LEFT_SHIFT, HID_KEY_1));
+}
+
+// A report never holds more than the one key being typed, so any number
+// of different keys stays within the boot report's six slots
+static void test_six_key_limit(void) {
+    typed_t typed = type_string("qwertyuiop");
+    CHECK_EQ(typed.reports, 11);
+    for (int i = 0; i < mock_usb_log_count; i++) {
+        int keys = 0;
+        for (int k = 2; k < REPORT_SIZE; k++) keys += mock_usb_log[i].data[k] != 0;
+        CHECK(keys <= 1);
+        CHECK_EQ(mock_usb_log[i].data[1], 0);
+    }
+    CHECK(sent_is(9, 0, HID_KEY_P));
+}
+
+// CR before LF and characters without a key are not typed
+static void test_dropped_characters(void) {
+    typed_t typed = type_string("a\r\nb\x7f" "c\x01");
+    CHECK_EQ(typed.reports, 5);
+    CHECK(sent_is(1, 0, HID_KEY_ENTER));
+    CHECK(sent_is(3, 0, HID_KEY_C));
+
+    typed = type_string("\r");
+    CHECK_EQ(typed.reports, 0);
+    CHECK(!paste_active());
+}
+
+// Text longer than the FIFO is fed as space frees up and typed in full
+static void test_flow_control(void) {
+    static char text[3 * PASTE_FIFO_SIZE];
+    for (size_t i = 0; i < sizeof(text); i++) text[i] = (char) ('a' + i % 26);
+    reset();
+    typed_t typed = type_text(text, sizeof(text), 1);
+    CHECK_EQ(typed.reports, sizeof(text) + 1);
+    CHECK_EQ(paste_free(), PASTE_FIFO_SIZE);
+}
+
+// The host reads one report per bInterval, back to back
+static void test_rate(void) {
+    static const char text[] = "setup password=Kiosk-2024; boot order: usb,hdd\n";
+    size_t chars = sizeof(text) - 1;
+    static const uint32_t intervals[] = { 1, 2, 4, 8, 10 };
+
+    for (unsigned i = 0; i < sizeof(intervals) / sizeof(intervals[0]); i++) {
+        reset();
+        typed_t typed = type_text(text, chars, intervals[i]);
+        CHECK_EQ(typed.reports, chars + 4);     // "ss", "oo", "dd" and the final release
+        CHECK_EQ(typed.last_ms - typed.first_ms, (typed.reports - 1) * intervals[i]);
+        printf("  bInterval %2u ms: %lu reports, %6.1f chars/s\n", intervals[i],
+               (unsigned long) typed.reports, chars * 1000.0 / (typed.reports * intervals[i]));
+    }
+}
+
+//--------------------------------------------------------------------+
+// Estimate for a file
+//--------------------------------------------------------------------+
+
+static int estimate(const char* path) {
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return 1;
+    }
+    size_t size = 0, capacity = 4096;
+    char* text = malloc(capacity);
+    size_t n;
+    while (text && (n = fread(text + size, 1, capacity - size, f)) > 0) {
+        size += n;
+        if (size == capacity) text = realloc(text, capacity *= 2);
+    }
+    fclose(f);
+    if (!text) return 1;
+
+    printf("%s: %lu bytes\n", path, (unsigned long) size);
+    static const uint32_t intervals[] = { 1, 2, 4, 8, 10 };
+    for (unsigned i = 0; i < sizeof(intervals) / sizeof(intervals[0]); i++) {
+        reset();
+        typed_t typed = type_text(text, size, intervals[i]);
+        double seconds = typed.reports * intervals[i] / 1000.0;
+        printf("  bInterval %2u ms: %lu reports, %8.2f s, %7.1f chars/s\n", intervals[i],
+               (unsigned long) typed.reports, seconds, seconds > 0 ? size / seconds : 0.0);
+    }
+    free(text);
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc == 2) return estimate(argv[1]);
+
+    RUN(test_one_report_per_key);
+    RUN(test_repeated_key);
+    RUN(test_shift_changes);
+    RUN(test_six_key_limit);
+    RUN(test_dropped_characters);
+    RUN(test_flow_control);
+    RUN(test_rate);
+    return test_summary();
+}
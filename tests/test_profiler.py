@@ -0,0 +1,162 @@
+#!/usr/bin/env python3
+"""
+PS/2 to USB HID Keyboard Bridge - profile viewer symbol lookup
+
+Builds a small Arm ELF32 image in memory, with Thumb function symbols
+(bit 0 set), aliases, gaps, functions without a size and data symbols,
+and checks which function tools/profiler.py resolves each PC to:
+
+  test_profiler.py
+
+tests/CMakeLists.txt runs this under ctest.
+"""
+
+import os
+import struct
+import sys
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'tools'))
+import profiler  # noqa: E402
+
+SHT_STRTAB = 3
+STT_OBJECT = 1
+STB_GLOBAL = 1
+
+failures = 0
+
+
+def check(cond, what):
+    global failures
+    if not cond:
+        failures += 1
+        print(f"  FAIL: {what}")
+
+
+def elf32(symbols, machine=profiler.EM_ARM, symtab=True):
+    """A little-endian ELF32 file holding only a symbol table. symbols is a
+    list of (name, value, size, type)."""
+    strings = b'\0'
+    entries = struct.pack('<IIIBBH', 0, 0, 0, 0, 0, 0)
+    for name, value, size, kind in symbols:
+        entries += struct.pack('<IIIBBH', len(strings), value, size, (STB_GLOBAL << 4) | kind, 0, 1)
+        strings += name.encode() + b'\0'
+
+    header_size, section_size = 52, 40
+    strtab_offset = header_size
+    symtab_offset = strtab_offset + len(strings)
+    shoff = symtab_offset + len(entries)
+    # (name, type, flags, addr, offset, size, link, info, align, entsize)
+    sections = [(0,) * 10,
+                (0, SHT_STRTAB, 0, 0, strtab_offset, len(strings), 0, 0, 1, 0),
+                (0, profiler.SHT_SYMTAB if symtab else SHT_STRTAB, 0, 0, symtab_offset,
+                 len(entries), 1, 1, 4, 16)]
+
+    header = b'\x7fELF' + bytes([1, 1, 1]) + bytes(9)
+    header += struct.pack('<HHIIIIIHHHHHH', 2, machine, 1, 0, 0, shoff, 0,
+                          header_size, 0, 0, section_size, len(sections), 1)
+    return header + strings + entries + b''.join(struct.pack('<10I', *s) for s in sections)
+
+
+SYMBOLS = [
+    ('main', 0x10000101, 0x40, profiler.STT_FUNC),
+    # A gap of 0x40 after main
+    ('ps2_task', 0x10000181, 0x20, profiler.STT_FUNC),
+    # Aliases: the first with a size is kept, wherever it is in the table
+    ('isr_unused', 0x10000201, 0, profiler.STT_FUNC),
+    ('isr_hardfault', 0x10000201, 0x10, profiler.STT_FUNC),
+    ('isr_nmi', 0x10000201, 0x10, profiler.STT_FUNC),
+    ('memcpy', 0x10000301, 0x30, profiler.STT_FUNC),
+    ('__wrap_memcpy', 0x10000301, 0x30, profiler.STT_FUNC),
+    # From assembly: no size, taken to end at the next function
+    ('crt0_entry', 0x10000401, 0, profiler.STT_FUNC),
+    ('runtime_init', 0x10000481, 0x20, profiler.STT_FUNC),
+    # Data is not a function, even between functions
+    ('keymap_layers', 0x100004a0, 0x40, STT_OBJECT),
+    ('ram_buffer', 0x20000000, 0x100, STT_OBJECT),
+    # A RAM function without a size is the last one, so it runs on
+    ('time_critical', 0x20001001, 0, profiler.STT_FUNC),
+]
+
+
+def test_functions():
+    functions = profiler.read_functions(elf32(SYMBOLS))
+    addresses = [f[0] for f in functions]
+    check(addresses == sorted(addresses), "functions sorted by address")
+    check(all(address % 2 == 0 for address in addresses), "Thumb bit cleared")
+    check(len(functions) == 7, f"{len(functions)} functions, expected 7")
+    check((0x10000200, 0x10, 'isr_hardfault') in functions, "sized alias kept over one without a size")
+    check((0x10000300, 0x30, 'memcpy') in functions, "first alias kept")
+    check(not any(name in ('keymap_layers', 'ram_buffer') for _, _, name in functions), "data symbols left out")
+
+
+def test_lookup():
+    symbols = profiler.Symbols(profiler.read_functions(elf32(SYMBOLS)))
+    expected = [
+        (0x10000000, None),                 # before the first function
+        (0x10000100, 'main'),
+        (0x10000101, 'main'),               # an odd PC is still inside
+        (0x1000013e, 'main'),
+        (0x10000140, None),                 # just past main, in the gap
+        (0x1000017e, None),
+        (0x10000180, 'ps2_task'),
+        (0x1000019e, 'ps2_task'),
+        (0x100001a0, None),
+        (0x10000200, 'isr_hardfault'),
+        (0x1000020e, 'isr_hardfault'),
+        (0x10000210, None),
+        (0x10000300, 'memcpy'),
+        (0x1000032e, 'memcpy'),
+        (0x10000400, 'crt0_entry'),
+        (0x1000047e, 'crt0_entry'),         # up to the next function
+        (0x10000480, 'runtime_init'),
+        (0x100004a0, None),                 # in keymap_layers
+        (0x20000010, None),                 # in ram_buffer
+        (0x20001000, 'time_critical'),
+        (0x20041000, 'time_critical'),
+    ]
+    for pc, name in expected:
+        got = symbols.lookup(pc)
+        check(got == name, f"{pc:#010x}: got {got}, expected {name}")
+
+
+# PCs without a function are shown as unknown: boot ROM or the address
+def test_labels():
+    symbols = profiler.Symbols(profiler.read_functions(elf32(SYMBOLS)))
+    check(profiler.label(symbols, 0x00000120) == '[boot rom]', "boot ROM")
+    check(profiler.label(symbols, 0x10000150) == '[0x10000150]', "gap")
+    check(profiler.label(symbols, 0x10000400) == 'crt0_entry', "known function")
+
+    empty = profiler.Symbols([])
+    check(empty.lookup(0x10000100) is None, "no functions")
+
+
+# Bit 0 is only an instruction set flag on Arm
+def test_other_machine():
+    functions = profiler.read_functions(elf32([('f', 0x1001, 4, profiler.STT_FUNC)], machine=3))
+    check(functions == [(0x1001, 4, 'f')], f"non-Arm address kept: {functions}")
+
+
+def test_errors():
+    for data, message in [(b'MZ\0\0' + bytes(60), "not an ELF file"),
+                          (b'\x7fELF' + bytes([3, 1]) + bytes(58), "unsupported ELF class or encoding"),
+                          (elf32(SYMBOLS, symtab=False), "no symbol table (stripped?)")]:
+        try:
+            profiler.read_functions(data)
+        except profiler.ElfError as e:
+            check(str(e) == message, f"got '{e}', expected '{message}'")
+        else:
+            check(False, f"no error for '{message}'")
+
+
+def main():
+    tests = [test_functions, test_lookup, test_labels, test_other_machine, test_errors]
+    for test in tests:
+        before = failures
+        test()
+        print(f"{'ok  ' if failures == before else 'FAIL'} {test.__name__}")
+    print(f"{failures} failed")
+    return 1 if failures else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
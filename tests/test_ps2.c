@@ -0,0 +1,278 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * PS/2 Decoder Tests
+ *
+ * ps2.c runs against the GPIO and clock stand-ins: each byte is clocked in
+ * bit by bit as a keyboard would send it, with ps2_task() polling both
+ * clock phases, and the reports it queues are checked. Also built with
+ * PS2_HOT_PATH_IN_RAM=1, where the clock must be held low while each byte
+ * is handled, and with key statistics.
+ */
+
+#include "test.h"
+#include "pico/time.h"
+#include "hardware/gpio.h"
+#include "ps2.h"
+#include "report_queue.h"
+#include "keystats.h"
+#include "boot_timing.h"
+#include "hid_keycodes.h"
+#include <string.h>
+
+static uint8_t reports[64][REPORT_SIZE];
+static int report_count;
+
+static void reset(void) {
+    // Past the power-on window in which F1-F3 select the USB profile
+    mock_time_reset(10 * 1000 * 1000);
+    ps2_init();
+    report_count = 0;
+}
+
+static void collect(void) {
+    const uint8_t* report;
+    while ((report = report_queue_peek()) != NULL) {
+        if (report_count < 64) memcpy(reports[report_count++], report, REPORT_SIZE);
+        report_queue_pop();
+    }
+}
+
+static void clock_bit(bool bit) {
+    mock_gpio_line[PS2_DATA_PIN] = bit;
+    mock_time_advance_us(20);
+    ps2_task();
+    mock_gpio_line[PS2_CLOCK_PIN] = false;
+    mock_time_advance_us(40);
+    ps2_task();
+    mock_gpio_line[PS2_CLOCK_PIN] = true;
+    mock_time_advance_us(20);
+    ps2_task();
+}
+
+static void send_byte(uint8_t byte) {
+    bool parity = true;
+    clock_bit(false);
+    for (int i = 0; i < 8; i++) {
+        bool bit = (byte >> i) & 1;
+        parity ^= bit;
+        clock_bit(bit);
+    }
+    clock_bit(parity);
+    clock_bit(true);
+    mock_gpio_line[PS2_DATA_PIN] = true;
+    mock_time_advance_us(1000);
+    ps2_task();
+}
+
+static void send(const uint8_t* bytes, int count) {
+    for (int i = 0; i < count; i++) send_byte(bytes[i]);
+    collect();
+}
+
+static bool report_is(int i, uint8_t modifiers, uint8_t key) {
+    static const uint8_t zero[4] = { 0 };
+    return i < report_count && reports[i][0] == modifiers && reports[i][1] == 0 &&
+           reports[i][2] == key && reports[i][3] == 0 && memcmp(&reports[i][4], zero, 4) == 0;
+}
+
+static void test_key_press_release(void) {
+    static const uint8_t bytes[] = { 0x1C, 0xF0, 0x1C };
+    reset();
+    send(bytes, sizeof(bytes));
+    CHECK_EQ(report_count, 2);
+    CHECK(report_is(0, 0, HID_KEY_A));
+    CHECK(report_is(1, 0, 0));
+    CHECK(ps2_kbd_state() == PS2_KBD_READY);
+}
+
+static void test_modifier_and_extended(void) {
+    static const uint8_t bytes[] = { 0xE0, 0x14, 0xE0, 0x75, 0xE0, 0xF0, 0x75, 0xE0, 0xF0, 0x14 };
+    reset();
+    send(bytes, sizeof(bytes));
+    CHECK_EQ(report_count, 4);
+    CHECK(report_is(0, HID_MOD_RIGHT_CTRL, 0));
+    CHECK(report_is(1, HID_MOD_RIGHT_CTRL, HID_KEY_ARROW_UP));
+    CHECK(report_is(2, HID_MOD_RIGHT_CTRL, 0));
+    CHECK(report_is(3, 0, 0));
+}
+
+static void test_lock_keys(void) {
+    static const uint8_t num[] = { 0x77, 0xF0, 0x77 };
+    static const uint8_t scroll[] = { 0x7E, 0xF0, 0x7E };
+    reset();
+    send(num, sizeof(num));
+    CHECK(report_is(0, 0, HID_KEY_NUM_LOCK));
+    send(scroll, sizeof(scroll));
+    CHECK(report_is(2, 0, HID_KEY_SCROLL_LOCK));
+}
+
+// Pause is one press and release, with no Ctrl or Num Lock from its bytes
+static void test_pause(void) {
+    static const uint8_t bytes[] = { 0xE1, 0x14, 0x77, 0xE1, 0xF0, 0x14, 0xF0, 0x77 };
+    reset();
+    send(bytes, sizeof(bytes));
+    CHECK_EQ(report_count, 2);
+    CHECK(report_is(0, 0, HID_KEY_PAUSE));
+    CHECK(report_is(1, 0, 0));
+
+    // Decoding carries on normally afterwards
+    static const uint8_t a[] = { 0x1C, 0xF0, 0x1C };
+    send(a, sizeof(a));
+    CHECK(report_is(2, 0, HID_KEY_A));
+}
+
+// Six keys fill the report; a seventh is dropped, not swapped in
+static void test_six_keys(void) {
+    static const uint8_t codes[] = { 0x1C, 0x32, 0x21, 0x23, 0x24, 0x2B, 0x34 };
+    reset();
+    send(codes, sizeof(codes));
+    CHECK_EQ(report_count, 6);
+    CHECK(report_count == 6 && reports[5][7] == HID_KEY_F);
+    static const uint8_t release_b[] = { 0xF0, 0x32 };
+    send(release_b, sizeof(release_b));
+    CHECK(report_count == 7 && reports[6][3] == 0 && reports[6][4] == HID_KEY_C);
+}
+
+static void test_bat(void) {
+    static const uint8_t bat[] = { PS2_BAT_PASSED };
+    reset();
+    CHECK(ps2_kbd_state() == PS2_KBD_POWER_UP);
+    send(bat, 1);
+    CHECK(ps2_kbd_state() == PS2_KBD_READY);
+    CHECK_EQ(report_count, 0);
+}
+
+// A failed self-test is reported as such; the keyboard's keys still work
+static void test_bat_failed(void) {
+    static const uint8_t bat[] = { PS2_BAT_FAILED };
+    static const uint8_t a[] = { 0x1C, 0xF0, 0x1C };
+    reset();
+    send(bat, 1);
+    CHECK(ps2_kbd_state() == PS2_KBD_BAT_FAILED);
+    CHECK_EQ(report_count, 0);
+    send(a, sizeof(a));
+    CHECK(ps2_kbd_state() == PS2_KBD_BAT_FAILED);
+    CHECK(report_is(0, 0, HID_KEY_A));
+
+    // A keyboard plugged in later passes its self-test
+    static const uint8_t passed[] = { PS2_BAT_PASSED };
+    send(passed, 1);
+    CHECK(ps2_kbd_state() == PS2_KBD_READY);
+}
+
+// A keyboard that was already running sends no self-test result; it
+// counts as ready once PS2_BAT_TIMEOUT_MS pass without a byte
+static void test_bat_timeout(void) {
+    reset();
+    for (int ms = 1; ms < PS2_BAT_TIMEOUT_MS; ms++) {
+        mock_time_advance_us(1000);
+        ps2_task();
+    }
+    CHECK(ps2_kbd_state() == PS2_KBD_POWER_UP);
+    mock_time_advance_us(1000);
+    ps2_task();
+    CHECK(ps2_kbd_state() == PS2_KBD_READY);
+    CHECK(boot_timing_get(BOOT_PS2_READY) != 0);
+
+    // Any scancode before that also means the keyboard is running
+    static const uint8_t a[] = { 0x1C };
+    reset();
+    send(a, 1);
+    CHECK(ps2_kbd_state() == PS2_KBD_READY);
+}
+
+// Keys typed before the host has enumerated the device, even before the
+// self-test result, wait in the report queue in order
+static void test_keys_before_mount(void) {
+    static const uint8_t early[] = { 0x1C, 0xF0, 0x1C };
+    static const uint8_t bat[] = { PS2_BAT_PASSED };
+    static const uint8_t later[] = {
+        0x32, 0xF0, 0x32, 0x21, 0xF0, 0x21, 0x23, 0xF0, 0x23,
+        0x24, 0xF0, 0x24, 0x2B, 0xF0, 0x2B, 0x34, 0xF0, 0x34, 0x33, 0xF0, 0x33,
+    };
+    reset();
+    for (unsigned i = 0; i < sizeof(early); i++) send_byte(early[i]);
+    send_byte(bat[0]);
+    for (unsigned i = 0; i < sizeof(later); i++) send_byte(later[i]);
+    CHECK(ps2_kbd_state() == PS2_KBD_READY);
+
+    // The host reads the queue once it has configured the device
+    collect();
+    static const uint8_t keys[] = { HID_KEY_A, HID_KEY_B, HID_KEY_C, HID_KEY_D, HID_KEY_E,
+                                    HID_KEY_F, HID_KEY_G, HID_KEY_H };
+    CHECK_EQ(report_count, 2 * sizeof(keys));
+    for (unsigned i = 0; i < sizeof(keys); i++) {
+        CHECK(report_is(2 * i, 0, keys[i]));
+        CHECK(report_is(2 * i + 1, 0, 0));
+    }
+}
+
+// Injected keys merge into the report; unchanged state queues nothing
+static void test_injected_keys(void) {
+    static const uint8_t keys[6] = { HID_KEY_DELETE };
+    static const uint8_t none[6] = { 0 };
+    static const uint8_t a[] = { 0x1C };
+    reset();
+    send(a, 1);
+    ps2_set_injected(HID_MOD_LEFT_CTRL, keys);
+    ps2_set_injected(HID_MOD_LEFT_CTRL, keys);
+    collect();
+    CHECK_EQ(report_count, 2);
+    CHECK(report_count == 2 && reports[1][0] == HID_MOD_LEFT_CTRL &&
+          reports[1][2] == HID_KEY_A && reports[1][3] == HID_KEY_DELETE);
+    ps2_set_injected(0, none);
+    collect();
+    CHECK(report_is(2, 0, HID_KEY_A));
+}
+
+#if KEYSTATS_ENABLE
+// Presses are counted once each as they leave the chatter filter;
+// typematic repeats are not
+static void test_key_statistics(void) {
+    static const uint8_t bytes[] = {
+        0x1C, 0x1C, 0x1C, 0x1C, 0xF0, 0x1C,     // A held, repeating
+        0x1C, 0x32, 0x32, 0xF0, 0x32, 0xF0, 0x1C,
+        0xE0, 0x75, 0xE0, 0x75, 0xE0, 0xF0, 0x75,
+    };
+    reset();
+    send(bytes, sizeof(bytes));
+    CHECK_EQ(keystats_counts[HID_KEY_A], 2);
+    CHECK_EQ(keystats_counts[HID_KEY_B], 1);
+    CHECK_EQ(keystats_counts[HID_KEY_ARROW_UP], 1);
+    CHECK_EQ(keystats_total(), 4);
+}
+#endif
+
+static void test_clock_hold(void) {
+    static const uint8_t bytes[] = { 0x1C, 0xF0, 0x1C };
+    reset();
+    uint32_t before = mock_gpio_held_low[PS2_CLOCK_PIN];
+    send(bytes, sizeof(bytes));
+    uint32_t holds = mock_gpio_held_low[PS2_CLOCK_PIN] - before;
+#if PS2_HOT_PATH_IN_RAM
+    CHECK_EQ(holds, 3);
+#else
+    CHECK_EQ(holds, 0);
+#endif
+    // Released again afterwards
+    CHECK(mock_gpio_dir[PS2_CLOCK_PIN] == GPIO_IN);
+    CHECK_EQ(report_count, 2);
+}
+
+int main(void) {
+    RUN(test_key_press_release);
+    RUN(test_modifier_and_extended);
+    RUN(test_lock_keys);
+    RUN(test_pause);
+    RUN(test_six_keys);
+    RUN(test_bat);
+    RUN(test_bat_failed);
+    RUN(test_bat_timeout);
+    RUN(test_keys_before_mount);
+    RUN(test_injected_keys);
+#if KEYSTATS_ENABLE
+    RUN(test_key_statistics);
+#endif
+    RUN(test_clock_hold);
+    return test_summary();
+}
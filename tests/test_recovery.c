@@ -0,0 +1,165 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * Watchdog Recovery Tests
+ *
+ * The record is a plain variable here, standing in for the RAM that
+ * survives a reset. A run sets it through the hooks as the main loop
+ * does; a reset is recovery_boot() on the same record, told whether the
+ * watchdog timed out, as recovery_pico.c does after every start.
+ */
+
+#include "test.h"
+#include "recovery.h"
+#include <string.h>
+
+static recovery_record_t record;
+
+//--------------------------------------------------------------------+
+// Helpers
+//--------------------------------------------------------------------+
+
+// Power-on: RAM holds whatever it powers up with
+static bool power_on(uint8_t fill) {
+    memset(&record, fill, sizeof(record));
+    return recovery_boot(&record, false);
+}
+
+// A run up to where it stops: bytes_count PS/2 bytes from first, a report
+// with key held, and the main loop in stage at uptime_ms
+static void run(recovery_stage_t stage, uint8_t key, uint8_t first, int bytes_count, uint32_t uptime_ms) {
+    for (int i = 0; i < bytes_count; i++) recovery_ps2_byte((uint8_t) (first + i));
+    uint8_t report[8] = { 0, 0, key, 0, 0, 0, 0, 0 };
+    recovery_report(report);
+    recovery_alive(uptime_ms);
+    recovery_stage(STAGE_USB);
+    recovery_stage(stage);
+}
+
+//--------------------------------------------------------------------+
+// Tests
+//--------------------------------------------------------------------+
+
+// Random RAM is not taken for a record
+static void test_power_on(void) {
+    static const uint8_t fills[] = { 0x00, 0xFF, 0x59, 0xA5 };
+    for (unsigned i = 0; i < sizeof(fills); i++) {
+        CHECK(!power_on(fills[i]));
+        CHECK_EQ(recovery_cause(), RECOVERY_POWER_ON);
+        CHECK(recovery_rec == &record);
+        CHECK_EQ(record.resets, 0);
+        CHECK_EQ(record.watchdog_resets, 0);
+        CHECK_EQ(record.stage, STAGE_NONE);
+        CHECK_EQ(record.report[2], 0);
+    }
+
+    // One magic word intact is not enough
+    power_on(0);
+    record.magic_check = 0;
+    CHECK(!recovery_boot(&record, false));
+    CHECK_EQ(recovery_cause(), RECOVERY_POWER_ON);
+}
+
+// A hang: the stage, report and PS/2 bytes of the run are kept, and the
+// keys are released
+static void test_watchdog_reset(void) {
+    power_on(0xA5);
+    run(STAGE_STORE, 0x04, 0x10, 5, 1234);
+
+    CHECK(recovery_boot(&record, true));
+    CHECK_EQ(recovery_cause(), RECOVERY_WATCHDOG);
+    const recovery_record_t* last = recovery_last();
+    CHECK_EQ(last->stage, STAGE_STORE);
+    CHECK_EQ(last->uptime_ms, 1234);
+    CHECK_EQ(last->report[2], 0x04);
+    CHECK_EQ(record.resets, 1);
+    CHECK_EQ(record.watchdog_resets, 1);
+    CHECK(strcmp(recovery_stage_name(last->stage), "store") == 0);
+
+    // Oldest byte first; unused entries are zero
+    for (int i = 0; i < RECOVERY_PS2_BYTES; i++) {
+        CHECK_EQ(last->ps2_bytes[i], i < RECOVERY_PS2_BYTES - 5 ? 0 : 0x10 + i - (RECOVERY_PS2_BYTES - 5));
+    }
+
+    // The new run starts from a clean record
+    CHECK_EQ(record.stage, STAGE_NONE);
+    CHECK_EQ(record.uptime_ms, 0);
+    CHECK_EQ(record.report[2], 0);
+    CHECK_EQ(record.ps2_bytes[RECOVERY_PS2_BYTES - 1], 0);
+
+    // A watchdog reset releases keys even if none were down
+    run(STAGE_PS2, 0, 0x20, 1, 10);
+    CHECK(recovery_boot(&record, true));
+    CHECK_EQ(recovery_last()->stage, STAGE_PS2);
+    CHECK_EQ(record.resets, 2);
+    CHECK_EQ(record.watchdog_resets, 2);
+}
+
+// The PS/2 byte ring keeps the last RECOVERY_PS2_BYTES, oldest first
+static void test_ps2_ring(void) {
+    power_on(0);
+    run(STAGE_PS2, 0, 0, 3 * RECOVERY_PS2_BYTES + 3, 99);
+    recovery_boot(&record, true);
+    for (int i = 0; i < RECOVERY_PS2_BYTES; i++) {
+        CHECK_EQ(recovery_last()->ps2_bytes[i], 2 * RECOVERY_PS2_BYTES + 3 + i);
+    }
+    CHECK_EQ(recovery_last()->ps2_next, 0);
+}
+
+// Other resets release keys only if some were down
+static void test_other_reset(void) {
+    power_on(0);
+    run(STAGE_HID, 0, 0x30, 2, 500);
+    CHECK(!recovery_boot(&record, false));
+    CHECK_EQ(recovery_cause(), RECOVERY_RESET);
+    CHECK_EQ(recovery_last()->stage, STAGE_HID);
+    CHECK_EQ(record.resets, 1);
+    CHECK_EQ(record.watchdog_resets, 0);
+
+    run(STAGE_HID, 0x2C, 0x30, 2, 500);
+    CHECK(recovery_boot(&record, false));
+    CHECK_EQ(recovery_cause(), RECOVERY_RESET);
+    CHECK_EQ(record.resets, 2);
+
+    // Modifiers count as keys down
+    recovery_report((const uint8_t[8]) { 0x02, 0, 0, 0, 0, 0, 0, 0 });
+    CHECK(recovery_boot(&record, false));
+
+    // Counters run on across resets until power is lost
+    run(STAGE_CLOCK, 0, 0, 0, 1);
+    recovery_boot(&record, true);
+    CHECK_EQ(record.resets, 4);
+    CHECK_EQ(record.watchdog_resets, 1);
+    CHECK(!power_on(0));
+    CHECK_EQ(record.resets, 0);
+}
+
+// A stage number the firmware never writes is reported as start-up
+static void test_bad_stage(void) {
+    power_on(0);
+    record.stage = STAGE_COUNT + 3;
+    recovery_boot(&record, true);
+    CHECK_EQ(recovery_last()->stage, STAGE_NONE);
+    CHECK(strcmp(recovery_stage_name(STAGE_NONE), "start-up") == 0);
+    CHECK(strcmp(recovery_stage_name(STAGE_COUNT), "?") == 0);
+    for (uint8_t stage = 0; stage < STAGE_COUNT; stage++) {
+        CHECK(recovery_stage_name(stage) != NULL);
+    }
+}
+
+// A watchdog reset with a lost record still releases keys
+static void test_watchdog_without_record(void) {
+    memset(&record, 0x5A, sizeof(record));
+    CHECK(recovery_boot(&record, true));
+    CHECK_EQ(recovery_cause(), RECOVERY_POWER_ON);
+    CHECK_EQ(record.resets, 0);
+}
+
+int main(void) {
+    RUN(test_power_on);
+    RUN(test_watchdog_reset);
+    RUN(test_ps2_ring);
+    RUN(test_other_reset);
+    RUN(test_bad_stage);
+    RUN(test_watchdog_without_record);
+    return test_summary();
+}
@@ -0,0 +1,130 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * Report Snapshot Torture Test
+ *
+ * One writer publishes reports whose eight bytes all derive from a counter,
+ * so any mix of two reports is detectable. Reader threads copy the snapshot
+ * as fast as they can on other cores, and a timer signal interrupts the
+ * writer mid-publish to read from inside it, as an interrupt handler on
+ * the writer's core would. Every copy must be a whole report, and no
+ * reader may see the counter go backwards.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "test.h"
+#include "report_snapshot.h"
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <sys/time.h>
+
+#define READERS                 3
+#define PUBLISHES               20000000u
+
+static atomic_bool done;
+
+// A report made from n: bytes 0-3 are n, bytes 4-7 its complement
+static void make_report(uint32_t n, uint8_t report[REPORT_SIZE]) {
+    uint32_t words[2] = { n, ~n };
+    memcpy(report, words, REPORT_SIZE);
+}
+
+// The counter of a whole report, or -1 for a torn one
+static int64_t check_report(const uint8_t report[REPORT_SIZE]) {
+    uint32_t words[2];
+    memcpy(words, report, REPORT_SIZE);
+    return words[1] == ~words[0] ? (int64_t) words[0] : -1;
+}
+
+typedef struct {
+    uint64_t reads;
+    uint64_t torn;
+    uint64_t backwards;
+} reader_result_t;
+
+static void* reader(void* arg) {
+    reader_result_t* result = arg;
+    int64_t last = 0;
+
+    while (!atomic_load(&done)) {
+        uint8_t report[REPORT_SIZE];
+        report_snapshot_read(report);
+        int64_t n = check_report(report);
+        result->reads++;
+        if (n < 0) result->torn++;
+        else if (n < last) result->backwards++;
+        else last = n;
+    }
+    return NULL;
+}
+
+// Reads from a signal handler that interrupted the writer
+static volatile sig_atomic_t signal_reads, signal_torn;
+
+static void on_timer(int sig) {
+    (void) sig;
+    uint8_t report[REPORT_SIZE];
+    report_snapshot_read(report);
+    signal_reads++;
+    if (check_report(report) < 0) signal_torn++;
+}
+
+static void test_torture(void) {
+    pthread_t threads[READERS];
+    reader_result_t results[READERS];
+    sigset_t block;
+
+    uint8_t report[REPORT_SIZE];
+    make_report(0, report);
+    report_snapshot_publish(report);
+
+    // Readers never take the timer signal; the writer does
+    sigemptyset(&block);
+    sigaddset(&block, SIGALRM);
+    pthread_sigmask(SIG_BLOCK, &block, NULL);
+    memset(results, 0, sizeof(results));
+    for (int i = 0; i < READERS; i++) {
+        pthread_create(&threads[i], NULL, reader, &results[i]);
+    }
+    pthread_sigmask(SIG_UNBLOCK, &block, NULL);
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_timer;
+    sigaction(SIGALRM, &sa, NULL);
+    struct itimerval timer = { { 0, 50 }, { 0, 50 } };
+    setitimer(ITIMER_REAL, &timer, NULL);
+
+    for (uint32_t n = 1; n <= PUBLISHES; n++) {
+        make_report(n, report);
+        report_snapshot_publish(report);
+    }
+
+    struct itimerval off = { { 0, 0 }, { 0, 0 } };
+    setitimer(ITIMER_REAL, &off, NULL);
+    atomic_store(&done, true);
+
+    uint64_t reads = 0, torn = 0, backwards = 0;
+    for (int i = 0; i < READERS; i++) {
+        pthread_join(threads[i], NULL);
+        reads += results[i].reads;
+        torn += results[i].torn;
+        backwards += results[i].backwards;
+    }
+
+    report_snapshot_read(report);
+    CHECK_EQ(check_report(report), PUBLISHES);
+    CHECK_EQ(torn, 0);
+    CHECK_EQ(backwards, 0);
+    CHECK(reads > 0);
+    CHECK_EQ(signal_torn, 0);
+    printf("  %u publishes, %llu reads on %d threads, %d reads from inside the writer\n",
+           PUBLISHES, (unsigned long long) reads, READERS, (int) signal_reads);
+}
+
+int main(void) {
+    RUN(test_torture);
+    return test_summary();
+}
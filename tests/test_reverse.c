@@ -0,0 +1,313 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * USB Keyboard to PS/2 Tests
+ *
+ * The reverse bridge end to end in firmware code: HID reports go into
+ * usb_host.c as usb_host_task() passes them on, through the key pipeline
+ * of ps2.c (built with PS2_DEV_ENABLE=1) and out of ps2_dev.c onto the
+ * PS/2 lines, where a host that only listens reads the Set 2 bytes on
+ * falling clock edges. ps2_dev_send_report() is ps2_dev_pico.c's without
+ * the interrupt: the line state machine runs on the simulated clock.
+ */
+
+#include "test.h"
+#include "pico/time.h"
+#include "ps2.h"
+#include "ps2_dev.h"
+#include "ps2_tables.h"
+#include "usb_host.h"
+#include "debounce.h"
+#include "report_queue.h"
+#include "hid_keycodes.h"
+#include "test_usb_keyboards.h"
+#include <string.h>
+
+#define LOOP_US                 1000
+#define SETTLE_US               (20 * 1000)
+
+static ps2_dev_lines_t lines;
+static uint64_t next_step_us;
+static uint8_t frame_bits;
+static uint16_t frame;
+static int frame_errors;
+
+static uint8_t bytes[4096];
+static int byte_count;
+
+// As in ps2_dev_pico.c; the next line step is at most PS2_DEV_POLL_US away
+void ps2_dev_send_report(const uint8_t report[8]) {
+    ps2_dev_report(report, time_us_32());
+}
+
+//--------------------------------------------------------------------+
+// PS/2 Host
+//--------------------------------------------------------------------+
+
+static bool odd_parity(uint8_t byte) {
+    bool parity = true;
+    for (int i = 0; i < 8; i++) parity ^= (byte >> i) & 1;
+    return parity;
+}
+
+// The host reads a bit on each falling clock edge: start, 8 data, parity, stop
+static void falling_edge(bool data) {
+    frame |= (uint16_t) data << frame_bits;
+    if (++frame_bits < 11) return;
+    uint8_t byte = (uint8_t) (frame >> 1);
+    bool ok = !(frame & 1) && ((frame >> 9) & 1) == odd_parity(byte) && ((frame >> 10) & 1);
+    if (!ok) {
+        frame_errors++;
+    } else if (byte_count < (int) sizeof(bytes)) {
+        bytes[byte_count++] = byte;
+    }
+    frame_bits = 0;
+    frame = 0;
+}
+
+// Run the line state machine with the host leaving both lines released,
+// and the main loop's typematic and report work every LOOP_US
+static void run(uint32_t us) {
+    uint64_t end = mock_time_us + us;
+    uint64_t next_loop = mock_time_us;
+    while (mock_time_us < end) {
+        uint64_t t = next_step_us < next_loop ? next_step_us : next_loop;
+        if (t > end) t = end;
+        mock_time_advance_us(t - mock_time_us);
+
+        if (mock_time_us == next_step_us) {
+            bool clock = lines.clock;
+            next_step_us += ps2_dev_step(lines.clock, lines.data, time_us_32(), &lines);
+            if (clock && !lines.clock) falling_edge(lines.data);
+        }
+        if (mock_time_us == next_loop) {
+            ps2_dev_typematic(time_us_32());
+            while (report_queue_peek()) report_queue_pop();
+            next_loop += LOOP_US;
+        }
+    }
+}
+
+//--------------------------------------------------------------------+
+// Bridge
+//--------------------------------------------------------------------+
+
+static usb_host_layout_t boot_layout;
+static usb_host_layout_t nkro_layout;
+
+// Power-up with boot keyboards in slots 0 and 1 and the NKRO keyboard in
+// slot 2, as usb_host_start() and the attach messages leave it
+static void reset(void) {
+    mock_time_reset(10 * 1000 * 1000);
+    ps2_init();
+    usb_host_init(debounce_process);
+    ps2_dev_reset(time_us_32());
+    lines = (ps2_dev_lines_t) { true, true };
+    next_step_us = mock_time_us;
+    frame_bits = 0;
+    frame = 0;
+    frame_errors = 0;
+    byte_count = 0;
+
+    usb_host_boot_layout(&boot_layout);
+    usb_host_parse_layout(nkro_keyboard_desc, sizeof(nkro_keyboard_desc), &nkro_layout);
+    usb_host_attach(0, &boot_layout);
+    usb_host_attach(1, &boot_layout);
+    usb_host_attach(2, &nkro_layout);
+
+    // The self-test result is the first byte
+    run((PS2_DEV_BAT_MS + 10) * 1000);
+    CHECK_EQ(byte_count, 1);
+    CHECK_EQ(bytes[0], PS2_DEV_BAT_PASSED);
+    byte_count = 0;
+}
+
+static void report(uint8_t slot, const uint8_t* data, uint16_t len) {
+    usb_host_report(slot, data, len, to_ms_since_boot(get_absolute_time()));
+    run(SETTLE_US);
+}
+
+static void boot(uint8_t slot, uint8_t modifiers, const uint8_t* keys) {
+    uint8_t data[8];
+    boot_report(data, modifiers, keys);
+    report(slot, data, sizeof(data));
+}
+
+// The Set 2 bytes since the last call are exactly these (NOTHING_SENT: none)
+static bool sent(const uint8_t* expected, int count) {
+    bool same = byte_count == count && (count == 0 || memcmp(bytes, expected, (size_t) count) == 0);
+    if (!same) {
+        printf("  sent:");
+        for (int i = 0; i < byte_count; i++) printf(" %02X", bytes[i]);
+        printf("\n");
+    }
+    byte_count = 0;
+    return same;
+}
+
+#define SENT(...) sent((const uint8_t[]) { __VA_ARGS__ }, sizeof((const uint8_t[]) { __VA_ARGS__ }))
+#define NOTHING_SENT() sent(NULL, 0)
+
+//--------------------------------------------------------------------+
+// Set 2 Decoder
+//--------------------------------------------------------------------+
+
+typedef struct {
+    uint8_t key;
+    bool pressed;
+} key_event_t;
+
+// The host keyboard driver's view of the bytes: key presses and releases
+static int decode(key_event_t* events, int max) {
+    static const uint8_t pause[] = { 0xE1, 0x14, 0x77, 0xE1, 0xF0, 0x14, 0xF0, 0x77 };
+    bool extended = false, release = false;
+    int n = 0;
+    for (int i = 0; i < byte_count && n < max; i++) {
+        uint8_t b = bytes[i];
+        if (b == 0xE1 && i + (int) sizeof(pause) <= byte_count && memcmp(&bytes[i], pause, sizeof(pause)) == 0) {
+            events[n++] = (key_event_t) { HID_KEY_PAUSE, true };
+            i += sizeof(pause) - 1;
+        } else if (b == 0xE0) {
+            extended = true;
+        } else if (b == 0xF0) {
+            release = true;
+        } else {
+            uint8_t key = extended ? ps2_tables.extended[b] : ps2_tables.normal[b];
+            // E0 12 (the fake shift around Print Screen) maps to nothing
+            if (key) events[n++] = (key_event_t) { key, !release };
+            extended = release = false;
+        }
+    }
+    byte_count = 0;
+    return n;
+}
+
+//--------------------------------------------------------------------+
+// Tests
+//--------------------------------------------------------------------+
+
+static void test_key(void) {
+    reset();
+    boot(0, 0, (const uint8_t[]) { HID_KEY_A, 0 });
+    CHECK(SENT(0x1C));
+    boot(0, 0, NULL);
+    CHECK(SENT(0xF0, 0x1C));
+}
+
+// Modifiers before keys going down, after them going up; E0 prefixes
+static void test_modifier_and_extended(void) {
+    reset();
+    boot(0, HID_MOD_RIGHT_CTRL, (const uint8_t[]) { HID_KEY_ARROW_UP, 0 });
+    CHECK(SENT(0xE0, 0x14, 0xE0, 0x75));
+    boot(0, 0, NULL);
+    CHECK(SENT(0xE0, 0xF0, 0x75, 0xE0, 0xF0, 0x14));
+
+    // Pause has no break code
+    boot(0, 0, (const uint8_t[]) { HID_KEY_PAUSE, 0 });
+    boot(0, 0, NULL);
+    CHECK(SENT(0xE1, 0x14, 0x77, 0xE1, 0xF0, 0x14, 0xF0, 0x77));
+    CHECK_EQ(frame_errors, 0);
+}
+
+// Every key the tables map, pressed and released on a boot keyboard and
+// on the NKRO one, read back from the lines
+static void test_every_key(void) {
+    for (int nkro = 0; nkro <= 1; nkro++) {
+        reset();
+        int keys = 0;
+        for (unsigned key = HID_KEY_A; key <= 0xFF; key++) {
+            if (!ps2_set2_codes.make[key] && key != HID_KEY_PAUSE) continue;
+            uint8_t down[2] = { (uint8_t) key, 0 };
+            uint8_t modifiers = key >= 0xE0 ? (uint8_t) (1u << (key - 0xE0)) : 0;
+            if (key >= 0xE0) down[0] = 0;
+
+            if (!nkro) {
+                boot(0, modifiers, down);
+                boot(0, 0, NULL);
+            } else if (key < NKRO_BITMAP_KEYS || key >= 0xE0) {
+                uint8_t data[NKRO_REPORT_SIZE];
+                nkro_report(data, modifiers, down);
+                report(2, data, sizeof(data));
+                nkro_report(data, 0, NULL);
+                report(2, data, sizeof(data));
+            } else {
+                report(2, (const uint8_t[]) { 1, 0, 0, (uint8_t) key, 0, 0, 0, 0, 0 }, 9);
+                report(2, (const uint8_t[]) { 1, 0, 0, 0, 0, 0, 0, 0, 0 }, 9);
+            }
+            keys++;
+
+            key_event_t got[4];
+            int n = decode(got, 4);
+            bool ok = key == HID_KEY_PAUSE
+                    ? n == 1 && got[0].key == key && got[0].pressed
+                    : n == 2 && got[0].key == key && got[0].pressed && got[1].key == key && !got[1].pressed;
+            if (!ok) printf("  key %02X via %s: %d events\n", key, nkro ? "NKRO" : "boot", n);
+            CHECK(ok);
+        }
+        CHECK(keys > 100);
+        CHECK_EQ(frame_errors, 0);
+    }
+}
+
+// A held on keyboard 0, pressed and released on keyboard 1: the PS/2 host
+// sees one make, and the break only when keyboard 0 lets go
+static void test_shared_key(void) {
+    reset();
+    boot(0, 0, (const uint8_t[]) { HID_KEY_A, 0 });
+    CHECK(SENT(0x1C));
+    boot(1, 0, (const uint8_t[]) { HID_KEY_A, 0 });
+    boot(1, 0, NULL);
+    CHECK(NOTHING_SENT());
+    boot(0, 0, NULL);
+    CHECK(SENT(0xF0, 0x1C));
+
+    // Shift on the NKRO keyboard, A typed on a boot one
+    uint8_t data[NKRO_REPORT_SIZE];
+    nkro_report(data, HID_MOD_LEFT_SHIFT, NULL);
+    report(2, data, sizeof(data));
+    boot(0, HID_MOD_LEFT_SHIFT, (const uint8_t[]) { HID_KEY_A, 0 });
+    boot(0, 0, NULL);
+    CHECK(SENT(0x12, 0x1C, 0xF0, 0x1C));
+    nkro_report(data, 0, NULL);
+    report(2, data, sizeof(data));
+    CHECK(SENT(0xF0, 0x12));
+}
+
+// Unplugging a keyboard breaks only the keys no other keyboard holds
+static void test_unplug(void) {
+    reset();
+    boot(0, 0, (const uint8_t[]) { HID_KEY_A, HID_KEY_B, 0 });
+    boot(1, HID_MOD_LEFT_CTRL, (const uint8_t[]) { HID_KEY_A, 0 });
+    CHECK(SENT(0x1C, 0x32, 0x14));
+
+    usb_host_detach(1, to_ms_since_boot(get_absolute_time()));
+    run(SETTLE_US);
+    CHECK(SENT(0xF0, 0x14));
+    usb_host_detach(0, to_ms_since_boot(get_absolute_time()));
+    run(SETTLE_US);
+    CHECK(SENT(0xF0, 0x1C, 0xF0, 0x32));
+
+    // Reports from an unplugged keyboard are ignored
+    boot(0, 0, (const uint8_t[]) { HID_KEY_A, 0 });
+    CHECK(NOTHING_SENT());
+}
+
+// Media reports and error rollover leave the keys as they were
+static void test_ignored_reports(void) {
+    reset();
+    report(2, (const uint8_t[]) { 1, 0, 0, HID_KEY_A, 0, 0, 0, 0, 0 }, 9);
+    report(2, (const uint8_t[]) { 2, 0xE9, 0x00 }, 3);
+    boot(0, 0, (const uint8_t[]) { 1, 1, 1, 1, 1, 1 });
+    CHECK(SENT(0x1C));
+    report(2, (const uint8_t[]) { 1, 0, 0, 0, 0, 0, 0, 0, 0 }, 9);
+    CHECK(SENT(0xF0, 0x1C));
+}
+
+int main(void) {
+    RUN(test_key);
+    RUN(test_modifier_and_extended);
+    RUN(test_every_key);
+    RUN(test_shared_key);
+    RUN(test_unplug);
+    RUN(test_ignored_reports);
+    return test_summary();
+}
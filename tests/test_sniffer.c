@@ -0,0 +1,366 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * Bus Sniffer Tests
+ *
+ * Frames in both directions drawn on the two lines at one sample per
+ * microsecond, as sniffer_pico.c feeds them, and the records sniffer.c
+ * makes of them: data, timing, and the parity, framing, acknowledge,
+ * abort and inhibit flags.
+ */
+
+#include "test.h"
+#include "sniffer.h"
+#include <string.h>
+
+#define HALF_US                 40
+#define INHIBIT_HOLD_US         150
+
+static uint32_t now_us;
+
+static bool odd_parity(uint8_t byte) {
+    bool parity = true;
+    for (int i = 0; i < 8; i++) parity ^= (byte >> i) & 1;
+    return parity;
+}
+
+//--------------------------------------------------------------------+
+// Bus
+//--------------------------------------------------------------------+
+
+// Both lines at these levels for us, sampled every microsecond
+static void hold(bool clk, bool data, uint32_t us) {
+    for (uint32_t i = 0; i < us; i++) sniffer_sample(clk, data, now_us++);
+}
+
+static void start(void) {
+    sniffer_reset();
+    now_us = 1000;
+    hold(true, true, 100);
+}
+
+// Device to host: start bit, data, parity, stop; data changes while the
+// clock is high and is read on the falling edge. bits (up to 11) limits
+// how many are clocked. Returns the time of the first falling edge.
+static uint32_t device_frame(uint8_t byte, bool parity, bool stop, int bits) {
+    bool levels[11] = { false };
+    for (int i = 0; i < 8; i++) levels[1 + i] = (byte >> i) & 1;
+    levels[9] = parity;
+    levels[10] = stop;
+
+    uint32_t first = now_us + HALF_US / 2;
+    for (int i = 0; i < bits; i++) {
+        hold(true, levels[i], HALF_US / 2);
+        hold(false, levels[i], HALF_US);
+        hold(true, levels[i], HALF_US / 2);
+    }
+    return first;
+}
+
+static uint32_t device_byte(uint8_t byte) {
+    uint32_t first = device_frame(byte, odd_parity(byte), true, 11);
+    hold(true, true, 100);
+    return first;
+}
+
+// Host to device: inhibit, request to send, data, parity and stop read on
+// rising edges of the device's clock, then the ack clock. Returns the
+// time the host took the clock.
+static uint32_t host_frame(uint8_t byte, bool parity, bool stop, bool ack) {
+    uint32_t first = now_us;
+    hold(false, true, INHIBIT_HOLD_US);
+    hold(false, false, 5);
+    hold(true, false, HALF_US);
+
+    bool levels[10];
+    for (int i = 0; i < 8; i++) levels[i] = (byte >> i) & 1;
+    levels[8] = parity;
+    levels[9] = stop;
+    for (int i = 0; i < 10; i++) {
+        hold(false, levels[i], HALF_US);
+        hold(true, levels[i], HALF_US);
+    }
+
+    // Eleventh clock: the device holds data low to acknowledge
+    hold(false, !ack, HALF_US);
+    hold(true, !ack, 5);
+    hold(true, true, 100);
+    return first;
+}
+
+static bool next(sniffer_record_t* record) {
+    memset(record, 0xCC, sizeof(*record));
+    return sniffer_read(record);
+}
+
+//--------------------------------------------------------------------+
+// Device to Host
+//--------------------------------------------------------------------+
+
+static void test_device_frame(void) {
+    start();
+    uint32_t first = device_byte(0x1C);
+    device_byte(0xF0);
+
+    sniffer_record_t record;
+    CHECK(next(&record));
+    CHECK_EQ(record.data, 0x1C);
+    CHECK_EQ(record.flags, 0);
+    CHECK_EQ(record.time_us, first);
+    CHECK_EQ(record.length_us, 10 * 2 * HALF_US);
+    CHECK(next(&record));
+    CHECK_EQ(record.data, 0xF0);
+    CHECK_EQ(record.flags, 0);
+    CHECK(!next(&record));
+
+    CHECK_EQ(sniffer_stats()->device_frames, 2);
+    CHECK_EQ(sniffer_stats()->errors, 0);
+    CHECK(sniffer_idle());
+}
+
+static void test_device_errors(void) {
+    start();
+    device_frame(0x1C, !odd_parity(0x1C), true, 11);
+    hold(true, true, 100);
+    device_frame(0x32, odd_parity(0x32), false, 11);
+    hold(true, true, 100);
+    device_frame(0x00, false, false, 11);
+    hold(true, true, 100);
+
+    sniffer_record_t record;
+    CHECK(next(&record));
+    CHECK_EQ(record.data, 0x1C);
+    CHECK_EQ(record.flags, SNIFFER_PARITY_ERROR);
+    CHECK(next(&record));
+    CHECK_EQ(record.data, 0x32);
+    CHECK_EQ(record.flags, SNIFFER_FRAMING_ERROR);
+    CHECK(next(&record));
+    CHECK_EQ(record.flags, SNIFFER_PARITY_ERROR | SNIFFER_FRAMING_ERROR);
+    CHECK(!next(&record));
+    CHECK_EQ(sniffer_stats()->errors, 3);
+    CHECK_EQ(sniffer_stats()->device_frames, 3);
+}
+
+// The host holds the clock low in the middle of a byte: the bits so far
+// are recorded as aborted, then the inhibit. The inhibit's own falling
+// edge reads as one more bit, since it looks like any other.
+static void test_device_aborted(void) {
+    start();
+    uint32_t first = device_frame(0x2B, odd_parity(0x2B), true, 3);
+    uint32_t cut = now_us;
+    hold(false, true, INHIBIT_HOLD_US);
+    uint32_t released = now_us;
+    hold(true, true, 100);
+
+    sniffer_record_t record;
+    CHECK(next(&record));
+    CHECK_EQ(record.flags, SNIFFER_ABORTED);
+    CHECK_EQ(record.data & 0x03, 0x2B & 0x03);
+    CHECK_EQ(record.time_us, first);
+    CHECK(next(&record));
+    CHECK_EQ(record.flags, SNIFFER_INHIBIT);
+    CHECK_EQ(record.time_us, cut);
+    CHECK_EQ(record.length_us, released - cut);
+    CHECK(!next(&record));
+    CHECK_EQ(sniffer_stats()->errors, 1);
+    CHECK_EQ(sniffer_stats()->inhibits, 1);
+}
+
+// A clock that stops with the lines released ends the frame
+static void test_device_timeout(void) {
+    start();
+    device_frame(0x24, odd_parity(0x24), true, 6);
+    CHECK(!sniffer_idle());
+    uint32_t last_edge = now_us - HALF_US / 2;
+    hold(true, true, SNIFFER_FRAME_TIMEOUT_US + 10);
+    CHECK(sniffer_idle());
+
+    sniffer_record_t record;
+    CHECK(next(&record));
+    CHECK_EQ(record.flags, SNIFFER_ABORTED);
+    CHECK_EQ(record.data, 0x24 & 0x1F);
+    CHECK_EQ(record.time_us + record.length_us, last_edge);
+
+    // The next byte is read whole
+    device_byte(0x24);
+    CHECK(next(&record));
+    CHECK_EQ(record.flags, 0);
+    CHECK_EQ(record.data, 0x24);
+}
+
+//--------------------------------------------------------------------+
+// Host to Device
+//--------------------------------------------------------------------+
+
+static void test_host_frame(void) {
+    start();
+    uint32_t first = host_frame(0xED, odd_parity(0xED), true, true);
+    device_byte(0xFA);
+    host_frame(0x02, odd_parity(0x02), true, true);
+
+    sniffer_record_t record;
+    CHECK(next(&record));
+    CHECK_EQ(record.data, 0xED);
+    CHECK_EQ(record.flags, SNIFFER_HOST);
+    CHECK_EQ(record.time_us, first);
+    CHECK_EQ(record.length_us, INHIBIT_HOLD_US + 5 + HALF_US + 10 * 2 * HALF_US + HALF_US);
+    CHECK(next(&record));
+    CHECK_EQ(record.data, 0xFA);
+    CHECK_EQ(record.flags, 0);
+    CHECK(next(&record));
+    CHECK_EQ(record.data, 0x02);
+    CHECK_EQ(record.flags, SNIFFER_HOST);
+    CHECK(!next(&record));
+    CHECK_EQ(sniffer_stats()->host_frames, 2);
+    CHECK_EQ(sniffer_stats()->device_frames, 1);
+    CHECK_EQ(sniffer_stats()->inhibits, 0);
+}
+
+static void test_host_errors(void) {
+    start();
+    host_frame(0xF4, !odd_parity(0xF4), true, true);
+    host_frame(0xF5, odd_parity(0xF5), false, true);
+    host_frame(0xFF, odd_parity(0xFF), true, false);
+
+    sniffer_record_t record;
+    CHECK(next(&record));
+    CHECK_EQ(record.data, 0xF4);
+    CHECK_EQ(record.flags, SNIFFER_HOST | SNIFFER_PARITY_ERROR);
+    CHECK(next(&record));
+    CHECK_EQ(record.data, 0xF5);
+    CHECK_EQ(record.flags, SNIFFER_HOST | SNIFFER_FRAMING_ERROR);
+    CHECK(next(&record));
+    CHECK_EQ(record.data, 0xFF);
+    CHECK_EQ(record.flags, SNIFFER_HOST | SNIFFER_NO_ACK);
+    CHECK(!next(&record));
+    CHECK_EQ(sniffer_stats()->errors, 3);
+}
+
+// A device that never clocks the ack: the frame ends at its stop bit. One
+// that stops clocking earlier leaves an aborted frame.
+static void test_host_timeout(void) {
+    start();
+    uint32_t first = now_us;
+    hold(false, true, INHIBIT_HOLD_US);
+    hold(false, false, 5);
+    hold(true, false, HALF_US);
+    for (int i = 0; i < 10; i++) {
+        bool level = i < 8 ? (0xF2 >> i) & 1 : i == 8 ? odd_parity(0xF2) : true;
+        hold(false, level, HALF_US);
+        hold(true, level, HALF_US);
+    }
+    uint32_t stop_edge = now_us - HALF_US;
+    hold(true, true, SNIFFER_FRAME_TIMEOUT_US + 10);
+
+    sniffer_record_t record;
+    CHECK(next(&record));
+    CHECK_EQ(record.data, 0xF2);
+    CHECK_EQ(record.flags, SNIFFER_HOST | SNIFFER_NO_ACK);
+    CHECK_EQ(record.time_us, first);
+    CHECK_EQ(record.time_us + record.length_us, stop_edge);
+
+    hold(false, true, INHIBIT_HOLD_US);
+    hold(false, false, 5);
+    hold(true, false, HALF_US);
+    for (int i = 0; i < 4; i++) {
+        hold(false, true, HALF_US);
+        hold(true, true, HALF_US);
+    }
+    hold(true, true, SNIFFER_FRAME_TIMEOUT_US + 10);
+    CHECK(next(&record));
+    CHECK_EQ(record.data, 0x0F);
+    CHECK_EQ(record.flags, SNIFFER_HOST | SNIFFER_ABORTED);
+    CHECK(!next(&record));
+}
+
+// A host holding the clock without a request to send
+static void test_inhibit(void) {
+    start();
+    uint32_t first = now_us;
+    hold(false, true, 500);
+    CHECK(sniffer_idle());
+    hold(true, true, 100);
+
+    sniffer_record_t record;
+    CHECK(next(&record));
+    CHECK_EQ(record.flags, SNIFFER_INHIBIT);
+    CHECK_EQ(record.time_us, first);
+    CHECK_EQ(record.length_us, 500);
+    CHECK(!next(&record));
+    CHECK_EQ(sniffer_stats()->errors, 0);
+}
+
+//--------------------------------------------------------------------+
+// Start and Ring
+//--------------------------------------------------------------------+
+
+// Nothing is decoded until both lines have been seen released
+static void test_waits_for_idle_bus(void) {
+    sniffer_reset();
+    now_us = 0;
+    for (int i = 0; i < 12; i++) {
+        hold(false, false, HALF_US);
+        hold(true, false, HALF_US);
+    }
+    CHECK_EQ(sniffer_stats()->device_frames + sniffer_stats()->inhibits, 0);
+    hold(true, true, 100);
+    device_byte(0x32);
+
+    sniffer_record_t record;
+    int records = 0;
+    while (next(&record)) {
+        CHECK_EQ(record.flags, 0);
+        CHECK_EQ(record.data, 0x32);
+        records++;
+    }
+    CHECK_EQ(records, 1);
+}
+
+// Records beyond the ring are counted as lost; bytes go out whole records
+// at a time, little-endian
+static void test_ring_and_wire_format(void) {
+    start();
+    for (int i = 0; i < SNIFFER_RING_SIZE + 3; i++) {
+        hold(false, true, INHIBIT_HOLD_US);
+        hold(true, true, 10);
+    }
+    CHECK_EQ(sniffer_stats()->inhibits, SNIFFER_RING_SIZE + 3);
+    CHECK_EQ(sniffer_stats()->lost, 3);
+    CHECK_EQ(sniffer_stats()->high_water, SNIFFER_RING_SIZE);
+
+    uint8_t out[3 * SNIFFER_RECORD_SIZE];
+    uint32_t streamed = 0;
+    uint16_t n;
+    while ((n = sniffer_read_bytes(out, sizeof(out) - 1)) > 0) {
+        CHECK_EQ(n, 2 * SNIFFER_RECORD_SIZE);
+        streamed += n;
+    }
+    CHECK_EQ(streamed, SNIFFER_RING_SIZE * SNIFFER_RECORD_SIZE);
+    CHECK_EQ(sniffer_stats()->bytes_streamed, streamed);
+    CHECK_EQ(sniffer_read_bytes(out, SNIFFER_RECORD_SIZE - 1), 0);
+
+    sniffer_record_t record = { 0x12345678, 0xABCD, 0x5A, SNIFFER_HOST | SNIFFER_NO_ACK };
+    static const uint8_t wire[SNIFFER_RECORD_SIZE] = { 0x78, 0x56, 0x34, 0x12, 0xCD, 0xAB, 0x5A, 0x09 };
+    sniffer_encode(&record, out);
+    CHECK(memcmp(out, wire, sizeof(wire)) == 0);
+
+    // A long inhibit's length saturates
+    start();
+    hold(false, true, 70000);
+    hold(true, true, 10);
+    CHECK(next(&record));
+    CHECK_EQ(record.length_us, 0xFFFF);
+}
+
+int main(void) {
+    RUN(test_device_frame);
+    RUN(test_device_errors);
+    RUN(test_device_aborted);
+    RUN(test_device_timeout);
+    RUN(test_host_frame);
+    RUN(test_host_errors);
+    RUN(test_host_timeout);
+    RUN(test_inhibit);
+    RUN(test_waits_for_idle_bus);
+    RUN(test_ring_and_wire_format);
+    return test_summary();
+}
@@ -0,0 +1,158 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * SOCD Resolution Tests
+ *
+ * The sink keeps the key state the host would see. As in ps2.c, one report
+ * is built after each event, so every check on the state after an event is
+ * a check on one report: the resolution never needs a frame of its own.
+ */
+
+#include "test.h"
+#include "socd.h"
+#include "hid_keycodes.h"
+#include <stdlib.h>
+#include <string.h>
+
+static bool down[256];
+static int changes;
+
+static void sink(uint8_t key, bool pressed, uint32_t time_ms) {
+    (void) time_ms;
+    down[key] = pressed;
+    changes++;
+}
+
+static void reset(uint8_t mode) {
+    socd_init(sink);
+    socd_set_mode(mode);
+    memset(down, 0, sizeof(down));
+    changes = 0;
+}
+
+static void press(uint8_t key) {
+    socd_process(key, true, 0);
+}
+
+static void release(uint8_t key) {
+    socd_process(key, false, 0);
+}
+
+// Left and Right as the host sees them after the last event
+static bool state_is(bool left, bool right) {
+    return down[HID_KEY_ARROW_LEFT] == left && down[HID_KEY_ARROW_RIGHT] == right;
+}
+
+static void test_off(void) {
+    reset(SOCD_MODE_OFF);
+    press(HID_KEY_ARROW_LEFT);
+    press(HID_KEY_ARROW_RIGHT);
+    CHECK(state_is(true, true));
+    release(HID_KEY_ARROW_LEFT);
+    CHECK(state_is(false, true));
+    release(HID_KEY_ARROW_RIGHT);
+    CHECK(state_is(false, false));
+    CHECK_EQ(changes, 4);
+}
+
+static void test_last_input(void) {
+    reset(SOCD_MODE_LAST_INPUT);
+    press(HID_KEY_ARROW_LEFT);
+    CHECK(state_is(true, false));
+    press(HID_KEY_ARROW_RIGHT);
+    CHECK(state_is(false, true));
+    release(HID_KEY_ARROW_RIGHT);
+    CHECK(state_is(true, false));       // Left comes back
+    press(HID_KEY_ARROW_RIGHT);
+    release(HID_KEY_ARROW_LEFT);
+    CHECK(state_is(false, true));
+    release(HID_KEY_ARROW_RIGHT);
+    CHECK(state_is(false, false));
+}
+
+static void test_neutral(void) {
+    reset(SOCD_MODE_NEUTRAL);
+    press(HID_KEY_A);
+    press(HID_KEY_D);
+    CHECK(!down[HID_KEY_A] && !down[HID_KEY_D]);
+    release(HID_KEY_A);
+    CHECK(!down[HID_KEY_A] && down[HID_KEY_D]);
+    release(HID_KEY_D);
+    CHECK(!down[HID_KEY_D]);
+}
+
+static void test_first_input(void) {
+    reset(SOCD_MODE_FIRST_INPUT);
+    press(HID_KEY_W);
+    press(HID_KEY_S);
+    CHECK(down[HID_KEY_W] && !down[HID_KEY_S]);
+    release(HID_KEY_S);
+    CHECK(down[HID_KEY_W] && !down[HID_KEY_S]);
+    press(HID_KEY_S);
+    release(HID_KEY_W);
+    CHECK(!down[HID_KEY_W] && down[HID_KEY_S]);
+    release(HID_KEY_S);
+    CHECK(!down[HID_KEY_S]);
+}
+
+// Pairs are independent, and keys outside the pairs pass straight through
+static void test_other_keys(void) {
+    reset(SOCD_MODE_NEUTRAL);
+    press(HID_KEY_ARROW_UP);
+    press(HID_KEY_ARROW_LEFT);
+    press(HID_KEY_B);
+    CHECK(down[HID_KEY_ARROW_UP] && down[HID_KEY_ARROW_LEFT] && down[HID_KEY_B]);
+    CHECK_EQ(changes, 3);
+}
+
+// Changing the mode with keys held never leaves a key down at the host
+static void test_mode_change_while_held(void) {
+    static const uint8_t modes[] = {
+        SOCD_MODE_OFF, SOCD_MODE_LAST_INPUT, SOCD_MODE_NEUTRAL, SOCD_MODE_FIRST_INPUT
+    };
+    for (unsigned from = 0; from < 4; from++) {
+        for (unsigned to = 0; to < 4; to++) {
+            reset(modes[from]);
+            press(HID_KEY_ARROW_LEFT);
+            press(HID_KEY_ARROW_RIGHT);
+            socd_set_mode(modes[to]);
+            release(HID_KEY_ARROW_LEFT);
+            release(HID_KEY_ARROW_RIGHT);
+            CHECK(state_is(false, false));
+        }
+    }
+}
+
+// Random presses and releases of both keys in every resolving mode: after
+// each event at most one of the pair is down, it is a key that is held,
+// and the whole event is one report
+static void test_random(void) {
+    static const uint8_t modes[] = { SOCD_MODE_LAST_INPUT, SOCD_MODE_NEUTRAL, SOCD_MODE_FIRST_INPUT };
+    srand(1);
+    for (unsigned m = 0; m < 3; m++) {
+        reset(modes[m]);
+        bool held[2] = { false, false };
+        uint8_t keys[2] = { HID_KEY_ARROW_LEFT, HID_KEY_ARROW_RIGHT };
+        int bad = 0;
+        for (int i = 0; i < 10000; i++) {
+            int k = rand() % 2;
+            held[k] = !held[k];
+            socd_process(keys[k], held[k], (uint32_t) i);
+            bool l = down[keys[0]], r = down[keys[1]];
+            if ((l && r) || (l && !held[0]) || (r && !held[1])) bad++;
+            // Something is sent whenever exactly one key is held
+            if (held[0] != held[1] && !l && !r) bad++;
+        }
+        CHECK_EQ(bad, 0);
+    }
+}
+
+int main(void) {
+    RUN(test_off);
+    RUN(test_last_input);
+    RUN(test_neutral);
+    RUN(test_first_input);
+    RUN(test_other_keys);
+    RUN(test_mode_change_while_held);
+    RUN(test_random);
+    return test_summary();
+}
@@ -0,0 +1,366 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * Configuration Store Tests
+ *
+ * store.c on the RAM flash emulation. A power cycle is store_init() on the
+ * region as the last run left it. Power loss is injected at every byte a
+ * flush programs, both appending to a block and moving to the next one,
+ * and every key must then read back as either its old or its new value.
+ */
+
+#include "test.h"
+#include "store.h"
+#include "store_flash.h"
+#include <string.h>
+
+// Current contents the store fetches at a flush; length 0 deletes the key
+static uint8_t values[STORE_MAX_KEYS][STORE_BLOCK_SIZE / 2];
+static uint16_t lengths[STORE_MAX_KEYS];
+
+static const void* source(uint8_t key, uint16_t* len) {
+    *len = lengths[key];
+    return lengths[key] ? values[key] : NULL;
+}
+
+//--------------------------------------------------------------------+
+// Helpers
+//--------------------------------------------------------------------+
+
+static void reset(void) {
+    store_flash_ram_reset();
+    memset(lengths, 0, sizeof(lengths));
+    store_init(source);
+}
+
+static void power_cycle(void) {
+    store_flash_ram_fail_after(-1);
+    store_init(source);
+}
+
+static void set_value(uint8_t key, uint8_t fill, uint16_t len) {
+    memset(values[key], fill, len);
+    lengths[key] = len;
+    store_mark_dirty(key);
+}
+
+// The key reads back as len bytes of fill, or as absent for len 0
+static bool value_is(uint8_t key, uint8_t fill, uint16_t len) {
+    uint16_t got_len = 0;
+    const uint8_t* data = store_get(key, &got_len);
+    if (!len) return data == NULL;
+    if (!data || got_len != len) return false;
+    for (uint16_t i = 0; i < len; i++) {
+        if (data[i] != fill) return false;
+    }
+    return true;
+}
+
+// Sequence number in a block's header, as the flash holds it
+static uint32_t block_header_seq(uint8_t block) {
+    const uint8_t* p = store_flash_base() + (uint32_t) block * STORE_BLOCK_SIZE + 4;
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+// Clear one bit in flash, as a bit error would
+static void flip_bit(const void* at) {
+    uint32_t offset = (uint32_t) ((const uint8_t*) at - store_flash_base());
+    uint8_t byte = store_flash_base()[offset];
+    uint8_t cleared = byte & (uint8_t) (byte - 1);
+    store_flash_program(offset, &cleared, 1);
+}
+
+//--------------------------------------------------------------------+
+// Tests
+//--------------------------------------------------------------------+
+
+static void test_empty(void) {
+    reset();
+    uint16_t len;
+    CHECK(store_get(1, &len) == NULL);
+    CHECK(store_get(0, &len) == NULL);
+    CHECK(store_get(STORE_MAX_KEYS, &len) == NULL);
+    CHECK(store_flush());
+}
+
+static void test_round_trip(void) {
+    reset();
+    set_value(1, 0x11, 1);
+    set_value(2, 0x22, 7);
+    set_value(STORE_MAX_KEYS - 1, 0x33, 64);
+    CHECK(store_flush());
+    CHECK(value_is(1, 0x11, 1));
+    CHECK(value_is(2, 0x22, 7));
+    CHECK(value_is(STORE_MAX_KEYS - 1, 0x33, 64));
+    CHECK(value_is(3, 0, 0));
+
+    // Values are read in place from flash, not from the source
+    uint16_t len;
+    const uint8_t* data = store_get(2, &len);
+    CHECK(data >= store_flash_base() && data < store_flash_base() + STORE_SIZE);
+
+    power_cycle();
+    CHECK(value_is(1, 0x11, 1));
+    CHECK(value_is(2, 0x22, 7));
+    CHECK(value_is(STORE_MAX_KEYS - 1, 0x33, 64));
+
+    // Changed and deleted
+    set_value(1, 0x44, 3);
+    set_value(2, 0, 0);
+    CHECK(store_flush());
+    power_cycle();
+    CHECK(value_is(1, 0x44, 3));
+    CHECK(value_is(2, 0, 0));
+    CHECK(value_is(STORE_MAX_KEYS - 1, 0x33, 64));
+
+    // Deleting a key that was never written writes nothing
+    static uint8_t before[STORE_SIZE];
+    memcpy(before, store_flash_base(), sizeof(before));
+    set_value(5, 0, 0);
+    CHECK(store_flush());
+    CHECK(memcmp(before, store_flash_base(), sizeof(before)) == 0);
+}
+
+// A batch waits for the flush delay after the last change and for the
+// keyboard to be idle
+static void test_flush_due(void) {
+    reset();
+    CHECK(!store_flush_due(10000, false));
+    set_value(1, 0x11, 4);
+    CHECK(!store_flush_due(10000, false));
+    CHECK(!store_flush_due(10000 + STORE_FLUSH_DELAY_MS - 1, false));
+    CHECK(store_flush_due(10000 + STORE_FLUSH_DELAY_MS, false));
+
+    // Another change restarts the delay
+    store_mark_dirty(1);
+    CHECK(!store_flush_due(12000, false));
+    CHECK(store_flush_due(12000 + STORE_FLUSH_DELAY_MS, false));
+
+    // A held key holds the batch back until the keyboard was idle
+    CHECK(!store_flush_due(14000, true));
+    CHECK(!store_flush_due(14000 + STORE_IDLE_MS - 1, false));
+    CHECK(store_flush_due(14000 + STORE_IDLE_MS, false));
+
+    CHECK(store_flush());
+    CHECK(!store_flush_due(20000, false));
+}
+
+// Every block is erased in turn; none wears faster than the others
+static void test_wear_levelling(void) {
+    reset();
+    uint32_t erases[STORE_BLOCKS] = {0};
+    uint32_t seqs[STORE_BLOCKS] = {0};
+    for (uint8_t b = 0; b < STORE_BLOCKS; b++) seqs[b] = block_header_seq(b);
+
+    set_value(2, 0x22, 100);
+    CHECK(store_flush());
+    for (uint32_t i = 0; i < 20000; i++) {
+        set_value(1, (uint8_t) i, 64);
+        if (!store_flush()) {
+            CHECK(false);
+            break;
+        }
+        for (uint8_t b = 0; b < STORE_BLOCKS; b++) {
+            if (block_header_seq(b) != seqs[b]) {
+                seqs[b] = block_header_seq(b);
+                erases[b]++;
+            }
+        }
+    }
+
+    uint32_t least = erases[0], most = erases[0];
+    for (uint8_t b = 1; b < STORE_BLOCKS; b++) {
+        if (erases[b] < least) least = erases[b];
+        if (erases[b] > most) most = erases[b];
+    }
+    CHECK(least + 1 >= 20000 * 72 / STORE_BLOCK_SIZE / STORE_BLOCKS);
+    CHECK(most - least <= 1);
+
+    // Untouched keys are carried along to every new block
+    power_cycle();
+    CHECK(value_is(1, (uint8_t) 19999, 64));
+    CHECK(value_is(2, 0x22, 100));
+}
+
+// A batch that cannot fit in a block is dropped; the store keeps its
+// last values
+static void test_too_large(void) {
+    reset();
+    set_value(3, 0x33, 10);
+    CHECK(store_flush());
+    set_value(1, 0x11, STORE_BLOCK_SIZE / 2);
+    set_value(2, 0x22, STORE_BLOCK_SIZE / 2);
+    CHECK(!store_flush());
+    power_cycle();
+    CHECK(value_is(1, 0, 0));
+    CHECK(value_is(2, 0, 0));
+    CHECK(value_is(3, 0x33, 10));
+
+    set_value(1, 0x11, 100);
+    CHECK(store_flush());
+    CHECK(value_is(1, 0x11, 100));
+}
+
+// A record with a bad CRC is skipped with the rest of its block
+static void test_record_crc(void) {
+    reset();
+    set_value(1, 0x11, 16);
+    CHECK(store_flush());
+    set_value(1, 0x12, 16);
+    CHECK(store_flush());
+    set_value(2, 0x22, 16);
+    CHECK(store_flush());
+
+    uint16_t len;
+    flip_bit((const uint8_t*) store_get(1, &len) + 5);
+    power_cycle();
+    CHECK(value_is(1, 0x11, 16));
+    CHECK(value_is(2, 0, 0));
+
+    // The next batch starts a new block rather than appending after the
+    // damaged record
+    uint32_t seq = block_header_seq(1);
+    set_value(3, 0x33, 16);
+    CHECK(store_flush());
+    CHECK(block_header_seq(1) != seq);
+    power_cycle();
+    CHECK(value_is(1, 0x11, 16));
+    CHECK(value_is(3, 0x33, 16));
+
+    // A damaged header is caught too
+    set_value(3, 0x34, 16);
+    CHECK(store_flush());
+    flip_bit((const uint8_t*) store_get(3, &len) - 2);
+    power_cycle();
+    CHECK(value_is(3, 0x33, 16));
+}
+
+// A block with a bad header CRC is not current; the one before it is
+static void test_block_crc(void) {
+    reset();
+    set_value(1, 0x11, 16);
+    CHECK(store_flush());
+    CHECK(block_header_seq(0) == 1);
+
+    // Fill block 0 until the store moves to block 1
+    uint32_t i = 0;
+    while (block_header_seq(1) == 0xFFFFFFFFu && i < 10000) {
+        set_value(1, (uint8_t) ++i, 64);
+        CHECK(store_flush());
+    }
+    CHECK_EQ(block_header_seq(1), 2);
+
+    flip_bit(store_flash_base() + STORE_BLOCK_SIZE + 4);
+    power_cycle();
+    CHECK(value_is(1, (uint8_t) (i - 1), 64));
+}
+
+//--------------------------------------------------------------------+
+// Power Loss
+//--------------------------------------------------------------------+
+
+// Values before and after the batch that power loss interrupts
+#define LOSS_KEYS               4
+
+static const uint8_t old_fill[LOSS_KEYS] = { 0, 0x11, 0x12, 0x13 };
+static const uint16_t old_len[LOSS_KEYS] = { 0, 20, 20, 20 };
+static const uint8_t new_fill[LOSS_KEYS] = { 0, 0xA1, 0, 0xA3 };
+static const uint16_t new_len[LOSS_KEYS] = { 0, 20, 0, 40 };
+
+// Keys 1 to 3 saved, then key 4 flushed fills times
+static void loss_base(uint32_t fills) {
+    reset();
+    for (uint8_t key = 1; key < LOSS_KEYS; key++) set_value(key, old_fill[key], old_len[key]);
+    store_flush();
+    for (uint32_t i = 0; i < fills; i++) {
+        set_value(LOSS_KEYS, (uint8_t) i, 64);
+        store_flush();
+    }
+}
+
+// The batch power loss interrupts
+static void loss_batch(void) {
+    for (uint8_t key = 1; key < LOSS_KEYS; key++) set_value(key, new_fill[key], new_len[key]);
+}
+
+// Cut the batch short after every step bytes below fine_from and every
+// byte after, until it completes. Counts the cuts that left all the old
+// values and all the new ones; false if the batch never completed.
+static bool inject_power_loss(uint32_t fills, uint32_t step, uint32_t fine_from,
+                              uint32_t* old_runs, uint32_t* new_runs) {
+    *old_runs = *new_runs = 0;
+    for (uint32_t bytes = 0; bytes < 2 * STORE_BLOCK_SIZE; bytes += (bytes < fine_from) ? step : 1) {
+        loss_base(fills);
+        loss_batch();
+        store_flash_ram_fail_after((int32_t) bytes);
+        bool ok = store_flush();
+        power_cycle();
+
+        bool all_old = true, all_new = true;
+        for (uint8_t key = 1; key < LOSS_KEYS; key++) {
+            bool is_old = value_is(key, old_fill[key], old_len[key]);
+            bool is_new = value_is(key, new_fill[key], new_len[key]);
+            CHECK(is_old || is_new);
+            all_old &= is_old;
+            all_new &= is_new;
+        }
+        if (ok) CHECK(all_new);
+        *old_runs += all_old;
+        *new_runs += all_new;
+
+        // The store carries on after the failure
+        for (uint8_t key = 1; key < LOSS_KEYS; key++) set_value(key, 0x55, 8);
+        CHECK(store_flush());
+        power_cycle();
+        for (uint8_t key = 1; key < LOSS_KEYS; key++) CHECK(value_is(key, 0x55, 8));
+
+        if (ok) return true;
+    }
+    return false;
+}
+
+// The batch is appended to the current block
+static void test_power_loss_append(void) {
+    uint32_t old_runs, new_runs;
+    CHECK(inject_power_loss(0, 1, 0, &old_runs, &new_runs));
+    CHECK(old_runs > 0);
+    CHECK(new_runs > 0);
+}
+
+// The batch does not fit, so the store erases the next block and copies
+// every live value into it
+static void test_power_loss_move(void) {
+    // Flushes of key 4 after which the next batch moves to block 1
+    uint32_t fills = 0;
+    loss_base(0);
+    while (block_header_seq(1) == 0xFFFFFFFFu && fills < 10000) {
+        set_value(LOSS_KEYS, (uint8_t) fills++, 64);
+        store_flush();
+    }
+    fills--;
+
+    // The erase is cut short in coarse steps, the copy at every byte
+    uint32_t old_runs, new_runs;
+    CHECK(inject_power_loss(fills, 256, STORE_BLOCK_SIZE, &old_runs, &new_runs));
+    CHECK(old_runs > STORE_BLOCK_SIZE / 256);
+    CHECK(new_runs > 0);
+
+    loss_base(fills);
+    CHECK(block_header_seq(1) == 0xFFFFFFFFu);
+    loss_batch();
+    CHECK(store_flush());
+    CHECK_EQ(block_header_seq(1), 2);
+    CHECK(value_is(LOSS_KEYS, (uint8_t) (fills - 1), 64));
+}
+
+int main(void) {
+    RUN(test_empty);
+    RUN(test_round_trip);
+    RUN(test_flush_due);
+    RUN(test_wear_levelling);
+    RUN(test_too_large);
+    RUN(test_record_crc);
+    RUN(test_block_crc);
+    RUN(test_power_loss_append);
+    RUN(test_power_loss_move);
+    return test_summary();
+}
@@ -0,0 +1,290 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * Tap-Hold Tests
+ *
+ * Built with TAPHOLD_EXAMPLE_KEYS=1 (Space/Left Shift, Esc/Left Ctrl) and
+ * the default 200 ms term. Events are fed on a simulated millisecond clock
+ * with taphold_task() called every tick, as the main loop does; each event
+ * passed on records the clock, so the delay tap-hold adds can be checked
+ * against what its rules allow and is reported for random typing.
+ */
+
+#include "test.h"
+#include "taphold.h"
+#include "hid_keycodes.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    uint8_t key;
+    bool pressed;
+    uint32_t time_ms;       // Event time given to the next stage
+    uint32_t at_ms;         // Clock when it was passed on
+} out_event_t;
+
+static out_event_t out[4096];
+static int out_count;
+static uint32_t now_ms;
+
+static void sink(uint8_t key, bool pressed, uint32_t time_ms) {
+    if (out_count < (int) (sizeof(out) / sizeof(out[0]))) {
+        out[out_count++] = (out_event_t) { key, pressed, time_ms, now_ms };
+    }
+}
+
+static void reset(void) {
+    taphold_init(sink);
+    taphold_set_term(TAPHOLD_TERM_MS);
+    out_count = 0;
+    now_ms = 1000;
+}
+
+// Advance the clock to t, running the main loop's task every millisecond
+static void advance(uint32_t t) {
+    while (now_ms < t) {
+        now_ms++;
+        taphold_task(now_ms);
+    }
+}
+
+static void event(uint32_t t, uint8_t key, bool pressed) {
+    advance(t);
+    taphold_process(key, pressed, now_ms);
+}
+
+static bool out_is(int i, uint8_t key, bool pressed) {
+    return i < out_count && out[i].key == key && out[i].pressed == pressed;
+}
+
+static void test_plain_keys_pass_straight_through(void) {
+    reset();
+    event(1000, HID_KEY_A, true);
+    event(1050, HID_KEY_A, false);
+    CHECK_EQ(out_count, 2);
+    CHECK(out_is(0, HID_KEY_A, true) && out[0].at_ms == 1000);
+    CHECK(out_is(1, HID_KEY_A, false) && out[1].at_ms == 1050);
+}
+
+static void test_tap(void) {
+    reset();
+    event(1000, HID_KEY_SPACE, true);
+    CHECK(taphold_pending());
+    event(1080, HID_KEY_SPACE, false);
+    CHECK(!taphold_pending());
+    CHECK_EQ(out_count, 2);
+    // Decided at the release: the earliest a tap can be known
+    CHECK(out_is(0, HID_KEY_SPACE, true) && out[0].at_ms == 1080);
+    CHECK(out_is(1, HID_KEY_SPACE, false) && out[1].at_ms == 1080);
+}
+
+static void test_hold_by_term(void) {
+    reset();
+    event(1000, HID_KEY_ESCAPE, true);
+    advance(1199);
+    CHECK_EQ(out_count, 0);
+    advance(1200);
+    CHECK(out_is(0, HID_KEY_CONTROL_LEFT, true));
+    CHECK_EQ(out[0].at_ms, 1200);
+    CHECK_EQ(out[0].time_ms, 1200);
+    event(1500, HID_KEY_ESCAPE, false);
+    CHECK(out_is(1, HID_KEY_CONTROL_LEFT, false));
+}
+
+// Another key tapped inside the dual-role key decides hold at its release
+static void test_permissive_hold(void) {
+    reset();
+    event(1000, HID_KEY_SPACE, true);
+    event(1040, HID_KEY_A, true);
+    event(1070, HID_KEY_A, false);
+    CHECK_EQ(out_count, 3);
+    CHECK(out_is(0, HID_KEY_SHIFT_LEFT, true) && out[0].at_ms == 1070);
+    CHECK(out_is(1, HID_KEY_A, true) && out[1].time_ms == 1040);
+    CHECK(out_is(2, HID_KEY_A, false));
+    event(1100, HID_KEY_SPACE, false);
+    CHECK(out_is(3, HID_KEY_SHIFT_LEFT, false));
+}
+
+// Rolling from the dual-role key into the next one is a tap
+static void test_roll_is_tap(void) {
+    reset();
+    event(1000, HID_KEY_SPACE, true);
+    event(1030, HID_KEY_A, true);
+    event(1060, HID_KEY_SPACE, false);
+    event(1090, HID_KEY_A, false);
+    CHECK_EQ(out_count, 4);
+    CHECK(out_is(0, HID_KEY_SPACE, true) && out[0].at_ms == 1060);
+    CHECK(out_is(1, HID_KEY_A, true) && out[1].time_ms == 1030);
+    CHECK(out_is(2, HID_KEY_SPACE, false));
+    CHECK(out_is(3, HID_KEY_A, false) && out[3].at_ms == 1090);
+}
+
+// Events that arrive after the term decide hold at the term, not later
+static void test_term_passes_while_buffered(void) {
+    reset();
+    taphold_process(HID_KEY_SPACE, true, 1000);
+    taphold_process(HID_KEY_A, true, 1250);
+    CHECK(out_is(0, HID_KEY_SHIFT_LEFT, true) && out[0].time_ms == 1200);
+    CHECK(out_is(1, HID_KEY_A, true));
+}
+
+static void test_repeats_dropped(void) {
+    reset();
+    event(1000, HID_KEY_A, true);
+    event(1500, HID_KEY_A, true);
+    event(1533, HID_KEY_A, true);
+    event(1600, HID_KEY_A, false);
+    event(1601, HID_KEY_A, false);
+    CHECK_EQ(out_count, 2);
+
+    // A repeating dual-role key is still one hold
+    event(2000, HID_KEY_SPACE, true);
+    event(2500, HID_KEY_SPACE, true);
+    event(2533, HID_KEY_SPACE, true);
+    event(2600, HID_KEY_SPACE, false);
+    CHECK_EQ(out_count, 4);
+    CHECK(out_is(2, HID_KEY_SHIFT_LEFT, true) && out_is(3, HID_KEY_SHIFT_LEFT, false));
+}
+
+static void test_term_setting(void) {
+    reset();
+    taphold_set_term(50);
+    CHECK_EQ(taphold_get_term(), 50);
+    event(1000, HID_KEY_SPACE, true);
+    advance(1050);
+    CHECK(out_is(0, HID_KEY_SHIFT_LEFT, true) && out[0].at_ms == 1050);
+    event(1060, HID_KEY_SPACE, false);
+}
+
+// A full buffer settles the pending key as hold rather than drop events
+static void test_buffer_full(void) {
+    reset();
+    event(1000, HID_KEY_SPACE, true);
+    for (int i = 0; i < TAPHOLD_BUFFER_SIZE; i++) {
+        taphold_process((uint8_t) (HID_KEY_A + i), true, now_ms);
+    }
+    CHECK(taphold_pending());
+    CHECK_EQ(out_count, 0);
+    taphold_process(HID_KEY_1, true, now_ms);
+    CHECK(!taphold_pending());
+    CHECK(out_is(0, HID_KEY_SHIFT_LEFT, true));
+    CHECK_EQ(out_count, 2 + TAPHOLD_BUFFER_SIZE);
+    CHECK(out_is(out_count - 1, HID_KEY_1, true));
+}
+
+static int compare_u32(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*) a, y = *(const uint32_t*) b;
+    return x < y ? -1 : x > y;
+}
+
+typedef struct {
+    uint32_t time_ms;
+    uint8_t key;
+    bool pressed;
+} in_event_t;
+
+static int compare_events(const void* a, const void* b) {
+    const in_event_t* x = a;
+    const in_event_t* y = b;
+    return x->time_ms < y->time_ms ? -1 : x->time_ms > y->time_ms;
+}
+
+static void report_delays(const char* name, uint32_t* delay, int count) {
+    uint64_t sum = 0;
+    qsort(delay, count, sizeof(delay[0]), compare_u32);
+    for (int i = 0; i < count; i++) sum += delay[i];
+    printf("  %-9s %4d presses: delay mean %5.1f ms, median %3u ms, p99 %3u ms, max %3u ms\n",
+           name, count, (double) sum / count, delay[count / 2], delay[count * 99 / 100], delay[count - 1]);
+}
+
+// Random overlapping typing with Space as a dual-role key. Each press
+// passed on is matched to its physical press: nothing is lost, plain keys
+// wait only while a Space is undecided, and no press waits longer than
+// the term. The delays are reported.
+static void test_random_typing_latency(void) {
+    enum { PRESSES = 2000 };
+    static in_event_t events[2 * PRESSES];
+    static uint32_t press_time[256][PRESSES];
+    static uint16_t press_head[256], press_tail[256];
+    static uint32_t plain_delay[PRESSES], space_delay[PRESSES];
+    int count = 0, plain = 0, spaces = 0, unmatched = 0;
+    uint32_t plain_free = 0;
+
+    reset();
+    srand(1);
+    memset(press_head, 0, sizeof(press_head));
+    memset(press_tail, 0, sizeof(press_tail));
+
+    // 8 presses/s on average; letters held 40-120 ms, Space sometimes held
+    // as Shift for 250-450 ms; a key is not pressed again while down
+    uint32_t t = 1000;
+    uint32_t down_until[256] = { 0 };
+    for (int i = 0; i < PRESSES; i++) {
+        t += 20 + rand() % 230;
+        bool space = rand() % 5 == 0;
+        uint8_t key = space ? HID_KEY_SPACE : (uint8_t) (HID_KEY_A + rand() % 26);
+        if (down_until[key] >= t) continue;
+        uint32_t hold = space && rand() % 4 == 0 ? 250 + rand() % 200 : 40 + rand() % 80;
+        down_until[key] = t + hold;
+        events[count++] = (in_event_t) { t, key, true };
+        events[count++] = (in_event_t) { t + hold, key, false };
+    }
+    qsort(events, count, sizeof(events[0]), compare_events);
+
+    for (int i = 0; i < count; i++) {
+        const in_event_t* ev = &events[i];
+        if (ev->pressed) {
+            press_time[ev->key][press_tail[ev->key]++] = ev->time_ms;
+        }
+        event(ev->time_ms, ev->key, ev->pressed);
+    }
+    advance(now_ms + TAPHOLD_TERM_MS);
+
+    for (int j = 0; j < out_count; j++) {
+        if (!out[j].pressed) continue;
+        uint8_t key = out[j].key == HID_KEY_SHIFT_LEFT ? HID_KEY_SPACE : out[j].key;
+        if (press_head[key] == press_tail[key]) {
+            unmatched++;
+            continue;
+        }
+        uint32_t delay = out[j].at_ms - press_time[key][press_head[key]++];
+        if (key == HID_KEY_SPACE) space_delay[spaces++] = delay;
+        else plain_delay[plain++] = delay;
+        if (key != HID_KEY_SPACE && delay == 0) plain_free++;
+    }
+
+    CHECK_EQ(unmatched, 0);
+    CHECK_EQ(plain + spaces, count / 2);
+    report_delays("dual-role", space_delay, spaces);
+    report_delays("plain", plain_delay, plain);
+    printf("  plain presses not delayed at all: %u of %d\n", plain_free, plain);
+    CHECK(space_delay[spaces - 1] <= TAPHOLD_TERM_MS);
+    CHECK(plain_delay[plain - 1] <= TAPHOLD_TERM_MS);
+}
+
+// Overlapping typing: plain keys pressed during an undecided Space wait
+// exactly until it is decided
+static void test_overlap_latency(void) {
+    reset();
+    event(1000, HID_KEY_SPACE, true);
+    event(1020, HID_KEY_H, true);
+    event(1045, HID_KEY_SPACE, false);
+    event(1060, HID_KEY_H, false);
+    CHECK(out_is(1, HID_KEY_H, true));
+    CHECK_EQ(out[1].at_ms - 1020, 25);
+    printf("  key pressed inside a tap waits %u ms (until the tap's release)\n", out[1].at_ms - 1020);
+}
+
+int main(void) {
+    RUN(test_plain_keys_pass_straight_through);
+    RUN(test_tap);
+    RUN(test_hold_by_term);
+    RUN(test_permissive_hold);
+    RUN(test_roll_is_tap);
+    RUN(test_term_passes_while_buffered);
+    RUN(test_repeats_dropped);
+    RUN(test_term_setting);
+    RUN(test_buffer_full);
+    RUN(test_random_typing_latency);
+    RUN(test_overlap_latency);
+    return test_summary();
+}
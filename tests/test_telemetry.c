@@ -0,0 +1,358 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * Telemetry Tests
+ *
+ * Built with TELEMETRY_ENABLE=1 and KEYSTATS_ENABLE=1. Packets are decoded
+ * as tools/telemetry.py reads them, and sent through the TinyUSB stand-in
+ * the way main.c's telemetry_hid_task() does, so the check that keyboard
+ * reports go first covers the real endpoint handling.
+ */
+
+#include "test.h"
+#include "tusb.h"
+#include "pico/time.h"
+#include "usb_descriptors.h"
+#include "telemetry.h"
+#include "keystats.h"
+#include "boot_timing.h"
+#include "report_queue.h"
+#include "hid_keycodes.h"
+#include <string.h>
+
+#define PAYLOAD         4
+#define TRACE_PER_PKT   ((TELEMETRY_REPORT_SIZE - PAYLOAD) / 4)
+
+static uint8_t pkt[TELEMETRY_REPORT_SIZE];
+
+static uint32_t get_u32(const uint8_t* p, unsigned index) {
+    p += PAYLOAD + 4 * index;
+    return p[0] | (uint32_t) p[1] << 8 | (uint32_t) p[2] << 16 | (uint32_t) p[3] << 24;
+}
+
+static void advance_ms(uint32_t ms) {
+    mock_time_advance_us((uint64_t) ms * 1000);
+}
+
+static void reset(void) {
+    mock_time_reset(5000000);
+    mock_usb_reset();
+    report_queue_init();
+    keystats_init();
+    telemetry_init();
+}
+
+// Take every packet due now; returns how many, the types in types[]
+static int drain(uint8_t* types, int max) {
+    int n = 0;
+    while (telemetry_next_packet(pkt)) {
+        if (n < max) types[n] = pkt[0];
+        n++;
+        if (n > 1000) break;
+    }
+    return n;
+}
+
+//--------------------------------------------------------------------+
+// Stand-in for main.c
+//--------------------------------------------------------------------+
+
+// As telemetry_hid_task() in main.c
+static void telemetry_hid_task(void) {
+    uint8_t report[TELEMETRY_REPORT_SIZE];
+
+    if (tud_suspended() || report_queue_peek()) return;
+    if (!tud_hid_n_ready(HID_INSTANCE_TELEMETRY)) return;
+
+    uint16_t len = telemetry_next_packet(report);
+    if (len) tud_hid_n_report(HID_INSTANCE_TELEMETRY, 0, report, len);
+}
+
+// As send_keyboard_report() in main.c
+static void send_keyboard_report(void) {
+    if (!tud_hid_ready()) return;
+    const uint8_t* report = report_queue_peek();
+    if (report && tud_hid_report(0, report, REPORT_SIZE)) {
+        report_queue_pop();
+        telemetry_report_sent();
+    }
+}
+
+// Main loop every millisecond, the host polling both endpoints on the interval
+static void run_ms(uint32_t ms) {
+    for (uint32_t i = 0; i < ms; i++) {
+        advance_ms(1);
+        mock_now_ms = to_ms_since_boot(get_absolute_time());
+        telemetry_loop();
+        send_keyboard_report();
+        telemetry_hid_task();
+        if (mock_now_ms % HID_POLL_INTERVAL_MS == 0) {
+            mock_usb_poll(HID_INSTANCE_KEYBOARD);
+            mock_usb_poll(HID_INSTANCE_TELEMETRY);
+        }
+    }
+}
+
+//--------------------------------------------------------------------+
+// Tests
+//--------------------------------------------------------------------+
+
+// One of each summary packet per interval, then nothing until the next
+static void test_interval(void) {
+    uint8_t types[16];
+    reset();
+
+    CHECK_EQ(drain(types, 16), 4);
+    CHECK_EQ(types[0], TELEMETRY_PKT_COUNTERS);
+    CHECK_EQ(types[1], TELEMETRY_PKT_LOOP_HIST);
+    CHECK_EQ(types[2], TELEMETRY_PKT_LATENCY);
+    CHECK_EQ(types[3], TELEMETRY_PKT_BOOT);
+
+    advance_ms(TELEMETRY_INTERVAL_MS - 1);
+    CHECK_EQ(telemetry_next_packet(pkt), 0);
+    advance_ms(1);
+    CHECK_EQ(drain(types, 16), 4);
+    CHECK_EQ(types[0], TELEMETRY_PKT_COUNTERS);
+}
+
+static void test_header_and_counters(void) {
+    reset();
+    telemetry_count(TM_PS2_BYTES);
+    telemetry_count(TM_PS2_BYTES);
+    telemetry_count(TM_USB_SUSPENDS);
+
+    uint8_t first_seq;
+    CHECK_EQ(telemetry_next_packet(pkt), TELEMETRY_REPORT_SIZE);
+    first_seq = pkt[1];
+    CHECK_EQ(pkt[0], TELEMETRY_PKT_COUNTERS);
+    CHECK_EQ(pkt[2], TM_COUNTER_COUNT);
+    CHECK_EQ(pkt[3], 0);
+    CHECK_EQ(get_u32(pkt, 0), 5000);                    // uptime_ms
+    CHECK_EQ(get_u32(pkt, 1 + TM_PS2_BYTES), 2);
+    CHECK_EQ(get_u32(pkt, 1 + TM_USB_SUSPENDS), 1);
+    CHECK_EQ(get_u32(pkt, 1 + TM_KEY_EVENTS), 0);
+    CHECK_EQ(telemetry_counter(TM_PS2_BYTES), 2);
+
+    // Unused payload bytes are zero, the sequence number counts packets
+    for (unsigned i = PAYLOAD + 4 * (1 + TM_COUNTER_COUNT); i < TELEMETRY_REPORT_SIZE; i++) {
+        CHECK_EQ(pkt[i], 0);
+    }
+    telemetry_next_packet(pkt);
+    CHECK_EQ(pkt[1], (uint8_t) (first_seq + 1));
+
+    // GET_REPORT reads the counters without disturbing what is due
+    telemetry_counters_packet(pkt);
+    CHECK_EQ(pkt[0], TELEMETRY_PKT_COUNTERS);
+    CHECK_EQ(telemetry_next_packet(pkt), TELEMETRY_REPORT_SIZE);
+    CHECK_EQ(pkt[0], TELEMETRY_PKT_LATENCY);
+
+    // A reset from the host clears the counters
+    telemetry_init();
+    telemetry_next_packet(pkt);
+    CHECK_EQ(get_u32(pkt, 1 + TM_PS2_BYTES), 0);
+}
+
+// Bucket n holds 2^(n-1) <= v < 2^n microseconds
+static void test_loop_histogram(void) {
+    static const uint32_t pass_us[] = { 0, 1, 3, 4, 100, 1000000 };
+    reset();
+    for (unsigned i = 0; i < sizeof(pass_us) / sizeof(pass_us[0]); i++) {
+        mock_time_advance_us(pass_us[i]);
+        telemetry_loop();
+    }
+
+    telemetry_next_packet(pkt);
+    CHECK_EQ(telemetry_next_packet(pkt), TELEMETRY_REPORT_SIZE);
+    CHECK_EQ(pkt[0], TELEMETRY_PKT_LOOP_HIST);
+    CHECK_EQ(pkt[2], TELEMETRY_HIST_BUCKETS);
+    CHECK_EQ(get_u32(pkt, 0), 1);
+    CHECK_EQ(get_u32(pkt, 1), 1);
+    CHECK_EQ(get_u32(pkt, 2), 1);
+    CHECK_EQ(get_u32(pkt, 3), 1);
+    CHECK_EQ(get_u32(pkt, 7), 1);
+    CHECK_EQ(get_u32(pkt, TELEMETRY_HIST_BUCKETS - 1), 1);     // Everything above
+}
+
+// Latency runs from the first unreported key event to the report
+static void test_latency_histogram(void) {
+    reset();
+    telemetry_key_event();
+    mock_time_advance_us(600);
+    telemetry_key_event();                  // Same report: not restarted
+    mock_time_advance_us(900);
+    telemetry_report_sent();                // 1500 us
+    telemetry_report_sent();                // No event pending: not counted
+    telemetry_key_event();
+    mock_time_advance_us(20);
+    telemetry_report_sent();                // 20 us
+
+    telemetry_next_packet(pkt);
+    CHECK_EQ(get_u32(pkt, 1 + TM_KEY_EVENTS), 3);
+    CHECK_EQ(get_u32(pkt, 1 + TM_REPORTS_SENT), 3);
+    telemetry_next_packet(pkt);
+    telemetry_next_packet(pkt);
+    CHECK_EQ(pkt[0], TELEMETRY_PKT_LATENCY);
+    uint32_t total = 0;
+    for (unsigned b = 0; b < TELEMETRY_HIST_BUCKETS; b++) total += get_u32(pkt, b);
+    CHECK_EQ(total, 2);
+    CHECK_EQ(get_u32(pkt, 11), 1);          // 1024..2047
+    CHECK_EQ(get_u32(pkt, 5), 1);           // 16..31
+}
+
+static void test_boot_marks(void) {
+    reset();
+    boot_timing_mark(BOOT_MAIN);
+    advance_ms(3);
+    boot_timing_mark(BOOT_PS2_READY);
+
+    uint8_t types[8];
+    drain(types, 0);
+    // Drained past it: read it again next interval
+    advance_ms(TELEMETRY_INTERVAL_MS);
+    for (int i = 0; i < 4; i++) telemetry_next_packet(pkt);
+    CHECK_EQ(pkt[0], TELEMETRY_PKT_BOOT);
+    CHECK_EQ(pkt[2], BOOT_MARK_COUNT);
+    CHECK_EQ(get_u32(pkt, BOOT_MAIN), 5000000);
+    CHECK_EQ(get_u32(pkt, BOOT_PS2_READY), 5003000);
+    CHECK_EQ(get_u32(pkt, BOOT_USB_MOUNTED), 0);
+}
+
+static void test_trace(void) {
+    uint8_t types[8];
+    reset();
+    drain(types, 0);
+
+    telemetry_trace(TRACE_PS2_BYTE, 0x1C);
+    advance_ms(2);
+    telemetry_trace(TRACE_REPORT_SENT, HID_KEY_A);
+    CHECK_EQ(telemetry_trace_count(), 2);
+
+    CHECK_EQ(telemetry_next_packet(pkt), TELEMETRY_REPORT_SIZE);
+    CHECK_EQ(pkt[0], TELEMETRY_PKT_TRACE);
+    CHECK_EQ(pkt[2], 2);
+    CHECK_EQ(get_u32(pkt, 0), (5000 & 0xFFFF) | TRACE_PS2_BYTE << 16 | 0x1C << 24);
+    CHECK_EQ(get_u32(pkt, 1), (5002 & 0xFFFF) | TRACE_REPORT_SENT << 16 | HID_KEY_A << 24);
+    CHECK_EQ(telemetry_next_packet(pkt), 0);
+
+    // Sent entries stay readable for the console
+    CHECK_EQ(telemetry_trace_count(), 2);
+    CHECK_EQ(telemetry_trace_entry(1) >> 24, HID_KEY_A);
+
+    // More than a packet's worth goes out in full packets, in order
+    for (int i = 0; i < TRACE_PER_PKT + 3; i++) telemetry_trace(TRACE_PS2_BYTE, (uint8_t) i);
+    CHECK_EQ(telemetry_next_packet(pkt), TELEMETRY_REPORT_SIZE);
+    CHECK_EQ(pkt[2], TRACE_PER_PKT);
+    CHECK_EQ(get_u32(pkt, 0) >> 24, 0);
+    telemetry_next_packet(pkt);
+    CHECK_EQ(pkt[2], 3);
+    CHECK_EQ(get_u32(pkt, 2) >> 24, TRACE_PER_PKT + 2);
+}
+
+// A full ring drops the oldest unsent entry and counts it
+static void test_trace_overflow(void) {
+    uint8_t types[8];
+    reset();
+    drain(types, 0);
+
+    for (int i = 0; i < TELEMETRY_TRACE_SIZE + 5; i++) telemetry_trace(TRACE_PS2_BYTE, (uint8_t) i);
+    CHECK_EQ(telemetry_counter(TM_TRACE_DROPPED), 5);
+    CHECK_EQ(telemetry_trace_count(), TELEMETRY_TRACE_SIZE);
+    CHECK_EQ(telemetry_trace_entry(0) >> 24, 5);
+
+    int entries = 0;
+    uint32_t first = 0;
+    while (telemetry_next_packet(pkt)) {
+        if (entries == 0) first = get_u32(pkt, 0);
+        entries += pkt[2];
+    }
+    CHECK_EQ(entries, TELEMETRY_TRACE_SIZE);
+    CHECK_EQ(first >> 24, 5);
+}
+
+// One range of key counters with presses in it per interval, in turn
+static void test_key_counters(void) {
+    uint8_t types[8];
+    reset();
+    for (int i = 0; i < 3; i++) keystats_press(HID_KEY_A);
+    keystats_press(HID_KEY_ENTER);
+
+    CHECK_EQ(drain(types, 8), 5);
+    CHECK_EQ(types[4], TELEMETRY_PKT_KEYS);
+
+    // Each range with presses in it comes round in the following intervals
+    uint32_t count_a = 0, count_enter = 0;
+    for (int interval = 0; interval < 4; interval++) {
+        advance_ms(TELEMETRY_INTERVAL_MS);
+        while (telemetry_next_packet(pkt)) {
+            if (pkt[0] != TELEMETRY_PKT_KEYS) continue;
+            CHECK(pkt[2] > 0 && pkt[3] + pkt[2] <= KEYSTATS_KEYS);
+            if (pkt[3] <= HID_KEY_A && HID_KEY_A < pkt[3] + pkt[2]) {
+                count_a = get_u32(pkt, HID_KEY_A - pkt[3]);
+            }
+            if (pkt[3] <= HID_KEY_ENTER && HID_KEY_ENTER < pkt[3] + pkt[2]) {
+                count_enter = get_u32(pkt, HID_KEY_ENTER - pkt[3]);
+            }
+        }
+    }
+    CHECK_EQ(count_a, 3);
+    CHECK_EQ(count_enter, 1);
+
+    // No presses: no KEYS packet
+    keystats_init();
+    advance_ms(TELEMETRY_INTERVAL_MS);
+    CHECK_EQ(drain(types, 8), 4);
+}
+
+// Packets go out on the telemetry endpoint only while no keyboard report
+// waits, and the keyboard reports keep their own timing
+static void test_keyboard_first(void) {
+    reset();
+    mock_now_ms = to_ms_since_boot(get_absolute_time());
+    run_ms(100);
+    int telemetry_before = 0;
+    for (int i = 0; i < mock_usb_log_count; i++) {
+        CHECK_EQ(mock_usb_log[i].instance, HID_INSTANCE_TELEMETRY);
+        CHECK_EQ(mock_usb_log[i].len, TELEMETRY_REPORT_SIZE);
+        telemetry_before++;
+    }
+    CHECK_EQ(telemetry_before, 4);
+
+    // A burst of keys queued while trace entries wait
+    for (int i = 0; i < 20; i++) telemetry_trace(TRACE_PS2_BYTE, (uint8_t) i);
+    mock_usb_log_count = 0;
+    for (int i = 0; i < 4; i++) {
+        uint8_t report[REPORT_SIZE] = { 0, 0, (uint8_t) (HID_KEY_A + i) };
+        report_queue_push(report);
+        telemetry_key_event();
+    }
+    run_ms(100);
+
+    int keyboard = 0, trace = 0, last_keyboard = -1, first_trace = -1;
+    for (int i = 0; i < mock_usb_log_count; i++) {
+        if (mock_usb_log[i].instance == HID_INSTANCE_KEYBOARD) {
+            CHECK_EQ(mock_usb_log[i].data[2], HID_KEY_A + keyboard);
+            CHECK_EQ(mock_usb_log[i].time_ms, 5100 + HID_POLL_INTERVAL_MS * (keyboard + 1));
+            keyboard++;
+            last_keyboard = i;
+        } else if (mock_usb_log[i].data[0] == TELEMETRY_PKT_TRACE) {
+            if (first_trace < 0) first_trace = i;
+            trace += mock_usb_log[i].data[2];
+        }
+    }
+    CHECK_EQ(keyboard, 4);
+    CHECK_EQ(trace, 20);
+    // The trace waited for the last key report to leave the queue
+    CHECK(first_trace > last_keyboard);
+}
+
+int main(void) {
+    RUN(test_interval);
+    RUN(test_header_and_counters);
+    RUN(test_loop_histogram);
+    RUN(test_latency_histogram);
+    RUN(test_boot_marks);
+    RUN(test_trace);
+    RUN(test_trace_overflow);
+    RUN(test_key_counters);
+    RUN(test_keyboard_first);
+    return test_summary();
+}
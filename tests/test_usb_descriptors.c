@@ -0,0 +1,257 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * USB Descriptor Tests
+ *
+ * usb_descriptors.c built against the TinyUSB descriptor stand-in, once
+ * plain and once with every optional interface (test_usb_descriptors_all).
+ * The boot profile must come out byte for byte as the original
+ * keyboard-only firmware's configuration descriptor in both builds; the
+ * other profiles are walked descriptor by descriptor.
+ */
+
+#include "test.h"
+#include "tusb.h"
+#include "bsp/board_api.h"
+#include "usb_descriptors.h"
+#include "usb_profile.h"
+#include "config.h"
+#include <string.h>
+
+// Descriptor callbacks the stack would call
+uint8_t const* tud_descriptor_device_cb(void);
+uint8_t const* tud_descriptor_configuration_cb(uint8_t index);
+uint8_t const* tud_hid_descriptor_report_cb(uint8_t instance);
+
+//--------------------------------------------------------------------+
+// Stand-ins
+//--------------------------------------------------------------------+
+
+size_t board_usb_get_serial(uint16_t desc_str[], size_t max_chars) {
+    (void) max_chars;
+    desc_str[0] = '1';
+    return 1;
+}
+
+#if CONFIG_ENABLE
+static uint8_t poll_interval_ms = HID_POLL_INTERVAL_MS;
+
+uint8_t config_poll_interval(void) {
+    return poll_interval_ms;
+}
+#endif
+
+//--------------------------------------------------------------------+
+// Helpers
+//--------------------------------------------------------------------+
+
+// Configuration descriptor of the keyboard-only firmware this bridge
+// started as, which BMC64 was tested with
+static const uint8_t boot_configuration[34] = {
+    // Configuration: 34 bytes, 1 interface, bus powered, remote wakeup, 100 mA
+    0x09, 0x02, 0x22, 0x00, 0x01, 0x01, 0x00, 0xA0, 0x32,
+    // Interface 0: HID, boot subclass, keyboard protocol
+    0x09, 0x04, 0x00, 0x00, 0x01, 0x03, 0x01, 0x01, 0x00,
+    // HID 1.11, one 65-byte report descriptor
+    0x09, 0x21, 0x11, 0x01, 0x00, 0x01, 0x22, 0x41, 0x00,
+    // Endpoint 0x81: interrupt IN, 16 bytes, 10 ms
+    0x07, 0x05, 0x81, 0x03, 0x10, 0x00, 0x0A,
+};
+
+typedef struct {
+    uint8_t interfaces;             // Interface descriptors
+    uint8_t hid_interfaces;
+    uint8_t protocol[8];            // bInterfaceProtocol per HID interface
+    uint16_t report_len[8];         // wDescriptorLength per HID interface
+    uint8_t endpoints;
+    uint8_t ep_address[16];
+    uint16_t ep_size[16];
+    uint8_t ep_interval[16];
+    bool well_formed;               // Lengths add up to wTotalLength
+} config_info_t;
+
+static uint16_t get_u16(const uint8_t* p) {
+    return (uint16_t) (p[0] | p[1] << 8);
+}
+
+static config_info_t walk(const uint8_t* desc, uint16_t len) {
+    config_info_t info;
+    memset(&info, 0, sizeof(info));
+
+    uint16_t pos = 0;
+    while (pos + 2 <= len && desc[pos] >= 2) {
+        const uint8_t* d = &desc[pos];
+        switch (d[1]) {
+            case TUSB_DESC_INTERFACE:
+                info.interfaces++;
+                if (d[5] == TUSB_CLASS_HID && info.hid_interfaces < 8) {
+                    info.protocol[info.hid_interfaces++] = d[7];
+                }
+                break;
+            case HID_DESC_TYPE_HID:
+                info.report_len[info.hid_interfaces - 1] = get_u16(&d[7]);
+                break;
+            case TUSB_DESC_ENDPOINT:
+                if (info.endpoints < 16) {
+                    info.ep_address[info.endpoints] = d[2];
+                    info.ep_size[info.endpoints] = get_u16(&d[4]);
+                    info.ep_interval[info.endpoints] = d[6];
+                    info.endpoints++;
+                }
+                break;
+        }
+        pos += d[0];
+    }
+    info.well_formed = pos == len && get_u16(&desc[2]) == len && desc[4] == info.interfaces;
+    return info;
+}
+
+static int find_ep(const config_info_t* info, uint8_t address) {
+    for (int i = 0; i < info->endpoints; i++) {
+        if (info->ep_address[i] == address) return i;
+    }
+    return -1;
+}
+
+//--------------------------------------------------------------------+
+// Tests
+//--------------------------------------------------------------------+
+
+static void test_boot_profile_unchanged(void) {
+    uint8_t desc[512];
+    memset(desc, 0xEE, sizeof(desc));
+    uint16_t len = usb_descriptors_configuration(USB_PROFILE_BOOT, desc);
+    CHECK_EQ(len, sizeof(boot_configuration));
+    CHECK(memcmp(desc, boot_configuration, sizeof(boot_configuration)) == 0);
+    for (unsigned i = 0; i < len; i++) {
+        if (desc[i] != boot_configuration[i]) {
+            printf("  byte %u is 0x%02X, expected 0x%02X\n", i, desc[i], boot_configuration[i]);
+        }
+    }
+    CHECK_EQ(desc[len], 0xEE);
+}
+
+// The boot profile's keyboard has no configuration feature report
+static void test_boot_report_descriptor(void) {
+    static const uint8_t keyboard_start[] = { 0x05, 0x01, 0x09, 0x06, 0xA1, 0x01, 0x05, 0x07 };
+    usb_profile_request(USB_PROFILE_BOOT);
+    usb_profile_apply();
+    const uint8_t* report = tud_hid_descriptor_report_cb(HID_INSTANCE_KEYBOARD);
+    CHECK(memcmp(report, keyboard_start, sizeof(keyboard_start)) == 0);
+    CHECK_EQ(report[64], 0xC0);     // End collection, 65 bytes in all
+}
+
+// Keyboard and consumer endpoints keep their own size whatever buffer
+// the vendor interfaces need
+static void test_profiles(void) {
+    for (uint8_t profile = 0; profile < USB_PROFILE_COUNT; profile++) {
+        uint8_t desc[512];
+        uint8_t itfs = usb_profile_interfaces(profile);
+        uint16_t len = usb_descriptors_configuration(profile, desc);
+        config_info_t info = walk(desc, len);
+
+        CHECK(info.well_formed);
+        CHECK_EQ(info.protocol[0], HID_ITF_PROTOCOL_KEYBOARD);
+        CHECK_EQ(info.ep_address[0], 0x81);
+        CHECK_EQ(info.ep_size[0], 16);
+        CHECK_EQ(info.ep_interval[0], HID_POLL_INTERVAL_MS);
+
+        uint8_t hid = 1 + !!(itfs & USB_ITF_CONSUMER) + !!(itfs & USB_ITF_PASTE) + !!(itfs & USB_ITF_TELEMETRY);
+        CHECK_EQ(info.hid_interfaces, hid);
+        CHECK_EQ(info.interfaces, hid + ((itfs & USB_ITF_CDC) ? 2 : 0));
+
+        int consumer = find_ep(&info, 0x86);
+        CHECK_EQ(consumer >= 0, !!(itfs & USB_ITF_CONSUMER));
+        if (consumer >= 0) CHECK_EQ(info.ep_size[consumer], 16);
+
+        int paste = find_ep(&info, 0x82);
+        CHECK_EQ(paste >= 0, !!(itfs & USB_ITF_PASTE));
+        if (paste >= 0) {
+            CHECK_EQ(info.ep_size[paste], 64);
+            CHECK_EQ(info.ep_size[find_ep(&info, 0x02)], 64);
+        }
+
+        int telemetry = find_ep(&info, 0x83);
+        CHECK_EQ(telemetry >= 0, !!(itfs & USB_ITF_TELEMETRY));
+        if (telemetry >= 0) CHECK_EQ(info.ep_size[telemetry], 64);
+
+        // Every IN endpoint fits the stack's buffer
+        for (int i = 0; i < info.endpoints; i++) {
+            CHECK(info.ep_size[i] <= 64);
+        }
+    }
+}
+
+// The HID descriptors give each report descriptor's real length
+static void test_report_lengths(void) {
+    uint8_t desc[512];
+    uint8_t profile = USB_PROFILE_COUNT - 1;
+    while (profile > 0 && usb_profile_request(profile) == false) profile--;
+    usb_profile_apply();
+    uint16_t len = usb_descriptors_configuration(usb_profile_active(), desc);
+    config_info_t info = walk(desc, len);
+
+    CHECK_EQ(info.report_len[HID_INSTANCE_KEYBOARD], CONFIG_ENABLE ? 65 + 16 : 65);
+    if (info.hid_interfaces > HID_INSTANCE_CONSUMER) {
+        const uint8_t* consumer = tud_hid_descriptor_report_cb(HID_INSTANCE_CONSUMER);
+        CHECK_EQ(consumer[info.report_len[HID_INSTANCE_CONSUMER] - 1], 0xC0);
+    }
+#if PASTE_ENABLE
+    CHECK_EQ(info.report_len[HID_INSTANCE_PASTE], 34);
+#endif
+#if TELEMETRY_ENABLE
+    const uint8_t* telemetry = tud_hid_descriptor_report_cb(HID_INSTANCE_TELEMETRY);
+    CHECK_EQ(telemetry[0], 0x06);
+    CHECK_EQ(telemetry[4], 0x02);   // Usage 2, as tools/telemetry.py looks for
+    CHECK_EQ(telemetry[info.report_len[HID_INSTANCE_TELEMETRY] - 1], 0xC0);
+#endif
+
+    // The served descriptor is the active profile's
+    CHECK(memcmp(tud_descriptor_configuration_cb(0), desc, len) == 0);
+}
+
+static void test_device_descriptor(void) {
+    usb_profile_request(USB_PROFILE_BOOT);
+    usb_profile_apply();
+    const tusb_desc_device_t* dev = (const tusb_desc_device_t*) tud_descriptor_device_cb();
+    CHECK_EQ(dev->bLength, 18);
+    CHECK_EQ(dev->idVendor, 0xCAFE);
+    CHECK_EQ(dev->idProduct, 0x4004);
+    CHECK_EQ(dev->bDeviceClass, 0);
+    CHECK_EQ(dev->bMaxPacketSize0, 64);
+
+    usb_profile_request(USB_PROFILE_STANDARD);
+    usb_profile_apply();
+    dev = (const tusb_desc_device_t*) tud_descriptor_device_cb();
+    CHECK_EQ(dev->idProduct, USB_PROFILE_PID(usb_profile_interfaces(USB_PROFILE_STANDARD)));
+    CHECK(dev->idProduct != 0x4004);
+}
+
+#if CONFIG_ENABLE
+// A changed poll interval lands in the keyboard endpoint only; it is the
+// one byte of the boot profile that may differ
+static void test_poll_interval(void) {
+    uint8_t desc[512];
+    poll_interval_ms = 1;
+    uint16_t len = usb_descriptors_configuration(USB_PROFILE_STANDARD, desc);
+    config_info_t info = walk(desc, len);
+    CHECK_EQ(info.ep_interval[0], 1);
+    CHECK_EQ(info.ep_interval[find_ep(&info, 0x86)], 10);
+
+    len = usb_descriptors_configuration(USB_PROFILE_BOOT, desc);
+    CHECK(memcmp(desc, boot_configuration, 33) == 0);
+    CHECK_EQ(desc[33], 1);
+    poll_interval_ms = HID_POLL_INTERVAL_MS;
+}
+#endif
+
+int main(void) {
+    RUN(test_boot_profile_unchanged);
+    RUN(test_boot_report_descriptor);
+    RUN(test_profiles);
+    RUN(test_report_lengths);
+    RUN(test_device_descriptor);
+#if CONFIG_ENABLE
+    RUN(test_poll_interval);
+#endif
+    return test_summary();
+}
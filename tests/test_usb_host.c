@@ -0,0 +1,243 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * USB Keyboard Input Tests
+ *
+ * Report descriptors parsed into key fields, and reports from one or more
+ * keyboards turned into the key events usb_host.c passes to the pipeline.
+ * All keyboards feed the one pipeline, so a key is pressed when the first
+ * keyboard presses it and released when the last lets go.
+ */
+
+#include "test.h"
+#include "usb_host.h"
+#include "hid_keycodes.h"
+#include "test_usb_keyboards.h"
+#include <string.h>
+
+typedef struct {
+    uint8_t key;
+    bool pressed;
+} out_event_t;
+
+static out_event_t out[64];
+static int out_count;
+
+static void sink(uint8_t key, bool pressed, uint32_t time_ms) {
+    (void) time_ms;
+    if (out_count < (int) (sizeof(out) / sizeof(out[0]))) out[out_count++] = (out_event_t) { key, pressed };
+}
+
+static usb_host_layout_t boot_layout;
+static usb_host_layout_t nkro_layout;
+
+// Boot keyboards in slots 0 and 1, the NKRO keyboard in slot 2
+static void reset(void) {
+    usb_host_init(sink);
+    usb_host_boot_layout(&boot_layout);
+    usb_host_parse_layout(nkro_keyboard_desc, sizeof(nkro_keyboard_desc), &nkro_layout);
+    usb_host_attach(0, &boot_layout);
+    usb_host_attach(1, &boot_layout);
+    usb_host_attach(2, &nkro_layout);
+    out_count = 0;
+}
+
+static void boot(uint8_t slot, uint8_t modifiers, const uint8_t* keys) {
+    uint8_t report[8];
+    boot_report(report, modifiers, keys);
+    usb_host_report(slot, report, sizeof(report), 0);
+}
+
+static bool out_is(int i, uint8_t key, bool pressed) {
+    return i < out_count && out[i].key == key && out[i].pressed == pressed;
+}
+
+static bool field_is(const usb_host_field_t* f, uint8_t id, uint8_t usage_min, bool array,
+                     uint8_t size, uint8_t count, uint16_t bit_offset) {
+    return f->report_id == id && f->usage_min == usage_min && f->logical_min == 0 &&
+           f->array == array && f->size == size && f->count == count && f->bit_offset == bit_offset;
+}
+
+//--------------------------------------------------------------------+
+// Report Descriptors
+//--------------------------------------------------------------------+
+
+static void test_boot_descriptor(void) {
+    usb_host_layout_t boot, parsed;
+    usb_host_boot_layout(&boot);
+    CHECK(usb_host_parse_layout(boot_keyboard_desc, sizeof(boot_keyboard_desc), &parsed));
+    CHECK_EQ(parsed.count, 2);
+    CHECK(!parsed.report_ids);
+    CHECK(memcmp(parsed.fields, boot.fields, 2 * sizeof(usb_host_field_t)) == 0);
+}
+
+// Key fields of IDs 1 and 3; the media keys of ID 2 are not keyboard keys
+static void test_nkro_descriptor(void) {
+    usb_host_layout_t layout;
+    CHECK(usb_host_parse_layout(nkro_keyboard_desc, sizeof(nkro_keyboard_desc), &layout));
+    CHECK(layout.report_ids);
+    CHECK_EQ(layout.count, 4);
+    CHECK(field_is(&layout.fields[0], 1, 0xE0, false, 1, 8, 0));
+    CHECK(field_is(&layout.fields[1], 1, 0x00, true, 8, 6, 16));
+    CHECK(field_is(&layout.fields[2], 3, 0xE0, false, 1, 8, 0));
+    CHECK(field_is(&layout.fields[3], 3, 0x00, false, 1, NKRO_BITMAP_KEYS, 8));
+
+    CHECK(!usb_host_parse_layout(mouse_desc, sizeof(mouse_desc), &layout));
+    CHECK_EQ(layout.count, 0);
+
+    // A descriptor cut short keeps the fields read so far
+    CHECK(usb_host_parse_layout(boot_keyboard_desc, 24, &layout));
+    CHECK_EQ(layout.count, 1);
+}
+
+//--------------------------------------------------------------------+
+// One Keyboard
+//--------------------------------------------------------------------+
+
+// Releases (keys, then modifiers) before presses (modifiers, then keys)
+static void test_event_order(void) {
+    reset();
+    boot(0, HID_MOD_LEFT_CTRL, (const uint8_t[]) { HID_KEY_A, 0 });
+    CHECK_EQ(out_count, 2);
+    CHECK(out_is(0, HID_KEY_CONTROL_LEFT, true));
+    CHECK(out_is(1, HID_KEY_A, true));
+
+    boot(0, HID_MOD_LEFT_SHIFT, (const uint8_t[]) { HID_KEY_B, 0 });
+    CHECK_EQ(out_count, 6);
+    CHECK(out_is(2, HID_KEY_A, false));
+    CHECK(out_is(3, HID_KEY_CONTROL_LEFT, false));
+    CHECK(out_is(4, HID_KEY_SHIFT_LEFT, true));
+    CHECK(out_is(5, HID_KEY_B, true));
+
+    // The same report again changes nothing
+    boot(0, HID_MOD_LEFT_SHIFT, (const uint8_t[]) { HID_KEY_B, 0 });
+    CHECK_EQ(out_count, 6);
+    CHECK_EQ(usb_host_stats()->events, 6);
+}
+
+// Each report ID keeps its own keys; reports without key fields and error
+// rollover reports leave them alone
+static void test_report_ids(void) {
+    reset();
+    usb_host_report(2, (const uint8_t[]) { 1, 0, 0, HID_KEY_A, 0, 0, 0, 0, 0 }, 9, 0);
+    uint8_t report[NKRO_REPORT_SIZE];
+    nkro_report(report, 0, (const uint8_t[]) { HID_KEY_B, 0 });
+    usb_host_report(2, report, sizeof(report), 0);
+    usb_host_report(2, (const uint8_t[]) { 1, 0, 0, 0, 0, 0, 0, 0, 0 }, 9, 0);
+    usb_host_report(2, (const uint8_t[]) { 2, 0xE9, 0x00 }, 3, 0);
+    CHECK_EQ(out_count, 3);
+    CHECK(out_is(0, HID_KEY_A, true));
+    CHECK(out_is(1, HID_KEY_B, true));
+    CHECK(out_is(2, HID_KEY_A, false));
+    CHECK_EQ(usb_host_stats()->unmatched, 1);
+
+    boot(0, 0, (const uint8_t[]) { HID_KEY_A, 0 });
+    boot(0, 0, (const uint8_t[]) { 1, 1, 1, 1, 1, 1 });
+    CHECK_EQ(out_count, 4);
+    CHECK_EQ(usb_host_stats()->rollovers, 1);
+    CHECK_EQ(usb_host_stats()->reports, 6);
+}
+
+// Unplugging releases keys, then modifiers; its reports are ignored after
+static void test_detach(void) {
+    reset();
+    boot(0, HID_MOD_LEFT_SHIFT, (const uint8_t[]) { HID_KEY_A, HID_KEY_B, 0 });
+    usb_host_detach(0, 0);
+    CHECK_EQ(out_count, 6);
+    CHECK(out_is(3, HID_KEY_A, false));
+    CHECK(out_is(4, HID_KEY_B, false));
+    CHECK(out_is(5, HID_KEY_SHIFT_LEFT, false));
+
+    boot(0, 0, (const uint8_t[]) { HID_KEY_A, 0 });
+    usb_host_detach(0, 0);
+    CHECK_EQ(out_count, 6);
+}
+
+//--------------------------------------------------------------------+
+// Several Keyboards
+//--------------------------------------------------------------------+
+
+// A held on keyboard 0, pressed and released on keyboard 1: A stays down
+// until keyboard 0 lets go
+static void test_shared_key(void) {
+    reset();
+    boot(0, 0, (const uint8_t[]) { HID_KEY_A, 0 });
+    boot(1, 0, (const uint8_t[]) { HID_KEY_A, 0 });
+    boot(1, 0, NULL);
+    CHECK_EQ(out_count, 1);
+    CHECK(out_is(0, HID_KEY_A, true));
+
+    boot(0, 0, NULL);
+    CHECK_EQ(out_count, 2);
+    CHECK(out_is(1, HID_KEY_A, false));
+
+    // Other keys on the second keyboard still come through
+    boot(0, 0, (const uint8_t[]) { HID_KEY_A, 0 });
+    boot(1, 0, (const uint8_t[]) { HID_KEY_A, HID_KEY_B, 0 });
+    boot(1, 0, (const uint8_t[]) { HID_KEY_A, 0 });
+    CHECK_EQ(out_count, 5);
+    CHECK(out_is(3, HID_KEY_B, true));
+    CHECK(out_is(4, HID_KEY_B, false));
+    CHECK_EQ(usb_host_stats()->events, 5);
+}
+
+// Shift held on an NKRO keyboard and typed on a boot one
+static void test_shared_modifier(void) {
+    reset();
+    uint8_t report[NKRO_REPORT_SIZE];
+    nkro_report(report, HID_MOD_LEFT_SHIFT, NULL);
+    usb_host_report(2, report, sizeof(report), 0);
+    boot(0, HID_MOD_LEFT_SHIFT, (const uint8_t[]) { HID_KEY_A, 0 });
+    boot(0, 0, NULL);
+    CHECK_EQ(out_count, 3);
+    CHECK(out_is(0, HID_KEY_SHIFT_LEFT, true));
+    CHECK(out_is(1, HID_KEY_A, true));
+    CHECK(out_is(2, HID_KEY_A, false));
+
+    nkro_report(report, 0, NULL);
+    usb_host_report(2, report, sizeof(report), 0);
+    CHECK(out_is(3, HID_KEY_SHIFT_LEFT, false));
+}
+
+// Unplugging one keyboard leaves the keys another holds
+static void test_detach_shared(void) {
+    reset();
+    boot(0, 0, (const uint8_t[]) { HID_KEY_A, HID_KEY_B, 0 });
+    boot(1, HID_MOD_LEFT_CTRL, (const uint8_t[]) { HID_KEY_A, 0 });
+    CHECK_EQ(out_count, 3);
+
+    usb_host_detach(1, 0);
+    CHECK_EQ(out_count, 4);
+    CHECK(out_is(3, HID_KEY_CONTROL_LEFT, false));
+
+    usb_host_detach(0, 0);
+    CHECK_EQ(out_count, 6);
+    CHECK(out_is(4, HID_KEY_A, false));
+    CHECK(out_is(5, HID_KEY_B, false));
+
+    // Plugged in again: pressed afresh
+    usb_host_attach(0, &boot_layout);
+    boot(0, 0, (const uint8_t[]) { HID_KEY_A, 0 });
+    CHECK(out_is(6, HID_KEY_A, true));
+}
+
+// PS/2 LED bits (Scroll, Num, Caps) to HID ones (Num, Caps, Scroll)
+static void test_leds(void) {
+    CHECK_EQ(usb_host_leds_from_ps2(0x00), 0x00);
+    CHECK_EQ(usb_host_leds_from_ps2(0x01), 0x04);
+    CHECK_EQ(usb_host_leds_from_ps2(0x02), 0x01);
+    CHECK_EQ(usb_host_leds_from_ps2(0x04), 0x02);
+    CHECK_EQ(usb_host_leds_from_ps2(0x07), 0x07);
+}
+
+int main(void) {
+    RUN(test_boot_descriptor);
+    RUN(test_nkro_descriptor);
+    RUN(test_event_order);
+    RUN(test_report_ids);
+    RUN(test_detach);
+    RUN(test_shared_key);
+    RUN(test_shared_modifier);
+    RUN(test_detach_shared);
+    RUN(test_leds);
+    return test_summary();
+}
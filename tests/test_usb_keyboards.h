@@ -0,0 +1,70 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * USB Keyboard Descriptors for Tests
+ *
+ * Report descriptors as keyboards send them, and the reports they make,
+ * shared by test_usb_host.c and test_reverse.c.
+ */
+
+#ifndef TEST_USB_KEYBOARDS_H_
+#define TEST_USB_KEYBOARDS_H_
+
+#include <stdint.h>
+#include <string.h>
+
+// Boot keyboard in report protocol: modifiers, reserved byte, LEDs out,
+// six keycodes
+static const uint8_t boot_keyboard_desc[] = {
+    0x05, 0x01, 0x09, 0x06, 0xA1, 0x01,
+    0x05, 0x07, 0x19, 0xE0, 0x29, 0xE7, 0x15, 0x00, 0x25, 0x01, 0x75, 0x01, 0x95, 0x08, 0x81, 0x02,
+    0x95, 0x01, 0x75, 0x08, 0x81, 0x01,
+    0x95, 0x05, 0x75, 0x01, 0x05, 0x08, 0x19, 0x01, 0x29, 0x05, 0x91, 0x02,
+    0x95, 0x01, 0x75, 0x03, 0x91, 0x01,
+    0x95, 0x06, 0x75, 0x08, 0x15, 0x00, 0x25, 0x65, 0x05, 0x07, 0x19, 0x00, 0x29, 0x65, 0x81, 0x00,
+    0xC0,
+};
+
+// ID 1: 6KRO keyboard, ID 2: media keys, ID 3: NKRO bitmap of keys 0x00-0x77
+static const uint8_t nkro_keyboard_desc[] = {
+    0x05, 0x01, 0x09, 0x06, 0xA1, 0x01, 0x85, 0x01,
+    0x05, 0x07, 0x19, 0xE0, 0x29, 0xE7, 0x15, 0x00, 0x25, 0x01, 0x75, 0x01, 0x95, 0x08, 0x81, 0x02,
+    0x95, 0x01, 0x75, 0x08, 0x81, 0x01,
+    0x95, 0x06, 0x75, 0x08, 0x15, 0x00, 0x26, 0xFF, 0x00, 0x05, 0x07, 0x19, 0x00, 0x2A, 0xFF, 0x00,
+    0x81, 0x00,
+    0xC0,
+    0x05, 0x0C, 0x09, 0x01, 0xA1, 0x01, 0x85, 0x02,
+    0x15, 0x00, 0x26, 0xFF, 0x03, 0x19, 0x00, 0x2A, 0xFF, 0x03, 0x75, 0x10, 0x95, 0x01, 0x81, 0x00,
+    0xC0,
+    0x05, 0x01, 0x09, 0x06, 0xA1, 0x01, 0x85, 0x03,
+    0x05, 0x07, 0x19, 0xE0, 0x29, 0xE7, 0x15, 0x00, 0x25, 0x01, 0x75, 0x01, 0x95, 0x08, 0x81, 0x02,
+    0x19, 0x00, 0x29, 0x77, 0x95, 0x78, 0x81, 0x02,
+    0xC0,
+};
+#define NKRO_BITMAP_KEYS        0x78
+#define NKRO_REPORT_SIZE        17          // ID 3: ID, modifiers, 15 bitmap bytes
+
+static const uint8_t mouse_desc[] = {
+    0x05, 0x01, 0x09, 0x02, 0xA1, 0x01, 0x09, 0x01, 0xA1, 0x00,
+    0x05, 0x09, 0x19, 0x01, 0x29, 0x03, 0x15, 0x00, 0x25, 0x01, 0x95, 0x03, 0x75, 0x01, 0x81, 0x02,
+    0x95, 0x01, 0x75, 0x05, 0x81, 0x01,
+    0x05, 0x01, 0x09, 0x30, 0x09, 0x31, 0x15, 0x81, 0x25, 0x7F, 0x75, 0x08, 0x95, 0x02, 0x81, 0x06,
+    0xC0, 0xC0,
+};
+
+// Boot report with modifiers and up to six keys (0-terminated)
+static inline void boot_report(uint8_t report[8], uint8_t modifiers, const uint8_t* keys) {
+    memset(report, 0, 8);
+    report[0] = modifiers;
+    for (int i = 0; i < 6 && keys && keys[i]; i++) report[2 + i] = keys[i];
+}
+
+// NKRO keyboard report ID 3 with modifiers and keys below NKRO_BITMAP_KEYS
+// (0-terminated)
+static inline void nkro_report(uint8_t report[NKRO_REPORT_SIZE], uint8_t modifiers, const uint8_t* keys) {
+    memset(report, 0, NKRO_REPORT_SIZE);
+    report[0] = 3;
+    report[1] = modifiers;
+    for (int i = 0; keys && keys[i]; i++) report[2 + keys[i] / 8] |= (uint8_t) (1u << (keys[i] % 8));
+}
+
+#endif /* TEST_USB_KEYBOARDS_H_ */
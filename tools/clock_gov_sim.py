@@ -0,0 +1,172 @@
+#!/usr/bin/env python3
+"""
+PS/2 to USB HID Keyboard Bridge - clock governor simulation
+
+Runs the firmware's clock governor (clock_gov.c, built as a host library)
+against a keyboard activity trace and reports how long the bridge ran at
+each speed, how quickly it came back up, and the estimated energy saved.
+
+  clock_gov_sim.py --native ./libclockgov.so                 synthetic 8 h day
+  clock_gov_sim.py --native ./libclockgov.so --hours 24 --seed 3
+  clock_gov_sim.py --native ./libclockgov.so --trace keys.txt
+
+Build the library with the same settings as the firmware, e.g.
+
+  gcc -shared -fPIC -I. -o libclockgov.so clock_gov.c
+  gcc -shared -fPIC -I. -DCLOCK_GOV_IDLE_MS=5000 -o libclockgov.so clock_gov.c
+
+A trace file has one key press per line: its time in seconds from the
+start. Each press keeps the keyboard active for --press-ms.
+
+Energy model: current = static + dynamic, where the dynamic part scales
+with clock and voltage squared.
+"""
+
+import argparse
+import ctypes
+import random
+import sys
+
+# Mirrors clock_gov.h
+FULL, LOW, WAKING = 0, 1, 2
+NONE, SLOW_DOWN, VOLTAGE_UP, SPEED_UP = 0, 1, 2, 3
+
+
+def synthetic_trace(rng, hours, typing_s, idle_s, keys_per_s):
+    """Press times (s): typing bursts separated by exponential idle gaps."""
+    presses = []
+    t = 0.0
+    end = hours * 3600
+    while t < end:
+        burst_end = t + rng.expovariate(1 / typing_s)
+        while t < min(burst_end, end):
+            presses.append(t)
+            t += rng.expovariate(keys_per_s)
+        t += rng.expovariate(1 / idle_s)
+    return presses
+
+
+def read_trace(path):
+    with open(path) as f:
+        return sorted(float(line.split()[0]) for line in f if line.strip() and not line.startswith('#'))
+
+
+def activity(presses, press_s):
+    """Merge presses into sorted, non-overlapping (start, end) intervals."""
+    spans = []
+    for t in presses:
+        if spans and t <= spans[-1][1]:
+            spans[-1] = (spans[-1][0], max(spans[-1][1], t + press_s))
+        else:
+            spans.append((t, t + press_s))
+    return spans
+
+
+class Governor:
+    def __init__(self, path):
+        self.lib = ctypes.CDLL(path)
+        self.lib.clock_gov_update.restype = ctypes.c_int
+        self.lib.clock_gov_update.argtypes = [ctypes.c_uint32, ctypes.c_bool]
+        self.lib.clock_gov_init.argtypes = [ctypes.c_uint32]
+        self.lib.clock_gov_init(0)
+
+    def update(self, now_us, active):
+        return self.lib.clock_gov_update(ctypes.c_uint32(now_us & 0xFFFFFFFF), active)
+
+
+def simulate(gov, spans, end_s, step_us):
+    """Call the governor every step_us (as the main loop would) and return
+    time per state, action counts and wake latencies."""
+    time_in = {FULL: 0, LOW: 0, WAKING: 0}
+    actions = {SLOW_DOWN: 0, VOLTAGE_UP: 0, SPEED_UP: 0}
+    wakes = []
+    state = FULL
+    wake_start = None
+
+    span = 0
+    now = 0
+    end_us = int(end_s * 1e6)
+    while now < end_us:
+        while span < len(spans) and spans[span][1] * 1e6 <= now:
+            span += 1
+        active = span < len(spans) and spans[span][0] * 1e6 <= now
+
+        action = gov.update(now, active)
+        if action == SLOW_DOWN:
+            state = LOW
+        elif action == VOLTAGE_UP:
+            state = WAKING
+            wake_start = now
+        elif action == SPEED_UP:
+            state = FULL
+            wakes.append(now - wake_start)
+        if action in actions:
+            actions[action] += 1
+
+        # Skip ahead over long steady stretches, never past the next event
+        step = step_us
+        if state == LOW and not active and span < len(spans):
+            step = max(step_us, int(spans[span][0] * 1e6) - now)
+        elif state == LOW and not active:
+            step = end_us - now
+        step = min(step, end_us - now)
+        time_in[state] += step
+        now += step
+
+    return time_in, actions, wakes
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument('--native', required=True, metavar='LIB', help="clock_gov.c built as a shared library")
+    parser.add_argument('--trace', help="key press times, one per line (s)")
+    parser.add_argument('--hours', type=float, default=8.0, help="synthetic trace length")
+    parser.add_argument('--typing', type=float, default=60.0, help="mean typing burst (s)")
+    parser.add_argument('--idle', type=float, default=300.0, help="mean gap between bursts (s)")
+    parser.add_argument('--rate', type=float, default=5.0, help="key presses per second while typing")
+    parser.add_argument('--press-ms', type=float, default=120.0, help="activity per press (frames and release)")
+    parser.add_argument('--step-us', type=int, default=1000, help="governor call interval")
+    parser.add_argument('--seed', type=int, default=1)
+    parser.add_argument('--full-mhz', type=float, default=125.0)
+    parser.add_argument('--low-mhz', type=float, default=62.5)
+    parser.add_argument('--full-v', type=float, default=1.10)
+    parser.add_argument('--low-v', type=float, default=1.00)
+    parser.add_argument('--full-ma', type=float, default=25.0, help="current at full speed")
+    parser.add_argument('--static-ma', type=float, default=8.0, help="current not scaling with clock")
+    args = parser.parse_args()
+
+    rng = random.Random(args.seed)
+    if args.trace:
+        presses = read_trace(args.trace)
+        end_s = (presses[-1] if presses else 0) + 60
+    else:
+        presses = synthetic_trace(rng, args.hours, args.typing, args.idle, args.rate)
+        end_s = args.hours * 3600
+    if not presses:
+        sys.exit("empty trace")
+
+    gov = Governor(args.native)
+    time_in, actions, wakes = simulate(gov, activity(presses, args.press_ms / 1000), end_s, args.step_us)
+
+    dynamic = args.full_ma - args.static_ma
+    low_ma = args.static_ma + dynamic * (args.low_mhz / args.full_mhz) * (args.low_v / args.full_v) ** 2
+    waking_ma = args.static_ma + dynamic * (args.low_mhz / args.full_mhz)
+    total_us = sum(time_in.values())
+    charge = {FULL: args.full_ma, LOW: low_ma, WAKING: waking_ma}
+    mah = sum(time_in[s] * charge[s] for s in time_in) / 3.6e9
+    mah_full = total_us * args.full_ma / 3.6e9
+
+    print(f"{len(presses)} presses over {total_us / 3.6e9:.2f} h")
+    for name, s in (('full', FULL), ('low', LOW), ('waking', WAKING)):
+        print(f"  {name:7s} {time_in[s] / 1e6:10.1f} s  {100 * time_in[s] / total_us:5.1f}%")
+    print(f"slow-downs {actions[SLOW_DOWN]}, speed-ups {actions[SPEED_UP]}")
+    if wakes:
+        print(f"first activity to full clock: max {max(wakes) / 1000:.1f} ms, "
+              f"mean {sum(wakes) / len(wakes) / 1000:.1f} ms")
+    print(f"current: full {args.full_ma:.1f} mA, low {low_ma:.1f} mA")
+    print(f"charge: {mah:.1f} mAh vs {mah_full:.1f} mAh at full speed "
+          f"({100 * (1 - mah / mah_full):.1f}% saved)")
+
+
+if __name__ == '__main__':
+    main()
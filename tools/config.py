@@ -0,0 +1,201 @@
+#!/usr/bin/env python3
+"""
+PS/2 to USB HID Keyboard Bridge - configuration tool
+
+Changes settings and keymaps at runtime through the keyboard interface's
+feature report (firmware built with CONFIG_ENABLE=1). No driver is needed.
+
+  config.py info                          protocol and keymap limits
+  config.py get debounce                  read a setting
+  config.py set taphold-term 180          change a setting
+  config.py keymap-read 1 layer1.bin      save a layer (256 x LE16 actions)
+  config.py keymap-write 1 layer1.bin     load a layer
+  config.py map 1 0x4c 0x017f             change one keymap entry
+  config.py defaults                      restore built-in settings
+  config.py reconnect                     re-enumerate (applies poll-interval
+                                          and usb-profile)
+
+Settings: poll-interval, debounce, taphold-term, combo-term, socd,
+usb-profile (0 boot keyboard, 1 standard, 2 debug).
+Changes are saved in flash once the keyboard has been idle for a few
+seconds; "defaults" deletes the saved values.
+
+--native LIB runs the commands against the firmware's protocol handler
+built as a host library instead of a device, e.g.
+
+  gcc -shared -fPIC -I. -o libconfig.so config.c keymap.c debounce.c \\
+      taphold.c combo.c socd.c usb_profile.c store.c store_flash_ram.c
+
+Requires the 'hid' module (pip install hidapi) unless --native is used.
+"""
+
+import argparse
+import ctypes
+import struct
+import sys
+
+USB_VID = 0xCAFE
+KEYBOARD_INTERFACE = 0
+
+# Mirrors config.h
+PROTOCOL_VERSION = 1
+REPORT_SIZE = 64
+HEADER_SIZE = 4
+LAYER_SIZE = 256 * 2
+
+CMD_INFO = 0x01
+CMD_GET_PARAM = 0x02
+CMD_SET_PARAM = 0x03
+CMD_KEYMAP_READ = 0x04
+CMD_KEYMAP_WRITE = 0x05
+CMD_KEYMAP_COMMIT = 0x06
+CMD_DEFAULTS = 0x07
+CMD_RECONNECT = 0x08
+
+STATUS = {
+    0: 'ok', 1: 'protocol version mismatch', 2: 'unknown command',
+    3: 'bad argument', 4: 'out of sequence',
+}
+
+PARAMS = {
+    'poll-interval': 0x01,
+    'debounce': 0x02,
+    'taphold-term': 0x03,
+    'combo-term': 0x04,
+    'socd': 0x05,
+    'usb-profile': 0x06,
+}
+
+
+class ConfigError(Exception):
+    pass
+
+
+class HidTransport:
+    """Feature reports on the keyboard interface of a real device."""
+
+    def __init__(self):
+        import hid
+        for info in hid.enumerate(USB_VID):
+            if info['interface_number'] == KEYBOARD_INTERFACE:
+                self.dev = hid.device()
+                self.dev.open_path(info['path'])
+                return
+        sys.exit("keyboard interface not found")
+
+    def transfer(self, request):
+        # No report IDs: hidapi wants a leading 0 and may return one
+        self.dev.send_feature_report(b'\x00' + request)
+        data = bytes(self.dev.get_feature_report(0, REPORT_SIZE + 1))
+        return data[1:] if len(data) > REPORT_SIZE else data
+
+
+class NativeTransport:
+    """The firmware's protocol handler built as a host shared library."""
+
+    def __init__(self, path):
+        self.lib = ctypes.CDLL(path)
+        self.lib.keymap_init()
+        self.lib.config_init()
+        self.lib.config_load()
+
+    def transfer(self, request):
+        buf = ctypes.create_string_buffer(request, REPORT_SIZE)
+        self.lib.config_request(buf, ctypes.c_uint16(len(request)))
+        out = ctypes.create_string_buffer(REPORT_SIZE)
+        self.lib.config_response(out)
+        return out.raw
+
+
+class Config:
+    def __init__(self, transport):
+        self.transport = transport
+        self.tag = 0
+
+    def request(self, command, data=b''):
+        self.tag = (self.tag + 1) & 0xFF
+        report = bytes([PROTOCOL_VERSION, command, self.tag, len(data)]) + data
+        response = self.transport.transfer(report.ljust(REPORT_SIZE, b'\x00'))
+        version, cmd, tag, status = response[:HEADER_SIZE]
+        if (cmd, tag) != (command, self.tag):
+            raise ConfigError("response does not match request")
+        if status != 0:
+            raise ConfigError(STATUS.get(status, f"status {status}"))
+        return response[HEADER_SIZE:]
+
+    def info(self):
+        data = self.request(CMD_INFO)
+        return {'layers': data[0], 'chunk_size': data[1], 'report_size': data[2]}
+
+    def get(self, param):
+        return struct.unpack_from('<I', self.request(CMD_GET_PARAM, bytes([param])), 1)[0]
+
+    def set(self, param, value):
+        data = self.request(CMD_SET_PARAM, struct.pack('<BI', param, value))
+        return struct.unpack_from('<I', data, 1)[0]
+
+    def read_layer(self, layer):
+        blob = b''
+        while len(blob) < LAYER_SIZE:
+            data = self.request(CMD_KEYMAP_READ, struct.pack('<BH', layer, len(blob)))
+            count = data[3]
+            blob += data[4:4 + count]
+        return blob
+
+    def write_layer(self, layer, blob):
+        if len(blob) != LAYER_SIZE:
+            raise ConfigError(f"layer blob must be {LAYER_SIZE} bytes")
+        chunk_size = self.info()['chunk_size']
+        for offset in range(0, LAYER_SIZE, chunk_size):
+            chunk = blob[offset:offset + chunk_size]
+            self.request(CMD_KEYMAP_WRITE, struct.pack('<BHB', layer, offset, len(chunk)) + chunk)
+        self.request(CMD_KEYMAP_COMMIT, bytes([layer]))
+
+
+def number(text):
+    return int(text, 0)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument('--native', metavar='LIB', help="use a natively built protocol handler")
+    parser.add_argument('command', choices=['info', 'get', 'set', 'keymap-read', 'keymap-write',
+                                            'map', 'defaults', 'reconnect'])
+    parser.add_argument('args', nargs='*')
+    args = parser.parse_args()
+
+    config = Config(NativeTransport(args.native) if args.native else HidTransport())
+    a = args.args
+
+    try:
+        if args.command == 'info':
+            print(' '.join(f"{k}={v}" for k, v in config.info().items()))
+        elif args.command == 'get':
+            print(config.get(PARAMS[a[0]]))
+        elif args.command == 'set':
+            print(config.set(PARAMS[a[0]], number(a[1])))
+        elif args.command == 'keymap-read':
+            blob = config.read_layer(number(a[0]))
+            if len(a) > 1:
+                open(a[1], 'wb').write(blob)
+            else:
+                for key, action in enumerate(struct.unpack(f'<{LAYER_SIZE // 2}H', blob)):
+                    if action:
+                        print(f"0x{key:02x}: 0x{action:04x}")
+        elif args.command == 'keymap-write':
+            config.write_layer(number(a[0]), open(a[1], 'rb').read())
+        elif args.command == 'map':
+            layer, key, action = number(a[0]), number(a[1]), number(a[2])
+            blob = bytearray(config.read_layer(layer))
+            struct.pack_into('<H', blob, 2 * key, action)
+            config.write_layer(layer, bytes(blob))
+        elif args.command == 'defaults':
+            config.request(CMD_DEFAULTS)
+        elif args.command == 'reconnect':
+            config.request(CMD_RECONNECT)
+    except (ConfigError, KeyError, IndexError) as e:
+        sys.exit(f"error: {e}")
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,130 @@
+#!/usr/bin/env python3
+"""
+PS/2 to USB HID Keyboard Bridge - paste mode host tool
+
+Streams text to the bridge's paste interface (firmware built with
+PASTE_ENABLE=1), which types it on the boot keyboard interface.
+
+  paste.py config.txt            type a file
+  echo hello | paste.py          type stdin
+
+The typing rate a text gets at each bInterval comes from the host test
+harness, which runs paste.c itself: build-tests/test_paste config.txt
+
+Requires the 'hid' module (pip install hidapi).
+"""
+
+import argparse
+import sys
+import time
+
+USB_VID = 0xCAFE
+PASTE_USAGE_PAGE = 0xFF00
+PASTE_USAGE = 0x01
+PASTE_REPORT_SIZE = 64
+PASTE_STATUS_TYPING = 0x01
+
+# Keys that need Shift on a US layout, and their unshifted twin
+SHIFTED = {
+    '!': '1', '@': '2', '#': '3', '$': '4', '%': '5', '^': '6', '&': '7',
+    '*': '8', '(': '9', ')': '0', '_': '-', '+': '=', '{': '[', '}': ']',
+    '|': '\\', ':': ';', '"': "'", '~': '`', '<': ',', '>': '.', '?': '/',
+}
+
+
+def key_of(c):
+    """Physical key and shift state for a character, or None if untypable."""
+    if c.isascii() and c.isalpha():
+        return c.lower(), c.isupper()
+    if c in SHIFTED:
+        return SHIFTED[c], True
+    if c in '\t\n ' or (c.isascii() and c.isprintable()):
+        return c, False
+    return None
+
+
+def typable(text):
+    """Text as the firmware will type it (CR and unknown characters dropped)."""
+    return ''.join(c for c in text if c != '\r' and key_of(c) is not None)
+
+
+def find_interface(hid):
+    """The paste interface, by its vendor usage. Interface numbers depend on
+    the profile and on which other interfaces the firmware has; backends
+    that report no usages get each report descriptor read instead."""
+    devices = hid.enumerate(USB_VID)
+    for info in devices:
+        if info['usage_page'] == PASTE_USAGE_PAGE and info['usage'] == PASTE_USAGE:
+            return info
+
+    # Usage Page (0xFF00), Usage (0x01)
+    start = bytes([0x06, PASTE_USAGE_PAGE & 0xFF, PASTE_USAGE_PAGE >> 8, 0x09, PASTE_USAGE])
+    for info in devices:
+        dev = hid.device()
+        try:
+            dev.open_path(info['path'])
+            desc = bytes(dev.get_report_descriptor())
+        except (OSError, IOError, AttributeError):
+            desc = b''
+        finally:
+            dev.close()
+        if desc.startswith(start):
+            return info
+    return None
+
+
+def open_device():
+    import hid
+    info = find_interface(hid)
+    if info is None:
+        sys.exit("paste interface not found (is the firmware built with PASTE_ENABLE=1?)")
+    dev = hid.device()
+    dev.open_path(info['path'])
+    return dev
+
+
+def read_status(dev, timeout_ms):
+    data = dev.read(PASTE_REPORT_SIZE, timeout_ms)
+    if not data:
+        # Status only streams on change - poll it with GET_REPORT
+        data = dev.get_input_report(0, PASTE_REPORT_SIZE + 1)[1:]
+    return data[0], data[1] | (data[2] << 8), data[3] | (data[4] << 8)
+
+
+def send(text):
+    dev = open_device()
+    data = text.encode('ascii')
+    sent = 0
+    typing = True
+    start = time.monotonic()
+
+    while sent < len(data) or typing:
+        flags, free, received = read_status(dev, 100)
+        typing = bool(flags & PASTE_STATUS_TYPING)
+
+        # Only send what the FIFO has room for, minus what is still in flight
+        free -= (sent - received) & 0xFFFF
+        while sent < len(data) and free > 0:
+            chunk = data[sent:sent + min(free, PASTE_REPORT_SIZE - 1)]
+            report = bytes([len(chunk)]) + chunk
+            dev.write(b'\x00' + report.ljust(PASTE_REPORT_SIZE, b'\x00'))
+            sent += len(chunk)
+            free -= len(chunk)
+            typing = True
+
+    elapsed = time.monotonic() - start
+    rate = len(data) / elapsed if elapsed else 0
+    print(f"typed {len(data)} characters in {elapsed:.2f} s ({rate:.1f} chars/s)")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument('file', nargs='?', help="text to type (default: stdin)")
+    args = parser.parse_args()
+
+    text = open(args.file).read() if args.file else sys.stdin.read()
+    send(typable(text))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,274 @@
+#!/usr/bin/env python3
+"""
+PS/2 to USB HID Keyboard Bridge - profile viewer
+
+Reads the sampling profiler's PC histogram over the telemetry interface
+(firmware built with PROFILER_ENABLE=1 and TELEMETRY_ENABLE=1) and
+resolves the PCs to functions using the firmware's ELF file.
+
+  profiler.py build/dev_hid_composite.elf              profile the next 10 s
+  profiler.py build/dev_hid_composite.elf --seconds 60 --save idle.txt
+  profiler.py build/dev_hid_composite.elf --load idle.txt
+  profiler.py build/dev_hid_composite.elf --map build/dev_hid_composite.elf.map
+                                                      also total per source file
+  profiler.py --stop / --start                        pause or resume sampling
+
+Without --reset the profile is the difference between two complete
+readings of the histogram, so other tools' statistics are left alone.
+A saved profile has one "pc count" line per PC (hex PC).
+
+The ELF reader needs no extra modules; reading the device requires the
+'hid' module (pip install hidapi).
+"""
+
+import argparse
+import bisect
+import collections
+import os
+import re
+import struct
+import sys
+import time
+
+from telemetry import (open_device, decode, TELEMETRY_REPORT_SIZE, PKT_PROFILE,
+                       CMD_RESET, CMD_PROFILER_START, CMD_PROFILER_STOP)
+
+# ELF constants
+SHT_SYMTAB = 2
+STT_FUNC = 2
+EM_ARM = 40
+
+# Fixed address ranges (RP2040 and RP2350)
+BOOT_ROM_END = 0x10000000
+
+
+class ElfError(Exception):
+    pass
+
+
+def read_functions(data):
+    """Function symbols of an ELF image as a sorted list of (address,
+    size, name). Arm Thumb addresses have bit 0 cleared."""
+    if data[:4] != b'\x7fELF':
+        raise ElfError("not an ELF file")
+    elf_class, encoding = data[4], data[5]
+    if elf_class not in (1, 2) or encoding not in (1, 2):
+        raise ElfError("unsupported ELF class or encoding")
+    end = '<' if encoding == 1 else '>'
+    wide = elf_class == 2
+
+    if wide:
+        machine, = struct.unpack_from(end + 'H', data, 18)
+        shoff, = struct.unpack_from(end + 'Q', data, 40)
+        shentsize, shnum = struct.unpack_from(end + 'HH', data, 58)
+        section = end + 'IIQQQQIIQQ'
+        symbol, symbol_size = end + 'IBBHQQ', 24
+    else:
+        machine, = struct.unpack_from(end + 'H', data, 18)
+        shoff, = struct.unpack_from(end + 'I', data, 32)
+        shentsize, shnum = struct.unpack_from(end + 'HH', data, 46)
+        section = end + 'IIIIIIIIII'
+        symbol, symbol_size = end + 'IIIBBH', 16
+
+    sections = [struct.unpack_from(section, data, shoff + i * shentsize) for i in range(shnum)]
+    symtab = next((s for s in sections if s[1] == SHT_SYMTAB), None)
+    if symtab is None:
+        raise ElfError("no symbol table (stripped?)")
+    # (name, type, flags, addr, offset, size, link, info, align, entsize)
+    offset, size, link = symtab[4], symtab[5], symtab[6]
+    strtab = sections[link]
+    strings = data[strtab[4]:strtab[4] + strtab[5]]
+
+    functions = {}
+    for pos in range(offset, offset + size, symbol_size):
+        if wide:
+            name, info, _, _, value, sym_size = struct.unpack_from(symbol, data, pos)
+        else:
+            name, value, sym_size, info, _, _ = struct.unpack_from(symbol, data, pos)
+        if info & 0xF != STT_FUNC:
+            continue
+        if machine == EM_ARM:
+            value &= ~1
+        text = strings[name:strings.index(b'\0', name)].decode(errors='replace')
+        # Aliases share an address: keep the first with a size
+        if value not in functions or not functions[value][0]:
+            functions[value] = (sym_size, text)
+    return sorted((address, size, name) for address, (size, name) in functions.items())
+
+
+class Symbols:
+    def __init__(self, functions):
+        self.functions = functions
+        self.addresses = [f[0] for f in functions]
+
+    def lookup(self, pc):
+        """Function containing pc, or None. A function without a size
+        (e.g. from assembly) is taken to end at the next one."""
+        i = bisect.bisect_right(self.addresses, pc) - 1
+        if i < 0:
+            return None
+        address, size, name = self.functions[i]
+        if size:
+            return name if pc < address + size else None
+        following = self.addresses[i + 1] if i + 1 < len(self.addresses) else None
+        return name if following is None or pc < following else None
+
+
+def read_map(text):
+    """Input sections of a GNU ld map file as a sorted list of (address,
+    size, source file)."""
+    pattern = re.compile(r'^ (\.\S+)\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)\s+(\S+)$', re.M)
+    spans = []
+    # Long section names put the address on the next line
+    for _, address, size, path in pattern.findall(re.sub(r'^( \.\S+)\n\s+', r'\1 ', text, flags=re.M)):
+        address, size = int(address, 16), int(size, 16)
+        if size:
+            member = re.search(r'\(([^)]+)\)$', path)
+            name = os.path.basename(member.group(1) if member else path)
+            spans.append((address, size, re.sub(r'\.(obj|o)$', '', name)))
+    return sorted(spans)
+
+
+def file_of(spans, starts, pc):
+    i = bisect.bisect_right(starts, pc) - 1
+    if i >= 0 and pc < spans[i][0] + spans[i][1]:
+        return spans[i][2]
+    return None
+
+
+def label(symbols, pc):
+    name = symbols.lookup(pc)
+    if name:
+        return name
+    return '[boot rom]' if pc < BOOT_ROM_END else f'[{pc:#010x}]'
+
+
+def read_passes(dev, seconds):
+    """Two complete readings of the histogram, seconds apart: ({pc: count},
+    samples, dropped) each. The first packets may be halfway through a pass
+    and are skipped."""
+    readings = []
+    current = {}
+    synced = False
+    deadline = None
+    while len(readings) < 2:
+        data = dev.read(TELEMETRY_REPORT_SIZE, 100)
+        if not data or data[0] != PKT_PROFILE:
+            continue
+        _, _, payload = decode(data)
+        if synced:
+            current.update(payload['entries'])
+        if not payload['last']:
+            continue
+        if synced and (not readings or time.monotonic() >= deadline):
+            readings.append((current, payload['samples'], payload['dropped']))
+            deadline = time.monotonic() + seconds
+        synced = True
+        current = {}
+    return readings
+
+
+def difference(first, last):
+    """last minus first; a reading with fewer samples means the device was
+    reset in between, so last is used as it is."""
+    counts, samples, dropped = last
+    if samples < first[1]:
+        return last
+    counts = {pc: count - first[0].get(pc, 0) for pc, count in counts.items()}
+    return ({pc: count for pc, count in counts.items() if count > 0},
+            samples - first[1], dropped - first[2])
+
+
+def save(path, profile):
+    counts, samples, dropped = profile
+    with open(path, 'w') as f:
+        f.write(f"# samples {samples} dropped {dropped}\n")
+        for pc, count in sorted(counts.items()):
+            f.write(f"{pc:#010x} {count}\n")
+
+
+def load(path):
+    counts = {}
+    samples = dropped = 0
+    with open(path) as f:
+        for line in f:
+            words = line.split()
+            if not words:
+                continue
+            if words[0] == '#':
+                samples, dropped = int(words[2]), int(words[4])
+            else:
+                counts[int(words[0], 16)] = int(words[1])
+    return counts, samples or sum(counts.values()), dropped
+
+
+def report(profile, symbols, spans, top):
+    counts, samples, dropped = profile
+    total = sum(counts.values())
+    if not total:
+        print("no samples")
+        return
+
+    by_function = collections.Counter()
+    for pc, count in counts.items():
+        by_function[label(symbols, pc)] += count
+    resolved = total - sum(c for name, c in by_function.items() if name.startswith('['))
+
+    print(f"{samples} samples, {dropped} dropped, {100 * resolved / total:.1f}% in known functions")
+    print(f"  {'function':40s} {'samples':>9s}      %")
+    for name, count in by_function.most_common(top):
+        print(f"  {name:40s} {count:9d} {100 * count / total:5.1f}%")
+
+    if spans:
+        starts = [s[0] for s in spans]
+        by_file = collections.Counter()
+        for pc, count in counts.items():
+            by_file[file_of(spans, starts, pc) or ('[boot rom]' if pc < BOOT_ROM_END else '?')] += count
+        print()
+        print(f"  {'file':40s} {'samples':>9s}      %")
+        for name, count in by_file.most_common(top):
+            print(f"  {name:40s} {count:9d} {100 * count / total:5.1f}%")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument('elf', nargs='?', help="firmware ELF file (with symbols)")
+    parser.add_argument('--map', help="linker map file, to total samples per source file")
+    parser.add_argument('--seconds', type=float, default=10.0, help="time to profile")
+    parser.add_argument('--reset', action='store_true', help="clear the histogram (and telemetry) first")
+    parser.add_argument('--save', metavar='FILE', help="also write the samples to FILE")
+    parser.add_argument('--load', metavar='FILE', help="read samples from FILE instead of the device")
+    parser.add_argument('--top', type=int, default=25, help="rows to print")
+    parser.add_argument('--start', action='store_true', help="resume sampling and exit")
+    parser.add_argument('--stop', action='store_true', help="pause sampling and exit")
+    args = parser.parse_args()
+
+    if args.start or args.stop:
+        open_device().write(bytes([0, CMD_PROFILER_START if args.start else CMD_PROFILER_STOP]))
+        return
+    if not args.elf:
+        parser.error("the ELF file is required")
+
+    try:
+        symbols = Symbols(read_functions(open(args.elf, 'rb').read()))
+    except (ElfError, struct.error) as e:
+        sys.exit(f"{args.elf}: {e}")
+    spans = read_map(open(args.map).read()) if args.map else None
+
+    if args.load:
+        profile = load(args.load)
+    else:
+        dev = open_device()
+        if args.reset:
+            dev.write(bytes([0, CMD_RESET]))
+        print(f"profiling for {args.seconds:g} s...", file=sys.stderr)
+        first, last = read_passes(dev, args.seconds)
+        profile = last if args.reset else difference(first, last)
+
+    if args.save:
+        save(args.save, profile)
+    report(profile, symbols, spans, args.top)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,499 @@
+#!/usr/bin/env python3
+"""
+PS/2 to USB HID Keyboard Bridge - PS/2 device output simulation
+
+Runs the firmware's PS/2 device output (ps2_dev.c, built as a host
+library) against a simulated PS/2 host at line level: open-drain clock and
+data lines, the host reading bits on falling clock edges, inhibiting the
+bus, and sending commands with a request to send and clocking its bits
+out on the device's clock. It checks the protocol, types every mapped key
+through the output and decodes it back, and measures the latency from a
+report reaching the output to the host holding the last byte of its
+scancode.
+
+  ps2dev_sim.py --simulate ./libps2dev.so
+  ps2dev_sim.py --simulate ./libps2dev.so --keys 5000 --inhibit-rate 0.05
+
+Build the library with the same settings as the firmware, e.g.
+
+  gcc -c -fPIC -I. ps2_dev.c && g++ -c -fPIC -std=c++17 -I. ps2_tables.cpp
+  g++ -shared -o libps2dev.so ps2_dev.o ps2_tables.o
+
+The exit status is 1 if any check failed. tests/CMakeLists.txt builds
+the library and runs this under ctest.
+"""
+
+import argparse
+import ctypes
+import heapq
+import random
+import sys
+
+# Mirrors ps2_dev.h
+ACK, RESEND, BAT_PASSED, ECHO = 0xFA, 0xFE, 0xAA, 0xEE
+SET_LEDS, CMD_ECHO, SCAN_SET, READ_ID, TYPEMATIC = 0xED, 0xEE, 0xF0, 0xF2, 0xF3
+ENABLE, DISABLE, DEFAULTS, CMD_RESEND, RESET = 0xF4, 0xF5, 0xF6, 0xFE, 0xFF
+BAT_MS = 300
+
+# Mirrors hid_keycodes.h
+KEY_A, KEY_CAPS_LOCK, KEY_PRINT_SCREEN, KEY_PAUSE = 0x04, 0x39, 0x46, 0x48
+MODIFIER_FIRST = 0xE0
+PAUSE_SEQUENCE = [0xE1, 0x14, 0x77, 0xE1, 0xF0, 0x14, 0xF0, 0x77]
+
+# Time for the main loop to pass a report on and wake the line interrupt
+KICK_US = 2
+
+
+class Lines(ctypes.Structure):
+    _fields_ = [('clock', ctypes.c_bool), ('data', ctypes.c_bool)]
+
+
+class Stats(ctypes.Structure):
+    _fields_ = [(name, ctypes.c_uint32) for name in
+                ('bytes_sent', 'bytes_received', 'cancelled', 'host_errors', 'host_resends', 'overruns')]
+
+
+class Device:
+    def __init__(self, path):
+        lib = ctypes.CDLL(path)
+        lib.ps2_dev_reset.argtypes = [ctypes.c_uint32]
+        lib.ps2_dev_report.argtypes = [ctypes.c_char_p, ctypes.c_uint32]
+        lib.ps2_dev_typematic.argtypes = [ctypes.c_uint32]
+        lib.ps2_dev_step.argtypes = [ctypes.c_bool, ctypes.c_bool, ctypes.c_uint32, ctypes.POINTER(Lines)]
+        lib.ps2_dev_step.restype = ctypes.c_uint32
+        lib.ps2_dev_line_idle.restype = ctypes.c_bool
+        lib.ps2_dev_idle.restype = ctypes.c_bool
+        lib.ps2_dev_leds.restype = ctypes.c_uint8
+        lib.ps2_dev_stats.restype = ctypes.POINTER(Stats)
+        self.lib = lib
+        self.lines = Lines(True, True)
+
+        # The decoder's Set 2 to HID tables, to read the output back
+        tables = (ctypes.c_uint8 * 512).in_dll(lib, 'ps2_tables')
+        self.normal = bytes(tables[:256])
+        self.extended = bytes(tables[256:])
+
+    def stats(self):
+        s = self.lib.ps2_dev_stats().contents
+        return {name: getattr(s, name) for name, _ in Stats._fields_}
+
+
+def odd_parity(byte):
+    return 1 - bin(byte).count('1') % 2
+
+
+class Decoder:
+    """Host keyboard driver: Set 2 bytes to (hid, make) events."""
+
+    def __init__(self, dev):
+        self.dev = dev
+        self.extended = False
+        self.release = False
+        self.pause = 0
+
+    def byte(self, b):
+        if self.pause:
+            self.pause -= 1
+            return (KEY_PAUSE, True) if self.pause == 0 else None
+        if b == 0xE1:
+            self.pause = len(PAUSE_SEQUENCE) - 1
+            return None
+        if b == 0xE0:
+            self.extended = True
+            return None
+        if b == 0xF0:
+            self.release = True
+            return None
+        table = self.dev.extended if self.extended else self.dev.normal
+        make = not self.release
+        self.extended = self.release = False
+        hid = table[b]
+        return (hid, make) if hid else None     # E0 12 (fake shift) maps to nothing
+
+
+class Sim:
+    """Time in microseconds. Lines are open-drain: low if either side drives low."""
+
+    def __init__(self, dev, rng, inhibit_rate=0.0):
+        self.dev = dev
+        self.rng = rng
+        self.now = 0
+        self.next_step = 0
+        self.events = []            # (time, seq, callable)
+        self.seq = 0
+        self.host_clock = True
+        self.host_data = True
+        self.clock = True
+        self.inhibit_rate = inhibit_rate
+
+        # Receiver
+        self.bits = []
+        self.last_fall = None
+        self.received = []          # (time, byte)
+        self.frame_errors = 0
+        self.periods = []
+
+        # Sender
+        self.sending = None         # bit list while clocking a byte out
+        self.acked = None
+
+        dev.lib.ps2_dev_reset(0)
+
+    def at(self, t, fn):
+        heapq.heappush(self.events, (t, self.seq, fn))
+        self.seq += 1
+
+    def levels(self):
+        return (self.dev.lines.clock and self.host_clock, self.dev.lines.data and self.host_data)
+
+    def kick(self, was_idle):
+        """The firmware re-arms the idle line interrupt for the first new scancode."""
+        if was_idle and self.dev.lib.ps2_dev_line_idle() and not self.dev.lib.ps2_dev_idle():
+            self.next_step = min(self.next_step, self.now + KICK_US)
+
+    def run_until(self, end, done=None):
+        while self.now < end:
+            if done and done():
+                return True
+            t_event = self.events[0][0] if self.events else end
+            t = min(self.next_step, t_event, end)
+            self.now = t
+            if self.events and self.events[0][0] == t:
+                _, _, fn = heapq.heappop(self.events)
+                fn()
+                self.watch()
+                continue
+            if t == self.next_step:
+                clock, data = self.levels()
+                delay = self.dev.lib.ps2_dev_step(clock, data, t & 0xFFFFFFFF, ctypes.byref(self.dev.lines))
+                self.next_step = t + delay
+                self.watch()
+        return done() if done else True
+
+    def watch(self):
+        clock, data = self.levels()
+        if clock == self.clock:
+            return
+        self.clock = clock
+        if not clock:
+            self.falling(data)
+
+    def falling(self, data):
+        if not self.host_clock:
+            # Our own inhibit: a partly received byte is lost (and sent again)
+            self.bits = []
+            return
+        if self.sending is not None:
+            self.send_bit(data)
+            return
+
+        if self.bits and self.now - self.last_fall > 2000:
+            self.bits = []
+            self.frame_errors += 1
+        if self.bits:
+            self.periods.append(self.now - self.last_fall)
+        self.last_fall = self.now
+        self.bits.append(data)
+        if len(self.bits) == 1 and self.inhibit_rate and self.rng.random() < self.inhibit_rate:
+            # Cut the byte short somewhere before its eleventh clock
+            self.at(self.now + self.rng.randint(10, 700), self.inhibit)
+        if len(self.bits) == 11:
+            b = sum(bit << i for i, bit in enumerate(self.bits[1:9]))
+            if self.bits[0] or not self.bits[10] or self.bits[9] != odd_parity(b):
+                self.frame_errors += 1
+            else:
+                self.received.append((self.now, b))
+            self.bits = []
+
+    def inhibit(self, length=150):
+        # The clock may already be low (device driven): no edge, so drop
+        # the partial byte here
+        self.host_clock = False
+        self.bits = []
+        self.at(self.now + length, self.release_clock)
+
+    def release_clock(self):
+        self.host_clock = True
+
+    # Host to device: inhibit, request to send, then one bit per device clock
+    def send(self, byte, bad_parity=False, timeout=20000):
+        parity = odd_parity(byte) ^ bad_parity
+        self.acked = None
+
+        def request():
+            self.host_data = False
+            self.sending = [(byte >> i) & 1 for i in range(8)] + [parity, 1]
+            self.host_clock = True
+
+        self.host_clock = False
+        self.bits = []
+        self.at(self.now + 100, request)
+        self.run_until(self.now + timeout, lambda: self.acked is not None)
+        return self.acked
+
+    def send_bit(self, data):
+        if self.sending:
+            self.host_data = bool(self.sending.pop(0))
+        else:
+            # Eleventh clock: the device holds data low to acknowledge
+            self.acked = not data
+            self.sending = None
+
+    def expect(self, count, timeout=20000):
+        start = len(self.received)
+        self.run_until(self.now + timeout, lambda: len(self.received) - start >= count)
+        return [b for _, b in self.received[start:]]
+
+
+class Checks:
+    def __init__(self):
+        self.failed = 0
+
+    def check(self, name, ok, detail=''):
+        print(f"  {'ok  ' if ok else 'FAIL'} {name}{': ' + detail if detail else ''}")
+        if not ok:
+            self.failed += 1
+
+
+def hexs(data):
+    return ' '.join(f'{b:02X}' for b in data)
+
+
+def protocol_checks(sim, checks):
+    print("protocol:")
+    lib = sim.dev.lib
+
+    got = sim.expect(1, timeout=(BAT_MS + 50) * 1000)
+    checks.check("self-test result after power-up", got == [BAT_PASSED], hexs(got))
+
+    # Each byte is answered before the next goes out; the last one may have
+    # several bytes of reply
+    def command(name, out, want):
+        replies = []
+        for i, b in enumerate(out):
+            if not sim.send(b):
+                checks.check(name, False, f"{b:02X} not acknowledged on the wire")
+                return
+            replies += sim.expect(1 if i < len(out) - 1 else len(want) - len(replies))
+        checks.check(name, replies == want, hexs(replies))
+
+    command("reset", [RESET], [ACK])
+    got = sim.expect(1, timeout=(BAT_MS + 50) * 1000)
+    checks.check("self-test result after reset", got == [BAT_PASSED], hexs(got))
+    command("set LEDs", [SET_LEDS, 0x05], [ACK, ACK])
+    checks.check("LED state", lib.ps2_dev_leds() == 0x05, f"{lib.ps2_dev_leds():#x}")
+    command("scan set query", [SCAN_SET, 0x00], [ACK, ACK, 0x02])
+    command("select set 2", [SCAN_SET, 0x02], [ACK, ACK])
+    command("read ID", [READ_ID], [ACK, 0xAB, 0x83])
+    command("echo", [CMD_ECHO], [ECHO])
+    command("typematic", [TYPEMATIC, 0x20], [ACK, ACK])
+    command("disable", [DISABLE], [ACK])
+    command("enable", [ENABLE], [ACK])
+    command("defaults", [DEFAULTS], [ACK])
+    command("unknown command", [0x88], [RESEND])
+    command("resend", [CMD_RESEND], [RESEND])
+    sim.send(0xF4, bad_parity=True)
+    got = sim.expect(1)
+    checks.check("parity error answered with resend", got == [RESEND], hexs(got))
+    command("command in place of an argument", [SET_LEDS, ECHO], [ACK, ECHO])
+
+    # Keys typed while scanning is disabled are dropped
+    sim.send(DISABLE)
+    sim.expect(1)
+    report(sim, [0, 0, KEY_A, 0, 0, 0, 0, 0])
+    report(sim, [0] * 8)
+    got = sim.expect(1, timeout=5000)
+    checks.check("no scancodes while disabled", got == [], hexs(got))
+    sim.send(ENABLE)
+    sim.expect(1)
+
+    periods = sim.periods
+    checks.check("clock 10-16.7 kHz", periods and 60 <= min(periods) and max(periods) <= 100,
+                 f"period {min(periods)}-{max(periods)} us")
+    checks.check("no framing errors", sim.frame_errors == 0, str(sim.frame_errors))
+
+
+def report(sim, data):
+    was_idle = sim.dev.lib.ps2_dev_idle()
+    sim.dev.lib.ps2_dev_report(bytes(data), sim.now & 0xFFFFFFFF)
+    sim.kick(was_idle)
+
+
+def roundtrip_checks(sim, checks):
+    """Press and release every key the keymap can produce, read it back."""
+    print("every key, make and break:")
+    dev = sim.dev
+    keys = sorted(set(k for k in dev.normal + dev.extended if k)) + [KEY_PAUSE]
+    decoder = Decoder(dev)
+    wrong = []
+    start = len(sim.received)
+    for hid in keys:
+        if hid >= MODIFIER_FIRST:
+            down = [1 << (hid - MODIFIER_FIRST), 0, 0, 0, 0, 0, 0, 0]
+        else:
+            down = [0, 0, hid, 0, 0, 0, 0, 0]
+        report(sim, down)
+        sim.run_until(sim.now + 5000)
+        report(sim, [0] * 8)
+        sim.run_until(sim.now + 5000)
+
+    events = [e for _, b in sim.received[start:] for e in [decoder.byte(b)] if e]
+    want = []
+    for hid in keys:
+        want += [(hid, True)] + ([] if hid == KEY_PAUSE else [(hid, False)])
+    for got, expected in zip(events, want):
+        if got != expected:
+            wrong.append(f"{expected[0]:#04x}")
+    checks.check(f"{len(keys)} keys decoded back", not wrong and len(events) == len(want),
+                 f"{len(events)} events" + (f", wrong {' '.join(wrong[:8])}" if wrong else ''))
+
+
+def typematic_checks(sim, checks):
+    print("typematic:")
+    sim.send(TYPEMATIC)
+    sim.expect(1)
+    sim.send(0x00)          # 250 ms, 30 per second
+    sim.expect(1)
+
+    start = len(sim.received)
+    report(sim, [0, 0, KEY_A, 0, 0, 0, 0, 0])
+    held_until = sim.now + 1000000
+    while sim.now < held_until:
+        was_idle = sim.dev.lib.ps2_dev_idle()
+        sim.dev.lib.ps2_dev_typematic(sim.now & 0xFFFFFFFF)
+        sim.kick(was_idle)
+        sim.run_until(sim.now + 1000)
+    report(sim, [0] * 8)
+    sim.run_until(sim.now + 5000)
+    decoder = Decoder(sim.dev)
+    makes = [t for t, b in sim.received[start:] if decoder.byte(b) == (KEY_A, True)]
+    gaps = [b - a for a, b in zip(makes, makes[1:])]
+    # The press and 1 + (1000 - 250) / 33.3 repeats
+    checks.check("repeats over 1 s at 30/s after 250 ms", 23 <= len(makes) <= 25,
+                 f"{len(makes)} makes, first repeat after {gaps[0] / 1000:.1f} ms, "
+                 f"then every {sum(gaps[1:]) / len(gaps[1:]) / 1000:.1f} ms" if len(gaps) > 1 else '')
+
+    sim.send(DEFAULTS)
+    sim.expect(1)
+
+
+def typing(sim, checks, count, rate, hold_ms):
+    """Random overlapping key presses; latency per key event. The host
+    driver answers Caps Lock with an LED command, as an operating system
+    does, and may inhibit in the middle of a byte."""
+    print(f"latency, {count} random key presses at {rate:.0f}/s:")
+    dev = sim.dev
+    rng = sim.rng
+    plain = [k for k in range(KEY_A, MODIFIER_FIRST) if k in dev.normal]
+    extended = [k for k in range(KEY_A, MODIFIER_FIRST) if k in dev.extended]
+    keys = plain + extended + list(range(MODIFIER_FIRST, MODIFIER_FIRST + 8))
+
+    held = {}                   # hid -> release time
+    pending = []                # (hid, make, report time)
+    latency = {'one byte': [], 'extended': [], 'modifier': []}
+    decoder = Decoder(dev)
+    seen = len(sim.received)
+    caps = False
+    mismatches = 0
+
+    def current_report():
+        mods = sum(1 << (k - MODIFIER_FIRST) for k in held if k >= MODIFIER_FIRST)
+        normal = [k for k in held if k < MODIFIER_FIRST][:6]
+        return [mods, 0] + normal + [0] * (6 - len(normal))
+
+    def collect():
+        nonlocal seen, caps, mismatches
+        while seen < len(sim.received):
+            t, b = sim.received[seen]
+            seen += 1
+            if b in (ACK, RESEND):
+                continue
+            event = decoder.byte(b)
+            if not event:
+                continue
+            if not pending or pending[0][:2] != event:
+                mismatches += 1
+                continue
+            hid, make, t0 = pending.pop(0)
+            if make:
+                kind = 'modifier' if hid >= MODIFIER_FIRST else 'extended' if hid in extended else 'one byte'
+                latency[kind].append(t - t0)
+            if hid == KEY_CAPS_LOCK and make:
+                caps = not caps
+                sim.at(sim.now + 200, lambda: led_command(caps))
+
+    def led_command(on):
+        sim.send(SET_LEDS)
+        sim.send(0x04 if on else 0x00)
+
+    for _ in range(count):
+        press_at = sim.now + int(rng.expovariate(rate) * 1e6)
+        # Releases due before the next press, each at its own time
+        for hid, until in sorted(held.items(), key=lambda kv: kv[1]):
+            if until >= press_at:
+                break
+            sim.run_until(until)
+            collect()
+            del held[hid]
+            pending.append((hid, False, sim.now))
+            report(sim, current_report())
+        sim.run_until(press_at)
+        collect()
+        hid = rng.choice(keys)
+        if hid in held or len([k for k in held if k < MODIFIER_FIRST]) >= 6:
+            continue
+        held[hid] = sim.now + int(rng.expovariate(1000 / hold_ms) * 1e6)
+        pending.append((hid, True, sim.now))
+        report(sim, current_report())
+    for hid in list(held):
+        del held[hid]
+        pending.append((hid, False, sim.now))
+        report(sim, current_report())
+    sim.run_until(sim.now + 200000)
+    collect()
+
+    stats = dev.stats()
+    checks.check("every event arrived, in order", not pending and mismatches == 0,
+                 f"{len(pending)} missing, {mismatches} out of order")
+    checks.check("no frame errors", sim.frame_errors == 0, str(sim.frame_errors))
+    print(f"  bytes cancelled by host inhibit and sent again: {stats['cancelled']}, "
+          f"LED command bytes {stats['bytes_received']}, overruns {stats['overruns']}")
+    for kind, values in latency.items():
+        if not values:
+            continue
+        values.sort()
+        print(f"  {kind:9s} make: min {values[0] / 1000:.2f} ms, "
+              f"median {values[len(values) // 2] / 1000:.2f} ms, "
+              f"p99 {values[int(len(values) * 0.99)] / 1000:.2f} ms, max {values[-1] / 1000:.2f} ms")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument('--simulate', required=True, metavar='LIB', help="ps2_dev.c built as a shared library")
+    parser.add_argument('--keys', type=int, default=2000, help="random key presses for the latency run")
+    parser.add_argument('--rate', type=float, default=8.0, help="key presses per second")
+    parser.add_argument('--hold-ms', type=float, default=120.0, help="mean time a key is held")
+    parser.add_argument('--inhibit-rate', type=float, default=0.02,
+                        help="share of bytes the host cuts short with an inhibit")
+    parser.add_argument('--seed', type=int, default=1)
+    args = parser.parse_args()
+
+    rng = random.Random(args.seed)
+    checks = Checks()
+    dev = Device(args.simulate)
+
+    sim = Sim(dev, rng)
+    protocol_checks(sim, checks)
+    roundtrip_checks(sim, checks)
+    typematic_checks(sim, checks)
+
+    sim = Sim(dev, rng, inhibit_rate=args.inhibit_rate)
+    sim.expect(1, timeout=(BAT_MS + 50) * 1000)
+    typing(sim, checks, args.keys, args.rate, args.hold_ms)
+
+    print("all checks passed" if checks.failed == 0 else f"{checks.failed} checks failed")
+    sys.exit(1 if checks.failed else 0)
+
+
+if __name__ == '__main__':
+    main()
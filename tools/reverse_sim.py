@@ -0,0 +1,414 @@
+#!/usr/bin/env python3
+"""
+PS/2 to USB HID Keyboard Bridge - USB keyboard to PS/2 simulation
+
+Runs the reverse bridge on the host: the firmware's USB keyboard input
+(usb_host.c) turns HID reports into key events, a stand-in for the key
+pipeline with the default keymap builds the boot report as ps2.c does,
+and the PS/2 device output (ps2_dev.c) clocks scancodes out to the
+simulated PS/2 host of ps2dev_sim.py. It parses boot, multi-report-ID
+NKRO and mouse report descriptors, types every key through boot and NKRO
+reports and decodes it back from the PS/2 lines, and measures the latency
+from a key going down on the USB keyboard to the PS/2 host holding its
+scancode: waiting for the USB poll, the main loop, and the PS/2 bytes.
+
+  reverse_sim.py --simulate ./libreverse.so
+  reverse_sim.py --simulate ./libreverse.so --usb-interval-ms 8 --loop-us 500
+
+Build the library with the same settings as the firmware, e.g.
+
+  gcc -c -fPIC -I. usb_host.c ps2_dev.c && g++ -c -fPIC -std=c++17 -I. ps2_tables.cpp
+  g++ -shared -o libreverse.so usb_host.o ps2_dev.o ps2_tables.o
+
+The exit status is 1 if any check failed. The pipeline here is a
+stand-in; tests/test_reverse.c checks the bytes with ps2.c's own.
+"""
+
+import argparse
+import ctypes
+import os
+import random
+import sys
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from ps2dev_sim import (Checks, Decoder, Device, Sim, report, BAT_MS, SET_LEDS, KEY_A, KEY_PAUSE,
+                        MODIFIER_FIRST)
+
+# Mirrors usb_host.h
+FIELDS = 8
+
+# Descriptors as keyboards send them
+BOOT_KEYBOARD = bytes([
+    0x05, 0x01, 0x09, 0x06, 0xA1, 0x01,
+    0x05, 0x07, 0x19, 0xE0, 0x29, 0xE7, 0x15, 0x00, 0x25, 0x01, 0x75, 0x01, 0x95, 0x08, 0x81, 0x02,
+    0x95, 0x01, 0x75, 0x08, 0x81, 0x01,
+    0x95, 0x05, 0x75, 0x01, 0x05, 0x08, 0x19, 0x01, 0x29, 0x05, 0x91, 0x02,
+    0x95, 0x01, 0x75, 0x03, 0x91, 0x01,
+    0x95, 0x06, 0x75, 0x08, 0x15, 0x00, 0x25, 0x65, 0x05, 0x07, 0x19, 0x00, 0x29, 0x65, 0x81, 0x00,
+    0xC0,
+])
+
+# ID 1: 6KRO keyboard, ID 2: media keys, ID 3: NKRO bitmap of keys 0x00-0x77
+NKRO_KEYBOARD = bytes([
+    0x05, 0x01, 0x09, 0x06, 0xA1, 0x01, 0x85, 0x01,
+    0x05, 0x07, 0x19, 0xE0, 0x29, 0xE7, 0x15, 0x00, 0x25, 0x01, 0x75, 0x01, 0x95, 0x08, 0x81, 0x02,
+    0x95, 0x01, 0x75, 0x08, 0x81, 0x01,
+    0x95, 0x06, 0x75, 0x08, 0x15, 0x00, 0x26, 0xFF, 0x00, 0x05, 0x07, 0x19, 0x00, 0x2A, 0xFF, 0x00,
+    0x81, 0x00,
+    0xC0,
+    0x05, 0x0C, 0x09, 0x01, 0xA1, 0x01, 0x85, 0x02,
+    0x15, 0x00, 0x26, 0xFF, 0x03, 0x19, 0x00, 0x2A, 0xFF, 0x03, 0x75, 0x10, 0x95, 0x01, 0x81, 0x00,
+    0xC0,
+    0x05, 0x01, 0x09, 0x06, 0xA1, 0x01, 0x85, 0x03,
+    0x05, 0x07, 0x19, 0xE0, 0x29, 0xE7, 0x15, 0x00, 0x25, 0x01, 0x75, 0x01, 0x95, 0x08, 0x81, 0x02,
+    0x19, 0x00, 0x29, 0x77, 0x95, 0x78, 0x81, 0x02,
+    0xC0,
+])
+NKRO_BITMAP_KEYS = 0x78
+
+MOUSE = bytes([
+    0x05, 0x01, 0x09, 0x02, 0xA1, 0x01, 0x09, 0x01, 0xA1, 0x00,
+    0x05, 0x09, 0x19, 0x01, 0x29, 0x03, 0x15, 0x00, 0x25, 0x01, 0x95, 0x03, 0x75, 0x01, 0x81, 0x02,
+    0x95, 0x01, 0x75, 0x05, 0x81, 0x01,
+    0x05, 0x01, 0x09, 0x30, 0x09, 0x31, 0x15, 0x81, 0x25, 0x7F, 0x75, 0x08, 0x95, 0x02, 0x81, 0x06,
+    0xC0, 0xC0,
+])
+
+# Time from the poll to the report in core 1's callback (a full-speed
+# 8-byte transfer and the PIO-USB interrupt)
+USB_TRANSFER_US = 20
+
+
+class Field(ctypes.Structure):
+    _fields_ = [('report_id', ctypes.c_uint8), ('usage_min', ctypes.c_uint8), ('logical_min', ctypes.c_uint8),
+                ('array', ctypes.c_bool), ('size', ctypes.c_uint8), ('count', ctypes.c_uint8),
+                ('bit_offset', ctypes.c_uint16)]
+
+    def tuple(self):
+        return (self.report_id, self.usage_min, self.logical_min, self.array, self.size, self.count,
+                self.bit_offset)
+
+
+class Layout(ctypes.Structure):
+    _fields_ = [('fields', Field * FIELDS), ('count', ctypes.c_uint8), ('report_ids', ctypes.c_bool)]
+
+
+class UsbStats(ctypes.Structure):
+    _fields_ = [(name, ctypes.c_uint32) for name in ('reports', 'rollovers', 'unmatched', 'events')]
+
+
+SINK = ctypes.CFUNCTYPE(None, ctypes.c_uint8, ctypes.c_bool, ctypes.c_uint32)
+
+
+class Bridge:
+    """usb_host.c into the key pipeline into ps2_dev.c. The pipeline keeps
+    the boot report as press_key()/release_key() in ps2.c do and hands
+    each changed report to the PS/2 output."""
+
+    def __init__(self, dev):
+        lib = dev.lib
+        lib.usb_host_init.argtypes = [SINK]
+        lib.usb_host_boot_layout.argtypes = [ctypes.POINTER(Layout)]
+        lib.usb_host_parse_layout.argtypes = [ctypes.c_char_p, ctypes.c_uint16, ctypes.POINTER(Layout)]
+        lib.usb_host_parse_layout.restype = ctypes.c_bool
+        lib.usb_host_attach.argtypes = [ctypes.c_uint8, ctypes.POINTER(Layout)]
+        lib.usb_host_detach.argtypes = [ctypes.c_uint8, ctypes.c_uint32]
+        lib.usb_host_report.argtypes = [ctypes.c_uint8, ctypes.c_char_p, ctypes.c_uint16, ctypes.c_uint32]
+        lib.usb_host_leds_from_ps2.argtypes = [ctypes.c_uint8]
+        lib.usb_host_leds_from_ps2.restype = ctypes.c_uint8
+        lib.usb_host_stats.restype = ctypes.POINTER(UsbStats)
+        self.lib = lib
+        self.sim = None
+        self.mods = 0
+        self.keys = [0] * 6
+        self.events = []            # (hid, make) as the pipeline saw them
+        self.sink = SINK(self.key_event)
+        lib.usb_host_init(self.sink)
+
+    def key_event(self, key, pressed, time_ms):
+        self.events.append((key, pressed))
+        if key >= MODIFIER_FIRST:
+            bit = 1 << (key - MODIFIER_FIRST)
+            self.mods = self.mods | bit if pressed else self.mods & ~bit
+        elif pressed and key not in self.keys and 0 in self.keys:
+            self.keys[self.keys.index(0)] = key
+        elif not pressed and key in self.keys:
+            self.keys[self.keys.index(key)] = 0
+        report(self.sim, [self.mods, 0] + self.keys)
+
+    def layout(self, desc=None):
+        """The boot layout, or the one parsed from desc and whether it has keys."""
+        layout = Layout()
+        if desc is None:
+            self.lib.usb_host_boot_layout(ctypes.byref(layout))
+            return layout, True
+        return layout, self.lib.usb_host_parse_layout(desc, len(desc), ctypes.byref(layout))
+
+    def attach(self, slot, layout):
+        self.lib.usb_host_attach(slot, ctypes.byref(layout))
+
+    def report(self, slot, data):
+        self.lib.usb_host_report(slot, bytes(data), len(data), (self.sim.now // 1000) & 0xFFFFFFFF)
+
+    def stats(self):
+        s = self.lib.usb_host_stats().contents
+        return {name: getattr(s, name) for name, _ in UsbStats._fields_}
+
+
+def boot_report(held):
+    mods = sum(1 << (k - MODIFIER_FIRST) for k in held if k >= MODIFIER_FIRST)
+    keys = sorted(k for k in held if k < MODIFIER_FIRST)[:6]
+    return [mods, 0] + keys + [0] * (6 - len(keys))
+
+
+def nkro_reports(held):
+    """ID 1 for the keys beyond the bitmap, ID 3 for the rest."""
+    others = sorted(k for k in held if NKRO_BITMAP_KEYS <= k < MODIFIER_FIRST)[:6]
+    bitmap = [0] * 16
+    for k in held:
+        if k >= MODIFIER_FIRST:
+            bitmap[0] |= 1 << (k - MODIFIER_FIRST)
+        elif k < NKRO_BITMAP_KEYS:
+            bitmap[1 + k // 8] |= 1 << (k % 8)
+    return [[1, 0, 0] + others + [0] * (6 - len(others)), [3] + bitmap]
+
+
+def decoded(sim, start):
+    decoder = Decoder(sim.dev)
+    return [e for _, b in sim.received[start:] for e in [decoder.byte(b)] if e]
+
+
+def descriptor_checks(bridge, checks):
+    print("report descriptors:")
+    boot, _ = bridge.layout()
+    parsed, ok = bridge.layout(BOOT_KEYBOARD)
+    fields = [parsed.fields[i].tuple() for i in range(parsed.count)]
+    checks.check("boot keyboard in report protocol matches the boot layout",
+                 ok and fields == [boot.fields[i].tuple() for i in range(boot.count)] and not parsed.report_ids,
+                 ' '.join(str(f) for f in fields))
+
+    layout, ok = bridge.layout(NKRO_KEYBOARD)
+    fields = [layout.fields[i].tuple() for i in range(layout.count)]
+    want = [(1, 0xE0, 0, False, 1, 8, 0), (1, 0x00, 0, True, 8, 6, 16),
+            (3, 0xE0, 0, False, 1, 8, 0), (3, 0x00, 0, False, 1, NKRO_BITMAP_KEYS, 8)]
+    checks.check("NKRO keyboard: key fields of IDs 1 and 3, media keys skipped",
+                 ok and layout.report_ids and fields == want, ' '.join(str(f) for f in fields))
+
+    _, ok = bridge.layout(MOUSE)
+    checks.check("mouse has no key fields", ok is False)
+
+
+def every_key(sim, bridge, checks, name, slot, reports_for):
+    dev = sim.dev
+    keys = sorted(set(k for k in dev.normal + dev.extended if k)) + [KEY_PAUSE]
+    start = len(sim.received)
+    for hid in keys:
+        for data in reports_for({hid}):
+            bridge.report(slot, data)
+        sim.run_until(sim.now + 5000)
+        for data in reports_for(set()):
+            bridge.report(slot, data)
+        sim.run_until(sim.now + 5000)
+
+    events = decoded(sim, start)
+    want = []
+    for hid in keys:
+        want += [(hid, True)] + ([] if hid == KEY_PAUSE else [(hid, False)])
+    wrong = [f"{w[0]:#04x}" for got, w in zip(events, want) if got != w]
+    checks.check(f"{len(keys)} keys through {name} reports decoded back",
+                 not wrong and len(events) == len(want),
+                 f"{len(events)} events" + (f", wrong {' '.join(wrong[:8])}" if wrong else ''))
+
+
+def state_checks(sim, bridge, checks):
+    print("key state:")
+    KEY_B, LEFT_SHIFT = KEY_A + 1, MODIFIER_FIRST + 1
+
+    # A in ID 1, B in ID 3; an empty ID 1 report releases A only
+    start = len(sim.received)
+    bridge.report(1, [1, 0, 0, KEY_A, 0, 0, 0, 0, 0])
+    bridge.report(1, nkro_reports({KEY_B})[1])
+    bridge.report(1, nkro_reports(set())[0])
+    before = bridge.stats()
+    bridge.report(1, [2, 0xE9, 0x00])           # Volume up, no key fields
+    sim.run_until(sim.now + 10000)
+    checks.check("report IDs keep their own keys",
+                 decoded(sim, start) == [(KEY_A, True), (KEY_B, True), (KEY_A, False)],
+                 str(decoded(sim, start)))
+    checks.check("media report left the keys alone",
+                 bridge.stats()['unmatched'] == before['unmatched'] + 1 and bridge.events[-1] == (KEY_A, False))
+    bridge.report(1, nkro_reports(set())[1])
+    sim.run_until(sim.now + 5000)
+
+    # Error rollover while A is held: nothing changes
+    start = len(sim.received)
+    bridge.report(0, boot_report({KEY_A}))
+    bridge.report(0, [0, 0, 1, 1, 1, 1, 1, 1])
+    bridge.report(0, boot_report({KEY_A, KEY_B}))
+    sim.run_until(sim.now + 10000)
+    checks.check("error rollover report ignored",
+                 decoded(sim, start) == [(KEY_A, True), (KEY_B, True)] and bridge.stats()['rollovers'] == 1,
+                 str(decoded(sim, start)))
+
+    # Unplugged with A, B and Shift down
+    start = len(sim.received)
+    bridge.report(0, boot_report({KEY_A, KEY_B, LEFT_SHIFT}))
+    sim.run_until(sim.now + 5000)
+    bridge.lib.usb_host_detach(0, 0)
+    sim.run_until(sim.now + 10000)
+    checks.check("unplugging releases keys, then modifiers",
+                 decoded(sim, start) == [(LEFT_SHIFT, True), (KEY_A, False), (KEY_B, False), (LEFT_SHIFT, False)],
+                 str(decoded(sim, start)))
+    bridge.report(0, boot_report({KEY_A}))
+    checks.check("reports after unplugging ignored", bridge.events[-1] == (LEFT_SHIFT, False))
+
+    # The PS/2 host's lock LEDs, as USB LED bits
+    for byte in (SET_LEDS, 0x04):
+        sim.send(byte)
+        sim.expect(1)
+    ps2_leds = sim.dev.lib.ps2_dev_leds()
+    usb_leds = bridge.lib.usb_host_leds_from_ps2(ps2_leds)
+    checks.check("Caps Lock LED from the PS/2 host goes to USB bit 1", usb_leds == 0x02,
+                 f"PS/2 {ps2_leds:#04x}, USB {usb_leds:#04x}")
+    for byte in (SET_LEDS, 0x00):
+        sim.send(byte)
+        sim.expect(1)
+
+
+def typing(sim, bridge, checks, count, rate, hold_ms, interval_us, loop_us):
+    """Random overlapping key presses on a boot keyboard polled every
+    interval_us. A report is taken at the first poll after a change; the
+    main loop passes it on up to loop_us later."""
+    print(f"latency, {count} random key presses at {rate:.0f}/s, "
+          f"USB poll every {interval_us / 1000:g} ms, main loop up to {loop_us} us:")
+    dev = sim.dev
+    rng = sim.rng
+    keys = [k for k in range(KEY_A, MODIFIER_FIRST) if k in dev.normal or k in dev.extended]
+    keys = [k for k in keys if k != KEY_PAUSE] + list(range(MODIFIER_FIRST, MODIFIER_FIRST + 8))
+
+    # The keyboard: (time, hid, make) with at most six keys down
+    changes = []
+    held = {}
+    t = sim.now + 1000
+    for _ in range(count):
+        t += int(rng.expovariate(rate) * 1e6)
+        for hid, until in sorted(held.items(), key=lambda kv: kv[1]):
+            if until < t:
+                changes.append((until, hid, False))
+                del held[hid]
+        hid = rng.choice(keys)
+        if hid in held or len([k for k in held if k < MODIFIER_FIRST]) >= 6:
+            continue
+        held[hid] = t + int(rng.expovariate(1000 / hold_ms) * 1e6)
+        changes.append((t, hid, True))
+    changes += [(until, hid, False) for hid, until in held.items()]
+    changes.sort()
+
+    # The USB side: the first poll after each change, then the main loop
+    phase = rng.randrange(interval_us)
+    expected = []               # (hid, make, key time, poll time, pass-on time)
+    state = set()
+    delivered = sim.now
+    lost = 0
+    i = 0
+    while i < len(changes):
+        poll = phase + ((changes[i][0] - phase) // interval_us + 1) * interval_us
+        changed = {}
+        new = set(state)
+        while i < len(changes) and changes[i][0] < poll:
+            t, hid, make = changes[i]
+            changed[hid] = t
+            (new.add if make else new.discard)(hid)
+            i += 1
+        lost += sum(1 for hid in changed if (hid in new) == (hid in state))
+        delivered = max(delivered, poll + USB_TRANSFER_US + rng.randint(0, loop_us))
+
+        # Event order of usb_host_report()
+        released = sorted(state - new)
+        pressed = sorted(new - state)
+        order = ([(k, False) for k in released if k < MODIFIER_FIRST] +
+                 [(k, False) for k in released if k >= MODIFIER_FIRST] +
+                 [(k, True) for k in pressed if k >= MODIFIER_FIRST] +
+                 [(k, True) for k in pressed if k < MODIFIER_FIRST])
+        expected += [(hid, make, changed[hid], poll, delivered) for hid, make in order]
+        data = boot_report(new)
+        sim.at(delivered, lambda data=data: bridge.report(0, data))
+        state = new
+
+    start = len(sim.received)
+    sim.run_until(delivered + 200000)
+    decoder = Decoder(dev)
+    events = [(t, e) for t, b in sim.received[start:] for e in [decoder.byte(b)] if e]
+
+    mismatches = sum(1 for (_, got), want in zip(events, expected) if got != want[:2])
+    checks.check("every event arrived, in order", len(events) == len(expected) and mismatches == 0,
+                 f"{len(events)} of {len(expected)}, {mismatches} out of order")
+    checks.check("no frame errors", sim.frame_errors == 0, str(sim.frame_errors))
+    if lost:
+        print(f"  taps shorter than a poll interval, never reported: {lost}")
+
+    parts = {'total': [], 'USB poll': [], 'main loop': [], 'PS/2 bytes': []}
+    for (t, (hid, make)), (_, _, key_t, poll, passed) in zip(events, expected):
+        if not make:
+            continue
+        parts['total'].append(t - key_t)
+        parts['USB poll'].append(poll + USB_TRANSFER_US - key_t)
+        parts['main loop'].append(passed - poll - USB_TRANSFER_US)
+        parts['PS/2 bytes'].append(t - passed)
+    for name, values in parts.items():
+        if not values:
+            continue
+        values.sort()
+        print(f"  {name:10s} min {values[0] / 1000:.2f} ms, "
+              f"mean {sum(values) / len(values) / 1000:.2f} ms, "
+              f"p99 {values[int(len(values) * 0.99)] / 1000:.2f} ms, max {values[-1] / 1000:.2f} ms")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument('--simulate', required=True, metavar='LIB',
+                        help="usb_host.c and ps2_dev.c built as one shared library")
+    parser.add_argument('--keys', type=int, default=2000, help="random key presses for the latency run")
+    parser.add_argument('--rate', type=float, default=8.0, help="key presses per second")
+    parser.add_argument('--hold-ms', type=float, default=120.0, help="mean time a key is held")
+    parser.add_argument('--usb-interval-ms', type=float, default=1.0,
+                        help="keyboard's polling interval (bInterval, 1-10 ms for most)")
+    parser.add_argument('--loop-us', type=int, default=200,
+                        help="longest wait for the main loop to pick up a report")
+    parser.add_argument('--seed', type=int, default=1)
+    args = parser.parse_args()
+
+    rng = random.Random(args.seed)
+    checks = Checks()
+    dev = Device(args.simulate)
+    bridge = Bridge(dev)
+
+    descriptor_checks(bridge, checks)
+
+    sim = Sim(dev, rng)
+    bridge.sim = sim
+    sim.expect(1, timeout=(BAT_MS + 50) * 1000)
+    print("every key:")
+    boot, _ = bridge.layout()
+    nkro, _ = bridge.layout(NKRO_KEYBOARD)
+    bridge.attach(0, boot)
+    bridge.attach(1, nkro)
+    every_key(sim, bridge, checks, "boot", 0, lambda held: [boot_report(held)])
+    every_key(sim, bridge, checks, "NKRO", 1, nkro_reports)
+    state_checks(sim, bridge, checks)
+
+    sim = Sim(dev, rng)
+    bridge.sim = sim
+    bridge.lib.usb_host_init(bridge.sink)
+    bridge.mods, bridge.keys = 0, [0] * 6
+    bridge.attach(0, boot)
+    sim.expect(1, timeout=(BAT_MS + 50) * 1000)
+    typing(sim, bridge, checks, args.keys, args.rate, args.hold_ms,
+           int(args.usb_interval_ms * 1000), args.loop_us)
+
+    print("all checks passed" if checks.failed == 0 else f"{checks.failed} checks failed")
+    sys.exit(1 if checks.failed else 0)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,393 @@
+#!/usr/bin/env python3
+"""
+PS/2 to USB HID Keyboard Bridge - PS/2 bus sniffer
+
+Streams the frames the bridge hears on a PS/2 cable in both directions
+(firmware built with SNIFFER_ENABLE=1 and CONSOLE_ENABLE=1) through the
+debug console, and prints them with timestamps and their meaning.
+
+  sniff.py /dev/ttyACM0                    print frames until Ctrl-C
+  sniff.py /dev/ttyACM0 --save bus.bin     also keep the raw records
+  sniff.py --load bus.bin                  print a saved capture
+
+--simulate LIB instead drives the firmware's decoder (sniffer.c built as
+a host library) with simulated traffic in both directions, checks the
+decoded frames against what was sent, and reports timestamp error,
+throughput and ring buffer use:
+
+  gcc -shared -fPIC -I. -o libsniffer.so sniffer.c
+  sniff.py --simulate ./libsniffer.so --frames 5000 --max-gap-us 20
+  sniff.py --simulate ./libsniffer.so --gap-us 0 --drain-bytes 8    wire rate
+
+Live capture requires the 'serial' module (pip install pyserial).
+"""
+
+import argparse
+import ctypes
+import random
+import struct
+import sys
+import time
+
+# Mirrors sniffer.h
+RECORD_SIZE = 8
+HOST = 0x01
+PARITY_ERROR = 0x02
+FRAMING_ERROR = 0x04
+NO_ACK = 0x08
+ABORTED = 0x10
+INHIBIT = 0x20
+END = 0xFF
+INHIBIT_US = 100
+RING_SIZE = 512
+
+FLAG_NAMES = [(PARITY_ERROR, 'parity error'), (FRAMING_ERROR, 'framing error'),
+              (NO_ACK, 'no ack'), (ABORTED, 'aborted')]
+
+HOST_COMMANDS = {
+    0xED: 'set LEDs', 0xEE: 'echo', 0xF0: 'scan code set', 0xF2: 'read ID',
+    0xF3: 'typematic rate', 0xF4: 'enable', 0xF5: 'disable', 0xF6: 'defaults',
+    0xFE: 'resend', 0xFF: 'reset',
+}
+# Commands followed by an argument byte
+HOST_ARGUMENTS = (0xED, 0xF0, 0xF3)
+
+DEVICE_CODES = {
+    0xFA: 'ack', 0xAA: 'self-test passed', 0xFC: 'self-test failed', 0xEE: 'echo',
+    0xFE: 'resend', 0x00: 'overrun', 0xFF: 'overrun', 0xE0: 'extended', 0xF0: 'break',
+    0xAB: 'ID',
+}
+
+
+def parse_record(raw):
+    """(time_us, length_us, data, flags) from one wire record."""
+    return struct.unpack('<IHBB', raw)
+
+
+class Printer:
+    """Prints records with a running time and the meaning of each byte."""
+
+    def __init__(self):
+        self.first = None
+        self.last = None
+        self.wraps = 0
+        self.argument_for = None
+
+    def time_ms(self, time_us):
+        # The firmware's microsecond counter wraps every 71 minutes
+        if self.last is not None and time_us < self.last:
+            self.wraps += 1
+        self.last = time_us
+        absolute = time_us + (self.wraps << 32)
+        if self.first is None:
+            self.first = absolute
+        return (absolute - self.first) / 1000
+
+    def meaning(self, data, flags):
+        if flags & HOST:
+            if self.argument_for is not None:
+                text = f"argument of {HOST_COMMANDS[self.argument_for]}"
+                self.argument_for = None
+                return text
+            if data in HOST_ARGUMENTS:
+                self.argument_for = data
+            return HOST_COMMANDS.get(data, '')
+        return DEVICE_CODES.get(data, '')
+
+    def format(self, record):
+        time_us, length_us, data, flags = record
+        when = f"{self.time_ms(time_us):12.3f} ms"
+        if flags & INHIBIT:
+            return f"{when}  host inhibit {length_us} us"
+        direction = 'host -> kbd' if flags & HOST else 'kbd -> host'
+        problems = ', '.join(name for bit, name in FLAG_NAMES if flags & bit)
+        meaning = self.meaning(data, flags) if not flags & ABORTED else ''
+        return f"{when}  {direction}  {data:#04x}  {meaning:28s} {length_us:5d} us  {problems}".rstrip()
+
+
+#--------------------------------------------------------------------+
+# Live capture and saved files
+#--------------------------------------------------------------------+
+
+def capture(port, save):
+    import serial
+    link = serial.Serial(port, timeout=1)
+    link.write(b'\r')
+    time.sleep(0.2)
+    link.reset_input_buffer()
+    link.write(b'sniff\r')
+
+    # Echo, then the reply line; binary records start right after it
+    while True:
+        line = link.readline()
+        if not line:
+            sys.exit("no reply from the console")
+        if line.startswith(b'sniff needs'):
+            sys.exit(line.decode().strip())
+        if line.startswith(b'sniff:'):
+            break
+
+    printer = Printer()
+    out = open(save, 'wb') if save else None
+    received = 0
+    start = time.monotonic()
+    stopping = False
+    while True:
+        try:
+            raw = link.read(RECORD_SIZE)
+        except KeyboardInterrupt:
+            raw = b''
+            if not stopping:
+                link.write(b'x')
+                stopping = True
+        if len(raw) < RECORD_SIZE:
+            if not raw and not stopping:
+                continue
+            raw += link.read(RECORD_SIZE - len(raw))
+            if len(raw) < RECORD_SIZE:
+                continue
+        record = parse_record(raw)
+        if record[3] == END:
+            break
+        received += RECORD_SIZE
+        if out:
+            out.write(raw)
+        print(printer.format(record))
+
+    elapsed = time.monotonic() - start
+    for _ in range(2):
+        print(link.readline().decode(errors='replace').strip())
+    print(f"host: {received} bytes in {elapsed:.1f} s ({received / elapsed:.0f} B/s)")
+
+
+def load(path):
+    printer = Printer()
+    data = open(path, 'rb').read()
+    for offset in range(0, len(data) - RECORD_SIZE + 1, RECORD_SIZE):
+        print(printer.format(parse_record(data[offset:offset + RECORD_SIZE])))
+
+
+#--------------------------------------------------------------------+
+# Simulation
+#--------------------------------------------------------------------+
+
+class Record(ctypes.Structure):
+    _fields_ = [('time_us', ctypes.c_uint32), ('length_us', ctypes.c_uint16),
+                ('data', ctypes.c_uint8), ('flags', ctypes.c_uint8)]
+
+
+class Stats(ctypes.Structure):
+    _fields_ = [('device_frames', ctypes.c_uint32), ('host_frames', ctypes.c_uint32),
+                ('inhibits', ctypes.c_uint32), ('errors', ctypes.c_uint32),
+                ('lost', ctypes.c_uint32), ('bytes_streamed', ctypes.c_uint32),
+                ('high_water', ctypes.c_uint16)]
+
+
+def odd_parity(byte):
+    return 1 - bin(byte).count('1') % 2
+
+
+class Bus:
+    """Line changes as a sorted list of (time_us, clk, data); both lines
+    are open-collector, so each is high unless somebody pulls it low."""
+
+    def __init__(self):
+        self.events = []
+
+    def set(self, t, clk=None, data=None):
+        self.events.append((t, clk, data))
+
+    def levels(self):
+        """(time, clk, data) after each change, in time order."""
+        clk, data = 1, 1
+        for t, c, d in sorted(self.events, key=lambda e: e[0]):
+            clk = clk if c is None else c
+            data = data if d is None else d
+            yield t, clk, data
+
+
+def device_frame(bus, t, byte, half_us):
+    """Start, 8 data bits, parity, stop: data changes while the clock is
+    high, the host reads on falling edges. Returns the end time."""
+    bits = [0] + [(byte >> i) & 1 for i in range(8)] + [odd_parity(byte), 1]
+    first_fall = t + half_us // 2
+    for i, bit in enumerate(bits):
+        bus.set(t + 2 * i * half_us, data=bit)
+        bus.set(t + 2 * i * half_us + half_us // 2, clk=0)
+        bus.set(t + 2 * i * half_us + half_us // 2 + half_us, clk=1)
+    return first_fall, t + 2 * len(bits) * half_us
+
+
+def host_frame(bus, t, byte, half_us, inhibit_us, ack=True):
+    """Inhibit, request to send, then 10 device clocks reading data on
+    rising edges, and the device's ack on the eleventh. Returns the end."""
+    bus.set(t, clk=0)
+    bus.set(t + inhibit_us, data=0)
+    released = t + inhibit_us + 5
+    bus.set(released, clk=1)
+
+    fall = released + 40
+    bits = [(byte >> i) & 1 for i in range(8)] + [odd_parity(byte), 1]
+    for bit in bits:
+        bus.set(fall, clk=0)
+        bus.set(fall + 5, data=bit)     # Host changes data while clock is low
+        bus.set(fall + half_us, clk=1)
+        fall += 2 * half_us
+    if ack:
+        bus.set(fall - 10, data=0)
+    bus.set(fall, clk=0)
+    bus.set(fall + half_us, clk=1)
+    bus.set(fall + half_us + 5, data=1)
+    return fall + half_us + 5
+
+
+def simulated_traffic(rng, frames, abort_rate, gap_us):
+    """Typing with the host's LED updates and occasional inhibits. Returns
+    the bus and the expected records as (time_us, data, flags)."""
+    bus = Bus()
+    expected = []
+    t = 1000
+    for _ in range(frames):
+        half = rng.randint(30, 50)
+        kind = rng.random()
+        if kind < abort_rate:
+            # The host inhibits three bits into a device byte
+            byte = rng.randrange(256)
+            first, _ = device_frame(bus, t, byte, half)
+            cut = t + 2 * 3 * half + half // 2 + half + half // 2
+            bus.events = [e for e in bus.events if e[0] < cut]
+            bus.set(cut, clk=0, data=1)
+            hold = rng.randint(150, 300)
+            bus.set(cut + hold, clk=1)
+            expected.append((first, None, ABORTED))
+            expected.append((cut, 0, INHIBIT))
+            t = cut + hold
+        elif kind < abort_rate + 0.1:
+            # Set LEDs: command, ack, argument, ack
+            leds = rng.randrange(8)
+            for byte in (0xED, leds):
+                inhibit = rng.randint(100, 200)
+                expected.append((t, byte, HOST))
+                t = host_frame(bus, t, byte, half, inhibit) + rng.randint(100, 500)
+                first, t = device_frame(bus, t, 0xFA, half)
+                expected.append((first, 0xFA, 0))
+                t += rng.randint(100, 500)
+        else:
+            byte = rng.choice([0x1C, 0x32, 0x21, 0x23, 0x24, 0x2B, 0x34, 0x33, 0xF0, 0xE0])
+            first, t = device_frame(bus, t, byte, half)
+            expected.append((first, byte, 0))
+        # At least 50 us between bytes, as a keyboard sends them
+        t += (int(rng.expovariate(1 / gap_us)) if gap_us else 0) + 50
+    return bus, expected, t
+
+
+def simulate(args):
+    lib = ctypes.CDLL(args.simulate)
+    lib.sniffer_sample.argtypes = [ctypes.c_bool, ctypes.c_bool, ctypes.c_uint32]
+    lib.sniffer_read.argtypes = [ctypes.POINTER(Record)]
+    lib.sniffer_read.restype = ctypes.c_bool
+    lib.sniffer_read_bytes.argtypes = [ctypes.c_char_p, ctypes.c_uint16]
+    lib.sniffer_read_bytes.restype = ctypes.c_uint16
+    lib.sniffer_stats.restype = ctypes.POINTER(Stats)
+    lib.sniffer_reset()
+
+    rng = random.Random(args.seed)
+    bus, expected, end = simulated_traffic(rng, args.frames, args.abort_rate, args.gap_us)
+
+    # Poll the lines like the main loop: short passes, sometimes a long one
+    changes = list(bus.levels())
+    got = []
+    buffer = ctypes.create_string_buffer(64)
+    index = 0
+    clk = data = 1
+    now = 0
+    next_drain = args.drain_us
+    while now < end + 5000:
+        while index < len(changes) and changes[index][0] <= now:
+            _, clk, data = changes[index]
+            index += 1
+        lib.sniffer_sample(bool(clk), bool(data), now)
+        if now >= next_drain:
+            # The console job moves at most drain_bytes per USB frame
+            next_drain += args.drain_us
+            n = lib.sniffer_read_bytes(buffer, args.drain_bytes)
+            raw = buffer.raw[:n]
+            got.extend(parse_record(raw[i:i + RECORD_SIZE]) for i in range(0, n, RECORD_SIZE))
+        gap = args.max_gap_us if rng.random() < args.long_pass else rng.uniform(0.5, 2 * args.poll_us)
+        now += max(1, int(round(gap)))
+    while True:
+        n = lib.sniffer_read_bytes(buffer, 64)
+        if not n:
+            break
+        got.extend(parse_record(buffer.raw[i:i + RECORD_SIZE]) for i in range(0, n, RECORD_SIZE))
+
+    mismatches = 0
+    errors_us = []
+    for i, (want, have) in enumerate(zip(expected, got)):
+        w_time, w_data, w_flags = want
+        h_time, _, h_data, h_flags = have
+        # Aborted frames: only the flag matters, the bit count depends on
+        # where the cut fell
+        ok = (h_flags & (HOST | INHIBIT | ABORTED)) == w_flags and \
+             (w_data is None or w_flags == INHIBIT or h_data == w_data) and \
+             not h_flags & (PARITY_ERROR | FRAMING_ERROR | NO_ACK)
+        if not ok:
+            mismatches += 1
+            if mismatches <= 10:
+                print(f"record {i}: expected {w_data} flags {w_flags:#x} at {w_time}, "
+                      f"got {h_data:#04x} flags {h_flags:#x} at {h_time}")
+        errors_us.append(h_time - w_time)
+    if len(got) != len(expected):
+        print(f"expected {len(expected)} records, got {len(got)}")
+        mismatches += abs(len(got) - len(expected))
+
+    stats = lib.sniffer_stats().contents
+    seconds = end / 1e6
+    errors_us.sort()
+    print(f"{len(expected)} records over {seconds:.2f} s of bus time, {mismatches} mismatched")
+    print(f"frames: {stats.device_frames} device, {stats.host_frames} host, "
+          f"{stats.inhibits} inhibits, {stats.errors} with errors")
+    if errors_us:
+        print(f"timestamp error: median {errors_us[len(errors_us) // 2]} us, max {errors_us[-1]} us "
+              f"(polling every ~{args.poll_us} us, {100 * args.long_pass:g}% passes of "
+              f"{args.max_gap_us} us)")
+    print(f"stream: {stats.bytes_streamed} bytes, {stats.bytes_streamed / seconds:.0f} B/s average; "
+          f"drain capacity {args.drain_bytes * 1e6 / args.drain_us:.0f} B/s")
+    print(f"ring: high water {stats.high_water}/{RING_SIZE} records, {stats.lost} lost")
+    return mismatches == 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument('port', nargs='?', help="the bridge's console serial port")
+    parser.add_argument('--save', metavar='FILE', help="write the raw records to FILE")
+    parser.add_argument('--load', metavar='FILE', help="print a saved capture")
+    parser.add_argument('--simulate', metavar='LIB', help="sniffer.c built as a shared library")
+    parser.add_argument('--frames', type=int, default=2000, help="simulated traffic length")
+    parser.add_argument('--abort-rate', type=float, default=0.02,
+                        help="share of device bytes cut short by a host inhibit")
+    parser.add_argument('--gap-us', type=float, default=2000.0,
+                        help="mean gap between bytes (0: back to back, wire rate)")
+    parser.add_argument('--poll-us', type=float, default=2.0, help="mean main loop pass")
+    parser.add_argument('--max-gap-us', type=int, default=20, help="length of a long pass")
+    parser.add_argument('--long-pass', type=float, default=0.01, help="share of long passes")
+    parser.add_argument('--drain-us', type=int, default=1000, help="console job interval")
+    parser.add_argument('--drain-bytes', type=int, default=64, help="bytes streamed per interval")
+    parser.add_argument('--seed', type=int, default=1)
+    args = parser.parse_args()
+
+    if args.simulate:
+        sys.exit(0 if simulate(args) else 1)
+    elif args.load:
+        load(args.load)
+    elif args.port:
+        try:
+            capture(args.port, args.save)
+        except KeyboardInterrupt:
+            pass
+    else:
+        parser.error("a port, --load or --simulate is required")
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,233 @@
+#!/usr/bin/env python3
+"""
+PS/2 to USB HID Keyboard Bridge - telemetry decoder
+
+Reads the bridge's telemetry interface (firmware built with
+TELEMETRY_ENABLE=1) and prints counters, histograms and the event trace.
+
+  telemetry.py                   print a summary every second
+  telemetry.py --trace           also print trace events as they arrive
+  telemetry.py --keys            also print press counts per key
+                                 (firmware built with KEYSTATS_ENABLE=1)
+  telemetry.py --reset           clear the firmware's statistics first
+
+Requires the 'hid' module (pip install hidapi).
+"""
+
+import argparse
+import struct
+import sys
+import time
+
+USB_VID = 0xCAFE
+TELEMETRY_USAGE_PAGE = 0xFF00
+TELEMETRY_USAGE = 0x02
+TELEMETRY_REPORT_SIZE = 64
+
+PKT_COUNTERS = 0x01
+PKT_LOOP_HIST = 0x02
+PKT_LATENCY = 0x03
+PKT_TRACE = 0x04
+PKT_KEYS = 0x05
+PKT_BOOT = 0x06
+PKT_PROFILE = 0x07
+
+# OUT report commands
+CMD_RESET = 0x01
+CMD_PROFILER_START = 0x02
+CMD_PROFILER_STOP = 0x03
+
+# Same order as telemetry_counter_t
+COUNTERS = [
+    'ps2_bytes', 'key_events', 'reports_queued', 'reports_sent',
+    'reports_repeated', 'queue_overruns', 'usb_suspends', 'trace_dropped',
+]
+
+# Same values as telemetry_trace_t
+TRACE_EVENTS = {
+    1: 'ps2_byte', 2: 'report_sent', 3: 'usb_mount', 4: 'usb_suspend', 5: 'usb_resume',
+    6: 'ps2_bat', 7: 'watchdog_reset',
+}
+
+# Same order as boot_mark_t
+BOOT_MARKS = ['main', 'usb_started', 'ps2_ready', 'usb_mounted', 'first_report']
+
+
+def bucket_label(n):
+    """Range of histogram bucket n in microseconds (see telemetry.h)."""
+    if n == 0:
+        return '0'
+    low = 1 << (n - 1)
+    return f'{low}-{(1 << n) - 1}' if n < 14 else f'>={low}'
+
+
+def decode(packet):
+    """Decode one IN packet into (type, sequence, payload).
+
+    Payload is a dict of counters, a list of histogram buckets, a list
+    of (time_ms, event, data) trace entries, or a dict of presses per
+    keycode, or a dict of boot milestones in microseconds (0 = not
+    reached), or for a profile packet a dict of totals, 'last' (end of a
+    pass over the table) and a list of (pc, count) entries.
+    """
+    if len(packet) < 4:
+        raise ValueError("short packet")
+    kind, seq, count = packet[0], packet[1], packet[2]
+    body = bytes(packet[4:])
+
+    if kind == PKT_COUNTERS:
+        values = struct.unpack_from(f'<{count + 1}I', body)
+        names = COUNTERS + [f'counter{i}' for i in range(len(COUNTERS), count)]
+        payload = {'uptime_ms': values[0]}
+        payload.update(zip(names, values[1:]))
+    elif kind in (PKT_LOOP_HIST, PKT_LATENCY):
+        payload = list(struct.unpack_from(f'<{count}I', body))
+    elif kind == PKT_TRACE:
+        payload = [struct.unpack_from('<HBB', body, 4 * i) for i in range(count)]
+    elif kind == PKT_BOOT:
+        values = struct.unpack_from(f'<{count}I', body)
+        names = BOOT_MARKS + [f'mark{i}' for i in range(len(BOOT_MARKS), count)]
+        payload = dict(zip(names, values))
+    elif kind == PKT_KEYS:
+        first = packet[3]
+        payload = dict(enumerate(struct.unpack_from(f'<{count}I', body), first))
+    elif kind == PKT_PROFILE:
+        values = struct.unpack_from(f'<{2 + 2 * count}I', body)
+        payload = {'samples': values[0], 'dropped': values[1], 'last': bool(packet[3]),
+                   'entries': list(zip(values[2::2], values[3::2]))}
+    else:
+        raise ValueError(f"unknown packet type {kind:#x}")
+    return kind, seq, payload
+
+
+def format_histogram(title, buckets):
+    total = sum(buckets)
+    lines = [f"{title} ({total} samples)"]
+    for n, count in enumerate(buckets):
+        if count:
+            lines.append(f"  {bucket_label(n):>11} us: {count:10d} {100 * count / total:5.1f}%")
+    return '\n'.join(lines)
+
+
+def format_boot(marks):
+    """Boot milestones in ms; ready is when both keyboard and USB were."""
+    line = ' '.join(f"{name}={us / 1000:.1f}" for name, us in marks.items() if us)
+    if marks.get('ps2_ready') and marks.get('usb_mounted'):
+        line += f" ready={max(marks['ps2_ready'], marks['usb_mounted']) / 1000:.1f}"
+    return f"boot (ms): {line}"
+
+
+def format_keys(counts):
+    total = sum(counts.values())
+    lines = [f"key presses ({total})"]
+    for key, count in sorted(counts.items(), key=lambda item: -item[1]):
+        if count:
+            lines.append(f"  {key:#04x}: {count:10d} {100 * count / total:5.1f}%")
+    return '\n'.join(lines)
+
+
+def format_trace(entry):
+    time_ms, event, data = entry
+    name = TRACE_EVENTS.get(event, f'event{event}')
+    return f"  {time_ms:5d} ms  {name:12s} {data:#04x}"
+
+
+def find_interface(hid):
+    """The telemetry interface, by its vendor usage. Interface numbers depend
+    on the profile and on which other interfaces the firmware has; backends
+    that report no usages get each report descriptor read instead."""
+    devices = hid.enumerate(USB_VID)
+    for info in devices:
+        if info['usage_page'] == TELEMETRY_USAGE_PAGE and info['usage'] == TELEMETRY_USAGE:
+            return info
+
+    # Usage Page (0xFF00), Usage (0x02)
+    start = bytes([0x06, TELEMETRY_USAGE_PAGE & 0xFF, TELEMETRY_USAGE_PAGE >> 8, 0x09, TELEMETRY_USAGE])
+    for info in devices:
+        dev = hid.device()
+        try:
+            dev.open_path(info['path'])
+            desc = bytes(dev.get_report_descriptor())
+        except (OSError, IOError, AttributeError):
+            desc = b''
+        finally:
+            dev.close()
+        if desc.startswith(start):
+            return info
+    return None
+
+
+def open_device():
+    import hid
+    info = find_interface(hid)
+    if info is None:
+        sys.exit("telemetry interface not found (is the firmware built with TELEMETRY_ENABLE=1?)")
+    dev = hid.device()
+    dev.open_path(info['path'])
+    return dev
+
+
+def run(args):
+    dev = open_device()
+    if args.reset:
+        dev.write(bytes([0, CMD_RESET]))
+
+    state = {}
+    keys = {}
+    last_print = time.monotonic()
+    last_seq = None
+    lost = 0
+
+    while True:
+        data = dev.read(TELEMETRY_REPORT_SIZE, 100)
+        if data:
+            kind, seq, payload = decode(data)
+            if last_seq is not None:
+                lost += (seq - last_seq - 1) & 0xFF
+            last_seq = seq
+
+            if kind == PKT_TRACE:
+                if args.trace:
+                    for entry in payload:
+                        print(format_trace(entry))
+            elif kind == PKT_KEYS:
+                keys.update(payload)
+            else:
+                state[kind] = payload
+
+        if time.monotonic() - last_print >= args.interval and state:
+            last_print = time.monotonic()
+            if PKT_COUNTERS in state:
+                print(' '.join(f"{k}={v}" for k, v in state[PKT_COUNTERS].items()))
+            if PKT_BOOT in state:
+                print(format_boot(state[PKT_BOOT]))
+            if PKT_LOOP_HIST in state:
+                print(format_histogram("main loop time", state[PKT_LOOP_HIST]))
+            if PKT_LATENCY in state:
+                print(format_histogram("scancode to report sent", state[PKT_LATENCY]))
+            if PKT_PROFILE in state:
+                profile = state[PKT_PROFILE]
+                print(f"profiler: {profile['samples']} samples, {profile['dropped']} dropped "
+                      f"(tools/profiler.py resolves them)")
+            if args.keys and keys:
+                print(format_keys(keys))
+            if lost:
+                print(f"({lost} packets lost)")
+            print()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument('--trace', action='store_true', help="print trace events")
+    parser.add_argument('--keys', action='store_true', help="print press counts per key")
+    parser.add_argument('--reset', action='store_true', help="clear statistics on the device first")
+    parser.add_argument('--interval', type=float, default=1.0, help="summary interval in seconds")
+    args = parser.parse_args()
+    try:
+        run(args)
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == '__main__':
+    main()
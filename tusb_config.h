@@ -90,15 +90,74 @@
 #define CFG_TUD_ENDPOINT0_SIZE    64
 #endif
 
+// Paste mode: second HID interface that streams text to be typed
+#ifndef PASTE_ENABLE
+#define PASTE_ENABLE              0
+#endif
+
+// Telemetry: vendor HID interface streaming diagnostics (see telemetry.h)
+#ifndef TELEMETRY_ENABLE
+#define TELEMETRY_ENABLE          0
+#endif
+
+// Configuration protocol in keyboard feature reports (see config.h)
+#ifndef CONFIG_ENABLE
+#define CONFIG_ENABLE             0
+#endif
+
+// Debug console: CDC-ACM serial interface (see console.h)
+#ifndef CONSOLE_ENABLE
+#define CONSOLE_ENABLE            0
+#endif
+
 //------------- CLASS -------------//
-#define CFG_TUD_HID               1
-#define CFG_TUD_CDC               0
+// Keyboard and consumer, plus the optional interfaces; a USB profile may
+// enumerate fewer (see usb_profile.h)
+#define CFG_TUD_HID               (2 + PASTE_ENABLE + TELEMETRY_ENABLE)
+#define CFG_TUD_CDC               CONSOLE_ENABLE
 #define CFG_TUD_MSC               0
 #define CFG_TUD_MIDI              0
 #define CFG_TUD_VENDOR            0
 
 // HID buffer size Should be sufficient to hold ID (if any) + Data
+// The paste and telemetry interfaces and the configuration feature report
+// use full 64-byte packets. This only sizes the stack's buffers: each
+// interface's wMaxPacketSize is set in usb_descriptors.c, and the keyboard
+// endpoint stays at 16 bytes
+#if PASTE_ENABLE || TELEMETRY_ENABLE || CONFIG_ENABLE
+#define CFG_TUD_HID_EP_BUFSIZE    64
+#else
 #define CFG_TUD_HID_EP_BUFSIZE    16
+#endif
+
+// CDC FIFO sizes; the console needs room for three full lines
+#define CFG_TUD_CDC_RX_BUFSIZE    64
+#define CFG_TUD_CDC_TX_BUFSIZE    256
+#define CFG_TUD_CDC_EP_BUFSIZE    64
+
+//--------------------------------------------------------------------
+// HOST CONFIGURATION
+//--------------------------------------------------------------------
+
+// USB keyboard input: host port over PIO-USB, run on core 1 (see usb_host.h)
+#ifndef USB_HOST_ENABLE
+#define USB_HOST_ENABLE           0
+#endif
+
+#if USB_HOST_ENABLE
+#define CFG_TUH_ENABLED           1
+#define CFG_TUH_RPI_PIO_USB       1
+#define BOARD_TUH_RHPORT          1
+#define CFG_TUH_ENUMERATION_BUFSIZE 256
+
+// A hub and a few devices behind it, each with up to three HID interfaces
+// (keyboard, NKRO, media keys)
+#define CFG_TUH_HUB               1
+#define CFG_TUH_DEVICE_MAX        4
+#define CFG_TUH_HID               (3 * CFG_TUH_DEVICE_MAX)
+#define CFG_TUH_HID_EPIN_BUFSIZE  64
+#define CFG_TUH_HID_EPOUT_BUFSIZE 64
+#endif
 
 #ifdef __cplusplus
  }
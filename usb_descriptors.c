@@ -26,17 +26,19 @@
 #include "bsp/board_api.h"
 #include "tusb.h"
 #include "usb_descriptors.h"
+#include "usb_profile.h"
+#include "consumer.h"
+#include "paste.h"
+#include "telemetry.h"
+#include "config.h"
+#include <string.h>
 
 /* A combination of interfaces must have a unique product id, since PC will save device driver after the first plug.
  * Same VID/PID with different interface e.g MSC (first), then CDC (later) will possibly cause system error on PC.
  *
- * Auto ProductID layout's Bitmap:
- *   [MSB]         HID | MSC | CDC          [LSB]
+ * The interface set depends on the USB profile chosen at boot, so the
+ * product ID is derived from it at runtime, see USB_PROFILE_PID().
  */
-#define _PID_MAP(itf, n)  ( (CFG_TUD_##itf) << (n) )
-#define USB_PID           (0x4000 | _PID_MAP(CDC, 0) | _PID_MAP(MSC, 1) | _PID_MAP(HID, 2) | \
-                           _PID_MAP(MIDI, 3) | _PID_MAP(VENDOR, 4) )
-
 #define USB_VID   0xCafe
 #define USB_BCD   0x0200
 
@@ -54,7 +56,7 @@ tusb_desc_device_t const desc_device =
     .bMaxPacketSize0    = CFG_TUD_ENDPOINT0_SIZE,
 
     .idVendor           = USB_VID,
-    .idProduct          = USB_PID,
+    .idProduct          = USB_PROFILE_PID(USB_PROFILE_BOOT_ITFS),
     .bcdDevice          = 0x0100,
 
     .iManufacturer      = 0x01,
@@ -68,7 +70,23 @@ tusb_desc_device_t const desc_device =
 // Application return pointer to descriptor
 uint8_t const * tud_descriptor_device_cb(void)
 {
-  return (uint8_t const *) &desc_device;
+  uint8_t const itfs = usb_profile_interfaces(usb_profile_active());
+
+  // The boot profile is served as is
+  if ( itfs == USB_PROFILE_BOOT_ITFS ) return (uint8_t const *) &desc_device;
+
+  static tusb_desc_device_t desc_runtime;
+  desc_runtime = desc_device;
+  desc_runtime.idProduct = USB_PROFILE_PID(itfs);
+
+  if ( itfs & USB_ITF_CDC )
+  {
+    // Use Interface Association Descriptor (IAD) for CDC
+    desc_runtime.bDeviceClass    = TUSB_CLASS_MISC;
+    desc_runtime.bDeviceSubClass = MISC_SUBCLASS_COMMON;
+    desc_runtime.bDeviceProtocol = MISC_PROTOCOL_IAD;
+  }
+  return (uint8_t const *) &desc_runtime;
 }
 
 //--------------------------------------------------------------------+
@@ -80,43 +98,242 @@ uint8_t const * tud_descriptor_device_cb(void)
 // Byte 0: Modifier keys
 // Byte 1: Reserved
 // Bytes 2-7: Key codes (up to 6 simultaneous keys)
-uint8_t const desc_hid_report[] =
+uint8_t const desc_hid_boot_report[] =
 {
   TUD_HID_REPORT_DESC_KEYBOARD()
 };
 
+#if CONFIG_ENABLE
+// Configuration requests and responses: one vendor-defined feature report
+// inside the keyboard collection (boot protocol hosts ignore it). The boot
+// profile leaves it out.
+#define CONFIG_FEATURE_ITEMS \
+  HID_USAGE_PAGE_N  ( HID_USAGE_PAGE_VENDOR, 2 ), \
+  HID_USAGE         ( 0x05 ), \
+  HID_LOGICAL_MIN   ( 0x00 ), \
+  HID_LOGICAL_MAX_N ( 0xff, 2 ), \
+  HID_REPORT_SIZE   ( 8 ), \
+  HID_REPORT_COUNT  ( CONFIG_REPORT_SIZE ), \
+  HID_FEATURE       ( HID_DATA | HID_VARIABLE | HID_ABSOLUTE ),
+
+uint8_t const desc_hid_report[] =
+{
+  TUD_HID_REPORT_DESC_KEYBOARD(CONFIG_FEATURE_ITEMS)
+};
+#endif
+
+// Consumer interface: media keys and system power control, by report ID
+uint8_t const desc_hid_consumer_report[] =
+{
+  TUD_HID_REPORT_DESC_CONSUMER       ( HID_REPORT_ID(CONSUMER_REPORT_ID_CONSUMER) ),
+  TUD_HID_REPORT_DESC_SYSTEM_CONTROL ( HID_REPORT_ID(CONSUMER_REPORT_ID_SYSTEM) )
+};
+
+#if PASTE_ENABLE
+// Paste interface: vendor-defined 64-byte IN/OUT reports (no report ID)
+uint8_t const desc_hid_paste_report[] =
+{
+  TUD_HID_REPORT_DESC_GENERIC_INOUT(PASTE_REPORT_SIZE)
+};
+#endif
+
+#if TELEMETRY_ENABLE
+// Telemetry interface: vendor page, usage 2 (the paste interface is usage 1)
+// 64-byte IN packets; 1-byte OUT reports (via SET_REPORT) carry a
+// TELEMETRY_CMD_* command
+uint8_t const desc_hid_telemetry_report[] =
+{
+  HID_USAGE_PAGE_N ( HID_USAGE_PAGE_VENDOR, 2 ),
+  HID_USAGE        ( 0x02 ),
+  HID_COLLECTION   ( HID_COLLECTION_APPLICATION ),
+    HID_USAGE         ( 0x03 ),
+    HID_LOGICAL_MIN   ( 0x00 ),
+    HID_LOGICAL_MAX_N ( 0xff, 2 ),
+    HID_REPORT_SIZE   ( 8 ),
+    HID_REPORT_COUNT  ( TELEMETRY_REPORT_SIZE ),
+    HID_INPUT         ( HID_DATA | HID_VARIABLE | HID_ABSOLUTE ),
+    HID_USAGE         ( 0x04 ),
+    HID_REPORT_COUNT  ( 1 ),
+    HID_OUTPUT        ( HID_DATA | HID_VARIABLE | HID_ABSOLUTE ),
+  HID_COLLECTION_END
+};
+#endif
+
 // Invoked when received GET HID REPORT DESCRIPTOR
 // Application return pointer to descriptor
 // Descriptor contents must exist long enough for transfer to complete
 uint8_t const * tud_hid_descriptor_report_cb(uint8_t instance)
 {
-  (void) instance;
-  return desc_hid_report;
+  if (instance == HID_INSTANCE_CONSUMER) return desc_hid_consumer_report;
+#if PASTE_ENABLE
+  if (instance == HID_INSTANCE_PASTE) return desc_hid_paste_report;
+#endif
+#if TELEMETRY_ENABLE
+  if (instance == HID_INSTANCE_TELEMETRY) return desc_hid_telemetry_report;
+#endif
+#if CONFIG_ENABLE
+  if (usb_profile_interfaces(usb_profile_active()) & USB_ITF_CONFIG) return desc_hid_report;
+#endif
+  return desc_hid_boot_report;
 }
 
 //--------------------------------------------------------------------+
 // Configuration Descriptor
 //--------------------------------------------------------------------+
 
+// Interface numbers are fixed; a profile's interfaces are always a prefix
+// of this list, so they stay numbered without gaps
 enum
 {
   ITF_NUM_HID,
+  ITF_NUM_CONSUMER,
+#if PASTE_ENABLE
+  ITF_NUM_PASTE,
+#endif
+#if TELEMETRY_ENABLE
+  ITF_NUM_TELEMETRY,
+#endif
+#if CONSOLE_ENABLE
+  ITF_NUM_CDC,
+  ITF_NUM_CDC_DATA,
+#endif
   ITF_NUM_TOTAL
 };
 
-#define  CONFIG_TOTAL_LEN  (TUD_CONFIG_DESC_LEN + TUD_HID_DESC_LEN)
+// Largest configuration, with every interface the build has
+#define  CONFIG_TOTAL_LEN  (TUD_CONFIG_DESC_LEN + 2 * TUD_HID_DESC_LEN + PASTE_ENABLE * TUD_HID_INOUT_DESC_LEN + \
+                            TELEMETRY_ENABLE * TUD_HID_DESC_LEN + CONSOLE_ENABLE * TUD_CDC_DESC_LEN)
+
+#define EPNUM_HID         0x81
+#define EPNUM_PASTE_OUT   0x02
+#define EPNUM_PASTE_IN    0x82
+#define EPNUM_TELEMETRY   0x83
+#define EPNUM_CDC_NOTIF   0x84
+#define EPNUM_CDC_OUT     0x05
+#define EPNUM_CDC_IN      0x85
+#define EPNUM_CONSUMER    0x86
+
+// Offset of the keyboard endpoint's bInterval (last byte of its HID block)
+#define KEYBOARD_BINTERVAL_OFFSET  (TUD_CONFIG_DESC_LEN + TUD_HID_DESC_LEN - 1)
+
+// Keyboard and consumer endpoint size, fixed whatever CFG_TUD_HID_EP_BUFSIZE
+// the vendor interfaces need, so the boot keyboard descriptor stays the
+// one BMC64 was tested with (wMaxPacketSize 16)
+#define KEYBOARD_EP_SIZE  16
+#define CONSUMER_EP_SIZE  16
+
+TU_VERIFY_STATIC(KEYBOARD_EP_SIZE <= CFG_TUD_HID_EP_BUFSIZE && CONSUMER_EP_SIZE <= CFG_TUD_HID_EP_BUFSIZE,
+                 "HID endpoint larger than its buffer");
+
+// Telemetry polling interval in ms; the keyboard has its own endpoint
+#define TELEMETRY_POLL_INTERVAL_MS  8
+
+// Consumer polling interval in ms; media keys are not latency critical
+#define CONSUMER_POLL_INTERVAL_MS   10
+
+// Interface blocks, in descriptor order
+// Interface number, string index, protocol, report descriptor len, EP In address, size & polling interval
+// Using HID_ITF_PROTOCOL_KEYBOARD (1) for Boot Keyboard protocol - required for BMC64
+uint8_t const desc_itf_keyboard_boot[] =
+{
+  TUD_HID_DESCRIPTOR(ITF_NUM_HID, 0, HID_ITF_PROTOCOL_KEYBOARD, sizeof(desc_hid_boot_report), EPNUM_HID, KEYBOARD_EP_SIZE, HID_POLL_INTERVAL_MS)
+};
 
-#define EPNUM_HID   0x81
+#if CONFIG_ENABLE
+uint8_t const desc_itf_keyboard[] =
+{
+  TUD_HID_DESCRIPTOR(ITF_NUM_HID, 0, HID_ITF_PROTOCOL_KEYBOARD, sizeof(desc_hid_report), EPNUM_HID, KEYBOARD_EP_SIZE, HID_POLL_INTERVAL_MS)
+};
+#endif
 
-uint8_t const desc_configuration[] =
+uint8_t const desc_itf_consumer[] =
 {
-  // Config number, interface count, string index, total length, attribute, power in mA
-  TUD_CONFIG_DESCRIPTOR(1, ITF_NUM_TOTAL, 0, CONFIG_TOTAL_LEN, TUSB_DESC_CONFIG_ATT_REMOTE_WAKEUP, 100),
+  TUD_HID_DESCRIPTOR(ITF_NUM_CONSUMER, 0, HID_ITF_PROTOCOL_NONE, sizeof(desc_hid_consumer_report), EPNUM_CONSUMER, CONSUMER_EP_SIZE, CONSUMER_POLL_INTERVAL_MS)
+};
+
+#if PASTE_ENABLE
+// Interface number, string index, protocol, report descriptor len, EP Out & In address, size & polling interval
+uint8_t const desc_itf_paste[] =
+{
+  TUD_HID_INOUT_DESCRIPTOR(ITF_NUM_PASTE, 0, HID_ITF_PROTOCOL_NONE, sizeof(desc_hid_paste_report), EPNUM_PASTE_OUT, EPNUM_PASTE_IN, CFG_TUD_HID_EP_BUFSIZE, 1)
+};
+#endif
+
+#if TELEMETRY_ENABLE
+uint8_t const desc_itf_telemetry[] =
+{
+  TUD_HID_DESCRIPTOR(ITF_NUM_TELEMETRY, 0, HID_ITF_PROTOCOL_NONE, sizeof(desc_hid_telemetry_report), EPNUM_TELEMETRY, CFG_TUD_HID_EP_BUFSIZE, TELEMETRY_POLL_INTERVAL_MS)
+};
+#endif
 
-  // Interface number, string index, protocol, report descriptor len, EP In address, size & polling interval
-  // Using HID_ITF_PROTOCOL_KEYBOARD (1) for Boot Keyboard protocol - required for BMC64
-  TUD_HID_DESCRIPTOR(ITF_NUM_HID, 0, HID_ITF_PROTOCOL_KEYBOARD, sizeof(desc_hid_report), EPNUM_HID, CFG_TUD_HID_EP_BUFSIZE, 10)
+#if CONSOLE_ENABLE
+// Interface number, string index, EP notification address and size, EP data address (out, in) and size.
+uint8_t const desc_itf_cdc[] =
+{
+  TUD_CDC_DESCRIPTOR(ITF_NUM_CDC, 4, EPNUM_CDC_NOTIF, 8, EPNUM_CDC_OUT, EPNUM_CDC_IN, CFG_TUD_CDC_EP_BUFSIZE)
 };
+#endif
+
+typedef struct
+{
+  uint8_t itf;              // USB_ITF_* bit
+  uint8_t interfaces;       // Interface descriptors in the block
+  uint8_t const* desc;
+  uint16_t len;
+} itf_block_t;
+
+static itf_block_t const itf_blocks[] =
+{
+  { USB_ITF_KEYBOARD,  1, desc_itf_keyboard_boot, sizeof(desc_itf_keyboard_boot) },
+  { USB_ITF_CONSUMER,  1, desc_itf_consumer,      sizeof(desc_itf_consumer) },
+#if PASTE_ENABLE
+  { USB_ITF_PASTE,     1, desc_itf_paste,         sizeof(desc_itf_paste) },
+#endif
+#if TELEMETRY_ENABLE
+  { USB_ITF_TELEMETRY, 1, desc_itf_telemetry,     sizeof(desc_itf_telemetry) },
+#endif
+#if CONSOLE_ENABLE
+  { USB_ITF_CDC,       2, desc_itf_cdc,           sizeof(desc_itf_cdc) },
+#endif
+};
+
+// Assemble the configuration descriptor of a profile, returns its length.
+// The boot profile comes out as the plain 34-byte boot keyboard descriptor.
+uint16_t usb_descriptors_configuration(uint8_t profile, uint8_t* desc)
+{
+  uint8_t const itfs = usb_profile_interfaces(profile);
+  uint16_t len = TUD_CONFIG_DESC_LEN;
+  uint8_t count = 0;
+
+  for (size_t i = 0; i < TU_ARRAY_SIZE(itf_blocks); i++)
+  {
+    itf_block_t const* block = &itf_blocks[i];
+    if ( !(itfs & block->itf) ) continue;
+
+    uint8_t const* block_desc = block->desc;
+#if CONFIG_ENABLE
+    if ( block->itf == USB_ITF_KEYBOARD && (itfs & USB_ITF_CONFIG) ) block_desc = desc_itf_keyboard;
+#endif
+    memcpy(desc + len, block_desc, block->len);
+    len += block->len;
+    count += block->interfaces;
+  }
+
+  // Config number, interface count, string index, total length, attribute, power in mA
+  uint8_t const header[] = { TUD_CONFIG_DESCRIPTOR(1, count, 0, len, TUSB_DESC_CONFIG_ATT_REMOTE_WAKEUP, 100) };
+  memcpy(desc, header, sizeof(header));
+
+#if CONFIG_ENABLE
+  // The keyboard poll interval can be changed at runtime
+  desc[KEYBOARD_BINTERVAL_OFFSET] = config_poll_interval();
+#endif
+
+  return len;
+}
+
+// Configuration of the active profile, rebuilt for every request so a new
+// profile or poll interval applies from the next enumeration
+static uint8_t desc_configuration[CONFIG_TOTAL_LEN];
 
 #if TUD_OPT_HIGH_SPEED
 // Per USB specs: high speed capable device must report device_qualifier and other_speed_configuration
@@ -157,7 +374,7 @@ uint8_t const* tud_descriptor_other_speed_configuration_cb(uint8_t index)
   (void) index; // for multiple configurations
 
   // other speed config is basically configuration with type = OHER_SPEED_CONFIG
-  memcpy(desc_other_speed_config, desc_configuration, CONFIG_TOTAL_LEN);
+  usb_descriptors_configuration(usb_profile_active(), desc_other_speed_config);
   desc_other_speed_config[1] = TUSB_DESC_OTHER_SPEED_CONFIG;
 
   // this example use the same configuration for both high and full speed mode
@@ -173,7 +390,7 @@ uint8_t const * tud_descriptor_configuration_cb(uint8_t index)
 {
   (void) index; // for multiple configurations
 
-  // This example use the same configuration for both high and full speed mode
+  usb_descriptors_configuration(usb_profile_active(), desc_configuration);
   return desc_configuration;
 }
 
@@ -187,6 +404,7 @@ enum {
   STRID_MANUFACTURER,
   STRID_PRODUCT,
   STRID_SERIAL,
+  STRID_CDC,
 };
 
 // array of pointer to string descriptors
@@ -196,6 +414,7 @@ char const *string_desc_arr[] =
   "PS2USB Bridge",               // 1: Manufacturer
   "PS/2 to USB Keyboard",        // 2: Product
   NULL,                          // 3: Serials will use unique ID if possible
+  "PS/2 Bridge Console",          // 4: CDC Interface
 };
 
 static uint16_t _desc_str[32 + 1];
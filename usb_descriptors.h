@@ -31,4 +31,28 @@
 // Byte 1: Reserved (0)
 // Bytes 2-7: Up to 6 simultaneous key codes
 
+// HID interface instances, in descriptor order (include tusb.h first)
+// Each USB profile uses a prefix of this list (see usb_profile.h), so an
+// instance keeps its number; interfaces a profile lacks are never ready
+enum {
+  HID_INSTANCE_KEYBOARD = 0,
+  HID_INSTANCE_CONSUMER,
+#if PASTE_ENABLE
+  HID_INSTANCE_PASTE,
+#endif
+#if TELEMETRY_ENABLE
+  HID_INSTANCE_TELEMETRY,
+#endif
+};
+
+// Keyboard endpoint polling interval (bInterval) in ms
+// Queued reports and macro steps go out at most once per interval
+#ifndef HID_POLL_INTERVAL_MS
+#define HID_POLL_INTERVAL_MS  10
+#endif
+
+// Assemble the configuration descriptor of a USB profile (see usb_profile.h)
+// into desc, which must hold the largest one; returns its length
+uint16_t usb_descriptors_configuration(uint8_t profile, uint8_t* desc);
+
 #endif /* USB_DESCRIPTORS_H_ */
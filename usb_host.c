@@ -0,0 +1,316 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * USB Keyboard Input
+ *
+ * Each keyboard keeps the keys of each report ID it uses separately, so a
+ * report only changes the keys it carries. All keyboards feed the one key
+ * pipeline, so what is passed on is the change in the union over every
+ * report ID of every attached keyboard: a key held on two keyboards is
+ * released when the last lets go of it.
+ */
+
+#include "usb_host.h"
+#include <string.h>
+
+typedef struct {
+    bool attached;
+    usb_host_layout_t layout;
+    uint8_t ids[USB_HOST_REPORT_IDS];
+    uint8_t id_count;
+    uint32_t keys[USB_HOST_REPORT_IDS][8];  // Per report ID
+    uint32_t down[8];                       // Union over its report IDs
+} keyboard_t;
+
+static keyboard_t keyboards[USB_HOST_KEYBOARDS];
+static uint32_t passed_down[8];             // Union over all keyboards, as passed on
+static key_sink_t key_sink;
+static usb_host_stats_t stats;
+
+static inline bool key_bit(const uint32_t* keys, unsigned key) {
+    return (keys[key >> 5] >> (key & 31)) & 1u;
+}
+
+static inline void set_key(uint32_t* keys, unsigned key) {
+    keys[key >> 5] |= 1u << (key & 31);
+}
+
+//--------------------------------------------------------------------+
+// Report Descriptor
+//--------------------------------------------------------------------+
+
+typedef struct {
+    uint16_t page;
+    int32_t logical_min;
+    uint8_t report_id;
+    uint8_t size;
+    uint8_t count;
+} globals_t;
+
+// Input bits so far in each report
+typedef struct {
+    uint8_t id;
+    uint16_t bits;
+} report_offset_t;
+
+static uint16_t* input_offset(report_offset_t* offsets, uint8_t* count, uint8_t id) {
+    for (uint8_t i = 0; i < *count; i++) {
+        if (offsets[i].id == id) return &offsets[i].bits;
+    }
+    if (*count == USB_HOST_FIELDS) return NULL;
+    offsets[*count].id = id;
+    offsets[*count].bits = 0;
+    return &offsets[(*count)++].bits;
+}
+
+static bool id_listed(const usb_host_layout_t* layout, uint8_t id) {
+    for (uint8_t i = 0; i < layout->count; i++) {
+        if (layout->fields[i].report_id == id) return true;
+    }
+    return false;
+}
+
+// Distinct report IDs among the fields so far
+static unsigned id_count(const usb_host_layout_t* layout) {
+    unsigned n = 0;
+    for (uint8_t i = 0; i < layout->count; i++) {
+        bool first = true;
+        for (uint8_t j = 0; j < i; j++) {
+            if (layout->fields[j].report_id == layout->fields[i].report_id) first = false;
+        }
+        n += first;
+    }
+    return n;
+}
+
+// An input item with the current globals and usages
+static void input_item(usb_host_layout_t* layout, const globals_t* g, uint32_t flags,
+                       uint32_t usage, bool have_usage, uint16_t* offset) {
+    bool constant = flags & 0x01;
+    bool variable = flags & 0x02;
+    uint16_t page = (uint16_t) (usage >> 16);
+
+    if (constant || !have_usage || page != USB_HOST_PAGE_KEYBOARD) return;
+    if ((usage & 0xFFFF) > 0xFF || layout->count == USB_HOST_FIELDS) return;
+    if (variable ? g->size != 1 : (g->size == 0 || g->size > 16)) return;
+
+    // A new report ID only if there is room to keep its keys
+    if (!id_listed(layout, g->report_id) && id_count(layout) == USB_HOST_REPORT_IDS) return;
+
+    usb_host_field_t* field = &layout->fields[layout->count++];
+    field->report_id = g->report_id;
+    field->usage_min = (uint8_t) usage;
+    field->logical_min = g->logical_min < 0 ? 0 : (uint8_t) g->logical_min;
+    field->array = !variable;
+    field->size = g->size;
+    field->count = g->count;
+    field->bit_offset = *offset;
+}
+
+bool usb_host_parse_layout(const uint8_t* desc, uint16_t len, usb_host_layout_t* layout) {
+    globals_t g = { 0 };
+    globals_t pushed = { 0 };
+    report_offset_t offsets[USB_HOST_FIELDS];
+    uint8_t offset_count = 0;
+    uint32_t usage = 0;         // First usage or usage minimum, page in the high half
+    bool have_usage = false;
+
+    memset(layout, 0, sizeof(*layout));
+
+    for (uint16_t i = 0; i < len;) {
+        uint8_t prefix = desc[i++];
+        if (prefix == 0xFE) {
+            // Long item: data size, tag, data
+            if (i >= len) break;
+            i = (uint16_t) (i + 2 + desc[i]);
+            continue;
+        }
+
+        uint8_t size = prefix & 3;
+        if (size == 3) size = 4;
+        if (i + size > len) break;
+        uint32_t value = 0;
+        for (uint8_t b = 0; b < size; b++) value |= (uint32_t) desc[i + b] << (8 * b);
+        int32_t signed_value = (size > 0 && size < 4 && (value >> (8 * size - 1)) & 1)
+                             ? (int32_t) (value | (~0u << (8 * size))) : (int32_t) value;
+        i = (uint16_t) (i + size);
+
+        uint8_t type = (prefix >> 2) & 3;
+        uint8_t tag = prefix >> 4;
+
+        if (type == 0) {
+            // Main items; only input items take report bits we read
+            if (tag == 0x8) {
+                uint16_t* offset = input_offset(offsets, &offset_count, g.report_id);
+                if (offset == NULL) break;
+                input_item(layout, &g, value, usage, have_usage, offset);
+                *offset = (uint16_t) (*offset + g.size * g.count);
+            }
+            have_usage = false;
+        } else if (type == 1) {
+            switch (tag) {
+                case 0x0: g.page = (uint16_t) value; break;
+                case 0x1: g.logical_min = signed_value; break;
+                case 0x7: g.size = (uint8_t) value; break;
+                case 0x8: g.report_id = (uint8_t) value; layout->report_ids = true; break;
+                case 0x9: g.count = (uint8_t) value; break;
+                case 0xA: pushed = g; break;
+                case 0xB: g = pushed; break;
+                default: break;
+            }
+        } else if (type == 2 && (tag == 0x0 || tag == 0x1)) {
+            // Usage or usage minimum; a 4-byte usage carries its own page
+            uint32_t extended = size == 4 ? value : ((uint32_t) g.page << 16 | (value & 0xFFFF));
+            if (tag == 0x1 || !have_usage) usage = extended;
+            have_usage = true;
+        }
+    }
+
+    return layout->count > 0;
+}
+
+void usb_host_boot_layout(usb_host_layout_t* layout) {
+    static const usb_host_field_t boot[2] = {
+        // Modifier bits E0-E7, a reserved byte, then six keycodes
+        { .report_id = 0, .usage_min = 0xE0, .logical_min = 0, .array = false, .size = 1, .count = 8, .bit_offset = 0 },
+        { .report_id = 0, .usage_min = 0x00, .logical_min = 0, .array = true, .size = 8, .count = 6, .bit_offset = 16 },
+    };
+    memset(layout, 0, sizeof(*layout));
+    memcpy(layout->fields, boot, sizeof(boot));
+    layout->count = 2;
+}
+
+//--------------------------------------------------------------------+
+// Key State
+//--------------------------------------------------------------------+
+
+static uint32_t read_bits(const uint8_t* data, uint16_t len, uint32_t offset, uint8_t size) {
+    uint32_t value = 0;
+    for (uint8_t b = 0; b < size; b++) {
+        uint32_t bit = offset + b;
+        if ((bit >> 3) >= len) break;
+        value |= (uint32_t) ((data[bit >> 3] >> (bit & 7)) & 1u) << b;
+    }
+    return value;
+}
+
+// Keys of one report; false for an error rollover report
+static bool decode(const usb_host_layout_t* layout, uint8_t id, const uint8_t* data, uint16_t len,
+                   uint32_t* keys) {
+    memset(keys, 0, 8 * sizeof(uint32_t));
+    for (uint8_t f = 0; f < layout->count; f++) {
+        const usb_host_field_t* field = &layout->fields[f];
+        if (field->report_id != id) continue;
+
+        for (uint8_t i = 0; i < field->count; i++) {
+            uint32_t value = read_bits(data, len, field->bit_offset + (uint32_t) i * field->size, field->size);
+            if (!field->array) {
+                // Bits for codes 0-3 (no key, error codes) say nothing
+                uint32_t key = field->usage_min + i;
+                if (value && key > 0x03 && key <= 0xFF) set_key(keys, key);
+                continue;
+            }
+            if (value < field->logical_min) continue;
+            uint32_t key = field->usage_min + (value - field->logical_min);
+            if (key == 0 || key > 0xFF) continue;
+            // Error rollover, POST fail, undefined error
+            if (key <= 0x03) return false;
+            set_key(keys, key);
+        }
+    }
+    return true;
+}
+
+// Pass on the change in the keys held on all attached keyboards
+static void pass_on(uint32_t now_ms) {
+    // Keycode ranges, end exclusive
+    static const uint16_t order[4][2] = {
+        { 0x00, 0xE0 }, { 0xE0, 0x100 },    // Releases: keys, then modifiers
+        { 0xE0, 0x100 }, { 0x00, 0xE0 },    // Presses: modifiers, then keys
+    };
+
+    uint32_t now_down[8] = { 0 };
+    for (uint8_t slot = 0; slot < USB_HOST_KEYBOARDS; slot++) {
+        if (!keyboards[slot].attached) continue;
+        for (int w = 0; w < 8; w++) now_down[w] |= keyboards[slot].down[w];
+    }
+
+    for (int pass = 0; pass < 4; pass++) {
+        bool pressed = pass >= 2;
+        for (unsigned key = order[pass][0]; key < order[pass][1]; key++) {
+            bool was = key_bit(passed_down, key);
+            bool is = key_bit(now_down, key);
+            if (was == is || is != pressed) continue;
+            stats.events++;
+            if (key_sink) key_sink((uint8_t) key, pressed, now_ms);
+        }
+    }
+    memcpy(passed_down, now_down, sizeof(passed_down));
+}
+
+void usb_host_init(key_sink_t sink) {
+    key_sink = sink;
+    memset(keyboards, 0, sizeof(keyboards));
+    memset(passed_down, 0, sizeof(passed_down));
+    memset(&stats, 0, sizeof(stats));
+}
+
+void usb_host_attach(uint8_t slot, const usb_host_layout_t* layout) {
+    if (slot >= USB_HOST_KEYBOARDS) return;
+    keyboard_t* kbd = &keyboards[slot];
+    memset(kbd, 0, sizeof(*kbd));
+    kbd->layout = *layout;
+    for (uint8_t f = 0; f < layout->count; f++) {
+        uint8_t id = layout->fields[f].report_id;
+        if (memchr(kbd->ids, id, kbd->id_count) == NULL && kbd->id_count < USB_HOST_REPORT_IDS) {
+            kbd->ids[kbd->id_count++] = id;
+        }
+    }
+    kbd->attached = true;
+}
+
+void usb_host_detach(uint8_t slot, uint32_t now_ms) {
+    if (slot >= USB_HOST_KEYBOARDS || !keyboards[slot].attached) return;
+    keyboards[slot].attached = false;
+    pass_on(now_ms);
+}
+
+void usb_host_report(uint8_t slot, const uint8_t* report, uint16_t len, uint32_t now_ms) {
+    if (slot >= USB_HOST_KEYBOARDS || !keyboards[slot].attached || len == 0) return;
+    keyboard_t* kbd = &keyboards[slot];
+    stats.reports++;
+
+    uint8_t id = 0;
+    if (kbd->layout.report_ids) {
+        id = report[0];
+        report++;
+        len--;
+    }
+    const uint8_t* listed = memchr(kbd->ids, id, kbd->id_count);
+    if (listed == NULL) {
+        stats.unmatched++;
+        return;
+    }
+
+    uint32_t keys[8];
+    if (!decode(&kbd->layout, id, report, len, keys)) {
+        stats.rollovers++;
+        return;
+    }
+    memcpy(kbd->keys[listed - kbd->ids], keys, sizeof(keys));
+
+    memset(kbd->down, 0, sizeof(kbd->down));
+    for (uint8_t r = 0; r < kbd->id_count; r++) {
+        for (int w = 0; w < 8; w++) kbd->down[w] |= kbd->keys[r][w];
+    }
+    pass_on(now_ms);
+}
+
+uint8_t usb_host_leds_from_ps2(uint8_t ps2_leds) {
+    return (uint8_t) (((ps2_leds & 0x02) ? 0x01 : 0) |     // Num Lock
+                      ((ps2_leds & 0x04) ? 0x02 : 0) |     // Caps Lock
+                      ((ps2_leds & 0x01) ? 0x04 : 0));     // Scroll Lock
+}
+
+const usb_host_stats_t* usb_host_stats(void) {
+    return &stats;
+}
@@ -0,0 +1,125 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * USB Keyboard Input Header
+ *
+ * Optional input (USB_HOST_ENABLE) for USB keyboards, the reverse of the
+ * bridge's usual direction: with the PS/2 device output (PS2_DEV_ENABLE)
+ * a modern keyboard types into a PS/2-only machine. TinyUSB runs a host
+ * port over PIO-USB on core 1 (D+ on USB_HOST_DP_PIN, D- on the next pin,
+ * hubs allowed). Each keyboard report becomes key presses and releases
+ * that enter the key pipeline where PS/2 scancodes do, so layers, combos,
+ * tap-hold and macros apply, and the result goes to both outputs.
+ *
+ * Keyboards with a boot interface are read in boot protocol. Others are
+ * read in report protocol, with the key fields found in the report
+ * descriptor: bitmaps (one bit per key, e.g. modifiers or NKRO) and
+ * arrays of keycodes, in any number of report IDs. A report with an
+ * error rollover code is ignored, keeping the keys as they were.
+ *
+ * usb_host.c holds the descriptor parser and key state without hardware
+ * dependencies, so it runs on the host (tests/test_usb_host.c);
+ * usb_host_pico.c runs the USB host.
+ */
+
+#ifndef USB_HOST_H_
+#define USB_HOST_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "key_event.h"
+
+#ifndef USB_HOST_ENABLE
+#define USB_HOST_ENABLE         0
+#endif
+
+// PIO-USB port: D+ here, D- on the next pin
+#ifndef USB_HOST_DP_PIN
+#define USB_HOST_DP_PIN         20
+#endif
+
+// System clock for PIO-USB, a multiple of 12 MHz. clk_peri follows
+// clk_sys, so it is set before board_init() brings up the UART.
+#ifndef USB_HOST_SYS_KHZ
+#define USB_HOST_SYS_KHZ        120000
+#endif
+
+// Keyboard interfaces read at once
+#ifndef USB_HOST_KEYBOARDS
+#define USB_HOST_KEYBOARDS      4
+#endif
+
+// Key fields and report IDs with key fields, per keyboard
+#define USB_HOST_FIELDS         8
+#define USB_HOST_REPORT_IDS     4
+
+// Keyboard/keypad usage page
+#define USB_HOST_PAGE_KEYBOARD  0x07
+
+// A run of key items in an input report
+typedef struct {
+    uint8_t report_id;          // 0 when the device uses no report IDs
+    uint8_t usage_min;          // Keycode of the first bit, or of array value logical_min
+    uint8_t logical_min;        // Array value of usage_min
+    bool array;                 // Items are keycodes; otherwise one bit per keycode
+    uint8_t size;               // Bits per item
+    uint8_t count;              // Items
+    uint16_t bit_offset;        // From the start of the data, after any report ID
+} usb_host_field_t;
+
+typedef struct {
+    usb_host_field_t fields[USB_HOST_FIELDS];
+    uint8_t count;
+    bool report_ids;            // Reports start with their ID
+} usb_host_layout_t;
+
+typedef struct {
+    uint32_t reports;
+    uint32_t rollovers;         // Reports ignored for an error rollover code
+    uint32_t unmatched;         // Reports with no key fields (other report IDs)
+    uint32_t events;            // Key presses and releases passed on
+} usb_host_stats_t;
+
+// Clear all keyboards; key events go to sink
+void usb_host_init(key_sink_t sink);
+
+// Layout of the 8-byte boot protocol report
+void usb_host_boot_layout(usb_host_layout_t* layout);
+
+// Find the key fields of a report descriptor; false if there are none
+bool usb_host_parse_layout(const uint8_t* desc, uint16_t len, usb_host_layout_t* layout);
+
+// A keyboard in slot (0 to USB_HOST_KEYBOARDS - 1) appeared or went away;
+// the keys it held are released unless another keyboard holds them too
+void usb_host_attach(uint8_t slot, const usb_host_layout_t* layout);
+void usb_host_detach(uint8_t slot, uint32_t now_ms);
+
+// An input report from the keyboard in slot: releases (keys, then
+// modifiers), then presses (modifiers, then keys)
+void usb_host_report(uint8_t slot, const uint8_t* report, uint16_t len, uint32_t now_ms);
+
+// HID LED output bits (Num, Caps, Scroll) from PS/2 ones (Scroll, Num, Caps)
+uint8_t usb_host_leds_from_ps2(uint8_t ps2_leds);
+
+const usb_host_stats_t* usb_host_stats(void);
+
+#if USB_HOST_ENABLE
+
+// Device side (usb_host_pico.c): set the system clock (before
+// board_init()), start the host on core 1, pass reports it received to
+// the key pipeline from the main loop, and set the LEDs of attached
+// keyboards (HID bits)
+void usb_host_clock_init(void);
+void usb_host_start(void);
+void usb_host_task(void);
+void usb_host_set_leds(uint8_t leds);
+
+#else
+
+static inline void usb_host_clock_init(void) {}
+static inline void usb_host_start(void) {}
+static inline void usb_host_task(void) {}
+static inline void usb_host_set_leds(uint8_t leds) { (void) leds; }
+
+#endif
+
+#endif /* USB_HOST_H_ */
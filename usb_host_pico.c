@@ -0,0 +1,224 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * USB Keyboard Input - PIO-USB Host on Core 1
+ *
+ * PIO-USB does its frame timing in a timer interrupt and busy-waits for
+ * device responses, so the host stack gets core 1 to itself: nothing
+ * there is delayed by the PS/2 line interrupt or the main loop, and the
+ * main loop is not stalled by USB transfers. TinyUSB's host callbacks run
+ * on core 1 and hand attach, report and detach messages to core 0 through
+ * a multicore queue; usb_host_task() feeds them into the key pipeline.
+ *
+ * Core 1 runs from flash, so it is parked (multicore lockout) while the
+ * settings store erases or programs it.
+ */
+
+#include "usb_host.h"
+
+#if USB_HOST_ENABLE
+
+#include "pico/stdlib.h"
+#include "pico/multicore.h"
+#include "pico/util/queue.h"
+#include "hardware/clocks.h"
+#include "pio_usb.h"
+#include "tusb.h"
+#include "debounce.h"
+#include "ps2_dev.h"
+#include "clock_gov.h"
+#include <string.h>
+
+#if CLOCK_GOV_ENABLE
+#error USB_HOST_ENABLE needs a fixed system clock (a multiple of 12 MHz); CLOCK_GOV_ENABLE changes it
+#endif
+
+#if USB_HOST_SYS_KHZ % 12000 != 0
+#error USB_HOST_SYS_KHZ must be a multiple of 12 MHz
+#endif
+
+// Messages waiting for the main loop; a full queue makes core 1 wait
+#define MESSAGES        16
+
+typedef enum {
+    MSG_ATTACH = 0,
+    MSG_REPORT,
+    MSG_DETACH,
+} message_type_t;
+
+typedef struct {
+    uint8_t type;
+    uint8_t slot;
+    uint16_t len;
+    union {
+        usb_host_layout_t layout;
+        uint8_t report[CFG_TUH_HID_EPIN_BUFSIZE];
+    };
+} message_t;
+
+static queue_t messages;
+
+// Core 1 only: which interface each slot holds (address 0 = free), and
+// its LEDs
+static struct {
+    uint8_t dev_addr;
+    uint8_t instance;
+    uint8_t leds_sent;                  // Last LED state the stack took, 0xFF = none
+    uint8_t leds_report;                // LED transfer buffer, must outlive it
+    bool leds_busy;                     // LED transfer in flight
+} slots[USB_HOST_KEYBOARDS];
+
+static volatile uint8_t leds = 0;       // HID bits, set from core 0
+static uint8_t ps2_leds_seen = 0;       // Core 0: PS/2 host LED state passed on
+
+static int find_slot(uint8_t dev_addr, uint8_t instance) {
+    for (int i = 0; i < USB_HOST_KEYBOARDS; i++) {
+        if (slots[i].dev_addr == dev_addr && slots[i].instance == instance) return i;
+    }
+    return -1;
+}
+
+//--------------------------------------------------------------------+
+// Core 1
+//--------------------------------------------------------------------+
+
+// LED output reports to each keyboard not showing the current state. A
+// keyboard is only up to date once the stack took its transfer; a busy
+// control pipe or a failed transfer is retried on a later pass.
+static void send_leds(void) {
+    uint8_t state = leds;
+    for (int i = 0; i < USB_HOST_KEYBOARDS; i++) {
+        if (slots[i].dev_addr == 0 || slots[i].leds_busy || slots[i].leds_sent == state) continue;
+
+        slots[i].leds_report = state;
+        if (tuh_hid_set_report(slots[i].dev_addr, slots[i].instance, 0, HID_REPORT_TYPE_OUTPUT,
+                               &slots[i].leds_report, 1)) {
+            slots[i].leds_sent = state;
+            slots[i].leds_busy = true;
+        }
+    }
+}
+
+static void core1_main(void) {
+    multicore_lockout_victim_init();
+
+    pio_usb_configuration_t config = PIO_USB_DEFAULT_CONFIG;
+    config.pin_dp = USB_HOST_DP_PIN;
+    tuh_configure(BOARD_TUH_RHPORT, TUH_CFGID_RPI_PIO_USB_CONFIGURATION, &config);
+    tuh_init(BOARD_TUH_RHPORT);
+
+    while (true) {
+        tuh_task();
+        send_leds();
+    }
+}
+
+// Boot keyboards in boot protocol; any other interface only if its
+// report descriptor has key fields (mice and media controls have none)
+void tuh_hid_mount_cb(uint8_t dev_addr, uint8_t instance, uint8_t const* desc_report, uint16_t desc_len) {
+    static message_t msg;
+
+    bool boot = tuh_hid_interface_protocol(dev_addr, instance) == HID_ITF_PROTOCOL_KEYBOARD &&
+                tuh_hid_get_protocol(dev_addr, instance) == HID_PROTOCOL_BOOT;
+    if (boot) {
+        usb_host_boot_layout(&msg.layout);
+    } else if (!usb_host_parse_layout(desc_report, desc_len, &msg.layout)) {
+        return;
+    }
+
+    int slot = 0;
+    while (slot < USB_HOST_KEYBOARDS && slots[slot].dev_addr != 0) slot++;
+    if (slot == USB_HOST_KEYBOARDS) return;
+    slots[slot].dev_addr = dev_addr;
+    slots[slot].instance = instance;
+    slots[slot].leds_sent = 0xFF;       // Bring its LEDs in line with the others
+    slots[slot].leds_busy = false;
+
+    msg.type = MSG_ATTACH;
+    msg.slot = (uint8_t) slot;
+    queue_add_blocking(&messages, &msg);
+    tuh_hid_receive_report(dev_addr, instance);
+}
+
+void tuh_hid_umount_cb(uint8_t dev_addr, uint8_t instance) {
+    int slot = find_slot(dev_addr, instance);
+    if (slot < 0) return;
+    slots[slot].dev_addr = 0;
+
+    message_t msg = { .type = MSG_DETACH, .slot = (uint8_t) slot };
+    queue_add_blocking(&messages, &msg);
+}
+
+// len is 0 if the LED transfer failed; it is then sent again
+void tuh_hid_set_report_complete_cb(uint8_t dev_addr, uint8_t instance, uint8_t report_id,
+                                    uint8_t report_type, uint16_t len) {
+    (void) report_id;
+    (void) report_type;
+    int slot = find_slot(dev_addr, instance);
+    if (slot < 0) return;
+
+    slots[slot].leds_busy = false;
+    if (len == 0) slots[slot].leds_sent = 0xFF;
+}
+
+void tuh_hid_report_received_cb(uint8_t dev_addr, uint8_t instance, uint8_t const* report, uint16_t len) {
+    static message_t msg;
+    int slot = find_slot(dev_addr, instance);
+
+    if (slot >= 0 && len > 0) {
+        msg.type = MSG_REPORT;
+        msg.slot = (uint8_t) slot;
+        msg.len = len < sizeof(msg.report) ? len : sizeof(msg.report);
+        memcpy(msg.report, report, msg.len);
+        queue_add_blocking(&messages, &msg);
+    }
+    tuh_hid_receive_report(dev_addr, instance);
+}
+
+//--------------------------------------------------------------------+
+// Core 0
+//--------------------------------------------------------------------+
+
+// Changing clk_sys moves clk_peri with it, so this runs before board_init()
+// sets up the UART; a later change would leave its baud rate wrong
+void usb_host_clock_init(void) {
+    set_sys_clock_khz(USB_HOST_SYS_KHZ, true);
+}
+
+void usb_host_start(void) {
+    usb_host_init(debounce_process);
+    queue_init(&messages, sizeof(message_t), MESSAGES);
+    multicore_launch_core1(core1_main);
+}
+
+// All waiting messages: a report is a handful of key events
+void usb_host_task(void) {
+    static message_t msg;
+    uint32_t now_ms = to_ms_since_boot(get_absolute_time());
+
+    while (queue_try_remove(&messages, &msg)) {
+        switch (msg.type) {
+            case MSG_ATTACH:
+                usb_host_attach(msg.slot, &msg.layout);
+                break;
+            case MSG_REPORT:
+                usb_host_report(msg.slot, msg.report, msg.len, now_ms);
+                break;
+            default:
+                usb_host_detach(msg.slot, now_ms);
+                break;
+        }
+    }
+
+    // Lock keys set by the PS/2 host go to the USB keyboards
+    uint8_t ps2_leds = ps2_dev_leds();
+    if (ps2_leds != ps2_leds_seen) {
+        ps2_leds_seen = ps2_leds;
+        usb_host_set_leds(usb_host_leds_from_ps2(ps2_leds));
+    }
+}
+
+void usb_host_set_leds(uint8_t hid_leds) {
+    leds = hid_leds;
+}
+
+#endif /* USB_HOST_ENABLE */
@@ -0,0 +1,75 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * USB Profile Implementation
+ */
+
+#include "usb_profile.h"
+#include "hid_keycodes.h"
+
+#if USB_PROFILE_DEFAULT >= USB_PROFILE_COUNT || \
+    (USB_PROFILE_DEFAULT == USB_PROFILE_DEBUG && !USB_PROFILE_DEBUG_AVAILABLE)
+#error USB_PROFILE_DEFAULT names a profile this build does not have
+#endif
+
+static uint8_t active = USB_PROFILE_DEFAULT;
+static uint8_t requested = USB_PROFILE_DEFAULT;
+static bool change_pending = false;
+
+// Selection keys whose press was consumed, so their release is too
+static uint8_t keys_consumed = 0;
+
+static const uint8_t profile_itfs[USB_PROFILE_COUNT] = {
+    [USB_PROFILE_BOOT]     = USB_PROFILE_BOOT_ITFS,
+    [USB_PROFILE_STANDARD] = USB_PROFILE_STANDARD_ITFS,
+    [USB_PROFILE_DEBUG]    = USB_PROFILE_DEBUG_ITFS,
+};
+
+uint8_t usb_profile_interfaces(uint8_t profile) {
+    return profile < USB_PROFILE_COUNT ? profile_itfs[profile] : USB_PROFILE_BOOT_ITFS;
+}
+
+uint8_t usb_profile_active(void) {
+    return active;
+}
+
+bool usb_profile_request(uint8_t profile) {
+    if (profile >= USB_PROFILE_COUNT) return false;
+    if (profile == USB_PROFILE_DEBUG && !USB_PROFILE_DEBUG_AVAILABLE) {
+        profile = USB_PROFILE_STANDARD;
+    }
+    requested = profile;
+    return true;
+}
+
+uint8_t usb_profile_requested(void) {
+    return requested;
+}
+
+void usb_profile_apply(void) {
+    active = requested;
+    change_pending = false;
+}
+
+bool usb_profile_key(uint8_t key, bool pressed, uint32_t time_ms) {
+    if (key < HID_KEY_F1 || key >= HID_KEY_F1 + USB_PROFILE_COUNT) return false;
+
+    uint8_t bit = (uint8_t) (1u << (key - HID_KEY_F1));
+    if (!pressed) {
+        if (!(keys_consumed & bit)) return false;
+        keys_consumed &= (uint8_t) ~bit;
+        return true;
+    }
+
+    if (time_ms >= USB_PROFILE_SELECT_MS) return false;
+
+    keys_consumed |= bit;
+    usb_profile_request((uint8_t) (key - HID_KEY_F1));
+    if (requested != active) change_pending = true;
+    return true;
+}
+
+bool usb_profile_take_change(void) {
+    bool pending = change_pending;
+    change_pending = false;
+    return pending;
+}
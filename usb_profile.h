@@ -0,0 +1,114 @@
+/*
+ * PS/2 to USB HID Keyboard Bridge
+ * USB Profile Header
+ *
+ * The bridge can enumerate as one of several interface sets. The profile is
+ * picked at boot from the build default, a configuration setting or a key
+ * pressed right after power-on, and every interface set has its own
+ * product ID so hosts do not reuse a driver binding made for another set.
+ *
+ * Interfaces always appear in the same order, and each profile's HID
+ * interfaces are a prefix of that order, so HID instance numbers (see
+ * usb_descriptors.h) are the same in every profile.
+ *
+ * This module has no USB dependencies and can be built natively.
+ */
+
+#ifndef USB_PROFILE_H_
+#define USB_PROFILE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Optional interfaces, as in tusb_config.h
+#ifndef PASTE_ENABLE
+#define PASTE_ENABLE            0
+#endif
+#ifndef TELEMETRY_ENABLE
+#define TELEMETRY_ENABLE        0
+#endif
+#ifndef CONSOLE_ENABLE
+#define CONSOLE_ENABLE          0
+#endif
+#ifndef CONFIG_ENABLE
+#define CONFIG_ENABLE           0
+#endif
+
+// Profiles
+#define USB_PROFILE_BOOT        0   // Boot keyboard only, as BMC64 expects
+#define USB_PROFILE_STANDARD    1   // Keyboard plus consumer and system control
+#define USB_PROFILE_DEBUG       2   // Everything built: paste, telemetry, console
+#define USB_PROFILE_COUNT       3
+
+// Interfaces, in descriptor order
+#define USB_ITF_KEYBOARD        0x01
+#define USB_ITF_CONSUMER        0x02
+#define USB_ITF_PASTE           0x04
+#define USB_ITF_TELEMETRY       0x08
+#define USB_ITF_CDC             0x10
+#define USB_ITF_CONFIG          0x20    // Not an interface: keyboard carries the configuration feature report
+
+#define USB_PROFILE_BOOT_ITFS       (USB_ITF_KEYBOARD)
+#define USB_PROFILE_STANDARD_ITFS   (USB_ITF_KEYBOARD | USB_ITF_CONSUMER | \
+                                     (CONFIG_ENABLE ? USB_ITF_CONFIG : 0))
+#define USB_PROFILE_DEBUG_ITFS      (USB_PROFILE_STANDARD_ITFS | \
+                                     (PASTE_ENABLE ? USB_ITF_PASTE : 0) | \
+                                     (TELEMETRY_ENABLE ? USB_ITF_TELEMETRY : 0) | \
+                                     (CONSOLE_ENABLE ? USB_ITF_CDC : 0))
+
+// The debug profile only exists when it adds something to the standard one
+#define USB_PROFILE_DEBUG_AVAILABLE (PASTE_ENABLE || TELEMETRY_ENABLE || CONSOLE_ENABLE)
+
+// Profile at startup: the richest one the build has
+#ifndef USB_PROFILE_DEFAULT
+#if USB_PROFILE_DEBUG_AVAILABLE
+#define USB_PROFILE_DEFAULT     USB_PROFILE_DEBUG
+#elif CONFIG_ENABLE
+#define USB_PROFILE_DEFAULT     USB_PROFILE_STANDARD
+#else
+#define USB_PROFILE_DEFAULT     USB_PROFILE_BOOT
+#endif
+#endif
+
+// Keys pressed within this time after power-on select a profile (and are
+// not typed): F1 boot, F2 standard, F3 debug
+#ifndef USB_PROFILE_SELECT_MS
+#define USB_PROFILE_SELECT_MS   2000
+#endif
+
+/* Product ID bitmap, one per interface set:
+ *   [MSB]   CONSUMER | TELEMETRY | HID count (3 bits) | - | CDC   [LSB]
+ * The boot profile keeps 0x4004, the ID of the original keyboard-only
+ * firmware.
+ */
+#define USB_PROFILE_PID(itfs)   (0x4000 | \
+    (((itfs) & USB_ITF_CDC) ? 0x01 : 0) | \
+    ((1 + !!((itfs) & USB_ITF_CONSUMER) + !!((itfs) & USB_ITF_PASTE) + \
+      !!((itfs) & USB_ITF_TELEMETRY)) << 2) | \
+    (((itfs) & USB_ITF_TELEMETRY) ? 0x20 : 0) | \
+    (((itfs) & USB_ITF_CONSUMER) ? 0x40 : 0))
+
+// Interfaces (USB_ITF_*) of a profile
+uint8_t usb_profile_interfaces(uint8_t profile);
+
+// Profile used for the current enumeration
+uint8_t usb_profile_active(void);
+
+// Choose the profile for the next enumeration; an unknown profile is
+// rejected, the debug profile falls back to standard if it is not built
+bool usb_profile_request(uint8_t profile);
+
+// Profile for the next enumeration
+uint8_t usb_profile_requested(void);
+
+// Make the requested profile active (call while disconnected)
+void usb_profile_apply(void);
+
+// Check a key event for a profile selection key; returns true if the key
+// was consumed. Selecting a new profile asks for re-enumeration.
+bool usb_profile_key(uint8_t key, bool pressed, uint32_t time_ms);
+
+// True once after a selection key picked a profile other than the active one
+bool usb_profile_take_change(void);
+
+#endif /* USB_PROFILE_H_ */